@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "address_space.h"
+
+#ifndef PROCMAP_QUERY
+//headers older than Linux 6.11
+struct procmap_query {
+    __u64 size;
+    __u64 query_flags;
+    __u64 query_addr;
+    __u64 vma_start;
+    __u64 vma_end;
+    __u64 vma_flags;
+    __u64 vma_page_size;
+    __u64 vma_offset;
+    __u64 inode;
+    __u32 dev_major;
+    __u32 dev_minor;
+    __u32 vma_name_size;
+    __u32 build_id_size;
+    __u64 vma_name_addr;
+    __u64 build_id_addr;
+};
+#define PROCMAP_QUERY _IOWR('f', 17, struct procmap_query)
+#endif
+
+static constexpr uint64_t page_mask = ~uint64_t{0xfff};
+static constexpr uint64_t query_writable = 0x02; //PROCMAP_QUERY_VMA_WRITABLE
+
+address_space::~address_space() {
+    if (m_maps_fd >= 0) {
+        close(m_maps_fd);
+    }
+}
+
+void address_space::refresh() {
+    m_maps.clear();
+    for (auto &m: read_memory_maps(m_pid)) {
+        m_maps.emplace(m.start, std::move(m));
+    }
+    m_stale = false;
+    ++m_refreshes;
+}
+
+const mapping *address_space::find(uint64_t addr) {
+    if (m_stale) {
+        refresh();
+    }
+    auto it = m_maps.upper_bound(addr);
+    if (it == m_maps.begin()) {
+        return nullptr;
+    }
+    --it;
+    return it->second.contains(addr) ? &it->second : nullptr;
+}
+
+std::vector<mapping> address_space::list() {
+    if (m_stale) {
+        refresh();
+    }
+    std::vector<mapping> maps;
+    maps.reserve(m_maps.size());
+    for (auto &[start, m]: m_maps) {
+        maps.push_back(m);
+    }
+    return maps;
+}
+
+void address_space::mark_modified(uint64_t address, std::size_t size) {
+    for (auto page = address & page_mask; page < address + size; page += 0x1000) {
+        m_modified.insert(page);
+    }
+}
+
+bool address_space::unchanged(const mapping &m, uint64_t address, std::size_t size) {
+    if (!m_query) {
+        return true;
+    }
+    if (m_maps_fd < 0) {
+        m_maps_fd = open(("/proc/" + std::to_string(m_pid) + "/maps").c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    procmap_query query{};
+    query.size = sizeof(query);
+    query.query_addr = address;
+    if (m_maps_fd < 0 || ioctl(m_maps_fd, PROCMAP_QUERY, &query) < 0) {
+        if (m_maps_fd < 0 || errno == ENOTTY || errno == EINVAL) {
+            m_query = false;
+            return true;
+        }
+        m_stale = true; //ENOENT: nothing is mapped there any more
+        return false;
+    }
+    if (query.inode != m.inode || (query.vma_flags & query_writable) || address + size > query.vma_end ||
+        query.vma_offset + (address - query.vma_start) != m.offset + (address - m.start)) {
+        m_stale = true;
+        return false;
+    }
+    return true;
+}
+
+const address_space::mapped_file *address_space::file(const mapping &m) {
+    auto key = m.path + ':' + std::to_string(m.inode);
+    auto found = m_files.find(key);
+    if (found != m_files.end()) {
+        return found->second.loader ? &found->second : nullptr;
+    }
+
+    auto &mapped = m_files[key];
+    auto fd = open(m.path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st{};
+    if (fd < 0) {
+        return nullptr;
+    }
+    if (fstat(fd, &st) < 0 || st.st_ino != m.inode) {
+        close(fd);
+        return nullptr;
+    }
+    std::shared_ptr<elf::loader> loader;
+    try {
+        loader = elf::create_mmap_loader(fd);
+    } catch (std::exception &) {
+        return nullptr;
+    }
+
+    try {
+        elf::elf f{loader};
+        mapped.elf = true;
+        for (auto &seg: f.segments()) {
+            auto &hdr = seg.get_hdr();
+            if (hdr.type == elf::pt::load && (hdr.flags & elf::pf::w) != elf::pf::w) {
+                mapped.read_only.emplace_back(hdr.offset, hdr.offset + hdr.filesz);
+            }
+        }
+    } catch (std::exception &) {
+        mapped.elf = false; //any other file is served as it is
+    }
+    mapped.loader = std::move(loader);
+    return &mapped;
+}
+
+bool address_space::read_from_file(uint64_t address, void *buffer, std::size_t size) {
+    auto m = find(address);
+    if (!m || m->writable || m->path.empty() || m->path[0] != '/' || address + size > m->end) {
+        return false;
+    }
+    auto modified = m_modified.lower_bound(address & page_mask);
+    if (modified != m_modified.end() && *modified < address + size) {
+        return false;
+    }
+
+    auto f = file(*m);
+    if (!f) {
+        return false;
+    }
+    auto offset = m->offset + (address - m->start);
+    if (f->elf && std::none_of(f->read_only.begin(), f->read_only.end(), [&](auto &&r) {
+        return r.first <= offset && offset + size <= r.second;
+    })) {
+        return false;
+    }
+    if (!unchanged(*m, address, size)) {
+        return false;
+    }
+    try {
+        std::memcpy(buffer, f->loader->load(offset, size), size);
+    } catch (std::exception &) {
+        return false; //past the end of the file, e.g. the zero filled part of a last page
+    }
+    if (m->executable && m_overlay) {
+        m_overlay(address, static_cast<uint8_t *>(buffer), size);
+    }
+    return true;
+}
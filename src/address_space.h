@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "memory_map.h"
+#include "libelfin/elf/elf++.hh"
+
+//the mappings of a live process as an interval map keyed by start address. /proc/pid/maps is only
+//read again after invalidate(), which the debugger calls on the events that change the mappings
+//(library loads, new threads, traced mmap, mprotect and munmap calls), not on every stop.
+class address_space {
+public:
+    //patches the bytes the debugger changed in code, e.g. the int3 of breakpoints, into a read
+    using code_overlay = std::function<void(uint64_t address, uint8_t *buffer, std::size_t size)>;
+
+    explicit address_space(pid_t pid) : m_pid{pid} {}
+
+    address_space(const address_space &) = delete;
+
+    address_space &operator=(const address_space &) = delete;
+
+    ~address_space();
+
+    void set_code_overlay(code_overlay overlay) { m_overlay = std::move(overlay); }
+
+    void invalidate() { m_stale = true; }
+
+    //the mapping containing addr, nullptr if there is none
+    const mapping *find(uint64_t addr);
+
+    std::vector<mapping> list();
+
+    //the debugger wrote into the range, the file bytes no longer show it
+    void mark_modified(uint64_t address, std::size_t size);
+
+    //copies the range from the mapped file when it lies in a read-only mapping of a file that was not
+    //replaced since and the debugger did not write into, false otherwise. Of an ELF file only the
+    //segments without PF_W are served: RELRO pages are read-only too, but were relocated when loaded.
+    //Code gets the overlay. The kernel is asked whether the mapping is still that file at that offset
+    //and read-only, the program can change it without an event the debugger sees.
+    bool read_from_file(uint64_t address, void *buffer, std::size_t size);
+
+    std::size_t refreshes() const { return m_refreshes; }
+
+private:
+    struct mapped_file {
+        std::shared_ptr<elf::loader> loader;
+        bool elf = false;
+        std::vector<std::pair<uint64_t, uint64_t>> read_only; //file offset ranges of the PF_W-less segments
+    };
+
+    void refresh();
+
+    //the mapped file behind m, nullptr if it cannot be opened or is not the file that was mapped
+    const mapped_file *file(const mapping &m);
+
+    //whether the range is still mapped read-only from the file and offset of m, with the
+    //PROCMAP_QUERY ioctl. Invalidates the cache if not. Kernels before 6.11 lack the ioctl, there
+    //the cache is trusted.
+    bool unchanged(const mapping &m, uint64_t address, std::size_t size);
+
+    pid_t m_pid;
+    int m_maps_fd = -1;
+    bool m_query = true; //false once the kernel rejected PROCMAP_QUERY
+    bool m_stale = true;
+    std::size_t m_refreshes = 0;
+    std::map<uint64_t, mapping> m_maps;             //by start address
+    std::set<uint64_t> m_modified;                  //pages written by the debugger
+    std::map<std::string, mapped_file> m_files; //without loader for files that cannot be used
+    code_overlay m_overlay;
+};
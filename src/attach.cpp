@@ -0,0 +1,82 @@
+#include <set>
+#include <string>
+#include <dirent.h>
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+
+#include "attach.h"
+#include "utility.h"
+
+std::vector<pid_t> list_threads(pid_t pid) {
+    std::vector<pid_t> tids;
+    auto dir = opendir(("/proc/" + std::to_string(pid) + "/task").c_str());
+    if (!dir) {
+        return tids;
+    }
+    while (auto entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            tids.push_back(std::stoi(entry->d_name));
+        }
+    }
+    closedir(dir);
+    return tids;
+}
+
+std::vector<pid_t> seize_threads(pid_t pid, long options) {
+    std::set<pid_t> seized;
+
+    bool found_new = true;
+    while (found_new) {
+        found_new = false;
+        for (auto tid: list_threads(pid)) {
+            if (seized.count(tid)) {
+                continue;
+            }
+            if (counted_ptrace(PTRACE_SEIZE, tid, nullptr, options) < 0) {
+                if (tid == pid) {
+                    return {};
+                }
+                continue; //the thread exited in the meantime
+            }
+            seized.insert(tid);
+            found_new = true;
+        }
+    }
+
+    return {seized.begin(), seized.end()};
+}
+
+std::vector<pid_t> interrupt_threads(const std::vector<pid_t> &tids, std::map<pid_t, int> &pending_signals) {
+    for (auto tid: tids) {
+        counted_ptrace(PTRACE_INTERRUPT, tid, nullptr, nullptr);
+    }
+
+    std::vector<pid_t> stopped;
+    for (auto tid: tids) {
+        int wait_status;
+        while (true) {
+            if (waitpid(tid, &wait_status, __WALL) < 0 || !WIFSTOPPED(wait_status)) {
+                break;
+            }
+            if ((wait_status >> 16) == PTRACE_EVENT_STOP) {
+                stopped.push_back(tid);
+                break;
+            }
+            if ((wait_status >> 16) == 0 && WSTOPSIG(wait_status) != SIGTRAP) {
+                pending_signals[tid] = WSTOPSIG(wait_status);
+            }
+            counted_ptrace(PTRACE_CONT, tid, nullptr, nullptr);
+        }
+    }
+
+    return stopped;
+}
+
+void detach_threads(const std::vector<pid_t> &tids, const std::map<pid_t, int> &pending_signals) {
+    for (auto tid: tids) {
+        auto it = pending_signals.find(tid);
+        long signal = it == pending_signals.end() ? 0 : it->second;
+        counted_ptrace(PTRACE_DETACH, tid, nullptr, signal);
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <sys/types.h>
+
+std::vector<pid_t> list_threads(pid_t pid);
+
+//PTRACE_SEIZE every thread of pid without stopping it, repeated until no new thread shows up.
+//Returns an empty list if the process itself cannot be seized.
+std::vector<pid_t> seize_threads(pid_t pid, long options);
+
+//stops seized threads with PTRACE_INTERRUPT and waits until each one reports the stop.
+//Signals that raced with the interrupt are stored in pending_signals, exited threads are dropped.
+std::vector<pid_t> interrupt_threads(const std::vector<pid_t> &tids, std::map<pid_t, int> &pending_signals);
+
+void detach_threads(const std::vector<pid_t> &tids, const std::map<pid_t, int> &pending_signals);
@@ -1,23 +1,58 @@
 #include "breakpoint.h"
+#include "utility.h"
 
+//the int3 is patched through /proc/pid/mem, so this also works while other threads keep running (non-stop mode)
 void breakpoint::enable() {
-    auto data = ptrace(PTRACE_PEEKDATA, m_pid, m_addr, nullptr);
-    m_saved_data = static_cast<uint8_t>(data & 0xff); //save bottom byte
-    uint64_t int3 = 0xcc;
-    uint64_t data_with_int3 = ((data & ~0xff) | int3); //set bottom byte to 0xcc
-    ptrace(PTRACE_POKEDATA, m_pid, m_addr, data_with_int3);
+    read_process_memory(m_pid, m_addr, &m_saved_data, 1); //save original byte
+    uint8_t int3 = 0xcc;
+    write_process_memory(m_pid, m_addr, &int3, 1);
 
     m_enabled = true;
 }
 
 void breakpoint::disable() {
-    auto data = ptrace(PTRACE_PEEKDATA, m_pid, m_addr, nullptr);
-    auto restored_data = ((data & ~0xff) | m_saved_data);
-    ptrace(PTRACE_POKEDATA, m_pid, m_addr, restored_data);
+    write_process_memory(m_pid, m_addr, &m_saved_data, 1);
 
     m_enabled = false;
 }
 
+void breakpoint::rearm() {
+    uint8_t int3 = 0xcc;
+    write_process_memory(m_pid, m_addr, &int3, 1);
+
+    m_enabled = true;
+}
+
 bool breakpoint::is_enabled() const { return m_enabled; }
 
 std::intptr_t breakpoint::get_address() const { return m_addr; }
+
+void breakpoint::enable_all(std::vector<breakpoint> &bps) {
+    static constexpr std::intptr_t max_span = 64 * 1024;
+    static constexpr std::intptr_t page_mask = ~std::intptr_t{0xfff};
+    std::vector<uint8_t> chunk;
+
+    for (std::size_t first = 0; first < bps.size();) {
+        auto start = bps[first].m_addr;
+        auto last = first;
+        while (last + 1 < bps.size() && bps[last + 1].m_addr - start < max_span &&
+               (bps[last + 1].m_addr & page_mask) - (bps[last].m_addr & page_mask) <= 0x1000) {
+            ++last;
+        }
+
+        chunk.resize(bps[last].m_addr - start + 1);
+        read_process_memory(bps[first].m_pid, start, chunk.data(), chunk.size());
+        for (auto i = first; i <= last; ++i) {
+            auto &byte = chunk[bps[i].m_addr - start];
+            if (bps[i].m_enabled) {
+                continue;
+            }
+            bps[i].m_saved_data = byte;
+            bps[i].m_enabled = true;
+            byte = 0xcc;
+        }
+        write_process_memory(bps[first].m_pid, start, chunk.data(), chunk.size());
+
+        first = last + 1;
+    }
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 #include <sys/ptrace.h>
 #include <aio.h>
 
@@ -14,10 +15,21 @@ public:
 
     void disable();
 
+    //plants the int3 again over the byte saved by the last enable, one write instead of two accesses
+    void rearm();
+
     bool is_enabled() const;
 
     std::intptr_t get_address() const;
 
+    //the original byte under the int3, for showing memory as the program sees it
+    uint8_t get_saved_data() const { return m_saved_data; }
+
+    //enables many breakpoints of one process with a read and a write per run of consecutive pages
+    //holding breakpoints, at most 64 KiB, instead of two accesses per breakpoint. The pages between
+    //runs are not touched. bps must be sorted by address.
+    static void enable_all(std::vector<breakpoint> &bps);
+
 private:
     pid_t m_pid;
     std::intptr_t m_addr;
@@ -0,0 +1,60 @@
+#include <cerrno>
+#include <csignal>
+#include <sched.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "checkpoint.h"
+#include "utility.h"
+
+namespace {
+    //puts back the code and the registers the injection changed
+    void restore(pid_t pid, const user_regs_struct &regs, const uint8_t *code, long options) {
+        counted_ptrace(PTRACE_SETOPTIONS, pid, nullptr, options);
+        write_process_memory(pid, regs.rip, code, 2);
+        counted_ptrace(PTRACE_SETREGS, pid, nullptr, &regs);
+    }
+}
+
+pid_t fork_stopped_process(pid_t pid, const user_regs_struct &regs, long options) {
+    uint8_t code[2];
+    if (read_process_memory(pid, regs.rip, code, sizeof(code)) != sizeof(code)) {
+        return -1;
+    }
+    const uint8_t syscall_insn[2] = {0x0f, 0x05};
+    if (write_process_memory(pid, regs.rip, syscall_insn, sizeof(syscall_insn)) != sizeof(syscall_insn)) {
+        return -1;
+    }
+
+    auto call = regs;
+    call.rax = SYS_clone;
+    call.orig_rax = -1; //no syscall restart if the thread was stopped inside one
+    call.rdi = CLONE_PARENT | SIGCHLD;
+    call.rsi = call.rdx = call.r10 = call.r8 = 0;
+    counted_ptrace(PTRACE_SETREGS, pid, nullptr, &call);
+    counted_ptrace(PTRACE_SETOPTIONS, pid, nullptr, options | PTRACE_O_TRACEFORK);
+
+    //the fork event stops before the syscall returns, the next step completes it
+    pid_t child = -1;
+    int status;
+    counted_ptrace(PTRACE_SINGLESTEP, pid, nullptr, nullptr);
+    waitpid(pid, &status, __WALL);
+    if (WIFSTOPPED(status) && status >> 8 == (SIGTRAP | PTRACE_EVENT_FORK << 8)) {
+        unsigned long msg;
+        counted_ptrace(PTRACE_GETEVENTMSG, pid, nullptr, &msg);
+        child = static_cast<pid_t>(msg);
+        counted_ptrace(PTRACE_SINGLESTEP, pid, nullptr, nullptr);
+        waitpid(pid, &status, __WALL);
+    } else {
+        errno = ECHILD;
+    }
+    restore(pid, regs, code, options);
+
+    if (child > 0) {
+        //the auto-attached child starts with a SIGSTOP, which it must not see later
+        waitpid(child, &status, __WALL);
+        restore(child, regs, code, options);
+    }
+    return child;
+}
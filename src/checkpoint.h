@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <sys/types.h>
+#include <sys/user.h>
+
+//a stopped copy-on-write copy of the program, restart runs a fresh fork of it
+struct checkpoint {
+    unsigned id;
+    pid_t pid;
+    user_regs_struct regs;
+    std::string location;
+};
+
+//makes the stopped, single threaded tracee pid fork by running a clone syscall instruction
+//written over the code at its pc. The code and the registers (regs, those of pid) are put back in
+//both processes and the child is left stopped, traced with options. The child is created with
+//CLONE_PARENT, so it is a child of the debugger like the program it was taken from.
+//Returns the child, or -1 with errno set.
+pid_t fork_stopped_process(pid_t pid, const user_regs_struct &regs, long options);
@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <elf.h>
+#include <emmintrin.h>
+#include <fcntl.h>
+#include <sys/procfs.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "core_writer.h"
+#include "memory_map.h"
+#include "utility.h"
+
+namespace {
+    //memory is copied and scanned in batches of this many bytes
+    constexpr std::size_t batch_size = 8 << 20;
+
+    std::string read_file(const std::string &path) {
+        std::ifstream file{path, std::ios::binary};
+        return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    }
+
+    template<typename T>
+    void append(std::vector<uint8_t> &out, const T &value) {
+        auto bytes = reinterpret_cast<const uint8_t *>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    void add_note(std::vector<uint8_t> &notes, uint32_t type, const void *desc, std::size_t size) {
+        append(notes, Elf64_Nhdr{5, static_cast<Elf64_Word>(size), type});
+        const char name[8] = "CORE";
+        notes.insert(notes.end(), name, name + sizeof(name));
+        auto bytes = static_cast<const uint8_t *>(desc);
+        notes.insert(notes.end(), bytes, bytes + size);
+        notes.resize((notes.size() + 3) & ~std::size_t{3});
+    }
+
+    //16 bytes at a time, bailing out at the first non-zero 256 byte block
+    bool is_zero_page(const uint8_t *page, std::size_t size) {
+        auto p = reinterpret_cast<const __m128i *>(page);
+        for (std::size_t i = 0; i < size / 16; i += 16) {
+            auto acc = _mm_setzero_si128();
+            for (std::size_t j = i; j < i + 16; j += 4) {
+                acc = _mm_or_si128(acc, _mm_or_si128(_mm_or_si128(_mm_loadu_si128(p + j), _mm_loadu_si128(p + j + 1)),
+                                                     _mm_or_si128(_mm_loadu_si128(p + j + 2), _mm_loadu_si128(p + j + 3))));
+            }
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xffff) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void write_all(int fd, const uint8_t *data, std::size_t size, uint64_t offset) {
+        while (size > 0) {
+            auto n = pwrite(fd, data, size, offset);
+            if (n <= 0) {
+                throw std::runtime_error{std::string{"Cannot write the core: "} + strerror(errno)};
+            }
+            data += n;
+            size -= n;
+            offset += n;
+        }
+    }
+
+    //reads the ranges back to back into buffer, what cannot be read is left zero
+    void read_batch(pid_t pid, const std::vector<iovec> &remote, uint8_t *buffer) {
+        std::size_t i = 0;
+        while (i < remote.size()) {
+            std::size_t total = 0;
+            for (auto j = i; j < remote.size(); ++j) {
+                total += remote[j].iov_len;
+            }
+            iovec local{buffer, total};
+            ++g_syscall_counters.memory;
+            auto n = process_vm_readv(pid, &local, 1, &remote[i], remote.size() - i, 0);
+            if (n == static_cast<ssize_t>(total)) {
+                return;
+            }
+
+            //it stops in the first range that cannot be read completely, the rest of that range is skipped
+            std::size_t done = n > 0 ? n : 0;
+            while (done >= remote[i].iov_len) {
+                done -= remote[i].iov_len;
+                buffer += remote[i].iov_len;
+                ++i;
+            }
+            std::memset(buffer + done, 0, remote[i].iov_len - done);
+            buffer += remote[i].iov_len;
+            ++i;
+        }
+    }
+
+    //the vvar pages are mapped by the kernel for the vDSO and cannot be read through the process
+    bool dumped(const mapping &m) {
+        return m.readable && m.path != "[vvar]" && m.path != "[vvar_vclock]";
+    }
+}
+
+core_stats write_core(pid_t pid, const std::vector<core_thread> &threads,
+                      const std::map<uint64_t, uint8_t> &patches, const std::string &path) {
+    const uint64_t page_size = sysconf(_SC_PAGESIZE);
+    auto proc = "/proc/" + std::to_string(pid);
+    auto maps = read_memory_maps(pid);
+    core_stats stats;
+
+    //pid (comm) state ppid pgrp session ...
+    auto stat = read_file(proc + "/stat");
+    std::istringstream stat_fields{stat.substr(stat.rfind(')') + 2)};
+    char state = 'R';
+    int ppid = 0, pgrp = 0, sid = 0;
+    stat_fields >> state >> ppid >> pgrp >> sid;
+
+    auto prstatus = [&](const core_thread &thread) {
+        elf_prstatus status{};
+        status.pr_info.si_signo = thread.signal;
+        status.pr_cursig = thread.signal;
+        status.pr_pid = thread.tid;
+        status.pr_ppid = ppid;
+        status.pr_pgrp = pgrp;
+        status.pr_sid = sid;
+        static_assert(sizeof(status.pr_reg) == sizeof(thread.regs), "elf_gregset_t is user_regs_struct");
+        std::memcpy(&status.pr_reg, &thread.regs, sizeof(thread.regs));
+        return status;
+    };
+
+    std::vector<uint8_t> notes;
+    if (!threads.empty()) {
+        auto status = prstatus(threads.front());
+        add_note(notes, NT_PRSTATUS, &status, sizeof(status));
+    }
+
+    elf_prpsinfo info{};
+    info.pr_sname = state;
+    info.pr_state = state == 'R' ? 0 : state == 'S' ? 1 : state == 'D' ? 2 : state == 'Z' ? 4 : 3;
+    info.pr_pid = pid;
+    info.pr_ppid = ppid;
+    info.pr_pgrp = pgrp;
+    info.pr_sid = sid;
+    auto comm = read_file(proc + "/comm");
+    std::strncpy(info.pr_fname, comm.substr(0, comm.find('\n')).c_str(), sizeof(info.pr_fname) - 1);
+    auto cmdline = read_file(proc + "/cmdline");
+    std::replace(cmdline.begin(), cmdline.end(), '\0', ' ');
+    std::strncpy(info.pr_psargs, cmdline.c_str(), sizeof(info.pr_psargs) - 1);
+    add_note(notes, NT_PRPSINFO, &info, sizeof(info));
+
+    auto auxv = read_file(proc + "/auxv");
+    add_note(notes, NT_AUXV, auxv.data(), auxv.size());
+
+    //count, page size, (start, end, file offset in pages) per mapped file, then their names
+    std::vector<uint8_t> files;
+    std::string names;
+    uint64_t n_files = 0;
+    append(files, n_files);
+    append(files, page_size);
+    for (auto &m: maps) {
+        if (!m.path.empty() && m.path[0] == '/') {
+            append(files, m.start);
+            append(files, m.end);
+            append(files, m.offset / page_size);
+            names.append(m.path).push_back('\0');
+            ++n_files;
+        }
+    }
+    std::memcpy(files.data(), &n_files, sizeof(n_files));
+    files.insert(files.end(), names.begin(), names.end());
+    add_note(notes, NT_FILE, files.data(), files.size());
+
+    for (std::size_t i = 1; i < threads.size(); ++i) {
+        auto status = prstatus(threads[i]);
+        add_note(notes, NT_PRSTATUS, &status, sizeof(status));
+    }
+
+    std::vector<Elf64_Phdr> phdrs(maps.size() + 1);
+    auto notes_offset = sizeof(Elf64_Ehdr) + phdrs.size() * sizeof(Elf64_Phdr);
+    phdrs[0] = Elf64_Phdr{PT_NOTE, 0, notes_offset, 0, 0, notes.size(), 0, 4};
+
+    //segment data starts page aligned so that the holes of zero pages line up with file system blocks
+    uint64_t offset = (notes_offset + notes.size() + page_size - 1) & ~(page_size - 1);
+    auto data_offset = offset;
+    for (std::size_t i = 0; i < maps.size(); ++i) {
+        auto &m = maps[i];
+        Elf64_Word flags = (m.readable ? PF_R : 0) | (m.writable ? PF_W : 0) | (m.executable ? PF_X : 0);
+        auto size = dumped(m) ? m.end - m.start : 0;
+        phdrs[i + 1] = Elf64_Phdr{PT_LOAD, flags, offset, m.start, 0, size, m.end - m.start, page_size};
+        offset += size;
+    }
+
+    Elf64_Ehdr ehdr{};
+    std::memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+    ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+    ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr.e_ident[EI_OSABI] = ELFOSABI_NONE;
+    ehdr.e_type = ET_CORE;
+    ehdr.e_machine = EM_X86_64;
+    ehdr.e_version = EV_CURRENT;
+    ehdr.e_phoff = sizeof(Elf64_Ehdr);
+    ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+    ehdr.e_phentsize = sizeof(Elf64_Phdr);
+    ehdr.e_phnum = phdrs.size();
+
+    auto fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        throw std::runtime_error{"Cannot open " + path + ": " + strerror(errno)};
+    }
+
+    try {
+        iovec headers[] = {{&ehdr, sizeof(ehdr)},
+                           {phdrs.data(), phdrs.size() * sizeof(Elf64_Phdr)},
+                           {notes.data(), notes.size()}};
+        if (pwritev(fd, headers, 3, 0) != static_cast<ssize_t>(notes_offset + notes.size())) {
+            throw std::runtime_error{std::string{"Cannot write the core: "} + strerror(errno)};
+        }
+
+        //the dumped mappings follow each other in the file, so a batch of them is one contiguous
+        //range of the buffer and of the file
+        std::vector<uint8_t> buffer(batch_size);
+        std::vector<iovec> remote;
+        std::size_t batched = 0;
+        uint64_t batch_offset = data_offset;
+
+        auto flush = [&]() {
+            if (remote.empty()) {
+                return;
+            }
+            read_batch(pid, remote, buffer.data());
+
+            auto dst = buffer.data();
+            for (auto &r: remote) {
+                auto start = reinterpret_cast<uint64_t>(r.iov_base);
+                for (auto it = patches.lower_bound(start); it != patches.end() && it->first < start + r.iov_len; ++it) {
+                    dst[it->first - start] = it->second;
+                }
+                dst += r.iov_len;
+            }
+
+            //runs of pages with data are written, zero pages are skipped
+            std::size_t run = 0;
+            for (std::size_t page = 0; page <= batched; page += page_size) {
+                if (page == batched || is_zero_page(buffer.data() + page, page_size)) {
+                    if (page > run) {
+                        write_all(fd, buffer.data() + run, page - run, batch_offset + run);
+                    }
+                    if (page < batched) {
+                        stats.zero_bytes += page_size;
+                    }
+                    run = page + page_size;
+                }
+            }
+
+            stats.bytes += batched;
+            batch_offset += batched;
+            remote.clear();
+            batched = 0;
+        };
+
+        for (auto &m: maps) {
+            if (!dumped(m)) {
+                continue;
+            }
+            ++stats.segments;
+            for (auto addr = m.start; addr < m.end;) {
+                auto size = std::min<uint64_t>(m.end - addr, batch_size - batched);
+                remote.push_back(iovec{reinterpret_cast<void *>(addr), size});
+                batched += size;
+                addr += size;
+                if (batched == batch_size || remote.size() == IOV_MAX) {
+                    flush();
+                }
+            }
+        }
+        flush();
+
+        //trailing zero pages are holes too
+        if (ftruncate(fd, offset) < 0) {
+            throw std::runtime_error{std::string{"Cannot write the core: "} + strerror(errno)};
+        }
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+
+    close(fd);
+    return stats;
+}
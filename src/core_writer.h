@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <sys/user.h>
+
+//a thread of the core, the first one given to write_core is the one the core reports as current
+struct core_thread {
+    pid_t tid;
+    user_regs_struct regs;
+    int signal;
+};
+
+struct core_stats {
+    std::size_t segments = 0;
+    uint64_t bytes = 0;      //memory copied from the process
+    uint64_t zero_bytes = 0; //of which was left as holes in the file
+};
+
+//writes an ELF core of the stopped process pid to path. Memory is copied in large batches of
+//mappings per process_vm_readv and all-zero pages are skipped, leaving holes in a sparse file.
+//patches are written over the copied bytes, e.g. the instructions under the breakpoints.
+//Throws std::runtime_error if the file cannot be written.
+core_stats write_core(pid_t pid, const std::vector<core_thread> &threads,
+                      const std::map<uint64_t, uint8_t> &patches, const std::string &path);
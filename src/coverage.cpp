@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <map>
+
+#include "coverage.h"
+
+uint32_t line_coverage::intern_line(const std::string &file, unsigned line) {
+    auto file_id = m_file_ids.emplace(file, m_files.size()).first->second;
+    if (file_id == m_files.size()) {
+        m_files.push_back(file);
+    }
+
+    auto key = (static_cast<uint64_t>(file_id) << 32) | line;
+    auto id = m_line_ids.emplace(key, m_lines.size()).first->second;
+    if (id == m_lines.size()) {
+        m_lines.push_back(line_point{file_id, line, false});
+    }
+    return id;
+}
+
+void line_coverage::plant(pid_t pid, const dwarf::dwarf &dwarf, uint64_t load_address,
+                          const std::set<uint64_t> &taken) {
+    //several rows (and files, for inlined code) can share an address, the breakpoint is planted once
+    std::map<uint64_t, std::vector<uint32_t>> points;
+    for (const auto &cu: dwarf.compilation_units()) {
+        auto &lt = cu.get_line_table();
+        for (auto it = lt.begin(); it != lt.end(); ++it) {
+            if (it->is_stmt && !it->end_sequence && it->line != 0) {
+                auto &lines = points[it->address + load_address];
+                auto id = intern_line(it->file->path, it->line);
+                if (std::find(lines.begin(), lines.end(), id) == lines.end()) {
+                    lines.push_back(id);
+                }
+            }
+        }
+    }
+
+    //an int3 planted over a user breakpoint would save the int3 as the original byte
+    std::vector<breakpoint> planted;
+    planted.reserve(points.size());
+    for (auto &[addr, lines]: points) {
+        if (!taken.count(addr)) {
+            planted.emplace_back(pid, addr);
+        }
+    }
+    breakpoint::enable_all(planted);
+
+    m_breakpoints.reserve(points.size());
+    m_point_lines.reserve(points.size());
+    auto next = planted.begin();
+    for (auto &[addr, lines]: points) {
+        m_by_address[addr] = m_breakpoints.size();
+        if (taken.count(addr)) {
+            m_breakpoints.emplace_back(pid, addr);
+        } else {
+            m_breakpoints.push_back(*next++);
+        }
+        m_point_lines.push_back(std::move(lines));
+    }
+    m_point_hit.resize(points.size());
+
+    for (const auto &cu: dwarf.compilation_units()) {
+        for (const auto &die: cu.root()) {
+            if (die.tag != dwarf::DW_TAG::subprogram || !die.has(dwarf::DW_AT::low_pc) ||
+                !die.has(dwarf::DW_AT::name)) {
+                continue;
+            }
+            auto found = m_by_address.find(at_low_pc(die) + load_address);
+            if (found == m_by_address.end()) {
+                continue;
+            }
+            //the mangled name keeps overloads apart, lcov demangles it with --demangle-cpp
+            auto name = die.has(dwarf::DW_AT::linkage_name) ? die[dwarf::DW_AT::linkage_name].as_string()
+                                                             : at_name(die);
+            m_functions.push_back(function_point{name, m_point_lines[found->second].front(), found->second});
+        }
+    }
+}
+
+bool line_coverage::hit(uint64_t addr, bool user_breakpoint) {
+    auto found = m_by_address.find(addr);
+    if (found == m_by_address.end()) {
+        return false;
+    }
+
+    auto &bp = m_breakpoints[found->second];
+    //another thread may trap on the same int3 before it is lifted, it only needs its pc rewound
+    if (!m_point_hit[found->second]) {
+        if (bp.is_enabled() && !user_breakpoint) {
+            bp.disable();
+        }
+        m_point_hit[found->second] = true;
+        ++m_hits;
+        for (auto line: m_point_lines[found->second]) {
+            m_lines[line].hit = true;
+        }
+    }
+    return true;
+}
+
+void line_coverage::release(uint64_t addr) {
+    auto found = m_by_address.find(addr);
+    if (found != m_by_address.end() && m_breakpoints[found->second].is_enabled()) {
+        m_breakpoints[found->second].disable();
+    }
+}
+
+void line_coverage::replant(uint64_t addr) {
+    auto found = m_by_address.find(addr);
+    if (found != m_by_address.end() && !m_point_hit[found->second] && !m_breakpoints[found->second].is_enabled()) {
+        m_breakpoints[found->second].enable();
+    }
+}
+
+void line_coverage::remove_all() {
+    for (auto &bp: m_breakpoints) {
+        if (bp.is_enabled()) {
+            bp.disable();
+        }
+    }
+}
+
+void line_coverage::original_bytes(std::map<uint64_t, uint8_t> &out) const {
+    for (auto &bp: m_breakpoints) {
+        if (bp.is_enabled()) {
+            out[bp.get_address()] = bp.get_saved_data();
+        }
+    }
+}
+
+void line_coverage::overlay(uint64_t address, uint8_t *buffer, std::size_t size) const {
+    auto bp = std::lower_bound(m_breakpoints.begin(), m_breakpoints.end(), address,
+                               [](auto &&b, uint64_t a) { return static_cast<uint64_t>(b.get_address()) < a; });
+    for (; bp != m_breakpoints.end() && static_cast<uint64_t>(bp->get_address()) < address + size; ++bp) {
+        if (bp->is_enabled()) {
+            buffer[bp->get_address() - address] = 0xcc;
+        }
+    }
+}
+
+void line_coverage::write_lcov(std::ostream &out) const {
+    std::vector<std::vector<uint32_t>> file_lines(m_files.size());
+    for (uint32_t i = 0; i < m_lines.size(); ++i) {
+        file_lines[m_lines[i].file].push_back(i);
+    }
+    std::vector<std::vector<const function_point *>> file_functions(m_files.size());
+    for (auto &f: m_functions) {
+        file_functions[m_lines[f.line].file].push_back(&f);
+    }
+
+    out << "TN:\n";
+    for (uint32_t file = 0; file < m_files.size(); ++file) {
+        auto &lines = file_lines[file];
+        std::sort(lines.begin(), lines.end(), [this](auto a, auto b) { return m_lines[a].line < m_lines[b].line; });
+
+        out << "SF:" << m_files[file] << '\n';
+
+        unsigned functions_hit = 0;
+        for (auto f: file_functions[file]) {
+            out << "FN:" << m_lines[f->line].line << ',' << f->name << '\n';
+        }
+        for (auto f: file_functions[file]) {
+            bool hit = m_point_hit[f->point];
+            functions_hit += hit;
+            out << "FNDA:" << hit << ',' << f->name << '\n';
+        }
+        out << "FNF:" << file_functions[file].size() << '\n';
+        out << "FNH:" << functions_hit << '\n';
+
+        unsigned lines_hit = 0;
+        for (auto id: lines) {
+            lines_hit += m_lines[id].hit;
+            out << "DA:" << m_lines[id].line << ',' << m_lines[id].hit << '\n';
+        }
+        out << "LF:" << lines.size() << '\n';
+        out << "LH:" << lines_hit << '\n';
+        out << "end_of_record\n";
+    }
+}
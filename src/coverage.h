@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "breakpoint.h"
+#include "libelfin/dwarf/dwarf++.hh"
+
+//line coverage with one-shot breakpoints: every is_stmt address of the line tables gets an int3
+//that is removed the first time it is hit, so code that already ran executes at full speed again
+class line_coverage {
+public:
+    //plants the breakpoints in the stopped process, load_address relocates the DWARF addresses. The
+    //addresses in taken already hold an int3 of a user breakpoint, they are recorded but not planted.
+    void plant(pid_t pid, const dwarf::dwarf &dwarf, uint64_t load_address, const std::set<uint64_t> &taken);
+
+    bool active() const { return !m_by_address.empty(); }
+
+    //whether addr is one of the planted addresses, hit or not
+    bool contains(uint64_t addr) const { return m_by_address.count(addr) != 0; }
+
+    //records a hit on addr and restores the original instruction, false if it is not a coverage point.
+    //With user_breakpoint the int3 at addr belongs to a user breakpoint and is left in place.
+    bool hit(uint64_t addr, bool user_breakpoint);
+
+    //lifts the breakpoint at addr without counting a hit, so a user breakpoint can take its place
+    void release(uint64_t addr);
+
+    //plants the breakpoint at addr again once the user breakpoint that took its place is gone,
+    //unless the address was hit meanwhile
+    void replant(uint64_t addr);
+
+    //lifts the breakpoints that were not hit, before detaching
+    void remove_all();
+
+    void write_lcov(std::ostream &out) const;
+
+    //adds the original bytes under the breakpoints still planted
+    void original_bytes(std::map<uint64_t, uint8_t> &out) const;
+
+    //writes the int3 of the planted breakpoints into buffer, a copy of the original code at address
+    void overlay(uint64_t address, uint8_t *buffer, std::size_t size) const;
+
+    std::size_t points() const { return m_breakpoints.size(); }
+
+    std::size_t points_hit() const { return m_hits; }
+
+private:
+    struct line_point {
+        uint32_t file;
+        unsigned line;
+        bool hit;
+    };
+
+    struct function_point {
+        std::string name;
+        uint32_t line; //index into m_lines of the entry line
+        uint32_t point;
+    };
+
+    uint32_t intern_line(const std::string &file, unsigned line);
+
+    std::vector<std::string> m_files;
+    std::unordered_map<std::string, uint32_t> m_file_ids;
+    std::vector<line_point> m_lines;
+    std::unordered_map<uint64_t, uint32_t> m_line_ids; //(file << 32 | line) -> index into m_lines
+    std::vector<breakpoint> m_breakpoints; //sorted by address
+    std::vector<std::vector<uint32_t>> m_point_lines; //lines attributed to each breakpoint
+    std::vector<bool> m_point_hit;
+    std::unordered_map<uint64_t, uint32_t> m_by_address; //address -> index into m_breakpoints
+    std::vector<function_point> m_functions;
+    std::size_t m_hits = 0;
+};
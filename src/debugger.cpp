@@ -1,16 +1,46 @@
 #include <cstdint>
 #include <sys/wait.h>
+#include <sys/syscall.h>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
 #include <cstring>
+#include <chrono>
+#include <climits>
+#include <thread>
 
 #include "linenoise/linenoise.h"
 #include "utility.h"
 #include "debugger.h"
+#include "core_writer.h"
+#include "memory_search.h"
 #include "registers.h"
+#include "attach.h"
+#include "stack_snapshot.h"
+#include "stack_trie.h"
 
 
+//the matches of find and the changes of diff that are printed
+static constexpr std::size_t listing_limit = 1000;
+
+//the most of a variable print reads, of huge arrays only the first elements are shown anyway
+static constexpr std::size_t max_value_read = 1 << 20;
+
+//<start> and <+len|end> of a command
+static std::pair<uint64_t, uint64_t> parse_range(const std::string &start, const std::string &length_or_end) {
+    auto from = std::stoull(start, nullptr, 0);
+    auto to = length_or_end[0] == '+' ? from + std::stoull(length_or_end.substr(1), nullptr, 0)
+                                      : std::stoull(length_or_end, nullptr, 0);
+    if (to <= from) {
+        throw std::out_of_range{"Empty range " + start + " " + length_or_end};
+    }
+    return {from, to};
+}
+
+static bool any_running(const std::map<pid_t, thread_state> &threads) {
+    return std::any_of(threads.begin(), threads.end(), [](auto &&t) { return !t.second.stopped; });
+}
+
 std::vector<symbol> debugger::lookup_symbol(const std::string &name) {
     std::vector<symbol> syms;
 
@@ -31,13 +61,108 @@ std::vector<symbol> debugger::lookup_symbol(const std::string &name) {
 
 void debugger::initialise_load_address() {
     if (m_elf.get_hdr().type == elf::et::dyn) {
-        std::ifstream map("/proc/" + std::to_string(m_pid) + "/maps");
+        auto maps = m_target->memory_maps();
+        if (maps.empty()) {
+            return;
+        }
+
+        //the first mapping of the executable file is the load address, the main program is not
+        //necessarily the first line of an attached process
+        auto exe = m_target->executable();
+        auto first = std::find_if(maps.begin(), maps.end(), [&](auto &&m) { return m.path == exe; });
+        m_load_address = first != maps.end() ? first->start : maps.front().start;
+    }
+}
+
+debugger::debugger(std::string prog_name, std::unique_ptr<core_target> core)
+        : m_prog_name{std::move(prog_name)}, m_pid{core->pid()}, m_tid{core->pid()}, m_initialised{true},
+          m_image{std::make_shared<const program_image>(m_prog_name)}, m_dwarf{m_image->dwarf},
+          m_elf{m_image->elf}, m_index{m_image->index} {
+    for (auto &t: core->threads()) {
+        auto &thread = m_threads[t.tid];
+        thread.tid = t.tid;
+        thread.stopped = true;
+        thread.regs = t.regs;
+        thread.regs_valid = true;
+    }
+    if (!core->threads().empty()) {
+        m_tid = core->threads().front().tid;
+        m_stop_signal = core->threads().front().signal;
+    }
+    m_target = std::move(core);
+    initialise_load_address();
 
-        std::string addr;
-        std::getline(map, addr, '-');
+    *m_out << "Core of process " << std::dec << m_pid << " (" << m_threads.size() << " threads)";
+    if (m_stop_signal) {
+        *m_out << ", terminated by " << strsignal(m_stop_signal);
+    }
+    if (!m_threads.empty()) {
+        *m_out << " at 0x" << std::hex << get_pc() << " in " << symbolize(get_pc(), true);
+    }
+    *m_out << std::endl;
+}
+
+//PTRACE_SEIZE does not stop the threads, so everything except PTRACE_INTERRUPT happens
+//while the target keeps running. The DWARF index is already built by the constructor.
+void debugger::attach() {
+    m_ptrace_options = PTRACE_O_TRACECLONE;
+    auto tids = seize_threads(m_pid, m_ptrace_options);
+    if (tids.empty()) {
+        std::cerr << "Cannot attach to process " << m_pid << ": " << strerror(errno) << std::endl;
+        end_of_program = true;
+        return;
+    }
+
+    std::map<pid_t, int> pending_signals;
+    auto start = std::chrono::steady_clock::now();
+    tids = interrupt_threads(tids, pending_signals);
+    auto stopped = std::chrono::steady_clock::now();
+    m_stopped_since = stopped;
+
+    m_threads.clear();
+    for (auto tid: tids) {
+        auto &thread = m_threads[tid];
+        thread.tid = tid;
+        thread.stopped = true;
+        thread.pending_signal = pending_signals[tid];
+    }
+
+    m_attached = true;
+    *m_out << "Attached to process " << std::dec << m_pid << " (" << m_threads.size() << " threads), stopped in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(stopped - start).count() << " us" << std::endl;
+
+    initialise_load_address();
+    start_library_tracking();
+}
+
+void debugger::detach() {
+    check_live();
+    if (m_non_stop) {
+        set_non_stop(false);
+    }
+    m_coverage.remove_all();
+    m_libraries.stop();
+    for (auto &[addr, bp]: m_breakpoints) {
+        if (bp.is_enabled()) {
+            bp.disable();
+        }
+    }
+    m_breakpoints.clear();
+    m_stop_rules.clear();
+    m_tracepoints.clear();
 
-        m_load_address = std::stol(addr, 0, 16);
+    for (auto &[tid, thread]: m_threads) {
+        if (thread.regs_dirty) {
+            counted_ptrace(PTRACE_SETREGS, tid, nullptr, &thread.regs);
+        }
+        counted_ptrace(PTRACE_DETACH, tid, nullptr, static_cast<long>(thread.pending_signal));
     }
+    m_threads.clear();
+    end_of_program = true;
+
+    auto held = std::chrono::steady_clock::now() - m_stopped_since;
+    *m_out << "Detached from process " << std::dec << m_pid << ", target was stopped for "
+              << std::chrono::duration_cast<std::chrono::microseconds>(held).count() << " us" << std::endl;
 }
 
 uint64_t debugger::offset_load_address(uint64_t addr) {
@@ -53,15 +178,18 @@ void debugger::remove_breakpoint(std::intptr_t addr) {
         m_breakpoints.at(addr).disable();
     }
     m_breakpoints.erase(addr);
+    m_stop_rules.erase(addr);
+    m_tracepoints.erase(addr);
+    m_coverage.replant(addr);
 }
 
 void debugger::step_out() {
-    auto frame_pointer = get_register_value(m_pid, reg::rbp);
+    auto frame_pointer = get_register(reg::rbp);
     auto return_address = read_memory(frame_pointer + 8);
 
     bool should_remove_breakpoint = false;
     if (!m_breakpoints.count(return_address)) {
-        set_breakpoint_at_address(return_address);
+        set_breakpoint_at_address(return_address, "finish"); //not numbered, it is removed again
         should_remove_breakpoint = true;
     }
 
@@ -102,7 +230,7 @@ void debugger::step_over() {
         ++line;
     }
 
-    auto frame_pointer = get_register_value(m_pid, reg::rbp);
+    auto frame_pointer = get_register(reg::rbp);
     auto return_address = read_memory(frame_pointer + 8);
     if (!m_breakpoints.count(return_address)) {
         set_breakpoint_at_address(return_address, "show");
@@ -117,8 +245,8 @@ void debugger::step_over() {
 }
 
 void debugger::single_step_instruction() {
-    ptrace(PTRACE_SINGLESTEP, m_pid, nullptr, nullptr);
-    wait_for_signal();
+    resume_thread(current_thread(), PTRACE_SINGLESTEP);
+    wait_for_signal("break", m_tid);
 }
 
 void debugger::single_step_instruction_with_breakpoint_check() {
@@ -130,253 +258,1660 @@ void debugger::single_step_instruction_with_breakpoint_check() {
 }
 
 uint64_t debugger::read_memory(uint64_t address) {
-    return ptrace(PTRACE_PEEKDATA, m_pid, address, nullptr);
+    uint64_t value = 0;
+    m_target->read(address, &value, sizeof(value));
+    return value;
 }
 
 void debugger::write_memory(uint64_t address, uint64_t value) {
-    ptrace(PTRACE_POKEDATA, m_pid, address, value);
+    check_live();
+    m_target->write(address, &value, sizeof(value));
 }
 
-uint64_t debugger::get_pc() {
-    return get_register_value(m_pid, reg::rip);
+void debugger::check_live() {
+    if (!m_target->live()) {
+        throw std::runtime_error{"The program is not running, a core file can only be inspected"};
+    }
 }
 
-uint64_t debugger::get_offset_pc() {
-    return offset_load_address(get_pc());
+std::unique_ptr<live_target> debugger::make_live_target(pid_t pid) {
+    auto live = std::make_unique<live_target>(pid);
+    live->set_code_overlay([this](uint64_t address, uint8_t *buffer, std::size_t size) {
+        for (auto &[addr, bp]: m_breakpoints) {
+            auto a = static_cast<uint64_t>(addr);
+            if (bp.is_enabled() && a >= address && a < address + size) {
+                buffer[a - address] = 0xcc;
+            }
+        }
+        m_coverage.overlay(address, buffer, size);
+        m_libraries.overlay(address, buffer, size);
+    });
+    return live;
 }
 
-void debugger::set_pc(uint64_t pc) {
-    set_register_value(m_pid, reg::rip, pc);
+thread_state &debugger::current_thread() {
+    return m_threads.at(m_tid);
 }
 
-dwarf::die debugger::get_function_from_pc(uint64_t pc) {
-    for (auto &cu: m_dwarf.compilation_units()) {
-        if (die_pc_range(cu.root()).contains(pc)) {
-            for (const auto &die: cu.root()) {
-                if (die.tag == dwarf::DW_TAG::subprogram) {
-                    if (die_pc_range(die).contains(pc)) {
-                        return die;
-                    }
-                }
-            }
-        }
+user_regs_struct &debugger::get_registers(thread_state &thread) {
+    if (!thread.regs_valid) {
+        m_target->registers(thread.tid, thread.regs);
+        thread.regs_valid = true;
     }
+    return thread.regs;
+}
 
-    throw std::out_of_range{"Cannot find function"};
+uint64_t debugger::get_register(reg r) {
+    return get_register_value(get_registers(current_thread()), r);
 }
 
-dwarf::line_table::iterator debugger::get_line_entry_from_pc(uint64_t pc) {
-    for (auto &cu: m_dwarf.compilation_units()) {
-        if (die_pc_range(cu.root()).contains(pc)) {
-            auto &lt = cu.get_line_table();
-            auto it = lt.find_address(pc);
-            if (it == lt.end()) {
-                throw std::out_of_range{"Cannot find line entry"};
-            } else {
-                return it;
-            }
-        }
+void debugger::set_register(reg r, uint64_t value) {
+    check_live();
+    auto &thread = current_thread();
+    set_register_value(get_registers(thread), r, value);
+    thread.regs_dirty = true;
+}
+
+//dirty cached registers are written back only when the thread is about to run again
+void debugger::resume_thread(thread_state &thread, __ptrace_request request, bool deliver_signal) {
+    check_live();
+    if (thread.regs_dirty) {
+        counted_ptrace(PTRACE_SETREGS, thread.tid, nullptr, &thread.regs);
+        thread.regs_dirty = false;
     }
+    long signal = deliver_signal ? thread.pending_signal : 0;
+    if (deliver_signal) {
+        thread.pending_signal = 0;
+    }
+    thread.regs_valid = false;
+    thread.stopped = false;
+    thread.stepping = request == PTRACE_SINGLESTEP;
+    counted_ptrace(request, thread.tid, nullptr, signal);
+}
 
-    throw std::out_of_range{"Cannot find line entry"};
+void debugger::add_thread(pid_t tid) {
+    auto &thread = m_threads[tid];
+    thread.tid = tid;
+    thread.new_thread = true;
 }
 
-void debugger::print_source(const std::string &file_name, unsigned line, unsigned n_lines_context, std::string call) {
-    std::ifstream file{file_name};
+std::string debugger::symbolize(uint64_t pc, bool with_line) {
+    try {
+        auto name = at_name(get_function_from_pc(offset_load_address(pc)));
+        if (!with_line) {
+            return name;
+        }
+        auto line = get_line_entry_from_pc(offset_load_address(pc));
+        return name + " at " + line->file->path + ':' + std::to_string(line->line);
+    } catch (std::exception &) {
+        auto m = m_modules.find(pc);
+        if (!m) {
+            m_target->mappings_changed();
+            m_modules.load_from_maps(m_target->memory_maps());
+            m = m_modules.find(pc);
+        }
+        if (!m) {
+            return "??";
+        }
+        return with_line ? m->describe(pc) + " from " + m->path() : m->function_name(pc);
+    }
+}
 
-    auto start_line = line <= n_lines_context ? 1 : line - n_lines_context;
-    auto end_line = line + n_lines_context + (line < n_lines_context ? n_lines_context - line : 0) + 1;
+void debugger::backtrace() {
+    m_modules.load_from_maps(m_target->memory_maps());
 
-    char c{};
-    auto current_line = 1u;
+    auto frames = unwind_stack(m_modules, get_registers(current_thread()),
+                               [this](uint64_t addr, void *buf, std::size_t size) {
+                                   return m_target->read(addr, buf, size);
+                               });
 
-    while (current_line != start_line && file.get(c)) {
-        if (c == '\n') {
-            ++current_line;
-        }
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        auto pc = frames[i].pc;
+        auto lookup = i == 0 ? pc : pc - 1; //the call, not the instruction after it
+        *m_out << "#" << std::dec << i << " 0x" << std::hex << pc << " in " << symbolize(lookup, true) << std::endl;
     }
+}
 
-    if(call != "show") {
-        std::cout << (current_line == line ? "> " : "  ");
+frame_info debugger::current_frame(const dwarf::die *&function) {
+    auto &regs = get_registers(current_thread());
+    m_modules.load_from_maps(m_target->memory_maps());
+    auto frames = unwind_stack(m_modules, regs, [this](uint64_t addr, void *buf, std::size_t size) {
+        return m_target->read(addr, buf, size);
+    }, 1);
+    function = m_index.find_function(regs.rip - m_load_address);
+    return frame_info{&regs, frames.empty() ? 0 : frames[0].cfa, m_load_address,
+                      [this](uint64_t address, void *buffer, std::size_t size) {
+                          return m_target->read(address, buffer, size);
+                      }};
+}
+
+void debugger::print_value(const dwarf::die &var, const dwarf::die &function, const frame_info &frame) {
+    auto layout = m_types.layout(variable_type(var));
+    *m_out << variable_name(var) << " = ";
+
+    auto printer = make_printer();
+    location loc;
+    try {
+        loc = locate(var, function, frame);
+    } catch (std::exception &e) {
+        *m_out << "<error: " << e.what() << ">" << std::endl;
+        return;
+    }
+    if (loc.type == location::kind::none) {
+        *m_out << "<optimized out>";
+    } else if (loc.type == location::kind::value) {
+        printer.print(layout, loc.bytes.data(), loc.bytes.size());
+    } else {
+        print_memory_value(printer, layout, loc.address, m_types.layout_at(layout).size);
     }
-    else std::cout << "  ";
+    *m_out << std::endl;
+}
 
-    while (current_line <= end_line && file.get(c)) {
-        std::cout << c;
-        if (c == '\n') {
-            ++current_line;
+void debugger::print_memory_value(value_printer &printer, uint32_t layout, uint64_t address, uint64_t size) {
+    size = std::min<uint64_t>(size, max_value_read);
+    if (auto bytes = m_target->view(address, size)) {
+        printer.print(layout, bytes, size, address);
+        return;
+    }
+    std::vector<uint8_t> data(size);
+    if (m_target->read(address, data.data(), data.size())) {
+        printer.print(layout, data.data(), data.size(), address);
+    } else {
+        *m_out << "<error: Cannot access memory at 0x" << std::hex << address << ">";
+    }
+}
 
-            if(call != "show") {
-                std::cout << (current_line == line ? "> " : "  ");
+value_printer debugger::make_printer() {
+    return value_printer{*m_out, m_types,
+                         [this](uint64_t addr, void *buf, std::size_t size) { return m_target->read(addr, buf, size); },
+                         [this](std::vector<memory_request> &requests) { m_target->read_many(requests); },
+                         [this](uint64_t addr) { return symbolize(addr, false); }, m_print_elements};
+}
+
+const std::unordered_map<std::string, dwarf::die> &debugger::globals() {
+    if (!m_globals_indexed) {
+        m_globals = index_globals(m_dwarf);
+        m_globals_indexed = true;
+    }
+    return m_globals;
+}
+
+void debugger::print_variable(const std::string &name) {
+    const dwarf::die *function = nullptr;
+    auto frame = current_frame(function);
+    if (function) {
+        for (auto &v: variables_in_scope(*function, frame.regs->rip - m_load_address)) {
+            if (variable_name(v.die) == name) {
+                print_value(v.die, *function, frame);
+                return;
             }
-            else std::cout << "  ";
         }
     }
 
-    std::cout << std::endl;
+    auto global = globals().find(name);
+    if (global == globals().end()) {
+        throw std::out_of_range{"No symbol \"" + name + "\" in current context"};
+    }
+    print_value(global->second, dwarf::die{}, frame);
 }
 
-/*void debugger::show(){
-    auto func = get_function_from_pc(get_offset_pc());
-    auto func_entry = at_low_pc(func);
-    auto func_end = at_high_pc(func);
+void debugger::print_expression(const std::string &text) {
+    auto is_name = std::all_of(text.begin(), text.end(), [](char c) { return std::isalnum(c) || c == '_' || c == ':'; });
+    if (is_name && !text.empty() && !std::isdigit(text[0])) {
+        print_variable(text);
+        return;
+    }
 
-    auto line_entry = get_line_entry_from_pc(func_entry);
-    auto line_end = get_line_entry_from_pc(func_end-3);
+    const dwarf::die *function = nullptr;
+    auto frame = current_frame(function);
+    expression expr{text, expression_scope{function, frame.regs->rip - m_load_address, &globals()}, m_types};
+    auto value = expr.evaluate(eval_context{frame.regs, frame.load_address, [cfa = frame.cfa] { return cfa; },
+                                            [this](uint64_t addr, void *buf, std::size_t size) {
+                                                return m_target->read(addr, buf, size);
+                                            }});
+
+    auto layout = m_types.layout(expr.type());
+    auto printer = make_printer();
+    *m_out << text << " = ";
+    if (!expr.in_memory()) {
+        printer.print(layout, reinterpret_cast<const uint8_t *>(&value), sizeof(value));
+    } else {
+        print_memory_value(printer, layout, value, expr.type().size);
+    }
+    *m_out << std::endl;
+}
 
-    std::ifstream file{line_entry->file->path};
-    auto tmp=line_end->end_sequence;
-    auto tmp2=line_end->epilogue_begin;
+void debugger::info_locals() {
+    const dwarf::die *function = nullptr;
+    auto frame = current_frame(function);
+    if (!function) {
+        throw std::runtime_error{"No debug info for the current function"};
+    }
+    auto printed = false;
+    for (auto &v: variables_in_scope(*function, frame.regs->rip - m_load_address)) {
+        if (!v.parameter) {
+            print_value(v.die, *function, frame);
+            printed = true;
+        }
+    }
+    if (!printed) {
+        *m_out << "No locals." << std::endl;
+    }
+}
 
-    char c{};
-    auto current_line = 1u;
+//Each tick stops every thread, copies registers and stacks in bulk and resumes them before
+//any unwinding or symbol lookup is done, so the target pause is only the memory copy.
+void debugger::profile(int hz, double seconds, const std::string &output) {
+    check_live();
+    if (hz <= 0 || !(seconds >= 0)) {
+        throw std::runtime_error{"The sampling rate of a profile must be positive, its duration not negative"};
+    }
+    using clock = std::chrono::steady_clock;
+    static constexpr std::size_t max_stack_copy = 256 * 1024;
 
-    while (current_line != line_entry->line && file.get(c)) {
-        if (c == '\n') {
-            ++current_line;
+    //breakpoints would keep rewinding the threads that hit them
+    std::vector<std::intptr_t> lifted;
+    for (auto &[addr, bp]: m_breakpoints) {
+        if (bp.is_enabled()) {
+            bp.disable();
+            lifted.push_back(addr);
         }
     }
+    if (m_libraries.active()) {
+        m_libraries.disable();
+    }
+    if (m_non_stop) {
+        stop_all_threads();
+    }
 
-    std::cout << "  ";
+    auto maps = read_memory_maps(m_pid);
+    m_modules.load_from_maps(maps);
 
-    while (current_line <= line_end->line + 1 && file.get(c)) {
-        std::cout << c;
-        if (c == '\n') {
-            ++current_line;
-            std::cout << "  ";
+    stack_trie trie;
+    auto interval = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / hz));
+    auto start = clock::now();
+    auto end = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds));
+    auto next_tick = start;
+    clock::duration paused{};
+    std::size_t rounds = 0;
+
+    bool maps_stale = false;
+
+    while (!end_of_program && (seconds <= 0 || clock::now() < end)) {
+        for (auto &[tid, thread]: m_threads) {
+            if (thread.stopped) {
+                resume_thread(thread, PTRACE_CONT);
+            }
+        }
+
+        //new threads and libraries show up as stacks or pcs outside the known mappings,
+        //re-read them while the target is running
+        if (maps_stale) {
+            maps = read_memory_maps(m_pid);
+            m_modules.load_from_maps(maps);
+            maps_stale = false;
+        }
+
+        next_tick += interval;
+        std::this_thread::sleep_until(next_tick);
+
+        auto stop_begin = clock::now();
+        stop_all_threads();
+        if (m_threads.empty()) {
+            break;
+        }
+
+        std::vector<pid_t> tids;
+        for (auto &[tid, thread]: m_threads) {
+            tids.push_back(tid);
+        }
+        auto snapshots = capture_threads(m_pid, tids, maps, max_stack_copy);
+        for (auto &[tid, thread]: m_threads) {
+            resume_thread(thread, PTRACE_CONT);
+        }
+        paused += clock::now() - stop_begin;
+        ++rounds;
+
+        for (auto &snap: snapshots) {
+            auto frames = unwind_stack(m_modules, snap.regs, [&snap](uint64_t addr, void *buf, std::size_t size) {
+                return snap.read(addr, buf, size);
+            });
+            if (snap.stack.empty() || (!frames.empty() && !m_modules.find(frames.back().pc))) {
+                maps_stale = true;
+            }
+            for (std::size_t i = 1; i < frames.size(); ++i) {
+                --frames[i].pc; //name the call site, not the return address
+            }
+            trie.add(frames);
         }
     }
 
-    std::cout << std::endl;
-}*/
+    if (!m_threads.empty()) {
+        stop_all_threads();
+    }
+    for (auto addr: lifted) {
+        m_breakpoints[addr].enable();
+    }
+    if (m_libraries.active() && !end_of_program) {
+        m_libraries.enable();
+    }
 
-siginfo_t debugger::get_signal_info() {
-    siginfo_t info;
-    ptrace(PTRACE_GETSIGINFO, m_pid, nullptr, &info);
-    return info;
+    auto name = [this](uint64_t pc) { return symbolize(pc, false); };
+    if (output.empty() || output == "-") {
+        trie.write_folded(*m_out, name);
+    } else {
+        std::ofstream out{output};
+        trie.write_folded(out, name);
+    }
+
+    std::cerr << std::dec << trie.samples() << " samples, average pause "
+              << std::chrono::duration_cast<std::chrono::microseconds>(paused).count() / std::max<std::size_t>(rounds, 1)
+              << " us" << std::endl;
 }
 
-void debugger::step_over_breakpoint() {
-    if (m_breakpoints.count(get_pc())) {
-        auto &bp = m_breakpoints[get_pc()];
+void debugger::start_coverage() {
+    check_live();
+    if (m_coverage.active()) {
+        *m_out << "Coverage is already being recorded" << std::endl;
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::set<uint64_t> taken;
+    for (auto &[addr, bp]: m_breakpoints) {
         if (bp.is_enabled()) {
-            bp.disable();
-            ptrace(PTRACE_SINGLESTEP, m_pid, nullptr, nullptr);
-            wait_for_signal("show");
-            bp.enable();
+            taken.insert(addr);
         }
     }
+    m_coverage.plant(m_pid, m_dwarf, m_load_address, taken);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    *m_out << "Planted " << std::dec << m_coverage.points() << " coverage breakpoints in " << us.count() << " us"
+              << std::endl;
 }
 
-void debugger::wait_for_signal(std::string call) {
-    int wait_status;
-    auto options = 0;
-    waitpid(m_pid, &wait_status, options);
-
-    auto siginfo = get_signal_info();
-
-    switch (siginfo.si_signo) {
-        case SIGTRAP:
-            handle_sigtrap(siginfo, call);
-            break;
-        case SIGSEGV:
-            std::cout << "Yay, segfault. Reason: " << siginfo.si_code << std::endl;
-            break;
-        default:
-            end_of_program = true;
-            std::cout << "Got signal " << strsignal(siginfo.si_signo) << std::endl;
+void debugger::write_coverage(const std::string &output) {
+    *m_out << std::dec << m_coverage.points_hit() << " of " << m_coverage.points() << " line addresses executed"
+              << std::endl;
+    if (output.empty()) {
+        m_coverage.write_lcov(*m_out);
+        return;
     }
+    std::ofstream out{output};
+    m_coverage.write_lcov(out);
+    *m_out << "Wrote " << output << std::endl;
 }
 
-void debugger::handle_sigtrap(siginfo_t info, std::string call) {
-    switch (info.si_code) {
-        case SI_KERNEL:
-        case TRAP_BRKPT: {
-            set_pc(get_pc() - 1);
-            if(call != "show" && call != "initial"){
-                std::cout << "Hit breakpoint at address 0x" << std::hex << get_pc() << std::endl;
+void debugger::find(uint64_t start, uint64_t end, const std::string &text) {
+    auto pattern = parse_search_pattern(text);
+    //the heap grows and shrinks without the events the cached mappings are refreshed on
+    m_target->mappings_changed();
+    auto maps = m_target->memory_maps();
+    std::vector<search_range> ranges;
+    for (auto &m: maps) {
+        if (!m.readable || m.path == "[vvar]" || m.path == "[vvar_vclock]" || m.path == "[vsyscall]") {
+            continue;
+        }
+        auto from = end ? std::max(m.start, start) : m.start;
+        auto to = end ? std::min(m.end, end) : m.end;
+        if (from < to) {
+            ranges.push_back(search_range{from, to});
+        }
+    }
+    if (ranges.empty()) {
+        std::ostringstream message;
+        message << "Cannot access memory at 0x" << std::hex << start;
+        throw std::runtime_error{message.str()};
+    }
+
+    //the reads of the worker threads do not show in their own syscall counters
+    partial_reader read;
+    if (m_target->live()) {
+        read = [pid = m_pid](uint64_t address, void *buffer, std::size_t size) -> std::size_t {
+            auto n = read_process_memory(pid, address, buffer, size);
+            return n > 0 ? n : 0;
+        };
+    } else {
+        //a core reads a range whole or not at all, on failure the pages are read one by one up to
+        //the first that cannot be, e.g. past the end of a mapped file left out of the core
+        read = [this](uint64_t address, void *buffer, std::size_t size) -> std::size_t {
+            if (m_target->read(address, buffer, size)) {
+                return size;
             }
-            auto offset_pc = offset_load_address(get_pc()); //rember to offset the pc for querying DWARF
-            try{
-                auto line_entry = get_line_entry_from_pc(offset_pc);
-                if (call != "initial"){
-                    print_source(line_entry->file->path, line_entry->line);
+            std::size_t got = 0;
+            while (got < size) {
+                auto n = std::min<uint64_t>(size - got, ((address + got) | 0xfff) + 1 - (address + got));
+                if (!m_target->read(address + got, static_cast<uint8_t *>(buffer) + got, n)) {
+                    break;
                 }
+                got += n;
             }
-            catch(std::out_of_range e){
-                std::cout << "End of program" << std::endl;
-                end_of_program = true;
-                return;
-            }
-            return;
+            return got;
+        };
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    auto counted = g_syscall_counters.memory;
+    //a core is searched where it is mapped
+    auto result = search_memory(ranges, pattern, read, listing_limit,
+                                [this](uint64_t address, std::size_t size) { return m_target->view(address, size); });
+    auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    if (m_target->live()) {
+        g_syscall_counters.memory = counted + result.reads;
+    }
+
+    for (auto address: result.matches) {
+        *m_out << "0x" << std::hex << address;
+        auto m = find_mapping(maps, address);
+        if (m && !m->path.empty()) {
+            *m_out << " in " << m->path;
         }
-        case TRAP_TRACE:
-            return;
-        default:
-            std::cout << "Unknown SIGTRAP code " << info.si_code << std::endl;
-            return;
+        *m_out << std::endl;
+    }
+    if (result.total > result.matches.size()) {
+        *m_out << "... and " << std::dec << result.total - result.matches.size() << " more" << std::endl;
     }
+    *m_out << std::dec << result.total << (result.total == 1 ? " match in " : " matches in ") << std::fixed << std::setprecision(1)
+           << result.bytes / double(1 << 20) << " MiB in " << ms << " ms" << std::endl;
 }
 
-void debugger::continue_execution(std::string call) {
-    step_over_breakpoint();
-    ptrace(PTRACE_CONT, m_pid, nullptr, nullptr);
-    wait_for_signal(call);
+void debugger::take_snapshot(const std::string &name, uint64_t start, uint64_t end) {
+    auto started = std::chrono::steady_clock::now();
+    std::vector<uint8_t> data(end - start);
+    if (!m_target->read(start, data.data(), data.size())) {
+        std::ostringstream message;
+        message << "Cannot access memory in 0x" << std::hex << start << "-0x" << end;
+        throw std::runtime_error{message.str()};
+    }
+    m_snapshots.erase(name);
+    m_snapshots.emplace(name, memory_snapshot{start, std::move(data)});
+
+    auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    *m_out << "Snapshot " << name << " of 0x" << std::hex << start << "-0x" << end << std::dec << " (" << end - start
+           << " bytes) in " << std::fixed << std::setprecision(1) << ms << " ms" << std::endl;
 }
 
-void debugger::dump_registers() {
-    for (const auto &rd: g_register_descriptors) {
-        std::cout << rd.name << " 0x"
-                  << std::setfill('0') << std::setw(16) << std::hex << get_register_value(m_pid, rd.r) << std::endl;
+void debugger::diff_snapshot(const std::string &name) {
+    auto found = m_snapshots.find(name);
+    if (found == m_snapshots.end()) {
+        throw std::out_of_range{"No snapshot " + name};
+    }
+    auto &snapshot = found->second;
+
+    auto started = std::chrono::steady_clock::now();
+    std::vector<uint8_t> current;
+    auto bytes = m_target->view(snapshot.start(), snapshot.size());
+    if (!bytes) {
+        current.resize(snapshot.size());
+        if (!m_target->read(snapshot.start(), current.data(), current.size())) {
+            std::ostringstream message;
+            message << "Cannot access memory in 0x" << std::hex << snapshot.start() << "-0x" << snapshot.end();
+            throw std::runtime_error{message.str()};
+        }
+        bytes = current.data();
+    }
+    auto changes = snapshot.diff(bytes);
+    auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+
+    std::vector<mapping> maps;
+    if (!changes.empty()) {
+        m_target->mappings_changed();
+        maps = m_target->memory_maps();
+        m_modules.load_from_maps(maps);
     }
+    uint64_t changed = 0;
+    for (std::size_t i = 0; i < changes.size(); ++i) {
+        auto &c = changes[i];
+        changed += c.end - c.start;
+        if (i < listing_limit) {
+            *m_out << "0x" << std::hex << c.start << "-0x" << c.end << std::dec << " (" << c.end - c.start
+                   << " bytes) in " << owner_of(c.start, maps) << std::endl;
+        }
+    }
+    if (changes.size() > listing_limit) {
+        *m_out << "... and " << changes.size() - listing_limit << " more" << std::endl;
+    }
+    *m_out << std::dec << changes.size() << " changed ranges, " << changed << " of " << snapshot.size()
+           << " bytes, compared in " << std::fixed << std::setprecision(1) << ms << " ms" << std::endl;
 }
 
-void debugger::handle_command(const std::string &line) {
-    auto args = split(line, ' ');
-    auto command = args[0];
-
-    if (is_prefix(command, "cont")) {
-        continue_execution();
-    } else if (is_prefix(command, "break")) {
-        if (args[1][0] == '0' && args[1][1] == 'x') {
-            std::string addr{args[1], 2};
-            set_breakpoint_at_address(std::stol(addr, 0, 16));
-        } else if (args[1].find(':') != std::string::npos) {
-            auto file_and_line = split(args[1], ':');
-            set_breakpoint_at_source_line(file_and_line[0], std::stol(file_and_line[1]));
-        } else {
-            set_breakpoint_at_function(args[1]);
-        }
-    } else if (is_prefix(command, "step")) {
-        step_in();
-    } else if (is_prefix(command, "next")) {
-        step_over();
-    } else if (is_prefix(command, "finish")) {
-        step_out();
-    } else if (is_prefix(command, "register")) {
-        if (is_prefix(args[1], "dump")) {
-            dump_registers();
-        } else if (is_prefix(args[1], "read")) {
-            std::cout << get_register_value(m_pid, get_register_from_name(args[2])) << std::endl;
-        } else if (is_prefix(args[1], "write")) {
-            std::string val{args[3], 2}; //assume 0xVAL
-            set_register_value(m_pid, get_register_from_name(args[2]), std::stol(val, 0, 16));
+std::string debugger::owner_of(uint64_t addr, const std::vector<mapping> &maps) {
+    if (auto m = m_modules.find(addr)) {
+        if (auto index = m->index()) {
+            if (auto sym = index->find_symbol(addr - m->bias())) {
+                std::ostringstream owner;
+                owner << demangle(sym->name);
+                if (auto offset = addr - m->bias() - sym->addr) {
+                    owner << "+0x" << std::hex << offset;
+                }
+                return owner.str();
+            }
         }
-    } else if (is_prefix(command, "memory")) {
-        std::string addr{args[2], 2}; //assume 0xADDRESS
+    }
 
-        if (is_prefix(args[1], "read")) {
-            std::cout << std::hex << read_memory(std::stol(addr, 0, 16)) << std::endl;
+    auto mapping = find_mapping(maps, addr);
+    if (!mapping) {
+        return "??";
+    }
+    return mapping->path.empty() ? "[anonymous]" : mapping->path;
+}
+
+void debugger::gcore(const std::string &path) {
+    check_live();
+    std::vector<pid_t> running;
+    for (auto &[tid, thread]: m_threads) {
+        if (!thread.stopped) {
+            running.push_back(tid);
         }
-        if (is_prefix(args[1], "write")) {
-            std::string val{args[3], 2}; //assume 0xVAL
-            write_memory(std::stol(addr, 0, 16), std::stol(val, 0, 16));
+    }
+    if (!running.empty()) {
+        stop_all_threads();
+    }
+
+    //the threads that were running go on whether or not the core could be written
+    auto resume_running = [&] {
+        for (auto tid: running) {
+            auto thread = m_threads.find(tid);
+            if (thread != m_threads.end() && thread->second.stopped) {
+                resume_thread(thread->second, PTRACE_CONT);
+            }
         }
-    } else if (is_prefix(command, "symbol")) {
-        auto syms = lookup_symbol(args[1]);
-        for (auto &&s: syms) {
-            std::cout << s.name << ' ' << to_string(s.type) << " 0x" << std::hex << s.addr << std::endl;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    core_stats stats;
+    try {
+        std::vector<core_thread> threads;
+        auto &current = current_thread();
+        threads.push_back(core_thread{current.tid, get_registers(current), m_stop_signal});
+        for (auto &[tid, thread]: m_threads) {
+            if (tid != current.tid) {
+                threads.push_back(core_thread{tid, get_registers(thread), 0});
+            }
         }
+
+        //the core shows the program's own instructions, not the int3 under our breakpoints
+        std::map<uint64_t, uint8_t> patches;
+        for (auto &[addr, bp]: m_breakpoints) {
+            if (bp.is_enabled()) {
+                patches[addr] = bp.get_saved_data();
+            }
+        }
+        m_coverage.original_bytes(patches);
+        m_libraries.original_bytes(patches);
+
+        stats = write_core(m_pid, threads, patches, path);
+    } catch (...) {
+        resume_running();
+        throw;
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    resume_running();
+
+    *m_out << "Saved " << path << ": " << std::dec << stats.segments << " segments, "
+           << (stats.bytes - stats.zero_bytes) / 1024 << " KiB written, " << stats.zero_bytes / 1024
+           << " KiB of zero pages left as holes, in " << ms.count() << " ms" << std::endl;
+}
+
+void debugger::coverage(const std::string &output) {
+    initialise();
+    start_coverage();
+    while (!end_of_program) {
+        continue_execution("show");
+    }
+    write_coverage(output);
+}
+
+void debugger::trace_syscalls(const std::string &output) {
+    initialise();
+    m_ptrace_options = PTRACE_O_TRACECLONE | PTRACE_O_TRACESECCOMP | PTRACE_O_TRACESYSGOOD;
+    counted_ptrace(PTRACE_SETOPTIONS, m_pid, nullptr, m_ptrace_options);
+    m_syscalls.start(output);
+    while (!end_of_program) {
+        continue_execution("show");
+    }
+    m_syscalls.print_summary(*m_out);
+}
+
+debugger::~debugger() {
+    for (auto &cp: m_checkpoints) {
+        kill(cp.pid, SIGKILL);
+        int status;
+        waitpid(cp.pid, &status, __WALL);
+    }
+}
+
+void debugger::take_checkpoint() {
+    check_live();
+    if (m_attached) {
+        throw std::runtime_error{"Checkpoints need a program started by the debugger"};
+    }
+    if (m_threads.size() != 1 || any_running(m_threads)) {
+        throw std::runtime_error{"Checkpoints need a stopped, single threaded program"};
+    }
+    if (m_coverage.active()) {
+        throw std::runtime_error{"No checkpoints while coverage is collected"};
+    }
+
+    auto &thread = current_thread();
+    auto &regs = get_registers(thread);
+    auto pid = fork_stopped_process(m_pid, regs, m_ptrace_options);
+    if (pid < 0) {
+        throw std::runtime_error{std::string{"Cannot fork the program: "} + strerror(errno)};
+    }
+    thread.regs_dirty = false;
+
+    //the copy keeps the program's own code, the breakpoints are planted again when it is restarted
+    std::map<uint64_t, uint8_t> original;
+    for (auto &[addr, bp]: m_breakpoints) {
+        if (bp.is_enabled()) {
+            original[addr] = bp.get_saved_data();
+        }
+    }
+    m_libraries.original_bytes(original);
+    for (auto &[addr, data]: original) {
+        write_process_memory(pid, addr, &data, 1);
+    }
+
+    m_checkpoints.push_back(checkpoint{m_next_checkpoint++, pid, regs, symbolize(regs.rip, true)});
+    auto &cp = m_checkpoints.back();
+    *m_out << "Checkpoint " << std::dec << cp.id << ": process " << pid << " at 0x" << std::hex << regs.rip
+           << " in " << cp.location << std::endl;
+}
+
+void debugger::restart(unsigned id) {
+    auto cp = std::find_if(m_checkpoints.begin(), m_checkpoints.end(), [&](auto &&c) { return c.id == id; });
+    if (cp == m_checkpoints.end()) {
+        throw std::out_of_range{"No checkpoint " + std::to_string(id)};
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto pid = fork_stopped_process(cp->pid, cp->regs, m_ptrace_options);
+    if (pid < 0) {
+        throw std::runtime_error{std::string{"Cannot fork checkpoint "} + std::to_string(id) + ": " + strerror(errno)};
+    }
+
+    //the process being debugged is dropped
+    if (!end_of_program) {
+        kill_program();
+    }
+
+    m_pid = pid;
+    m_tid = pid;
+    m_threads.clear();
+    auto &thread = m_threads[pid];
+    thread.tid = pid;
+    thread.stopped = true;
+    thread.regs = cp->regs;
+    thread.regs_valid = true;
+    end_of_program = false;
+    m_stop_signal = m_stop_code = m_exit_code = m_exit_signal = 0;
+    m_target = make_live_target(pid);
+    m_events.watch_process(pid);
+    m_stopped_since = std::chrono::steady_clock::now();
+
+    for (auto &[addr, bp]: m_breakpoints) {
+        auto enabled = bp.is_enabled();
+        bp = breakpoint{pid, addr};
+        if (enabled) {
+            bp.enable();
+        }
+    }
+    m_libraries.move_to(pid);
+
+    auto ms = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    *m_out << "Switched to process " << std::dec << pid << " from checkpoint " << id << " in " << std::fixed
+           << std::setprecision(3) << ms.count() / 1000.0 << " ms, at 0x" << std::hex << cp->regs.rip << " in "
+           << cp->location << std::endl;
+}
+
+void debugger::kill_program() {
+    kill(m_pid, SIGKILL);
+    for (auto &[tid, thread]: m_threads) {
+        int status;
+        while (tid != m_pid && waitpid(tid, &status, __WALL) == tid && !WIFEXITED(status) && !WIFSIGNALED(status)) {
+        }
+    }
+    int status;
+    while (waitpid(m_pid, &status, __WALL) == m_pid && !WIFEXITED(status) && !WIFSIGNALED(status)) {
+    }
+}
+
+void debugger::print_checkpoints() {
+    for (auto &cp: m_checkpoints) {
+        *m_out << std::dec << cp.id << " process " << cp.pid << " at 0x" << std::hex << cp.regs.rip << " in "
+               << cp.location << std::endl;
+    }
+}
+
+void debugger::print_threads() {
+    for (auto &[tid, thread]: m_threads) {
+        *m_out << (tid == m_tid ? "* " : "  ") << std::dec << tid;
+        if (thread.stopped) {
+            *m_out << " stopped at 0x" << std::hex << get_register_value(get_registers(thread), reg::rip);
+        } else {
+            *m_out << " running";
+        }
+        *m_out << std::endl;
+    }
+}
+
+void debugger::select_thread(pid_t tid) {
+    if (!m_threads.count(tid)) {
+        throw std::runtime_error{"No thread " + std::to_string(tid)};
+    }
+    m_tid = tid;
+    *m_out << "[Switching to thread " << std::dec << tid << "]" << std::endl;
+}
+
+void debugger::set_non_stop(bool non_stop) {
+    check_live();
+    m_non_stop = non_stop;
+    if (!m_non_stop) {
+        stop_all_threads();
+        return;
+    }
+
+    //only the selected thread stays stopped, the others go back to work
+    for (auto &[tid, thread]: m_threads) {
+        if (tid != m_tid && thread.stopped) {
+            resume_thread(thread, PTRACE_CONT);
+        }
+    }
+}
+
+uint64_t debugger::get_pc() {
+    return get_register(reg::rip);
+}
+
+uint64_t debugger::get_offset_pc() {
+    return offset_load_address(get_pc());
+}
+
+void debugger::set_pc(uint64_t pc) {
+    set_register(reg::rip, pc);
+}
+
+dwarf::die debugger::get_function_from_pc(uint64_t pc) {
+    if (auto die = m_index.find_function(pc)) {
+        return *die;
+    }
+
+    throw std::out_of_range{"Cannot find function"};
+}
+
+dwarf::line_table::iterator debugger::get_line_entry_from_pc(uint64_t pc) {
+    if (auto entry = m_index.find_line(pc)) {
+        return *entry;
+    }
+
+    throw std::out_of_range{"Cannot find line entry"};
+}
+
+void debugger::print_source(const std::string &file_name, unsigned line, unsigned n_lines_context, std::string call) {
+    std::ifstream file{file_name};
+
+    auto start_line = line <= n_lines_context ? 1 : line - n_lines_context;
+    auto end_line = line + n_lines_context + (line < n_lines_context ? n_lines_context - line : 0) + 1;
+
+    char c{};
+    auto current_line = 1u;
+
+    while (current_line != start_line && file.get(c)) {
+        if (c == '\n') {
+            ++current_line;
+        }
+    }
+
+    if(call != "show") {
+        *m_out << (current_line == line ? "> " : "  ");
+    }
+    else *m_out << "  ";
+
+    while (current_line <= end_line && file.get(c)) {
+        *m_out << c;
+        if (c == '\n') {
+            ++current_line;
+
+            if(call != "show") {
+                *m_out << (current_line == line ? "> " : "  ");
+            }
+            else *m_out << "  ";
+        }
+    }
+
+    *m_out << std::endl;
+}
+
+/*void debugger::show(){
+    auto func = get_function_from_pc(get_offset_pc());
+    auto func_entry = at_low_pc(func);
+    auto func_end = at_high_pc(func);
+
+    auto line_entry = get_line_entry_from_pc(func_entry);
+    auto line_end = get_line_entry_from_pc(func_end-3);
+
+    std::ifstream file{line_entry->file->path};
+    auto tmp=line_end->end_sequence;
+    auto tmp2=line_end->epilogue_begin;
+
+    char c{};
+    auto current_line = 1u;
+
+    while (current_line != line_entry->line && file.get(c)) {
+        if (c == '\n') {
+            ++current_line;
+        }
+    }
+
+    *m_out << "  ";
+
+    while (current_line <= line_end->line + 1 && file.get(c)) {
+        *m_out << c;
+        if (c == '\n') {
+            ++current_line;
+            *m_out << "  ";
+        }
+    }
+
+    *m_out << std::endl;
+}*/
+
+siginfo_t debugger::get_signal_info() {
+    siginfo_t info;
+    counted_ptrace(PTRACE_GETSIGINFO, m_tid, nullptr, &info);
+    return info;
+}
+
+void debugger::step_over_breakpoint() {
+    if (m_breakpoints.count(get_pc())) {
+        auto &bp = m_breakpoints[get_pc()];
+        if (bp.is_enabled()) {
+            //in non-stop mode the other threads may run past the breakpoint while it is lifted
+            bp.disable();
+            resume_thread(current_thread(), PTRACE_SINGLESTEP);
+            wait_for_signal("show", m_tid);
+            bp.enable();
+        }
+    }
+}
+
+void debugger::wait_for_signal(std::string call, pid_t tid) {
+    if (tid != -1) {
+        //a thread that was just stepped, it reports right away
+        int wait_status;
+        do {
+            if (waitpid(tid, &wait_status, __WALL) < 0) {
+                end_of_program = true;
+                return;
+            }
+        } while (!handle_wait_status(tid, wait_status, call));
+    } else if (!wait_for_event(call)) {
+        return;
+    }
+
+    if (!m_non_stop && !end_of_program) {
+        stop_all_threads();
+    }
+}
+
+//Serves tracee events the moment SIGCHLD arrives and keeps reading commands meanwhile, so an
+//interrupt works while the program runs. The other commands typed meanwhile are read again at the
+//stop. Returns false if nothing runs that could report.
+bool debugger::wait_for_event(const std::string &call) {
+    std::vector<std::string> deferred;
+    while (true) {
+        if (!any_running(m_threads)) {
+            m_events.unread(deferred);
+            return false;
+        }
+
+        if (drain_events(call)) {
+            m_events.discard_interrupt();
+            m_events.unread(deferred);
+            return true;
+        }
+
+        switch (m_events.wait()) {
+            case event_loop::event::tracee:
+                break;
+            case event_loop::event::interrupt:
+                interrupt();
+                break;
+            case event_loop::event::input: {
+                std::string line;
+                while (m_events.next_line(line)) {
+                    if (!handle_running_command(line)) {
+                        deferred.push_back(line);
+                    }
+                }
+                break;
+            }
+        }
+    }
+}
+
+//SIGCHLD does not queue, every wake up collects all pending events. __WNOTHREAD keeps the
+//tracees of other worker threads out. Returns true at a stop to report or at the end of the program.
+bool debugger::drain_events(const std::string &call) {
+    int wait_status;
+    pid_t event_tid;
+    while ((event_tid = waitpid(-1, &wait_status, __WALL | __WNOTHREAD | WNOHANG)) > 0) {
+        if (handle_wait_status(event_tid, wait_status, call)) {
+            return true;
+        }
+    }
+    if (event_tid < 0) {
+        end_of_program = true;
+        return true;
+    }
+    return false;
+}
+
+void debugger::serve(const std::function<void(const std::string &output, bool command_done)> &report) {
+    auto flush = [&](bool command_done) {
+        auto text = m_capture.str();
+        m_capture.str("");
+        if (!text.empty() || command_done) {
+            report(text, command_done);
+        }
+    };
+
+    while (!end_of_program) {
+        //stops of threads left running in non-stop mode are reported on their own
+        if (drain_events("break") && !m_non_stop && !end_of_program) {
+            stop_all_threads();
+        }
+        flush(false);
+        if (end_of_program) {
+            break;
+        }
+
+        if (m_events.wait() == event_loop::event::input) {
+            std::string line;
+            while (!end_of_program && m_events.next_line(line)) {
+                try {
+                    if (!line.empty()) {
+                        handle_command(line);
+                    }
+                } catch (std::exception &e) {
+                    *m_out << "Error: " << e.what() << std::endl;
+                }
+                flush(true);
+            }
+        }
+    }
+    flush(false);
+}
+
+//the prompt of non-stop mode while other threads run: their stops are reported as they happen.
+//Returns false once no thread runs any more, the line editor can take over again then.
+bool debugger::read_command_while_running(std::string &line) {
+    *m_out << "MEGAdbg> " << std::flush;
+    while (true) {
+        int wait_status;
+        pid_t event_tid;
+        while ((event_tid = waitpid(-1, &wait_status, __WALL | __WNOTHREAD | WNOHANG)) > 0) {
+            if (handle_wait_status(event_tid, wait_status, "break")) {
+                *m_out << "MEGAdbg> " << std::flush;
+            }
+        }
+        if (event_tid < 0) {
+            end_of_program = true;
+        }
+        if (end_of_program || !any_running(m_threads)) {
+            *m_out << std::endl;
+            return false;
+        }
+
+        switch (m_events.wait()) {
+            case event_loop::event::tracee:
+                break;
+            case event_loop::event::interrupt:
+                interrupt();
+                break;
+            case event_loop::event::input:
+                if (m_events.next_line(line)) {
+                    return true;
+                }
+                break;
+        }
+    }
+}
+
+bool debugger::handle_running_command(const std::string &line) {
+    auto args = split(line, ' ');
+    if (!args.empty() && is_prefix(args[0], "interrupt")) {
+        interrupt();
+    } else if (!args.empty() && is_prefix(args[0], "thread") && args.size() == 1) {
+        print_threads();
+    } else {
+        return false;
+    }
+    return true;
+}
+
+pid_t debugger::interrupt() {
+    check_live();
+    auto target = m_threads.find(m_tid);
+    if (target == m_threads.end() || target->second.stopped) {
+        target = std::find_if(m_threads.begin(), m_threads.end(), [](auto &&t) { return !t.second.stopped; });
+    }
+    if (target == m_threads.end()) {
+        return 0;
+    }
+
+    auto &thread = target->second;
+    if (!thread.interrupt_requested) {
+        thread.interrupt_requested = true;
+        if (m_attached) {
+            counted_ptrace(PTRACE_INTERRUPT, thread.tid, nullptr, nullptr);
+        } else {
+            syscall(SYS_tgkill, m_pid, thread.tid, SIGSTOP);
+        }
+    }
+    return thread.tid;
+}
+
+//returns true when the event is a stop that has to be reported to the user
+bool debugger::handle_wait_status(pid_t tid, int wait_status, std::string call) {
+    if (WIFEXITED(wait_status) || WIFSIGNALED(wait_status)) {
+        m_threads.erase(tid);
+        if (tid == m_pid || m_threads.empty()) {
+            end_of_program = true;
+            m_exit_code = WIFEXITED(wait_status) ? WEXITSTATUS(wait_status) : 0;
+            m_exit_signal = WIFSIGNALED(wait_status) ? WTERMSIG(wait_status) : 0;
+            report_false_hits(false);
+            if (WIFEXITED(wait_status)) {
+                *m_out << "Process " << std::dec << m_pid << " exited with code " << WEXITSTATUS(wait_status) << std::endl;
+            } else {
+                *m_out << "Process " << std::dec << m_pid << " killed by signal " << strsignal(WTERMSIG(wait_status)) << std::endl;
+            }
+            return true;
+        }
+        *m_out << "[Thread " << std::dec << tid << " exited]" << std::endl;
+        if (tid == m_tid) {
+            m_tid = m_threads.begin()->first;
+        }
+        return false;
+    }
+
+    if (!WIFSTOPPED(wait_status)) {
+        return false;
+    }
+
+    if (!m_threads.count(tid)) {
+        //a new thread may report its initial stop before the clone event of its parent
+        add_thread(tid);
+    }
+    m_stopped_since = std::chrono::steady_clock::now();
+    auto &thread = m_threads[tid];
+    thread.stopped = true;
+
+    auto sig = WSTOPSIG(wait_status);
+    auto event = wait_status >> 16;
+
+    if (sig == SIGTRAP && event == PTRACE_EVENT_CLONE) {
+        unsigned long new_tid;
+        counted_ptrace(PTRACE_GETEVENTMSG, tid, nullptr, &new_tid);
+        if (!m_threads.count(new_tid)) {
+            add_thread(new_tid);
+        }
+        m_target->mappings_changed(); //the stack of the thread
+        *m_out << "[New thread " << std::dec << new_tid << "]" << std::endl;
+        //a traced clone still has its syscall exit stop to come
+        resume_thread(thread, thread.stepping ? PTRACE_SINGLESTEP : thread.in_syscall ? PTRACE_SYSCALL : PTRACE_CONT);
+        return false;
+    }
+
+    //auto-attached threads of a seized process start with PTRACE_EVENT_STOP instead of SIGSTOP
+    if (thread.new_thread && (sig == SIGSTOP || event == PTRACE_EVENT_STOP)) {
+        thread.new_thread = false;
+        resume_thread(thread, PTRACE_CONT);
+        return false;
+    }
+
+    if (thread.interrupt_requested && (sig == SIGSTOP || event == PTRACE_EVENT_STOP)) {
+        thread.interrupt_requested = false;
+        m_tid = tid;
+        m_stop_signal = SIGINT;
+        auto pc = get_register_value(get_registers(thread), reg::rip);
+        *m_out << "Thread " << std::dec << tid << " interrupted at 0x" << std::hex << pc << " in "
+                  << symbolize(pc, true) << std::endl;
+        return true;
+    }
+
+    if (event == PTRACE_EVENT_SECCOMP || sig == (SIGTRAP | 0x80)) {
+        handle_syscall_stop(thread, event == PTRACE_EVENT_SECCOMP);
+        return false;
+    }
+
+    if (sig == SIGTRAP && event == 0 && !thread.stepping && handle_fast_trap(thread)) {
+        return false;
+    }
+
+    if (tid != m_tid) {
+        m_tid = tid;
+        *m_out << "[Switching to thread " << std::dec << tid << "]" << std::endl;
+    }
+
+    auto siginfo = get_signal_info();
+    m_stop_signal = siginfo.si_signo;
+    m_stop_code = siginfo.si_code;
+
+    switch (siginfo.si_signo) {
+        case SIGTRAP:
+            handle_sigtrap(siginfo, call);
+            break;
+        case SIGINT:
+            //Ctrl-C at the prompt also reaches the tracee, it is not passed on like in gdb
+            *m_out << "Got signal " << strsignal(SIGINT) << std::endl;
+            if (!m_interactive) {
+                thread.pending_signal = SIGINT;
+            }
+            break;
+        case SIGSEGV:
+            thread.pending_signal = SIGSEGV;
+            *m_out << "Yay, segfault. Reason: " << siginfo.si_code << std::endl;
+            break;
+        default:
+            thread.pending_signal = siginfo.si_signo;
+            *m_out << "Got signal " << strsignal(siginfo.si_signo) << std::endl;
+    }
+    return true;
+}
+
+//breakpoints that never stop the user are serviced here, before any signal info is fetched or
+//anything printed, and the thread is resumed right away
+bool debugger::handle_fast_trap(thread_state &thread) {
+    if (m_libraries.active() && m_libraries.is_event(get_register_value(get_registers(thread), reg::rip) - 1)) {
+        handle_library_event(thread);
+        return true;
+    }
+    if (!m_coverage.active() && m_stop_rules.empty() && m_tracepoints.empty()) {
+        return false;
+    }
+
+    auto &regs = get_registers(thread);
+    auto addr = get_register_value(regs, reg::rip) - 1;
+    auto user = m_breakpoints.find(addr);
+    auto user_enabled = user != m_breakpoints.end() && user->second.is_enabled();
+    if (m_coverage.active() && m_coverage.hit(addr, user_enabled) && !user_enabled) {
+        set_register_value(regs, reg::rip, addr);
+        thread.regs_dirty = true;
+        resume_thread(thread, PTRACE_CONT);
+        return true;
+    }
+
+    auto rule = m_stop_rules.find(addr);
+    auto trace = m_tracepoints.find(addr);
+    if (!user_enabled || (rule == m_stop_rules.end() && trace == m_tracepoints.end())) {
+        return false;
+    }
+    if (trace != m_tracepoints.end()) {
+        collect(thread, addr, trace->second);
+    }
+    if (rule != m_stop_rules.end()) {
+        return !passes_breakpoint(thread, addr, rule->second);
+    }
+    resume_past_breakpoint(thread, addr);
+    return true;
+}
+
+bool debugger::passes_breakpoint(thread_state &thread, std::intptr_t addr, stop_rule &rule) {
+    ++rule.hits;
+    if (!rule.condition && !rule.ignore) {
+        return true;
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    auto stop = true;
+    if (rule.condition) {
+        try {
+            auto regs = regs_at_trap(thread, addr);
+            stop = rule.condition->test(trap_context(regs, rule.cfa));
+        } catch (std::exception &e) {
+            *m_out << "Error in testing condition of breakpoint " << std::dec << rule.number << ": " << e.what()
+                   << std::endl;
+            return true;
+        }
+    }
+    //as in gdb, only hits with a true condition use up the ignore count
+    if (stop && rule.ignore) {
+        --rule.ignore;
+        stop = false;
+    }
+    if (stop) {
+        return true;
+    }
+
+    ++rule.false_hits;
+    ++m_false_hits;
+    resume_past_breakpoint(thread, addr);
+    m_false_hit_time += std::chrono::steady_clock::now() - started;
+    return false;
+}
+
+void debugger::resume_past_breakpoint(thread_state &thread, std::intptr_t addr) {
+    set_register_value(get_registers(thread), reg::rip, addr);
+    thread.regs_dirty = true;
+    auto &bp = m_breakpoints[addr];
+    bp.disable();
+    auto stepped = step_thread(thread);
+    bp.rearm();
+    if (stepped) {
+        resume_thread(thread, PTRACE_CONT);
+    }
+}
+
+void debugger::collect(thread_state &thread, std::intptr_t addr, tracepoint &tp) {
+    ++tp.hits;
+    auto regs = regs_at_trap(thread, addr);
+    auto context = trap_context(regs, tp.cfa);
+    uint64_t values[max_trace_values];
+    uint64_t missing = 0;
+    for (std::size_t i = 0; i < tp.values.size(); ++i) {
+        try {
+            values[i] = tp.values[i].evaluate(context);
+        } catch (std::exception &) {
+            values[i] = 0;
+            missing |= uint64_t{1} << i;
+        }
+    }
+    auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    m_trace->record(tp.number, time, addr, thread.tid, missing, values, tp.values.size());
+}
+
+bool debugger::step_thread(thread_state &thread) {
+    resume_thread(thread, PTRACE_SINGLESTEP, false);
+    int wait_status;
+    waitpid(thread.tid, &wait_status, __WALL);
+    if (!WIFSTOPPED(wait_status)) {
+        handle_wait_status(thread.tid, wait_status, "break");
+        return false;
+    }
+    thread.stopped = true;
+    if (WSTOPSIG(wait_status) != SIGTRAP) {
+        thread.pending_signal = WSTOPSIG(wait_status);
+    }
+    return true;
+}
+
+void debugger::report_false_hits(bool stopped) {
+    if (!m_false_hits) {
+        return;
+    }
+    auto us = std::chrono::duration<double, std::micro>(m_false_hit_time).count();
+    *m_out << std::dec << m_false_hits << " breakpoint hits did not stop (" << std::fixed << std::setprecision(2)
+           << 100.0 * m_false_hits / (m_false_hits + stopped) << "% of the hits), resumed in " << std::setprecision(1)
+           << us / m_false_hits << " us each" << std::endl;
+    m_false_hits = 0;
+    m_false_hit_time = {};
+}
+
+void debugger::start_library_tracking() {
+    m_modules.load_from_maps(m_target->memory_maps());
+    if (m_libraries.start(m_pid, m_modules)) {
+        m_libraries.update(*m_target); //an attached process has its libraries already
+    }
+}
+
+//the dynamic linker changed its link_map list: new libraries get their modules and the breakpoints
+//waiting for them, then the thread steps over the internal breakpoint and runs on
+void debugger::handle_library_event(thread_state &thread) {
+    auto &regs = get_registers(thread);
+    set_register_value(regs, reg::rip, get_register_value(regs, reg::rip) - 1);
+    thread.regs_dirty = true;
+
+    auto added = m_libraries.update(*m_target);
+    m_target->mappings_changed();
+    if (!added.empty()) {
+        m_modules.load_from_maps(m_target->memory_maps());
+        resolve_pending_breakpoints(added);
+    }
+
+    m_libraries.disable();
+    auto stepped = step_thread(thread);
+    m_libraries.enable();
+    if (stepped) {
+        resume_thread(thread, PTRACE_CONT);
+    }
+}
+
+void debugger::resolve_pending_breakpoints(const std::vector<std::string> &libraries) {
+    for (auto &path: libraries) {
+        auto &modules = m_modules.modules();
+        auto m = std::find_if(modules.begin(), modules.end(), [&](auto &&m) { return m->path() == path; });
+        if (m == modules.end()) {
+            continue;
+        }
+        for (auto name = m_pending_breakpoints.begin(); name != m_pending_breakpoints.end();) {
+            auto addr = (*m)->breakpoint_address(*name);
+            if (!addr) {
+                ++name;
+                continue;
+            }
+            *m_out << "Resolved pending breakpoint on " << *name << " in " << path << std::endl;
+            set_breakpoint_at_address(addr);
+            m_library_breakpoints.insert(addr);
+            name = m_pending_breakpoints.erase(name);
+        }
+    }
+}
+
+//a traced syscall is resumed with PTRACE_SYSCALL to see its exit, everything else runs with PTRACE_CONT
+void debugger::handle_syscall_stop(thread_state &thread, bool entry) {
+    if (entry) {
+        m_syscalls.enter(thread.tid, get_registers(thread));
+        thread.in_syscall = true;
+        resume_thread(thread, PTRACE_SYSCALL);
+    } else {
+        auto &regs = get_registers(thread);
+        m_syscalls.exit(thread.tid, regs);
+        thread.in_syscall = false;
+        auto nr = static_cast<long>(regs.orig_rax);
+        if (nr == SYS_mmap || nr == SYS_munmap || nr == SYS_mprotect || nr == SYS_mremap) {
+            m_target->mappings_changed();
+        }
+        resume_thread(thread, PTRACE_CONT);
+    }
+}
+
+//all-stop mode: once one thread reports a stop, park the others with SIGSTOP
+void debugger::stop_all_threads() {
+    for (auto &[tid, thread]: m_threads) {
+        if (!thread.stopped && !thread.new_thread) {
+            if (m_attached) {
+                counted_ptrace(PTRACE_INTERRUPT, tid, nullptr, nullptr);
+            } else {
+                syscall(SYS_tgkill, m_pid, tid, SIGSTOP);
+            }
+        }
+    }
+
+    //events are collected from any thread: a leader that already exited is only reported
+    //after all other threads are reaped, so waiting on one thread at a time could block forever
+    auto running = [this]() {
+        return std::any_of(m_threads.begin(), m_threads.end(), [](auto &&t) { return !t.second.stopped; });
+    };
+
+    while (running()) {
+        int wait_status;
+        auto tid = waitpid(-1, &wait_status, __WALL | __WNOTHREAD);
+        if (tid < 0) {
+            m_threads.clear();
+            break;
+        }
+
+        if (WIFEXITED(wait_status) || WIFSIGNALED(wait_status)) {
+            m_threads.erase(tid);
+            if (tid == m_tid && !m_threads.empty()) {
+                m_tid = m_threads.begin()->first;
+            }
+            continue;
+        }
+        if (!WIFSTOPPED(wait_status)) {
+            continue;
+        }
+
+        if (!m_threads.count(tid)) {
+            add_thread(tid);
+        }
+        auto &thread = m_threads[tid];
+        auto sig = WSTOPSIG(wait_status);
+        auto event = wait_status >> 16;
+        thread.stopped = true;
+
+        if ((sig == SIGSTOP && event == 0) || event == PTRACE_EVENT_STOP) {
+            thread.new_thread = false;
+            thread.interrupt_requested = false;
+        } else if (sig == SIGTRAP && event == PTRACE_EVENT_CLONE) {
+            unsigned long new_tid;
+            counted_ptrace(PTRACE_GETEVENTMSG, tid, nullptr, &new_tid);
+            if (!m_threads.count(new_tid)) {
+                add_thread(new_tid);
+            }
+            m_target->mappings_changed();
+            *m_out << "[New thread " << std::dec << new_tid << "]" << std::endl;
+            resume_thread(thread, PTRACE_CONT, false);
+        } else {
+            if (sig == SIGTRAP) {
+                //the breakpoint will be hit again once the thread is resumed
+                auto pc = get_register_value(get_registers(thread), reg::rip) - 1;
+                if (m_breakpoints.count(pc) || m_coverage.contains(pc) || m_libraries.is_event(pc)) {
+                    set_register_value(thread.regs, reg::rip, pc);
+                    thread.regs_dirty = true;
+                }
+            } else if (sig != (SIGTRAP | 0x80)) {
+                thread.pending_signal = sig;
+            }
+            resume_thread(thread, PTRACE_CONT, false);
+        }
+    }
+
+    if (m_threads.empty()) {
+        end_of_program = true;
+    }
+}
+
+void debugger::handle_sigtrap(siginfo_t info, std::string call) {
+    switch (info.si_code) {
+        case SI_KERNEL:
+        case TRAP_BRKPT: {
+            set_pc(get_pc() - 1);
+            if (call == "remote") {
+                return; //the gdb client does its own reporting
+            }
+            if(call != "show" && call != "initial"){
+                report_false_hits(true);
+                auto rule = m_stop_rules.find(get_pc());
+                if (rule != m_stop_rules.end()) {
+                    *m_out << "Hit breakpoint " << std::dec << rule->second.number << " at address 0x" << std::hex
+                           << get_pc() << std::endl;
+                } else {
+                    *m_out << "Hit breakpoint at address 0x" << std::hex << get_pc() << std::endl;
+                }
+            }
+            auto offset_pc = offset_load_address(get_pc()); //rember to offset the pc for querying DWARF
+            try{
+                auto line_entry = get_line_entry_from_pc(offset_pc);
+                if (call != "initial"){
+                    print_source(line_entry->file->path, line_entry->line);
+                }
+            }
+            catch(std::out_of_range e){
+                if (m_library_breakpoints.count(get_pc())) {
+                    *m_out << "in " << symbolize(get_pc(), true) << std::endl;
+                    return;
+                }
+                *m_out << "End of program" << std::endl;
+                end_of_program = true;
+                return;
+            }
+            return;
+        }
+        case TRAP_TRACE:
+        case TRAP_HWBKPT:
+            return;
+        default:
+            *m_out << "Unknown SIGTRAP code " << info.si_code << std::endl;
+            return;
+    }
+}
+
+void debugger::continue_execution(std::string call) {
+    m_false_hits = 0;
+    m_false_hit_time = {};
+    step_over_breakpoint();
+    if (end_of_program) {
+        return;
+    }
+
+    if (m_non_stop) {
+        resume_thread(current_thread(), PTRACE_CONT);
+    } else {
+        for (auto &[tid, thread]: m_threads) {
+            if (thread.stopped) {
+                resume_thread(thread, PTRACE_CONT);
+            }
+        }
+    }
+    wait_for_signal(call);
+}
+
+void debugger::dump_registers() {
+    for (const auto &rd: g_register_descriptors) {
+        *m_out << rd.name << " 0x"
+                  << std::setfill('0') << std::setw(16) << std::hex << get_register(rd.r) << std::endl;
+    }
+}
+
+void debugger::handle_command(const std::string &line) {
+    auto args = split(line, ' ');
+    auto command = args[0];
+
+    if (is_prefix(command, "cont")) {
+        continue_execution();
+    } else if (is_prefix(command, "break")) {
+        //break <location> [if <condition>]
+        set_breakpoint_at_location(args[1], "break");
+        if (args.size() > 3 && args[2] == "if") {
+            auto condition = line.substr(line.find(" if ") + 4);
+            for (auto addr: m_set_by_command) {
+                set_condition(m_stop_rules.at(addr).number, condition);
+            }
+        }
+    } else if (command == "trace") {
+        auto collect = line.find(" collect ");
+        if (args.size() < 4 || args[2] != "collect") {
+            throw std::runtime_error{"Usage: trace <location> collect <expression>[, <expression>...]"};
+        }
+        set_breakpoint_at_location(args[1], "trace");
+        set_tracepoints(line.substr(collect + 9));
+    } else if (command == "tdump") {
+        dump_trace_file(args.size() > 1 ? args[1] : "");
+    } else if (command == "condition") {
+        //condition <number> [<expression>], without one the breakpoint stops on every hit again
+        if (args.size() < 2) {
+            throw std::runtime_error{"Usage: condition <breakpoint number> [<expression>]"};
+        }
+        auto start = line.find_first_not_of(' ', line.find(args[1]) + args[1].size());
+        set_condition(std::stoul(args[1]), start == std::string::npos ? "" : line.substr(start));
+    } else if (command == "ignore") {
+        if (args.size() < 3) {
+            throw std::runtime_error{"Usage: ignore <breakpoint number> <count>"};
+        }
+        set_ignore_count(std::stoul(args[1]), std::stoull(args[2]));
+    } else if (is_prefix(command, "step")) {
+        step_in();
+    } else if (is_prefix(command, "next")) {
+        step_over();
+    } else if (is_prefix(command, "finish")) {
+        step_out();
+    } else if (is_prefix(command, "register")) {
+        if (is_prefix(args[1], "dump")) {
+            dump_registers();
+        } else if (is_prefix(args[1], "read")) {
+            *m_out << get_register(get_register_from_name(args[2])) << std::endl;
+        } else if (is_prefix(args[1], "write")) {
+            std::string val{args[3], 2}; //assume 0xVAL
+            set_register(get_register_from_name(args[2]), std::stol(val, 0, 16));
+        }
+    } else if (is_prefix(command, "memory")) {
+        std::string addr{args[2], 2}; //assume 0xADDRESS
+
+        if (is_prefix(args[1], "read")) {
+            uint64_t value = 0;
+            if (!m_target->read(std::stol(addr, 0, 16), &value, sizeof(value))) {
+                throw std::runtime_error{"Cannot access memory at " + args[2]};
+            }
+            *m_out << std::hex << value << std::endl;
+        }
+        if (is_prefix(args[1], "write")) {
+            std::string val{args[3], 2}; //assume 0xVAL
+            write_memory(std::stol(addr, 0, 16), std::stol(val, 0, 16));
+        }
+    } else if (is_prefix(command, "symbol")) {
+        auto syms = lookup_symbol(args[1]);
+        for (auto &&s: syms) {
+            *m_out << s.name << ' ' << to_string(s.type) << " 0x" << std::hex << s.addr << std::endl;
+        }
+    } else if (is_prefix(command, "backtrace") || command == "bt") {
+        backtrace();
+    } else if (is_prefix(command, "print")) {
+        //print <expression>, the expression may contain spaces
+        auto start = line.find_first_not_of(' ', line.find(' ', line.find_first_not_of(' ')));
+        if (start == std::string::npos) {
+            throw std::runtime_error{"Usage: print <expression>"};
+        }
+        print_expression(line.substr(start));
+    } else if (command == "info" && args.size() > 1 && is_prefix(args[1], "locals")) {
+        info_locals();
+    } else if (command == "info" && args.size() > 1 && is_prefix(args[1], "breakpoints")) {
+        print_breakpoints();
+    } else if (command == "set" && args.size() > 3 && args[1] == "print" && is_prefix(args[2], "elements")) {
+        //set print elements <n>, 0 for no limit
+        auto n = std::stoul(args[3]);
+        m_print_elements = n ? n : SIZE_MAX;
+    } else if (is_prefix(command, "profile")) {
+        //profile <seconds> [hz] [output]
+        profile(args.size() > 2 ? std::stoi(args[2]) : 99, args.size() > 1 ? std::stod(args[1]) : 1,
+                args.size() > 3 ? args[3] : "");
+    } else if (is_prefix(command, "coverage")) {
+        //coverage start | coverage report [file]
+        if (args.size() > 1 && is_prefix(args[1], "report")) {
+            write_coverage(args.size() > 2 ? args[2] : "");
+        } else {
+            start_coverage();
+        }
+    } else if (command == "find") {
+        //find [<start> <+len|end>] <pattern>, the pattern may contain spaces
+        auto is_number = [](const std::string &s) { return !s.empty() && (std::isdigit(s[0]) || s[0] == '+'); };
+        auto ranged = args.size() > 3 && is_number(args[1]) && is_number(args[2]);
+        if (args.size() < 2) {
+            throw std::runtime_error{"Usage: find [<start> <+len|end>] <pattern>"};
+        }
+        std::string pattern;
+        for (auto i = ranged ? 3u : 1u; i < args.size(); ++i) {
+            pattern += (pattern.empty() ? "" : " ") + args[i];
+        }
+        if (ranged) {
+            auto [start, end] = parse_range(args[1], args[2]);
+            find(start, end, pattern);
+        } else {
+            find(0, 0, pattern);
+        }
+    } else if (command == "snapshot") {
+        if (args.size() < 4) {
+            throw std::runtime_error{"Usage: snapshot <name> <start> <+len|end>"};
+        }
+        auto [start, end] = parse_range(args[2], args[3]);
+        take_snapshot(args[1], start, end);
+    } else if (command == "diff") {
+        diff_snapshot(args.at(1));
+    } else if (command == "gcore") {
+        gcore(args.size() > 1 ? args[1] : "core." + std::to_string(m_pid));
+    } else if (command == "checkpoints") {
+        print_checkpoints();
+    } else if (is_prefix(command, "checkpoint")) {
+        take_checkpoint();
+    } else if (is_prefix(command, "restart")) {
+        restart(std::stoi(args.at(1)));
+    } else if (is_prefix(command, "thread")) {
+        if (args.size() > 1) {
+            select_thread(std::stoi(args[1]));
+        } else {
+            print_threads();
+        }
+    } else if (is_prefix(command, "detach")) {
+        detach();
+    } else if (is_prefix(command, "interrupt")) {
+        //only reachable in non-stop mode, otherwise nothing runs while the prompt is shown
+        auto tid = interrupt();
+        if (tid) {
+            wait_for_signal("break", tid);
+        }
+    } else if (is_prefix(command, "nonstop")) {
+        set_non_stop(args.size() < 2 || args[1] == "on");
     } else if (is_prefix(command, "show")) {
         if (m_breakpoints.size() == 0) {
             set_breakpoint_at_function("main", "show");
@@ -392,31 +1927,63 @@ void debugger::handle_command(const std::string &line) {
         auto &bp = m_breakpoints[get_pc()];
         bp.disable();
     } else {
-        std::cerr << "Unknown command\n";
+        throw std::runtime_error{"Unknown command " + command};
     }
 }
 
 void debugger::set_breakpoint_at_function(const std::string &name, std::string call) {
+    check_live();
+    bool found = false;
     for (const auto &cu: m_dwarf.compilation_units()) {
         for (const auto &die: cu.root()) {
-            if (die.has(dwarf::DW_AT::name) && at_name(die) == name) {
+            //declarations of library functions have no code
+            if (die.has(dwarf::DW_AT::name) && die.has(dwarf::DW_AT::low_pc) && at_name(die) == name) {
                 auto low_pc = at_low_pc(die);
                 auto entry = get_line_entry_from_pc(low_pc);
                 ++entry; //skip prologue
                 set_breakpoint_at_address(offset_dwarf_address(entry->address), call);
+                found = true;
             }
         }
     }
+    if (found) {
+        return;
+    }
+
+    //the symbols of the libraries, which are only opened now
+    for (auto &m: m_modules.modules()) {
+        if (auto addr = m->breakpoint_address(name)) {
+            set_breakpoint_at_address(addr, call);
+            m_library_breakpoints.insert(addr);
+            return;
+        }
+    }
+    m_pending_breakpoints.push_back(name);
+    *m_out << "No function " << name << " yet, the breakpoint is set when a library defining it is loaded"
+           << std::endl;
+}
+
+void debugger::set_breakpoint_at_location(const std::string &location, std::string call) {
+    m_set_by_command.clear();
+    if (location[0] == '0' && location[1] == 'x') {
+        std::string addr{location, 2};
+        set_breakpoint_at_address(std::stol(addr, 0, 16), call);
+    } else if (location.find(':') != std::string::npos) {
+        auto file_and_line = split(location, ':');
+        set_breakpoint_at_source_line(file_and_line[0], std::stol(file_and_line[1]), call);
+    } else {
+        set_breakpoint_at_function(location, call);
+    }
 }
 
-void debugger::set_breakpoint_at_source_line(const std::string &file, unsigned line) {
+void debugger::set_breakpoint_at_source_line(const std::string &file, unsigned line, std::string call) {
     for (const auto &cu: m_dwarf.compilation_units()) {
         if (is_suffix(file, at_name(cu.root()))) {
             const auto &lt = cu.get_line_table();
 
             for (const auto &entry: lt) {
                 if (entry.is_stmt && entry.line == line) {
-                    set_breakpoint_at_address(offset_dwarf_address(entry.address));
+                    set_breakpoint_at_address(offset_dwarf_address(entry.address), call);
                     return;
                 }
             }
@@ -425,23 +1992,354 @@ void debugger::set_breakpoint_at_source_line(const std::string &file, unsigned l
 }
 
 void debugger::set_breakpoint_at_address(std::intptr_t addr, std::string call) {
-    if (call != "show"){
-        std::cout << "Set breakpoint at address 0x" << std::hex << addr << std::endl;
+    check_live();
+    if (call == "trace") {
+        m_set_by_command.push_back(addr);
+    } else if (call == "break") {
+        m_set_by_command.push_back(addr);
+        auto existing = m_stop_rules.find(addr);
+        if (existing != m_stop_rules.end()) {
+            *m_out << "Breakpoint " << std::dec << existing->second.number << " is already at address 0x"
+                   << std::hex << addr << std::endl;
+            return;
+        }
+        auto &rule = m_stop_rules[addr];
+        rule.number = m_next_breakpoint++;
+        *m_out << "Set breakpoint " << std::dec << rule.number << " at address 0x" << std::hex << addr << std::endl;
+    } else if (call != "show") {
+        *m_out << "Set breakpoint at address 0x" << std::hex << addr << std::endl;
+    }
+    if (m_breakpoints.count(addr) && m_breakpoints[addr].is_enabled()) {
+        return; //enabling it again would save the int3 as the original byte
     }
+    m_coverage.release(addr);
     breakpoint bp{m_pid, addr};
     bp.enable();
     m_breakpoints[addr] = bp;
 }
 
-void debugger::run() {
+std::pair<const std::intptr_t, stop_rule> &debugger::rule_of(unsigned number) {
+    for (auto &entry: m_stop_rules) {
+        if (entry.second.number == number) {
+            return entry;
+        }
+    }
+    throw std::out_of_range{"No breakpoint number " + std::to_string(number)};
+}
+
+void debugger::set_condition(unsigned number, const std::string &text) {
+    auto &[addr, rule] = rule_of(number);
+    if (text.empty()) {
+        rule.condition.reset();
+        *m_out << "Breakpoint " << std::dec << number << " now unconditional" << std::endl;
+        return;
+    }
+    auto pc = addr - m_load_address;
+    rule.condition = std::make_unique<expression>(
+            text, expression_scope{m_index.find_function(pc), pc, &globals()}, m_types, expression::mode::condition);
+
+    rule.cfa = cfa_rule_at(addr);
+}
+
+cfa_rule debugger::cfa_rule_at(std::intptr_t addr) {
+    cfa_rule rule;
+    m_modules.load_from_maps(m_target->memory_maps());
+    auto m = m_modules.find(addr);
+    cfi_table::frame_rules frame;
+    if (m && m->cfi() && m->cfi()->find_rules(addr - m->bias(), frame) && !frame.cfa_expr) {
+        auto r = std::find_if(g_register_descriptors.begin(), g_register_descriptors.end(),
+                              [&](auto &&rd) { return rd.dwarf_r == static_cast<int>(frame.cfa_reg); });
+        if (r != g_register_descriptors.end()) {
+            rule.fixed = true;
+            rule.r = r->r;
+            rule.offset = frame.cfa_offset;
+        }
+    }
+    return rule;
+}
+
+user_regs_struct debugger::regs_at_trap(thread_state &thread, std::intptr_t addr) {
+    auto regs = get_registers(thread);
+    set_register_value(regs, reg::rip, addr);
+    return regs;
+}
+
+eval_context debugger::trap_context(const user_regs_struct &regs, const cfa_rule &cfa) {
+    //the closures capture at most two pointers, std::function keeps them without allocating
+    auto read = [this](uint64_t address, void *buffer, std::size_t size) {
+        return m_target->read(address, buffer, size);
+    };
+    if (cfa.fixed) {
+        return eval_context{&regs, m_load_address, [value = get_register_value(regs, cfa.r) + cfa.offset] {
+            return value;
+        }, read};
+    }
+    return eval_context{&regs, m_load_address, [this, &regs]() -> uint64_t {
+        auto frames = unwind_stack(m_modules, regs, [this](uint64_t address, void *buffer, std::size_t size) {
+            return m_target->read(address, buffer, size);
+        }, 1);
+        return frames.empty() ? 0 : frames[0].cfa;
+    }, read};
+}
+
+void debugger::set_tracepoints(const std::string &collect) {
+    std::vector<std::string> texts;
+    for (auto &part: split(collect, ',')) {
+        auto start = part.find_first_not_of(' ');
+        auto end = part.find_last_not_of(' ');
+        if (start == std::string::npos) {
+            throw std::runtime_error{"Usage: trace <location> collect <expression>[, <expression>...]"};
+        }
+        auto text = part.substr(start, end - start + 1);
+        if (text == "$regs") {
+            for (auto name: {"rax", "rbx", "rcx", "rdx", "rsi", "rdi", "rbp", "rsp", "r8", "r9", "r10", "r11",
+                             "r12", "r13", "r14", "r15", "rip", "eflags"}) {
+                texts.push_back(std::string{"$"} + name);
+            }
+        } else {
+            texts.push_back(text);
+        }
+    }
+    if (texts.size() > max_trace_values) {
+        throw std::runtime_error{"A tracepoint collects at most " + std::to_string(max_trace_values) + " values"};
+    }
+
+    for (auto addr: m_set_by_command) {
+        auto pc = addr - m_load_address;
+        expression_scope scope{m_index.find_function(pc), pc, &globals()};
+        tracepoint tp;
+        std::vector<trace_value> described;
+        for (auto &text: texts) {
+            try {
+                tp.values.emplace_back(text, scope, m_types);
+            } catch (std::exception &) {
+                //the int3 planted for the command would otherwise stop like a breakpoint
+                for (auto planted: m_set_by_command) {
+                    if (m_breakpoints.count(planted) && !m_stop_rules.count(planted) && !m_tracepoints.count(planted)) {
+                        remove_breakpoint(planted);
+                    }
+                }
+                throw;
+            }
+            auto &value = tp.values.back();
+            auto &type = value.type();
+            auto format = trace_format::unsigned_integer;
+            if (value.in_memory() || type.type == type_desc::kind::pointer || text[0] == '$') {
+                format = trace_format::address;
+            } else if (type.encoding == dwarf::DW_ATE::float_) {
+                format = trace_format::floating;
+            } else if (type.encoding == dwarf::DW_ATE::signed_ || type.encoding == dwarf::DW_ATE::signed_char ||
+                       type.type == type_desc::kind::enumeration) {
+                format = trace_format::signed_integer;
+            }
+            described.push_back(trace_value{text, format});
+        }
+        tp.cfa = cfa_rule_at(addr);
+
+        auto existing = m_tracepoints.find(addr);
+        tp.number = existing != m_tracepoints.end() ? existing->second.number : m_next_breakpoint++;
+        if (!m_trace) {
+            m_trace = std::make_unique<trace_buffer>("trace." + std::to_string(m_pid));
+        }
+        m_trace->define(tp.number, addr, symbolize(addr, true), described);
+        *m_out << "Tracepoint " << std::dec << tp.number << " at address 0x" << std::hex << addr << " collects "
+               << std::dec << texts.size() << (texts.size() == 1 ? " value" : " values") << " into "
+               << m_trace->path() << std::endl;
+        m_tracepoints[addr] = std::move(tp);
+    }
+}
+
+void debugger::dump_trace_file(const std::string &path) {
+    if (m_trace) {
+        m_trace->flush();
+    }
+    if (path.empty() && !m_trace) {
+        throw std::runtime_error{"No tracepoints, give the trace file to decode"};
+    }
+    dump_trace(path.empty() ? m_trace->path() : path, *m_out);
+    if (m_trace && (path.empty() || path == m_trace->path())) {
+        *m_out << std::dec << m_trace->records() << " hits recorded, " << m_trace->dropped()
+               << " dropped for a full buffer" << std::endl;
+    }
+}
+
+void debugger::set_ignore_count(unsigned number, uint64_t count) {
+    rule_of(number).second.ignore = count;
+    *m_out << "Will ignore next " << std::dec << count << " crossings of breakpoint " << number << std::endl;
+}
+
+void debugger::print_breakpoints() {
+    //breakpoints and tracepoints share their numbers
+    struct listed {
+        unsigned number;
+        std::intptr_t addr;
+        const stop_rule *rule;
+        const tracepoint *trace;
+    };
+    std::vector<listed> entries;
+    for (auto &[addr, rule]: m_stop_rules) {
+        entries.push_back(listed{rule.number, addr, &rule, nullptr});
+    }
+    for (auto &[addr, tp]: m_tracepoints) {
+        entries.push_back(listed{tp.number, addr, nullptr, &tp});
+    }
+    if (entries.empty()) {
+        *m_out << "No breakpoints." << std::endl;
+        return;
+    }
+    std::sort(entries.begin(), entries.end(), [](auto &&a, auto &&b) { return a.number < b.number; });
+
+    *m_out << "Num  Type   Address             Hits        What" << std::endl;
+    for (auto &e: entries) {
+        *m_out << std::left << std::dec << std::setw(5) << e.number << std::setw(7) << (e.rule ? "break" : "trace")
+               << "0x" << std::setw(18) << std::hex << e.addr << std::setw(12) << std::dec
+               << (e.rule ? e.rule->hits : e.trace->hits) << std::right << symbolize(e.addr, true) << std::endl;
+        if (e.trace) {
+            *m_out << "        collect ";
+            for (std::size_t i = 0; i < e.trace->values.size(); ++i) {
+                *m_out << (i ? ", " : "") << e.trace->values[i].text();
+            }
+            *m_out << std::endl;
+            continue;
+        }
+        auto rule = e.rule;
+        if (rule->condition) {
+            *m_out << "        stop only if " << rule->condition->text() << std::endl;
+        }
+        if (rule->ignore) {
+            *m_out << "        ignore next " << rule->ignore << " hits" << std::endl;
+        }
+        if (rule->false_hits) {
+            *m_out << "        " << rule->false_hits << " hits did not stop (" << std::fixed << std::setprecision(2)
+                   << 100.0 * rule->false_hits / rule->hits << "%)" << std::endl;
+        }
+    }
+}
+
+void debugger::initialise() {
+    if (m_initialised || m_attached) {
+        return;
+    }
+    m_initialised = true;
+
     wait_for_signal();
+    m_ptrace_options = PTRACE_O_TRACECLONE;
+    counted_ptrace(PTRACE_SETOPTIONS, m_pid, nullptr, m_ptrace_options);
     initialise_load_address();
+    start_library_tracking();
+}
+
+void debugger::run() {
+    initialise();
+    m_interactive = true;
+    if (m_target->live()) {
+        m_events.watch_input();
+    }
+
+    while (session_active()) {
+        //the line editor blocks, it is only used while no thread can report anything
+        std::string running_line;
+        if (any_running(m_threads) && read_command_while_running(running_line)) {
+            try {
+                if (!running_line.empty()) {
+                    run_command(running_line);
+                }
+            } catch (std::exception &e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+            }
+            continue;
+        }
+        if (!session_active()) {
+            break;
+        }
+
+        //stdin has one reader at a time: the event loop keeps what was typed while the program ran,
+        //and reads pipes and files throughout, the line editor only takes over a terminal it left alone
+        std::string typed;
+        if (m_target->live() && (!isatty(STDIN_FILENO) || m_events.has_input())) {
+            if (isatty(STDIN_FILENO)) {
+                *m_out << "MEGAdbg> " << std::flush;
+            }
+            if (!m_events.read_line(typed)) {
+                break;
+            }
+        } else if (auto edited = linenoise("MEGAdbg> ")) {
+            typed = edited;
+            linenoiseFree(edited);
+        } else {
+            break;
+        }
+        try {
+            run_command(typed);
+        } catch (std::exception &e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+        }
+        linenoiseHistoryAdd(typed.c_str());
+    }
+
+    //leaving an attached process traced would kill it on the next breakpoint
+    if (m_attached && !end_of_program) {
+        detach();
+    }
+}
+
+int debugger::run_script(std::istream &script) {
+    auto start = std::chrono::steady_clock::now();
+    auto before = g_syscall_counters;
+    initialise();
+
+    int status = 0;
+    std::string line;
+    while (session_active() && std::getline(script, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        try {
+            run_command(line);
+        } catch (std::exception &e) {
+            std::cerr << "Error in '" << line << "': " << e.what() << std::endl;
+            status = 1;
+            break;
+        }
+    }
+
+    if (!end_of_program && m_target->live()) {
+        if (m_attached) {
+            detach();
+        } else {
+            kill_program();
+            end_of_program = true;
+            m_exit_signal = SIGKILL;
+            *m_out << "Killed process " << std::dec << m_pid << std::endl;
+        }
+    }
+
+    if (m_timed) {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        std::cerr << "[time] total: " << std::fixed << std::setprecision(3) << us.count() / 1000.0 << " ms, "
+                  << g_syscall_counters.ptrace - before.ptrace << " ptrace, "
+                  << g_syscall_counters.memory - before.memory << " memory syscalls" << std::endl;
+    }
 
-    char *line = nullptr;
+    if (status) {
+        return status;
+    }
+    return m_exit_signal ? 128 + m_exit_signal : m_exit_code;
+}
 
-    while (!end_of_program && (line = linenoise("MEGAdbg> ")) != nullptr) {
+//handle_command, with the wall time and the syscalls it cost when --time is given
+void debugger::run_command(const std::string &line) {
+    if (!m_timed) {
         handle_command(line);
-        linenoiseHistoryAdd(line);
-        linenoiseFree(line);
+        return;
     }
+
+    auto before = g_syscall_counters;
+    auto start = std::chrono::steady_clock::now();
+    handle_command(line);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    std::cerr << "[time] " << line << ": " << std::fixed << std::setprecision(3) << us.count() / 1000.0 << " ms, "
+              << g_syscall_counters.ptrace - before.ptrace << " ptrace, "
+              << g_syscall_counters.memory - before.memory << " memory syscalls" << std::endl;
 }
@@ -4,32 +4,128 @@
 #include <string>
 #include <linux/types.h>
 #include <unordered_map>
-
-#include <fcntl.h>
+#include <unordered_set>
+#include <map>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <sstream>
 
 #include "breakpoint.h"
+#include "thread_state.h"
+#include "symbol_index.h"
+#include "program_image.h"
+#include "module.h"
+#include "coverage.h"
+#include "syscall_tracer.h"
+#include "event_loop.h"
+#include "target.h"
+#include "checkpoint.h"
+#include "library_tracker.h"
+#include "memory_snapshot.h"
+#include "variables.h"
+#include "expression.h"
+#include "trace_buffer.h"
 #include "utility.h"
 #include "libelfin/dwarf/dwarf++.hh"
 #include "libelfin/elf/elf++.hh"
 
+//the CFA at a code address as a register plus offset, so the expressions evaluated at a breakpoint
+//find the locals without unwinding
+struct cfa_rule {
+    bool fixed = false; //else the frame is unwound
+    reg r = reg::rsp;
+    int64_t offset = 0;
+};
+
+//what a user breakpoint checks on each hit before it stops the program, and how often it let it run on
+struct stop_rule {
+    unsigned number = 0;
+    std::unique_ptr<expression> condition; //compiled for the scope of the breakpoint, nullptr if none
+    cfa_rule cfa;
+    uint64_t ignore = 0;                   //hits with a true condition still to pass
+    uint64_t hits = 0;
+    uint64_t false_hits = 0;               //hits the program was resumed at without stopping
+};
+
+//a breakpoint that records values into the trace buffer on each hit and lets the program run on
+struct tracepoint {
+    unsigned number = 0;
+    std::vector<expression> values;
+    cfa_rule cfa;
+    uint64_t hits = 0;
+};
 
 class debugger {
+    friend class gdb_server;
+
 public:
     debugger(std::string prog_name, pid_t pid)
-            : m_prog_name{std::move(prog_name)}, m_pid{pid} {
-        auto fd = open(m_prog_name.c_str(), O_RDONLY);
-
-        m_elf = elf::elf{elf::create_mmap_loader(fd)};
-        m_dwarf = dwarf::dwarf{dwarf::elf::create_loader(m_elf)};
+            : debugger{prog_name, std::make_shared<const program_image>(prog_name), pid, false} {}
+
+    //worker inferiors are driven from their own thread, they take commands and tracee
+    //notifications through events() instead of stdin and SIGCHLD, and print into serve()'s report
+    debugger(std::string prog_name, std::shared_ptr<const program_image> image, pid_t pid, bool worker)
+            : m_prog_name{std::move(prog_name)}, m_pid{pid}, m_tid{pid}, m_worker{worker},
+              m_image{std::move(image)}, m_dwarf{m_image->dwarf}, m_elf{m_image->elf}, m_index{m_image->index} {
+        m_threads[pid].tid = pid;
+
+        if (worker) {
+            m_out = &m_capture;
+            m_events.open_worker();
+        } else {
+            m_events.open(pid);
+        }
+        m_target = make_live_target(pid);
     }
 
+    //inspects the threads and memory of a core file of prog_name, the commands that would run
+    //or modify the program fail
+    debugger(std::string prog_name, std::unique_ptr<core_target> core);
+
+    //kills the checkpoints, which would otherwise run on once the debugger is gone
+    ~debugger();
+
     void run();
 
+    //runs the commands of script without prompt or line editing, then kills a launched program or
+    //detaches from an attached one. Returns the exit status of the program, 128 + signal if it was
+    //killed, or 1 if a command failed.
+    int run_script(std::istream &script);
+
+    //report the wall time and syscalls of each command on stderr
+    void set_timing(bool timed) { m_timed = timed; }
+
+    //waits for the launched program to reach its first instruction, no-op once done or when attached
+    void initialise();
+
+    void attach();
+
+    void detach();
+
     void set_breakpoint_at_address(std::intptr_t addr, std::string call = "break");
 
     void set_breakpoint_at_function(const std::string &name, std::string call = "break");
 
-    void set_breakpoint_at_source_line(const std::string &file, unsigned line);
+    void set_breakpoint_at_source_line(const std::string &file, unsigned line, std::string call = "break");
+
+    //0xADDRESS, file:line or a function name
+    void set_breakpoint_at_location(const std::string &location, std::string call = "break");
+
+    //the breakpoint stops only when the C expression is true in its frame, an empty text removes it
+    void set_condition(unsigned number, const std::string &text);
+
+    //the next count hits of the breakpoint with a true condition do not stop
+    void set_ignore_count(unsigned number, uint64_t count);
+
+    void print_breakpoints();
+
+    //trace <location> collect <expressions>: the tracepoints the last break or trace command set
+    //collect the values of the comma separated expressions on each hit, $regs for all registers
+    void set_tracepoints(const std::string &collect);
+
+    //decodes a trace file, by default the one the tracepoints write to
+    void dump_trace_file(const std::string &path);
 
     void dump_registers();
 
@@ -51,13 +147,139 @@ public:
 
     void remove_breakpoint(std::intptr_t addr);
 
+    void backtrace();
+
+    //prints a local variable, parameter or global of the current frame
+    void print_variable(const std::string &name);
+
+    //evaluates a C expression in the current frame, names of variables are printed as by print_variable
+    void print_expression(const std::string &text);
+
+    //prints the local variables of the current frame, innermost scope first
+    void info_locals();
+
+    //samples the stacks of all threads hz times per second and writes them as folded stacks, for
+    //seconds or, if seconds is 0, until the program exits
+    void profile(int hz, double seconds, const std::string &output);
+
+    //plants one-shot breakpoints on every line, runs the program to its end and writes an lcov report
+    void coverage(const std::string &output);
+
+    //runs the program to its end reporting the syscalls its seccomp filter sends to the tracer
+    void trace_syscalls(const std::string &output);
+
+    //writes an ELF core of the process, the threads running in non-stop mode are stopped meanwhile
+    void gcore(const std::string &path);
+
+    //searches the readable memory in [start, end), or all of it when end is 0, for a pattern of
+    //parse_search_pattern and prints where it was found
+    void find(uint64_t start, uint64_t end, const std::string &pattern);
+
+    //copies [start, end) under name, replacing an earlier snapshot of that name
+    void take_snapshot(const std::string &name, uint64_t start, uint64_t end);
+
+    //prints the ranges of snapshot name that changed since it was taken, with the variable or mapping
+    //they belong to
+    void diff_snapshot(const std::string &name);
+
+    //forks the stopped program into a checkpoint that restart can return to
+    void take_checkpoint();
+
+    //replaces the program with a fresh copy of checkpoint id, which stays available
+    void restart(unsigned id);
+
+    void print_checkpoints();
+
+    void print_threads();
+
+    void select_thread(pid_t tid);
+
+    void set_non_stop(bool non_stop);
+
+    //stops the current thread, or the first running one, while the others keep running until it
+    //reports; returns the thread that was asked to stop or 0 if none runs
+    pid_t interrupt();
+
+    //the loop of a worker inferior: runs posted commands and reports asynchronous stops until the
+    //process is gone, report gets the output of each command and is told when it completed
+    void serve(const std::function<void(const std::string &output, bool command_done)> &report);
+
+    event_loop &events() { return m_events; }
+
+    pid_t pid() const { return m_pid; }
+
+    bool finished() const { return end_of_program; }
+
 private:
     bool end_of_program = false;
 
     void handle_command(const std::string &line);
 
+    //there is a process to debug, or a checkpoint to restart once it has exited
+    bool session_active() const { return !end_of_program || !m_checkpoints.empty(); }
+
+    void run_command(const std::string &line);
+
     void continue_execution(std::string call = "break");
 
+    thread_state &current_thread();
+
+    user_regs_struct &get_registers(thread_state &thread);
+
+    uint64_t get_register(reg r);
+
+    void set_register(reg r, uint64_t value);
+
+    void resume_thread(thread_state &thread, __ptrace_request request, bool deliver_signal = true);
+
+    void stop_all_threads();
+
+    void add_thread(pid_t tid);
+
+    bool handle_wait_status(pid_t tid, int wait_status, std::string call);
+
+    bool handle_fast_trap(thread_state &thread);
+
+    //counts a hit of a user breakpoint and decides whether it stops, the program runs on if not
+    bool passes_breakpoint(thread_state &thread, std::intptr_t addr, stop_rule &rule);
+
+    //single steps a thread off a lifted int3, false if it did not stop after the step
+    bool step_thread(thread_state &thread);
+
+    //steps the thread off the breakpoint at addr it trapped on and lets it run on
+    void resume_past_breakpoint(thread_state &thread, std::intptr_t addr);
+
+    //records a hit of the tracepoint at addr, without output or allocation
+    void collect(thread_state &thread, std::intptr_t addr, tracepoint &tp);
+
+    cfa_rule cfa_rule_at(std::intptr_t addr);
+
+    //a copy of the registers of a thread that trapped on the int3 at addr, with rip back at addr as
+    //the program sees it there; the cached registers keep the pc past the int3 for the stop report
+    user_regs_struct regs_at_trap(thread_state &thread, std::intptr_t addr);
+
+    //the context to evaluate expressions at a breakpoint in, regs must outlive it
+    eval_context trap_context(const user_regs_struct &regs, const cfa_rule &cfa);
+
+    //the hits resumed by conditions and ignore counts since the program was last continued, stopped
+    //if a hit stopped it
+    void report_false_hits(bool stopped);
+
+    //the address and rule of the user breakpoint number
+    std::pair<const std::intptr_t, stop_rule> &rule_of(unsigned number);
+
+    void start_library_tracking();
+
+    void handle_library_event(thread_state &thread);
+
+    void resolve_pending_breakpoints(const std::vector<std::string> &libraries);
+
+    void handle_syscall_stop(thread_state &thread, bool entry);
+
+    void start_coverage();
+
+    void write_coverage(const std::string &output);
+
     uint64_t get_pc();
 
     uint64_t get_offset_pc();
@@ -66,7 +288,16 @@ private:
 
     void step_over_breakpoint();
 
-    void wait_for_signal(std::string call = "break");
+    void wait_for_signal(std::string call = "break", pid_t tid = -1);
+
+    bool wait_for_event(const std::string &call);
+
+    bool drain_events(const std::string &call);
+
+    bool read_command_while_running(std::string &line);
+
+    //interrupt and thread, false for the other commands, which wait for the stop
+    bool handle_running_command(const std::string &line);
 
     siginfo_t get_signal_info();
 
@@ -80,17 +311,86 @@ private:
 
     dwarf::die get_function_from_pc(uint64_t pc);
 
+    std::string symbolize(uint64_t pc, bool with_line);
+
     dwarf::line_table::iterator get_line_entry_from_pc(uint64_t pc);
 
     uint64_t read_memory(uint64_t address);
 
     void write_memory(uint64_t address, uint64_t value);
 
+    //the registers, CFA and function of the current frame, function is nullptr outside of the DWARF
+    frame_info current_frame(const dwarf::die *&function);
+
+    //reads the variable in one piece and prints name = value
+    void print_value(const dwarf::die &var, const dwarf::die &function, const frame_info &frame);
+
+    //reads size bytes at address, capped at max_value_read, and prints them as the layout
+    void print_memory_value(value_printer &printer, uint32_t layout, uint64_t address, uint64_t size);
+
+    value_printer make_printer();
+
+    const std::unordered_map<std::string, dwarf::die> &globals();
+
+    //the global variable or, failing that, the mapping an address of data belongs to. m_modules must
+    //hold the mappings maps.
+    std::string owner_of(uint64_t addr, const std::vector<mapping> &maps);
+
+    //throws unless there is a process to run or modify
+    void check_live();
+
+    //SIGKILLs the program and reaps its threads, the leader last. The stopped checkpoints, children
+    //of the debugger too, are left alone.
+    void kill_program();
+
+    //a target whose reads of code show the int3 of the breakpoints, like the process memory
+    std::unique_ptr<live_target> make_live_target(pid_t pid);
+
     std::string m_prog_name;
     pid_t m_pid;
+    pid_t m_tid; //thread the commands operate on
+    bool m_non_stop = false;
+    bool m_attached = false;
+    bool m_initialised = false;
+    bool m_interactive = false;
+    bool m_worker = false;
+    bool m_timed = false;
+    long m_ptrace_options = 0;
+    int m_stop_signal = 0; //signal of the last reported stop
+    int m_stop_code = 0;   //its si_code, SI_KERNEL or TRAP_BRKPT for an int3
+    int m_exit_code = 0;
+    int m_exit_signal = 0; //set when the program was killed by a signal
+    std::ostream *m_out = &std::cout;
+    std::ostringstream m_capture; //output of a worker, handed to serve()'s report
+    std::chrono::steady_clock::time_point m_stopped_since;
+    std::map<pid_t, thread_state> m_threads;
     uint64_t m_load_address = 0;
     std::unordered_map<std::intptr_t, breakpoint> m_breakpoints;
+    std::unordered_map<std::intptr_t, stop_rule> m_stop_rules; //of the user breakpoints
+    unsigned m_next_breakpoint = 1;
+    std::vector<std::intptr_t> m_set_by_command; //the user breakpoints of the last break or trace command
+    std::unordered_map<std::intptr_t, tracepoint> m_tracepoints;
+    std::unique_ptr<trace_buffer> m_trace; //created with the first tracepoint
+    uint64_t m_false_hits = 0;                   //since the program was last continued
+    std::chrono::steady_clock::duration m_false_hit_time{};
+    std::unordered_set<std::intptr_t> m_library_breakpoints; //set on functions outside the program's DWARF
+    std::vector<std::string> m_pending_breakpoints; //functions of libraries that are not loaded yet
+    std::shared_ptr<const program_image> m_image;
     dwarf::dwarf m_dwarf;
     elf::elf m_elf;
+    const symbol_index &m_index;
+    module_table m_modules;
+    library_tracker m_libraries;
+    line_coverage m_coverage;
+    syscall_tracer m_syscalls;
+    event_loop m_events;
+    std::unique_ptr<target> m_target;
+    std::vector<checkpoint> m_checkpoints;
+    unsigned m_next_checkpoint = 1;
+    std::map<std::string, memory_snapshot> m_snapshots;
+    type_cache m_types;
+    std::unordered_map<std::string, dwarf::die> m_globals; //built on the first lookup of a global
+    bool m_globals_indexed = false;
+    std::size_t m_print_elements = 200; //of each array and container, set print elements
 };
 
@@ -0,0 +1,237 @@
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "event_loop.h"
+
+event_loop::~event_loop() {
+    for (auto fd: {m_pidfd, m_signal, m_wake, m_epoll}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void event_loop::open(pid_t pid) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_signal = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+    m_pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0)); //readable once the process is gone
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    for (auto fd: {m_signal, m_pidfd}) {
+        if (fd >= 0) {
+            ev.data.fd = fd;
+            epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+}
+
+void event_loop::watch_process(pid_t pid) {
+    if (m_pidfd >= 0) {
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, m_pidfd, nullptr);
+        close(m_pidfd);
+    }
+    m_pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    if (m_pidfd >= 0) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = m_pidfd;
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_pidfd, &ev);
+    }
+}
+
+void event_loop::open_worker() {
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_wake = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = m_wake;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wake, &ev);
+}
+
+void event_loop::watch_input(int fd, bool take_sigint) {
+    if (m_input >= 0) {
+        return;
+    }
+    m_input = fd;
+
+    if (take_sigint) {
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGCHLD);
+        sigaddset(&mask, SIGINT);
+        sigprocmask(SIG_BLOCK, &mask, nullptr);
+        signalfd(m_signal, &mask, 0);
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev);
+}
+
+event_loop::event event_loop::wait() {
+    while (true) {
+        {
+            //a Ctrl-C or a line that came together with a tracee event is reported on the next call
+            std::lock_guard<std::mutex> lock{m_mutex};
+            if (m_tracee) {
+                m_tracee = false;
+                return event::tracee;
+            }
+            if (m_interrupted) {
+                m_interrupted = false;
+                return event::interrupt;
+            }
+            if (m_buffer.find('\n') != std::string::npos || (m_input_ended && !m_buffer.empty())) {
+                return event::input;
+            }
+        }
+
+        epoll_event events[3];
+        auto n = epoll_wait(m_epoll, events, 3, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return event::tracee; //let the caller poll waitpid
+        }
+
+        std::lock_guard<std::mutex> lock{m_mutex};
+        for (int i = 0; i < n; ++i) {
+            auto fd = events[i].data.fd;
+            if (fd == m_signal) {
+                signalfd_siginfo info;
+                while (read(m_signal, &info, sizeof(info)) == sizeof(info)) {
+                    if (info.ssi_signo == SIGINT) {
+                        m_interrupted = true;
+                    } else {
+                        m_tracee = true;
+                    }
+                }
+            } else if (fd == m_pidfd) {
+                m_tracee = true;
+            } else if (fd == m_wake) {
+                uint64_t count;
+                read(m_wake, &count, sizeof(count)); //the state was set by the waking thread
+            } else if (fd == m_input) {
+                char buffer[256];
+                auto got = read(m_input, buffer, sizeof(buffer));
+                if (got <= 0) {
+                    //end of input, keep waiting for the tracee only
+                    epoll_ctl(m_epoll, EPOLL_CTL_DEL, m_input, nullptr);
+                    m_input_ended = true;
+                    return event::input;
+                }
+                for (ssize_t j = 0; j < got; ++j) {
+                    if (buffer[j] == '\x03') {
+                        m_interrupted = true;
+                    } else {
+                        m_buffer += buffer[j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+void event_loop::discard_interrupt() {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_interrupted = false;
+}
+
+bool event_loop::next_line(std::string &line) {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    auto end = m_buffer.find('\n');
+    if (end == std::string::npos) {
+        return false;
+    }
+    line = m_buffer.substr(0, end);
+    m_buffer.erase(0, end + 1);
+    return true;
+}
+
+void event_loop::unread(const std::vector<std::string> &lines) {
+    std::string front;
+    for (auto &line: lines) {
+        front += line;
+        front += '\n';
+    }
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_buffer.insert(0, front);
+}
+
+bool event_loop::has_input() {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return !m_buffer.empty();
+}
+
+bool event_loop::read_line(std::string &line) {
+    bool tracee = false;
+    while (!next_line(line)) {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            if (m_input_ended || m_input < 0) {
+                line = std::move(m_buffer);
+                m_buffer.clear();
+                m_tracee = m_tracee || tracee;
+                return !line.empty();
+            }
+        }
+        switch (wait()) {
+            case event::tracee:
+                tracee = true;
+                break;
+            case event::interrupt:
+            case event::input:
+                break;
+        }
+    }
+    if (tracee) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_tracee = true;
+    }
+    return true;
+}
+
+void event_loop::wake() {
+    uint64_t one = 1;
+    write(m_wake, &one, sizeof(one));
+}
+
+void event_loop::notify() {
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_tracee = true;
+    }
+    wake();
+}
+
+void event_loop::post(const std::string &line) {
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_buffer += line;
+        m_buffer += '\n';
+    }
+    wake();
+}
+
+void event_loop::request_interrupt() {
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_interrupted = true;
+    }
+    wake();
+}
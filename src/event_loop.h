@@ -0,0 +1,77 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+//waits for tracee events and user input at the same time: SIGCHLD and SIGINT arrive through a
+//signalfd, the exit of the whole process through a pidfd and commands through stdin, all in one epoll set.
+//The loop of a worker inferior has no signals or stdin of its own, other threads wake it through an eventfd.
+class event_loop {
+public:
+    enum class event { tracee, input, interrupt };
+
+    event_loop() = default;
+
+    event_loop(const event_loop &) = delete;
+
+    event_loop &operator=(const event_loop &) = delete;
+
+    ~event_loop();
+
+    //blocks SIGCHLD in the debugger, so it must be called after the tracee is forked
+    void open(pid_t pid);
+
+    //follows the exit of another process, after the debugger switched to a checkpoint
+    void watch_process(pid_t pid);
+
+    //SIGCHLD is blocked by the owner of the worker threads, which calls notify() for it
+    void open_worker();
+
+    //also wake up for lines on fd, used by the interactive prompt on stdin (which also takes over
+    //Ctrl-C) and by the gdb remote connection. A raw ^C byte on fd is an interrupt as well.
+    void watch_input(int fd = 0, bool take_sigint = true);
+
+    //blocks until something happens
+    event wait();
+
+    //the next complete line typed while the tracee was running, false if there is none
+    bool next_line(std::string &line);
+
+    //puts lines back in front of the input, for the next next_line() calls
+    void unread(const std::vector<std::string> &lines);
+
+    //whether input was read that no next_line() took yet, a part of a line included
+    bool has_input();
+
+    //the next line, waiting for it, so the prompt takes its input from the same reader as
+    //the commands typed while the tracee runs. The rest of the input without a newline at its
+    //end, false once there is nothing left. A Ctrl-C meanwhile is dropped, tracee events are kept.
+    bool read_line(std::string &line);
+
+    //forgets a Ctrl-C that arrived after the tracee had stopped anyway
+    void discard_interrupt();
+
+    //called from other threads: a tracee may have changed state, a command, a Ctrl-C
+    void notify();
+
+    void post(const std::string &line);
+
+    void request_interrupt();
+
+private:
+    void wake();
+
+    int m_epoll = -1;
+    int m_signal = -1;
+    int m_pidfd = -1;
+    int m_wake = -1;
+    int m_input = -1;
+
+    std::mutex m_mutex; //guards the state below, which other threads set
+    bool m_interrupted = false;
+    bool m_tracee = false;
+    bool m_input_ended = false;
+    std::string m_buffer;
+};
@@ -0,0 +1,1101 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#include "expression.h"
+
+using namespace dwarf;
+
+namespace {
+    using opcode = expression::opcode;
+    using domain = expression::domain;
+    using instruction = expression::instruction;
+
+    //bounds the recursion of the parser and the stack of the machine
+    constexpr unsigned max_nesting = 32;
+    constexpr std::size_t max_stack = 64;
+
+    std::runtime_error error_at(std::size_t pos, const std::string &message) {
+        return std::runtime_error{message + " at column " + std::to_string(pos + 1)};
+    }
+
+    struct token {
+        enum class kind { end, integer, floating, identifier, reg, punctuation };
+        kind type;
+        std::string text;
+        uint64_t value = 0;
+        double number = 0;
+        std::size_t pos = 0;
+    };
+
+    char unescape(const std::string &text, std::size_t &i) {
+        if (text[i] != '\\' || i + 1 >= text.size()) {
+            return text[i++];
+        }
+        i += 2;
+        switch (text[i - 1]) {
+            case 'n': return '\n';
+            case 't': return '\t';
+            case 'r': return '\r';
+            case '0': return '\0';
+            default: return text[i - 1];
+        }
+    }
+
+    std::vector<token> tokenize(const std::string &text) {
+        //the longer operators first
+        static const char *const punctuation[] = {"->", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+                                                  "+", "-", "*", "/", "%", "<", ">", "&", "|", "^", "!",
+                                                  "~", ".", "[", "]", "(", ")"};
+        auto is_identifier = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+
+        std::vector<token> tokens;
+        for (std::size_t i = 0; i < text.size();) {
+            auto c = text[i];
+            if (std::isspace(static_cast<unsigned char>(c))) {
+                ++i;
+                continue;
+            }
+            token t{token::kind::punctuation, "", 0, 0, i};
+            if (std::isdigit(static_cast<unsigned char>(c))) {
+                auto start = text.c_str() + i;
+                char *end;
+                errno = 0;
+                t.type = token::kind::integer;
+                t.value = std::strtoull(start, &end, 0);
+                if (*end == '.' || *end == 'e' || *end == 'E') {
+                    t.type = token::kind::floating;
+                    t.number = std::strtod(start, &end);
+                } else if (errno == ERANGE) {
+                    throw error_at(i, "Integer too large");
+                }
+                while (*end && std::strchr("uUlL", *end)) {
+                    ++end;
+                }
+                if (is_identifier(*end)) {
+                    throw error_at(i, "Invalid number");
+                }
+                i = end - text.c_str();
+            } else if (c == '\'') {
+                ++i;
+                t.type = token::kind::integer;
+                t.value = i < text.size() ? static_cast<unsigned char>(unescape(text, i)) : 0;
+                if (i >= text.size() || text[i] != '\'') {
+                    throw error_at(t.pos, "Unterminated character constant");
+                }
+                ++i;
+            } else if (is_identifier(c) || c == '$') {
+                t.type = c == '$' ? token::kind::reg : token::kind::identifier;
+                auto start = c == '$' ? ++i : i;
+                //qualified names like ns::value are one token
+                while (i < text.size()) {
+                    if (is_identifier(text[i])) {
+                        ++i;
+                    } else if (text.compare(i, 2, "::") == 0) {
+                        i += 2;
+                    } else {
+                        break;
+                    }
+                }
+                t.text = text.substr(start, i - start);
+                if (t.text.empty()) {
+                    throw error_at(t.pos, "Expected a register name");
+                }
+            } else {
+                for (auto p: punctuation) {
+                    if (text.compare(i, std::strlen(p), p) == 0) {
+                        t.text = p;
+                        break;
+                    }
+                }
+                if (t.text.empty()) {
+                    throw error_at(i, std::string{"Invalid character '"} + c + "'");
+                }
+                i += t.text.size();
+            }
+            tokens.push_back(std::move(t));
+        }
+        tokens.push_back(token{token::kind::end, "", 0, 0, text.size()});
+        return tokens;
+    }
+
+    //a node of the syntax tree, typed by the checker
+    struct node {
+        enum class kind { constant, variable, reg, unary, binary, logical, member, index };
+        kind type;
+        std::string op; //the operator, or the name of a member
+        std::size_t pos;
+        uint64_t value = 0; //of constants
+        reg r = reg::rax;
+        die var;
+        std::unique_ptr<node> left, right;
+
+        const type_desc *desc = nullptr;
+        const type_desc *operands = nullptr; //the type the operands of binary operators are converted to
+        bool in_memory = false;              //code can compute its address
+        bool reference = false;              //its storage holds the address of the value
+        unsigned bit_size = 0;
+        unsigned bit_offset = 0;
+        uint64_t offset = 0;                 //of members
+        fixed_location location;             //of variables
+        std::size_t variable = 0;            //index for the locate instruction
+    };
+
+    bool is_floating(const type_desc &t) {
+        return t.type == type_desc::kind::base && t.encoding == DW_ATE::float_;
+    }
+
+    bool is_integer(const type_desc &t) {
+        return t.type == type_desc::kind::enumeration || (t.type == type_desc::kind::base && !is_floating(t));
+    }
+
+    bool is_arithmetic(const type_desc &t) {
+        return is_integer(t) || is_floating(t);
+    }
+
+    bool is_pointer(const type_desc &t) {
+        return t.type == type_desc::kind::pointer;
+    }
+
+    bool is_scalar(const type_desc &t) {
+        return is_arithmetic(t) || is_pointer(t);
+    }
+
+    domain domain_of(const type_desc &t) {
+        if (is_floating(t)) {
+            return domain::floating;
+        }
+        if (t.type == type_desc::kind::enumeration || t.encoding == DW_ATE::signed_ ||
+            t.encoding == DW_ATE::signed_char) {
+            return domain::signed_integer;
+        }
+        return domain::unsigned_integer;
+    }
+
+    class parser {
+    public:
+        parser(std::vector<token> tokens, const expression_scope &scope, type_cache &types)
+                : m_tokens{std::move(tokens)}, m_scope{scope}, m_types{types} {}
+
+        std::unique_ptr<node> parse() {
+            auto root = binary(1, 0);
+            if (peek().type != token::kind::end) {
+                throw error_at(peek().pos, "Unexpected '" + peek().text + "'");
+            }
+            return root;
+        }
+
+    private:
+        const token &peek() const { return m_tokens[m_next]; }
+
+        bool accept(const char *punctuation) {
+            if (peek().type == token::kind::punctuation && peek().text == punctuation) {
+                ++m_next;
+                return true;
+            }
+            return false;
+        }
+
+        void expect(const char *punctuation) {
+            if (!accept(punctuation)) {
+                throw error_at(peek().pos, std::string{"Expected '"} + punctuation + "'");
+            }
+        }
+
+        static int precedence(const token &t) {
+            static const std::pair<const char *, int> operators[] = {
+                    {"||", 1}, {"&&", 2}, {"|", 3}, {"^", 4}, {"&", 5}, {"==", 6}, {"!=", 6},
+                    {"<", 7}, {"<=", 7}, {">", 7}, {">=", 7}, {"<<", 8}, {">>", 8},
+                    {"+", 9}, {"-", 9}, {"*", 10}, {"/", 10}, {"%", 10}};
+            if (t.type == token::kind::punctuation) {
+                for (auto &[op, prec]: operators) {
+                    if (t.text == op) {
+                        return prec;
+                    }
+                }
+            }
+            return 0;
+        }
+
+        std::unique_ptr<node> make(node::kind kind, const std::string &op, std::size_t pos) {
+            auto n = std::make_unique<node>();
+            n->type = kind;
+            n->op = op;
+            n->pos = pos;
+            return n;
+        }
+
+        std::unique_ptr<node> binary(int min_precedence, unsigned depth) {
+            auto left = unary(depth);
+            for (auto prec = precedence(peek()); prec >= min_precedence; prec = precedence(peek())) {
+                auto &op = m_tokens[m_next++];
+                auto kind = op.text == "&&" || op.text == "||" ? node::kind::logical : node::kind::binary;
+                auto n = make(kind, op.text, op.pos);
+                n->left = std::move(left);
+                n->right = binary(prec + 1, depth + 1);
+                left = std::move(n);
+            }
+            return left;
+        }
+
+        std::unique_ptr<node> unary(unsigned depth) {
+            if (depth > max_nesting) {
+                throw error_at(peek().pos, "Expression nested too deeply");
+            }
+            for (auto op: {"-", "+", "!", "~", "*", "&"}) {
+                auto pos = peek().pos;
+                if (accept(op)) {
+                    auto n = make(node::kind::unary, op, pos);
+                    n->left = unary(depth + 1);
+                    return n;
+                }
+            }
+            return postfix(primary(depth), depth);
+        }
+
+        std::unique_ptr<node> postfix(std::unique_ptr<node> left, unsigned depth) {
+            while (true) {
+                auto pos = peek().pos;
+                if (accept("[")) {
+                    auto n = make(node::kind::index, "[]", pos);
+                    n->left = std::move(left);
+                    n->right = binary(1, depth + 1);
+                    expect("]");
+                    left = std::move(n);
+                } else if (accept(".") || accept("->")) {
+                    auto arrow = m_tokens[m_next - 1].text == "->";
+                    if (peek().type != token::kind::identifier) {
+                        throw error_at(peek().pos, "Expected a member name");
+                    }
+                    auto n = make(node::kind::member, m_tokens[m_next++].text, pos);
+                    n->value = arrow;
+                    n->left = std::move(left);
+                    left = std::move(n);
+                } else {
+                    return left;
+                }
+            }
+        }
+
+        std::unique_ptr<node> constant(uint64_t value, const type_desc &type, std::size_t pos) {
+            auto n = make(node::kind::constant, "", pos);
+            n->value = value;
+            n->desc = &type;
+            return n;
+        }
+
+        std::unique_ptr<node> primary(unsigned depth) {
+            auto &t = m_tokens[m_next];
+            switch (t.type) {
+                case token::kind::integer: {
+                    ++m_next;
+                    if (t.value <= INT_MAX) {
+                        return constant(t.value, m_types.builtin("int", 4, DW_ATE::signed_), t.pos);
+                    }
+                    if (t.value <= LONG_MAX) {
+                        return constant(t.value, m_types.builtin("long", 8, DW_ATE::signed_), t.pos);
+                    }
+                    return constant(t.value, m_types.builtin("unsigned long", 8, DW_ATE::unsigned_), t.pos);
+                }
+                case token::kind::floating: {
+                    ++m_next;
+                    uint64_t bits;
+                    std::memcpy(&bits, &t.number, sizeof(bits));
+                    return constant(bits, m_types.builtin("double", 8, DW_ATE::float_), t.pos);
+                }
+                case token::kind::reg: {
+                    ++m_next;
+                    static const std::pair<const char *, const char *> aliases[] = {
+                            {"pc", "rip"}, {"sp", "rsp"}, {"fp", "rbp"}};
+                    auto name = t.text;
+                    for (auto &[alias, actual]: aliases) {
+                        name = name == alias ? actual : name;
+                    }
+                    auto rd = std::find_if(g_register_descriptors.begin(), g_register_descriptors.end(),
+                                           [&](auto &&rd) { return rd.name == name; });
+                    if (rd == g_register_descriptors.end()) {
+                        throw error_at(t.pos, "Invalid register $" + t.text);
+                    }
+                    auto n = make(node::kind::reg, "", t.pos);
+                    n->r = rd->r;
+                    return n;
+                }
+                case token::kind::identifier: {
+                    ++m_next;
+                    if (t.text == "true" || t.text == "false") {
+                        return constant(t.text == "true", m_types.builtin("bool", 1, DW_ATE::boolean), t.pos);
+                    }
+                    if (t.text == "nullptr" || t.text == "NULL") {
+                        return constant(0, m_types.pointer_to(m_types.get(die{})), t.pos);
+                    }
+                    auto n = make(node::kind::variable, t.text, t.pos);
+                    n->var = bind(t.text);
+                    return n;
+                }
+                case token::kind::punctuation:
+                    if (accept("(")) {
+                        auto n = binary(1, depth + 1);
+                        expect(")");
+                        return n;
+                    }
+                    [[fallthrough]];
+                default:
+                    throw error_at(t.pos, t.type == token::kind::end ? "Incomplete expression"
+                                                                       : "Unexpected '" + t.text + "'");
+            }
+        }
+
+        //the innermost variable of the name visible at the pc of the scope, else a global
+        die bind(const std::string &name) {
+            if (m_scope.function) {
+                for (auto &v: variables_in_scope(*m_scope.function, m_scope.pc)) {
+                    if (variable_name(v.die) == name) {
+                        return v.die;
+                    }
+                }
+            }
+            if (m_scope.globals) {
+                auto global = m_scope.globals->find(name);
+                if (global != m_scope.globals->end()) {
+                    return global->second;
+                }
+            }
+            throw std::runtime_error{"No symbol \"" + name + "\" in current context"};
+        }
+
+        std::vector<token> m_tokens;
+        std::size_t m_next = 0;
+        const expression_scope &m_scope;
+        type_cache &m_types;
+    };
+
+    //types the syntax tree and generates the code
+    class compiler {
+    public:
+        compiler(type_cache &types, const expression_scope &scope, std::vector<instruction> &code,
+                 std::vector<die> &variables)
+                : m_types{types}, m_scope{scope}, m_code{code}, m_variables{variables} {}
+
+        void check(node &n) {
+            switch (n.type) {
+                case node::kind::constant:
+                    break;
+                case node::kind::reg: {
+                    auto is_address = n.r == reg::rip || n.r == reg::rsp || n.r == reg::rbp;
+                    n.desc = is_address ? &m_types.pointer_to(m_types.get(die{})) : &long_type();
+                    break;
+                }
+                case node::kind::variable:
+                    check_variable(n);
+                    break;
+                case node::kind::unary:
+                    check(*n.left);
+                    check_unary(n);
+                    break;
+                case node::kind::binary:
+                case node::kind::logical:
+                    check(*n.left);
+                    check(*n.right);
+                    check_binary(n);
+                    break;
+                case node::kind::member:
+                    check(*n.left);
+                    check_member(n);
+                    break;
+                case node::kind::index:
+                    check(*n.left);
+                    check(*n.right);
+                    check_index(n);
+                    break;
+            }
+        }
+
+        //the type of the node where it is used as a value, arrays in memory decay to pointers
+        const type_desc &value_type(const node &n) {
+            if (n.desc->type == type_desc::kind::array && n.in_memory) {
+                return m_types.pointer_to(*n.desc->target);
+            }
+            if (is_floating(*n.desc) && n.desc->size != 8) {
+                return double_type(); //floats are computed as doubles
+            }
+            return *n.desc;
+        }
+
+        void gen_address(const node &n) {
+            switch (n.type) {
+                case node::kind::variable:
+                    gen_location(n);
+                    if (n.reference && n.location.type != fixed_location::kind::register_value) {
+                        emit(opcode::load);
+                    }
+                    return;
+                case node::kind::unary: //*p
+                    gen_value(*n.left);
+                    return;
+                case node::kind::member:
+                    if (n.value) {
+                        gen_value(*n.left);
+                    } else {
+                        gen_address(*n.left);
+                    }
+                    if (n.offset) {
+                        emit(opcode::constant, domain::unsigned_integer, 8, n.offset);
+                        emit(opcode::add);
+                    }
+                    if (n.reference) {
+                        emit(opcode::load);
+                    }
+                    return;
+                case node::kind::index: {
+                    auto &base = *n.left->desc;
+                    if (base.type == type_desc::kind::array && n.left->in_memory) {
+                        gen_address(*n.left);
+                    } else if (base.library == type_desc::container::vector) {
+                        gen_address(*n.left); //its first member is the pointer to the elements
+                        emit(opcode::load);
+                    } else {
+                        gen_value(*n.left);
+                    }
+                    gen_value(*n.right);
+                    scale(n.desc->size);
+                    emit(opcode::add);
+                    return;
+                }
+                default:
+                    throw error_at(n.pos, "Not in memory");
+            }
+        }
+
+        void gen_value(const node &n) {
+            auto &type = value_type(n);
+            if (n.in_memory) {
+                gen_address(n);
+                if (n.desc->type == type_desc::kind::array) {
+                    return; //the address of the first element
+                }
+                if (n.bit_size) {
+                    emit(opcode::load, domain::unsigned_integer, (n.bit_offset + n.bit_size + 7) / 8);
+                    emit(opcode::bits, domain_of(type), 8, uint64_t{n.bit_offset} << 8 | n.bit_size);
+                } else {
+                    emit(opcode::load, domain_of(*n.desc), n.desc->size);
+                }
+                return;
+            }
+
+            switch (n.type) {
+                case node::kind::constant:
+                    emit(opcode::constant, domain_of(type), 8, n.value);
+                    return;
+                case node::kind::reg:
+                    emit(opcode::reg, domain::unsigned_integer, 8, static_cast<uint64_t>(n.r));
+                    return;
+                case node::kind::variable:
+                    gen_location(n);
+                    if (is_integer(type) && type.size < 8) {
+                        emit(opcode::extend, domain_of(type), type.size);
+                    }
+                    return;
+                case node::kind::unary:
+                    gen_unary(n);
+                    return;
+                case node::kind::binary:
+                    gen_binary(n);
+                    return;
+                case node::kind::logical: {
+                    gen_value(*n.left);
+                    emit(opcode::to_bool, domain_of(value_type(*n.left)));
+                    auto jump = m_code.size();
+                    emit(n.op == "&&" ? opcode::and_then : opcode::or_else);
+                    gen_value(*n.right);
+                    emit(opcode::to_bool, domain_of(value_type(*n.right)));
+                    m_code[jump].operand = m_code.size();
+                    return;
+                }
+                default:
+                    throw error_at(n.pos, "Not a value");
+            }
+        }
+
+        void emit(opcode op, domain type = domain::unsigned_integer, uint8_t size = 8, uint64_t operand = 0) {
+            m_code.push_back(instruction{op, type, size, operand});
+        }
+
+        const type_desc &int_type() { return m_types.builtin("int", 4, DW_ATE::signed_); }
+
+    private:
+        const type_desc &long_type() { return m_types.builtin("long", 8, DW_ATE::signed_); }
+
+        const type_desc &double_type() { return m_types.builtin("double", 8, DW_ATE::float_); }
+
+        //integers smaller than int become int
+        const type_desc &promote(const type_desc &t) {
+            if (is_floating(t)) {
+                return double_type();
+            }
+            return t.size < 4 || t.type == type_desc::kind::enumeration ? int_type() : t;
+        }
+
+        //the usual arithmetic conversions
+        const type_desc &common(const type_desc &a, const type_desc &b) {
+            auto &pa = promote(a);
+            auto &pb = promote(b);
+            if (is_floating(pa) || is_floating(pb)) {
+                return double_type();
+            }
+            auto size = std::max(pa.size, pb.size);
+            auto is_unsigned = (pa.size == size && domain_of(pa) == domain::unsigned_integer) ||
+                               (pb.size == size && domain_of(pb) == domain::unsigned_integer);
+            if (size == 8) {
+                return is_unsigned ? m_types.builtin("unsigned long", 8, DW_ATE::unsigned_) : long_type();
+            }
+            return is_unsigned ? m_types.builtin("unsigned int", 4, DW_ATE::unsigned_) : int_type();
+        }
+
+        void check_variable(node &n) {
+            auto &type = m_types.get(variable_type(n.var));
+            if (n.var.has(DW_AT::const_value)) {
+                n.desc = &type;
+                return;
+            }
+            n.location = fixed_location_of(n.var, m_scope.function ? *m_scope.function : die{});
+            if (n.location.type == fixed_location::kind::other) {
+                n.variable = m_variables.size();
+                m_variables.push_back(n.var);
+            }
+            n.in_memory = n.location.type != fixed_location::kind::register_value;
+            n.desc = &type;
+            if (type.type == type_desc::kind::reference) {
+                n.reference = true;
+                n.in_memory = true;
+                n.desc = type.target;
+            }
+        }
+
+        void check_unary(node &n) {
+            auto &operand = *n.left;
+            auto &type = value_type(operand);
+            if (n.op == "*") {
+                if (!is_pointer(type) || type.target->type == type_desc::kind::unknown ||
+                    type.target->type == type_desc::kind::function) {
+                    throw error_at(n.pos, "Attempt to take contents of a non-pointer value");
+                }
+                n.desc = type.target;
+                n.in_memory = true;
+            } else if (n.op == "&") {
+                if (!operand.in_memory || operand.bit_size) {
+                    throw error_at(n.pos, "Attempt to take address of a value not in memory");
+                }
+                n.desc = &m_types.pointer_to(*operand.desc);
+            } else if (n.op == "!") {
+                require(is_scalar(type), operand, "Expected a scalar");
+                n.desc = &int_type();
+            } else {
+                require(n.op == "~" ? is_integer(type) : is_arithmetic(type), operand,
+                        n.op == "~" ? "Expected an integer" : "Expected a number");
+                n.desc = &promote(type);
+            }
+        }
+
+        void check_binary(node &n) {
+            auto &left = value_type(*n.left);
+            auto &right = value_type(*n.right);
+            auto &op = n.op;
+            if (n.type == node::kind::logical) {
+                require(is_scalar(left), *n.left, "Expected a scalar");
+                require(is_scalar(right), *n.right, "Expected a scalar");
+                n.desc = &int_type();
+            } else if ((op == "+" || op == "-") && is_pointer(left) && is_integer(right)) {
+                n.desc = &left;
+            } else if (op == "+" && is_integer(left) && is_pointer(right)) {
+                n.desc = &right;
+            } else if (op == "-" && is_pointer(left) && is_pointer(right)) {
+                if (element_size(left) != element_size(right)) {
+                    throw error_at(n.pos, "Subtracting pointers to different types");
+                }
+                n.desc = &long_type();
+            } else if (op == "==" || op == "!=" || op == "<" || op == "<=" || op == ">" || op == ">=") {
+                auto pointers = (is_pointer(left) && (is_pointer(right) || is_integer(right))) ||
+                                (is_integer(left) && is_pointer(right));
+                if (!pointers) {
+                    require(is_arithmetic(left), *n.left, "Expected a number");
+                    require(is_arithmetic(right), *n.right, "Expected a number");
+                }
+                n.operands = pointers ? &m_types.builtin("unsigned long", 8, DW_ATE::unsigned_) : &common(left, right);
+                n.desc = &int_type();
+            } else if (op == "<<" || op == ">>") {
+                require(is_integer(left), *n.left, "Expected an integer");
+                require(is_integer(right), *n.right, "Expected an integer");
+                n.desc = n.operands = &promote(left);
+            } else {
+                auto integers = op == "%" || op == "&" || op == "|" || op == "^";
+                for (auto side: {n.left.get(), n.right.get()}) {
+                    auto &t = value_type(*side);
+                    require(integers ? is_integer(t) : is_arithmetic(t), *side,
+                            integers ? "Expected an integer" : "Expected a number");
+                }
+                n.desc = n.operands = &common(left, right);
+            }
+        }
+
+        void check_member(node &n) {
+            auto &left = *n.left;
+            const type_desc *type = left.desc;
+            if (n.value) { //->
+                auto &pointer = value_type(left);
+                if (!is_pointer(pointer)) {
+                    throw error_at(n.pos, "The left operand of -> is not a pointer");
+                }
+                type = pointer.target;
+            } else if (!left.in_memory) {
+                throw error_at(n.pos, "Attempt to take a member of a value not in memory");
+            }
+            if (type->type != type_desc::kind::structure) {
+                throw error_at(n.pos, "Attempt to extract a component of a value that is not a structure");
+            }
+            auto member = find_member(*type, n.op, n.offset);
+            if (!member) {
+                throw error_at(n.pos, "There is no member named " + n.op);
+            }
+            n.in_memory = true;
+            n.desc = member->type;
+            n.bit_size = member->bit_size;
+            n.bit_offset = member->bit_offset;
+            if (member->type->type == type_desc::kind::reference) {
+                n.reference = true;
+                n.desc = member->type->target;
+            }
+        }
+
+        //looks into the base classes after the members of type itself, offset is added to
+        const type_desc::member *find_member(const type_desc &type, const std::string &name, uint64_t &offset) {
+            for (auto &m: type.members) {
+                if (!m.base_class && m.name == name) {
+                    offset += m.offset;
+                    return &m;
+                }
+            }
+            for (auto &m: type.members) {
+                auto base_offset = offset + m.offset;
+                if (m.base_class) {
+                    if (auto found = find_member(*m.type, name, base_offset)) {
+                        offset = base_offset;
+                        return found;
+                    }
+                }
+            }
+            return nullptr;
+        }
+
+        void check_index(node &n) {
+            auto &base = *n.left->desc;
+            require(is_integer(value_type(*n.right)), *n.right, "Expected an integer index");
+            if (base.type == type_desc::kind::array && n.left->in_memory) {
+                n.desc = base.target;
+            } else if (base.library == type_desc::container::vector && n.left->in_memory) {
+                n.desc = base.target;
+            } else if (is_pointer(value_type(*n.left)) && value_type(*n.left).target->type != type_desc::kind::unknown) {
+                n.desc = value_type(*n.left).target;
+            } else {
+                throw error_at(n.pos, "Cannot subscript something that is not an array, a pointer or a vector");
+            }
+            n.in_memory = true;
+        }
+
+        void require(bool condition, const node &n, const char *message) {
+            if (!condition) {
+                throw error_at(n.pos, message);
+            }
+        }
+
+        static uint64_t element_size(const type_desc &pointer) {
+            auto size = pointer.target ? pointer.target->size : 0;
+            return size ? size : 1; //void *
+        }
+
+        //multiplies the index on the top of the stack by the element size
+        void scale(uint64_t size) {
+            if (size != 1) {
+                emit(opcode::constant, domain::unsigned_integer, 8, size);
+                emit(opcode::mul);
+            }
+        }
+
+        void gen_location(const node &n) {
+            if (n.var.has(DW_AT::const_value)) {
+                auto v = n.var[DW_AT::const_value];
+                uint64_t bits = 0;
+                if (v.get_type() == value::type::block) {
+                    std::size_t size;
+                    auto data = v.as_block(&size);
+                    std::memcpy(&bits, data, std::min(size, sizeof(bits)));
+                } else {
+                    bits = v.get_type() == value::type::sconstant ? v.as_sconstant() : v.as_uconstant();
+                }
+                if (is_floating(*n.desc) && n.desc->size == 4) {
+                    float f;
+                    std::memcpy(&f, &bits, sizeof(f));
+                    double d = f;
+                    std::memcpy(&bits, &d, sizeof(bits));
+                }
+                emit(opcode::constant, domain::unsigned_integer, 8, bits);
+                return;
+            }
+            auto offset = static_cast<uint64_t>(n.location.offset);
+            switch (n.location.type) {
+                case fixed_location::kind::address:
+                    emit(opcode::constant, domain::unsigned_integer, 8, offset);
+                    emit(opcode::load_address);
+                    break;
+                case fixed_location::kind::cfa_offset:
+                    emit(opcode::cfa);
+                    emit(opcode::constant, domain::unsigned_integer, 8, offset);
+                    break;
+                case fixed_location::kind::register_offset:
+                    emit(opcode::reg, domain::unsigned_integer, 8, static_cast<uint64_t>(n.location.r));
+                    emit(opcode::constant, domain::unsigned_integer, 8, offset);
+                    break;
+                case fixed_location::kind::register_value:
+                    emit(opcode::reg, domain::unsigned_integer, 8, static_cast<uint64_t>(n.location.r));
+                    return;
+                case fixed_location::kind::other:
+                    emit(opcode::locate, domain::unsigned_integer, 8, n.variable);
+                    return;
+            }
+            emit(opcode::add);
+        }
+
+        //converts the value on the top of the stack
+        void convert(const type_desc &from, const type_desc &to) {
+            if (is_floating(to)) {
+                if (!is_floating(from)) {
+                    emit(opcode::to_double, domain_of(from));
+                }
+                return;
+            }
+            if (is_floating(from)) {
+                emit(opcode::to_integer, domain_of(to));
+            }
+            if ((&from != &to || is_floating(from)) && to.size < 8) {
+                emit(opcode::extend, domain_of(to), to.size);
+            }
+        }
+
+        //integer results are cut to the size of their type
+        void wrap(const type_desc &type) {
+            if (is_integer(type) && type.size < 8) {
+                emit(opcode::extend, domain_of(type), type.size);
+            }
+        }
+
+        void gen_unary(const node &n) {
+            if (n.op == "&") {
+                gen_address(*n.left);
+                return;
+            }
+            auto &operand = value_type(*n.left);
+            gen_value(*n.left);
+            if (n.op == "!") {
+                emit(opcode::logical_not, domain_of(operand));
+                return;
+            }
+            convert(operand, *n.desc);
+            if (n.op != "+") {
+                emit(n.op == "-" ? opcode::neg : opcode::bit_not, domain_of(*n.desc));
+                wrap(*n.desc);
+            }
+        }
+
+        void gen_binary(const node &n) {
+            static const std::pair<const char *, opcode> operators[] = {
+                    {"+", opcode::add}, {"-", opcode::sub}, {"*", opcode::mul}, {"/", opcode::div},
+                    {"%", opcode::mod}, {"<<", opcode::shl}, {">>", opcode::shr}, {"&", opcode::bit_and},
+                    {"|", opcode::bit_or}, {"^", opcode::bit_xor}, {"==", opcode::eq}, {"!=", opcode::ne},
+                    {"<", opcode::lt}, {"<=", opcode::le}, {">", opcode::gt}, {">=", opcode::ge}};
+            auto op = std::find_if(std::begin(operators), std::end(operators),
+                                   [&](auto &&o) { return n.op == o.first; })->second;
+            auto &left = value_type(*n.left);
+            auto &right = value_type(*n.right);
+
+            if (!n.operands) { //pointer arithmetic
+                gen_value(*n.left);
+                if (is_integer(left)) {
+                    scale(element_size(right));
+                }
+                gen_value(*n.right);
+                if (is_integer(right)) {
+                    scale(element_size(left));
+                }
+                emit(op, domain::unsigned_integer);
+                if (is_pointer(left) && is_pointer(right)) {
+                    emit(opcode::constant, domain::signed_integer, 8, element_size(left));
+                    emit(opcode::div, domain::signed_integer);
+                }
+                return;
+            }
+
+            auto &operands = *n.operands;
+            gen_value(*n.left);
+            convert(left, operands);
+            gen_value(*n.right);
+            if (op != opcode::shl && op != opcode::shr) {
+                convert(right, operands);
+            }
+            emit(op, domain_of(operands));
+            if (n.desc == n.operands) {
+                wrap(operands);
+            }
+        }
+
+        type_cache &m_types;
+        const expression_scope &m_scope;
+        std::vector<instruction> &m_code;
+        std::vector<die> &m_variables;
+    };
+
+    double as_double(uint64_t bits) {
+        double d;
+        std::memcpy(&d, &bits, sizeof(d));
+        return d;
+    }
+
+    uint64_t from_double(double d) {
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        return bits;
+    }
+
+    uint64_t extend(uint64_t value, unsigned size, domain type) {
+        if (size >= 8) {
+            return value;
+        }
+        auto shift = 64 - 8 * size;
+        return type == domain::signed_integer ? static_cast<uint64_t>(static_cast<int64_t>(value << shift) >> shift)
+                                              : value << shift >> shift;
+    }
+}
+
+expression::expression(const std::string &text, const expression_scope &scope, type_cache &types, mode m)
+        : m_text{text} {
+    auto root = parser{tokenize(text), scope, types}.parse();
+    compiler c{types, scope, m_code, m_variables};
+    c.check(*root);
+    m_function = scope.function ? *scope.function : die{};
+
+    auto &type = c.value_type(*root);
+    if (m == mode::condition) {
+        if (!is_scalar(type)) {
+            throw std::runtime_error{"A condition must be a number or a pointer"};
+        }
+        c.gen_value(*root);
+        c.emit(opcode::to_bool, domain_of(type));
+        m_type = &c.int_type();
+    } else if (is_scalar(*root->desc)) {
+        c.gen_value(*root);
+        m_type = &type;
+    } else if (root->in_memory) {
+        c.gen_address(*root);
+        m_type = root->desc;
+        m_in_memory = true;
+    } else {
+        throw std::runtime_error{"Cannot evaluate an expression of type " + root->desc->name};
+    }
+
+    //the depth of the stack along the code, jumps keep the depth of the code they skip
+    std::size_t depth = 0;
+    for (auto &in: m_code) {
+        switch (in.op) {
+            case opcode::constant:
+            case opcode::reg:
+            case opcode::cfa:
+            case opcode::load_address:
+            case opcode::locate:
+                ++depth;
+                break;
+            case opcode::add: case opcode::sub: case opcode::mul: case opcode::div: case opcode::mod:
+            case opcode::shl: case opcode::shr: case opcode::bit_and: case opcode::bit_or: case opcode::bit_xor:
+            case opcode::eq: case opcode::ne: case opcode::lt: case opcode::le: case opcode::gt: case opcode::ge:
+            case opcode::and_then: case opcode::or_else:
+                --depth;
+                break;
+            default:
+                break;
+        }
+        m_stack_size = std::max(m_stack_size, depth);
+    }
+    if (m_stack_size > max_stack) {
+        throw std::runtime_error{"Expression too complex"};
+    }
+}
+
+uint64_t expression::evaluate(const eval_context &context) const {
+    uint64_t stack[max_stack];
+    std::size_t top = 0;
+    uint64_t cfa = 0;
+    bool have_cfa = false;
+    auto get_cfa = [&] {
+        if (!have_cfa) {
+            cfa = context.cfa ? context.cfa() : 0;
+            have_cfa = true;
+        }
+        return cfa;
+    };
+
+    for (std::size_t pc = 0; pc < m_code.size(); ++pc) {
+        auto &in = m_code[pc];
+        switch (in.op) {
+            case opcode::constant:
+                stack[top++] = in.operand;
+                break;
+            case opcode::reg:
+                stack[top++] = get_register_value(*context.regs, static_cast<reg>(in.operand));
+                break;
+            case opcode::cfa:
+                stack[top++] = get_cfa();
+                break;
+            case opcode::load_address:
+                stack[top++] = context.load_address;
+                break;
+            case opcode::locate: {
+                auto &var = m_variables[in.operand];
+                auto loc = locate(var, m_function, frame_info{context.regs, get_cfa(), context.load_address, context.read});
+                if (loc.type != location::kind::memory) {
+                    throw std::runtime_error{"Variable " + variable_name(var) + " is not in memory"};
+                }
+                stack[top++] = loc.address;
+                break;
+            }
+            case opcode::load: {
+                uint8_t bytes[16]{};
+                auto size = std::min<std::size_t>(in.size, sizeof(bytes));
+                if (!context.read(stack[top - 1], bytes, size)) {
+                    std::ostringstream message;
+                    message << "Cannot access memory at 0x" << std::hex << stack[top - 1];
+                    throw std::runtime_error{message.str()};
+                }
+                uint64_t value = 0;
+                std::memcpy(&value, bytes, std::min<std::size_t>(size, sizeof(value)));
+                if (in.type == domain::floating && size == sizeof(float)) {
+                    float f;
+                    std::memcpy(&f, bytes, sizeof(f));
+                    value = from_double(f);
+                } else if (in.type == domain::floating && size > sizeof(double)) {
+                    long double ld;
+                    std::memcpy(&ld, bytes, sizeof(ld));
+                    value = from_double(static_cast<double>(ld));
+                } else if (in.type != domain::floating) {
+                    value = extend(value, size, in.type);
+                }
+                stack[top - 1] = value;
+                break;
+            }
+            case opcode::bits: {
+                auto size = static_cast<unsigned>(in.operand & 0xff);
+                auto value = stack[top - 1] >> (in.operand >> 8);
+                value &= size < 64 ? (uint64_t{1} << size) - 1 : ~uint64_t{0};
+                if (in.type == domain::signed_integer && size < 64 && (value >> (size - 1)) & 1) {
+                    value |= ~uint64_t{0} << size;
+                }
+                stack[top - 1] = value;
+                break;
+            }
+            case opcode::extend:
+                stack[top - 1] = extend(stack[top - 1], in.size, in.type);
+                break;
+            case opcode::to_double: {
+                auto v = stack[top - 1];
+                stack[top - 1] = from_double(in.type == domain::signed_integer ? static_cast<double>(static_cast<int64_t>(v))
+                                                                               : static_cast<double>(v));
+                break;
+            }
+            case opcode::to_integer: {
+                auto d = as_double(stack[top - 1]);
+                stack[top - 1] = in.type == domain::signed_integer ? static_cast<uint64_t>(static_cast<int64_t>(d))
+                                                                   : static_cast<uint64_t>(d);
+                break;
+            }
+            case opcode::neg:
+                stack[top - 1] = in.type == domain::floating ? from_double(-as_double(stack[top - 1])) : 0 - stack[top - 1];
+                break;
+            case opcode::bit_not:
+                stack[top - 1] = ~stack[top - 1];
+                break;
+            case opcode::logical_not:
+            case opcode::to_bool: {
+                auto v = stack[top - 1];
+                bool zero = in.type == domain::floating ? as_double(v) == 0 : v == 0;
+                stack[top - 1] = (in.op == opcode::logical_not) == zero;
+                break;
+            }
+            case opcode::and_then:
+            case opcode::or_else:
+                //the left operand is 0 or 1 and decides the result if it is 0 for && or 1 for ||
+                if ((stack[top - 1] != 0) == (in.op == opcode::or_else)) {
+                    pc = in.operand - 1;
+                } else {
+                    --top;
+                }
+                break;
+            default: {
+                auto b = stack[--top];
+                auto &a = stack[top - 1];
+                if (in.type == domain::floating) {
+                    auto x = as_double(a), y = as_double(b);
+                    switch (in.op) {
+                        case opcode::add: a = from_double(x + y); break;
+                        case opcode::sub: a = from_double(x - y); break;
+                        case opcode::mul: a = from_double(x * y); break;
+                        case opcode::div: a = from_double(x / y); break;
+                        case opcode::eq: a = x == y; break;
+                        case opcode::ne: a = x != y; break;
+                        case opcode::lt: a = x < y; break;
+                        case opcode::le: a = x <= y; break;
+                        case opcode::gt: a = x > y; break;
+                        case opcode::ge: a = x >= y; break;
+                        default: throw std::runtime_error{"Invalid operation on floating point values"};
+                    }
+                    break;
+                }
+                auto is_signed = in.type == domain::signed_integer;
+                auto sa = static_cast<int64_t>(a), sb = static_cast<int64_t>(b);
+                switch (in.op) {
+                    case opcode::add: a += b; break;
+                    case opcode::sub: a -= b; break;
+                    case opcode::mul: a *= b; break;
+                    case opcode::div:
+                    case opcode::mod:
+                        if (b == 0) {
+                            throw std::runtime_error{"Division by zero"};
+                        }
+                        if (is_signed && !(sa == INT64_MIN && sb == -1)) {
+                            a = in.op == opcode::div ? sa / sb : sa % sb;
+                        } else if (!is_signed) {
+                            a = in.op == opcode::div ? a / b : a % b;
+                        } else {
+                            a = in.op == opcode::div ? a : 0;
+                        }
+                        break;
+                    case opcode::shl: a <<= b & 63; break;
+                    case opcode::shr: a = is_signed ? static_cast<uint64_t>(sa >> (b & 63)) : a >> (b & 63); break;
+                    case opcode::bit_and: a &= b; break;
+                    case opcode::bit_or: a |= b; break;
+                    case opcode::bit_xor: a ^= b; break;
+                    case opcode::eq: a = a == b; break;
+                    case opcode::ne: a = a != b; break;
+                    case opcode::lt: a = is_signed ? sa < sb : a < b; break;
+                    case opcode::le: a = is_signed ? sa <= sb : a <= b; break;
+                    case opcode::gt: a = is_signed ? sa > sb : a > b; break;
+                    case opcode::ge: a = is_signed ? sa >= sb : a >= b; break;
+                    default: break;
+                }
+                break;
+            }
+        }
+    }
+    return stack[0];
+}
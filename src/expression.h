@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/user.h>
+
+#include "variables.h"
+#include "libelfin/dwarf/dwarf++.hh"
+
+//the program state an expression is evaluated against
+struct eval_context {
+    const user_regs_struct *regs;
+    uint64_t load_address; //added to the link time addresses of globals
+    std::function<uint64_t()> cfa; //of the frame of regs, only called by expressions using locals
+    std::function<bool(uint64_t address, void *buffer, std::size_t size)> read;
+};
+
+//the names an expression can use: the variables of function visible at pc, the globals and $registers
+struct expression_scope {
+    const dwarf::die *function; //nullptr outside of functions
+    uint64_t pc;                //a DWARF address
+    const std::unordered_map<std::string, dwarf::die> *globals;
+};
+
+//a C expression parsed into a typed syntax tree with its names bound to DWARF variables and types,
+//then compiled into code for a small stack machine, so it can be evaluated any number of times
+//without parsing or looking anything up again. Supports the arithmetic, bitwise, logical and
+//comparison operators of C, unary * & - ! ~, members (. ->), indexing of arrays, pointers and
+//std::vector, integer, floating point and character literals and $registers.
+class expression {
+public:
+    enum class mode {
+        value,    //scalars are loaded, aggregates stay in memory and evaluate to their address
+        condition //a scalar converted to 0 or 1
+    };
+
+    //throws std::runtime_error for syntax and type errors and unknown names
+    expression(const std::string &text, const expression_scope &scope, type_cache &types, mode m = mode::value);
+
+    //the address of the result if in_memory(), else its value zero or sign extended to 64 bits, or
+    //the bits of a double. Throws std::runtime_error if memory cannot be read or on a division by zero.
+    uint64_t evaluate(const eval_context &context) const;
+
+    bool test(const eval_context &context) const { return evaluate(context) != 0; }
+
+    const type_desc &type() const { return *m_type; }
+
+    bool in_memory() const { return m_in_memory; }
+
+    const std::string &text() const { return m_text; }
+
+    //the instructions of the stack machine, values are 64 bits: integers extended to 64 bits as by
+    //their type, addresses and the bits of doubles
+    enum class opcode : uint8_t {
+        constant, reg, cfa, load_address, locate, //push the operand, a register, the CFA, a variable
+        load, bits,                                //replace an address by the value there, extract a bit field
+        extend, to_double, to_integer,             //conversions
+        add, sub, mul, div, mod, shl, shr, bit_and, bit_or, bit_xor,
+        neg, bit_not, logical_not, to_bool,
+        eq, ne, lt, le, gt, ge,
+        and_then, or_else                          //&& and ||: jump to operand keeping a 0 or 1 that decides
+    };
+
+    //how operations treat their operands and loads extend values
+    enum class domain : uint8_t { signed_integer, unsigned_integer, floating };
+
+    struct instruction {
+        opcode op;
+        domain type = domain::unsigned_integer;
+        uint8_t size = 8;     //of loads and extensions
+        uint64_t operand = 0; //constant, reg, variable index, jump target, bit field offset << 8 | size
+    };
+
+private:
+    std::string m_text;
+    std::vector<instruction> m_code;
+    std::vector<dwarf::die> m_variables; //located at run time by the locate instruction
+    dwarf::die m_function;
+    std::size_t m_stack_size = 0;
+    const type_desc *m_type = nullptr;
+    bool m_in_memory = false;
+};
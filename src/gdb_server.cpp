@@ -0,0 +1,712 @@
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <climits>
+#include <sys/ptrace.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "gdb_server.h"
+#include "debugger.h"
+#include "utility.h"
+
+namespace {
+    enum class reg_source { gp, fp, zero };
+
+    //one register of the g packet, in the order of the target description
+    struct remote_register {
+        std::string name;
+        unsigned bits;
+        const char *type;
+        const char *feature;
+        reg_source source;
+        std::size_t offset; //into user_regs_struct or user_fpregs_struct
+        std::size_t size;   //bytes there, the rest of the packet field is zero
+    };
+
+    const std::vector<remote_register> &remote_registers() {
+        static const std::vector<remote_register> regs = []() {
+            std::vector<remote_register> r;
+            auto gp = [&r](const char *name, std::size_t offset, const char *type = "int64", unsigned bits = 64,
+                           const char *feature = "org.gnu.gdb.i386.core") {
+                r.push_back({name, bits, type, feature, reg_source::gp, offset, bits / 8});
+            };
+            auto fp = [&r](const std::string &name, std::size_t offset, std::size_t size, unsigned bits,
+                           const char *type, const char *feature = "org.gnu.gdb.i386.core") {
+                r.push_back({name, bits, type, feature, reg_source::fp, offset, size});
+            };
+
+            gp("rax", offsetof(user_regs_struct, rax));
+            gp("rbx", offsetof(user_regs_struct, rbx));
+            gp("rcx", offsetof(user_regs_struct, rcx));
+            gp("rdx", offsetof(user_regs_struct, rdx));
+            gp("rsi", offsetof(user_regs_struct, rsi));
+            gp("rdi", offsetof(user_regs_struct, rdi));
+            gp("rbp", offsetof(user_regs_struct, rbp), "data_ptr");
+            gp("rsp", offsetof(user_regs_struct, rsp), "data_ptr");
+            gp("r8", offsetof(user_regs_struct, r8));
+            gp("r9", offsetof(user_regs_struct, r9));
+            gp("r10", offsetof(user_regs_struct, r10));
+            gp("r11", offsetof(user_regs_struct, r11));
+            gp("r12", offsetof(user_regs_struct, r12));
+            gp("r13", offsetof(user_regs_struct, r13));
+            gp("r14", offsetof(user_regs_struct, r14));
+            gp("r15", offsetof(user_regs_struct, r15));
+            gp("rip", offsetof(user_regs_struct, rip), "code_ptr");
+            gp("eflags", offsetof(user_regs_struct, eflags), "int32", 32);
+            gp("cs", offsetof(user_regs_struct, cs), "int32", 32);
+            gp("ss", offsetof(user_regs_struct, ss), "int32", 32);
+            gp("ds", offsetof(user_regs_struct, ds), "int32", 32);
+            gp("es", offsetof(user_regs_struct, es), "int32", 32);
+            gp("fs", offsetof(user_regs_struct, fs), "int32", 32);
+            gp("gs", offsetof(user_regs_struct, gs), "int32", 32);
+            for (int i = 0; i < 8; ++i) {
+                fp("st" + std::to_string(i), offsetof(user_fpregs_struct, st_space) + i * 16, 10, 80, "i387_ext");
+            }
+            fp("fctrl", offsetof(user_fpregs_struct, cwd), 2, 32, "int");
+            fp("fstat", offsetof(user_fpregs_struct, swd), 2, 32, "int");
+            fp("ftag", offsetof(user_fpregs_struct, ftw), 2, 32, "int");
+            r.push_back({"fiseg", 32, "int", "org.gnu.gdb.i386.core", reg_source::zero, 0, 0});
+            fp("fioff", offsetof(user_fpregs_struct, rip), 4, 32, "int");
+            r.push_back({"foseg", 32, "int", "org.gnu.gdb.i386.core", reg_source::zero, 0, 0});
+            fp("fooff", offsetof(user_fpregs_struct, rdp), 4, 32, "int");
+            fp("fop", offsetof(user_fpregs_struct, fop), 2, 32, "int");
+            for (int i = 0; i < 16; ++i) {
+                fp("xmm" + std::to_string(i), offsetof(user_fpregs_struct, xmm_space) + i * 16, 16, 128, "vec128",
+                   "org.gnu.gdb.i386.sse");
+            }
+            fp("mxcsr", offsetof(user_fpregs_struct, mxcsr), 4, 32, "int", "org.gnu.gdb.i386.sse");
+            gp("orig_rax", offsetof(user_regs_struct, orig_rax), "int", 64, "org.gnu.gdb.i386.linux");
+            gp("fs_base", offsetof(user_regs_struct, fs_base), "int", 64, "org.gnu.gdb.i386.segments");
+            gp("gs_base", offsetof(user_regs_struct, gs_base), "int", 64, "org.gnu.gdb.i386.segments");
+            return r;
+        }();
+        return regs;
+    }
+
+    //Linux signal numbers to the numbering of the remote protocol, they differ above SIGFPE
+    const int gdb_signals[][2] = {
+        {SIGHUP, 1}, {SIGINT, 2}, {SIGQUIT, 3}, {SIGILL, 4}, {SIGTRAP, 5}, {SIGABRT, 6}, {SIGFPE, 8},
+        {SIGKILL, 9}, {SIGBUS, 10}, {SIGSEGV, 11}, {SIGSYS, 12}, {SIGPIPE, 13}, {SIGALRM, 14}, {SIGTERM, 15},
+        {SIGURG, 16}, {SIGSTOP, 17}, {SIGTSTP, 18}, {SIGCONT, 19}, {SIGCHLD, 20}, {SIGTTIN, 21},
+        {SIGTTOU, 22}, {SIGIO, 23}, {SIGXCPU, 24}, {SIGXFSZ, 25}, {SIGVTALRM, 26}, {SIGPROF, 27},
+        {SIGWINCH, 28}, {SIGUSR1, 30}, {SIGUSR2, 31},
+    };
+
+    int to_gdb_signal(int sig) {
+        for (auto &s: gdb_signals) {
+            if (s[0] == sig) {
+                return s[1];
+            }
+        }
+        return sig;
+    }
+
+    int from_gdb_signal(int sig) {
+        for (auto &s: gdb_signals) {
+            if (s[1] == sig) {
+                return s[0];
+            }
+        }
+        return sig;
+    }
+
+    const char hex_digits[] = "0123456789abcdef";
+
+    std::string to_hex(const void *data, std::size_t size) {
+        std::string out;
+        out.reserve(size * 2);
+        for (std::size_t i = 0; i < size; ++i) {
+            auto byte = static_cast<const uint8_t *>(data)[i];
+            out += hex_digits[byte >> 4];
+            out += hex_digits[byte & 0xf];
+        }
+        return out;
+    }
+
+    std::string from_hex(const std::string &hex) {
+        std::string out;
+        for (std::size_t i = 0; i + 1 < hex.size(); i += 2) {
+            out += static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16));
+        }
+        return out;
+    }
+
+    //the value of a hex digit, -1 for other characters
+    int hex_value(char c) {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    std::string hex_number(uint64_t value) {
+        std::ostringstream out;
+        out << std::hex << value;
+        return out.str();
+    }
+
+    std::string hex_byte(unsigned value) {
+        return to_hex(&value, 1);
+    }
+
+    //"addr,len" with an optional ":data" or ",kind" tail
+    void parse_address(const std::string &args, uint64_t &addr, uint64_t &len) {
+        auto comma = args.find(',');
+        addr = std::stoull(args.substr(0, comma), nullptr, 16);
+        len = std::stoull(args.substr(comma + 1), nullptr, 16);
+    }
+}
+
+gdb_server::gdb_server(debugger &dbg, int in, int out) : m_dbg{dbg}, m_in{in}, m_out{out} {
+    m_dbg.m_out = &std::cerr;
+}
+
+bool gdb_server::open_connection(const std::string &target, int &in, int &out) {
+    if (target == "stdio") {
+        in = STDIN_FILENO;
+        out = STDOUT_FILENO;
+        return true;
+    }
+
+    auto listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (listener < 0 || target.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    std::strcpy(addr.sun_path, target.c_str());
+    unlink(target.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(listener, 1) < 0) {
+        close(listener);
+        return false;
+    }
+
+    std::cerr << "Listening on " << target << std::endl;
+    in = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    close(listener);
+    unlink(target.c_str());
+    out = in;
+    return in >= 0;
+}
+
+bool gdb_server::read_packet(std::string &packet) {
+    while (true) {
+        auto start = m_input.find('$');
+        auto end = start == std::string::npos ? std::string::npos : m_input.find('#', start);
+        if (end != std::string::npos && end + 2 < m_input.size()) {
+            auto body = m_input.substr(start + 1, end - start - 1);
+            auto high = hex_value(m_input[end + 1]);
+            auto low = hex_value(m_input[end + 2]);
+            auto checksum = high < 0 || low < 0 ? -1 : high << 4 | low; //a malformed one matches no sum
+            m_input.erase(0, end + 3);
+
+            uint8_t sum = 0;
+            for (auto c: body) {
+                sum += static_cast<uint8_t>(c);
+            }
+            if (m_ack) {
+                auto ack = sum == checksum ? "+" : "-";
+                write(m_out, ack, 1);
+                if (sum != checksum) {
+                    continue;
+                }
+            }
+
+            packet.clear();
+            for (std::size_t i = 0; i < body.size(); ++i) {
+                if (body[i] == '}' && i + 1 < body.size()) {
+                    packet += static_cast<char>(body[++i] ^ 0x20);
+                } else {
+                    packet += body[i];
+                }
+            }
+            return true;
+        }
+
+        char buffer[4096];
+        auto got = read(m_in, buffer, sizeof(buffer));
+        if (got <= 0) {
+            return false;
+        }
+        m_input.append(buffer, got);
+    }
+}
+
+void gdb_server::send_packet(const std::string &data) {
+    std::string packet = "$";
+    packet.reserve(data.size() + 8);
+    uint8_t sum = 0;
+    for (auto c: data) {
+        if (c == '$' || c == '#' || c == '}' || c == '*') {
+            packet += '}';
+            sum += '}';
+            c ^= 0x20;
+        }
+        packet += c;
+        sum += static_cast<uint8_t>(c);
+    }
+    packet += '#';
+    packet += hex_byte(sum);
+
+    for (std::size_t sent = 0; sent < packet.size();) {
+        auto n = write(m_out, packet.data() + sent, packet.size() - sent);
+        if (n <= 0) {
+            return;
+        }
+        sent += n;
+    }
+    //the acknowledgement is read (and skipped) with the next packet
+}
+
+void gdb_server::serve() {
+    m_dbg.m_events.watch_input(m_in, false);
+
+    std::string packet;
+    bool done = false;
+    while (!done && read_packet(packet)) {
+        auto reply = handle_packet(packet, done);
+        send_packet(reply);
+        if (packet == "QStartNoAckMode") {
+            m_ack = false;
+        }
+    }
+}
+
+std::string gdb_server::stop_reply() {
+    if (m_dbg.end_of_program) {
+        return m_dbg.m_exit_signal ? "X" + hex_byte(to_gdb_signal(m_dbg.m_exit_signal)) : "W" + hex_byte(m_dbg.m_exit_code);
+    }
+
+    auto &thread = m_dbg.current_thread();
+    auto signal = m_dbg.m_stop_signal ? m_dbg.m_stop_signal : SIGTRAP;
+    auto reply = "T" + hex_byte(to_gdb_signal(signal)) + "thread:" + hex_number(thread.tid) + ";";
+
+    if (signal == SIGTRAP) {
+        //hardware breakpoints and watchpoints say in DR6 which slot fired
+        auto dr6 = counted_ptrace(PTRACE_PEEKUSER, thread.tid, offsetof(user, u_debugreg) + 6 * sizeof(long), nullptr);
+        for (unsigned i = 0; i < 4; ++i) {
+            if ((dr6 & (1 << i)) && m_slots[i].used) {
+                counted_ptrace(PTRACE_POKEUSER, thread.tid, offsetof(user, u_debugreg) + 6 * sizeof(long), 0);
+                if (m_slots[i].type == 0) {
+                    return reply + "hwbreak:;";
+                }
+                return reply + (m_slots[i].type == 1 ? "watch:" : "awatch:") + hex_number(m_slots[i].addr) + ";";
+            }
+        }
+        //a step that ends on a breakpoint stops before its int3 ran, the client would take it for a hit
+        auto int3 = m_dbg.m_stop_code == SI_KERNEL || m_dbg.m_stop_code == TRAP_BRKPT;
+        auto pc = get_register_value(m_dbg.get_registers(thread), reg::rip);
+        auto bp = m_dbg.m_breakpoints.find(pc);
+        if (int3 && bp != m_dbg.m_breakpoints.end() && bp->second.is_enabled()) {
+            reply += "swbreak:;";
+        }
+    }
+    return reply;
+}
+
+//vCont actions ("c", "C sig", "s", "S sig" with an optional ":tid"), or a plain c/s packet turned into one
+std::string gdb_server::resume(const std::string &actions) {
+    pid_t step_tid = 0;
+    int signal = 0;
+    for (auto &action: split(actions, ';')) {
+        if (action.empty()) {
+            continue;
+        }
+        auto colon = action.find(':');
+        pid_t tid = colon == std::string::npos ? -1 : std::stoi(action.substr(colon + 1), nullptr, 16);
+        auto applies = tid == -1 || tid == m_dbg.m_tid;
+        if ((action[0] == 's' || action[0] == 'S') && (tid > 0 || !step_tid)) {
+            step_tid = tid > 0 ? tid : m_dbg.m_tid;
+        }
+        if ((action[0] == 'C' || action[0] == 'S') && applies) {
+            signal = from_gdb_signal(std::stoi(action.substr(1, 2), nullptr, 16));
+        }
+    }
+
+    //the client decides about the signal of the stop it was told about
+    if (m_dbg.m_threads.count(m_dbg.m_tid)) {
+        m_dbg.current_thread().pending_signal = signal;
+    }
+    m_dbg.m_stop_signal = m_dbg.m_stop_code = 0;
+
+    if (step_tid && m_dbg.m_threads.count(step_tid)) {
+        m_dbg.m_tid = step_tid;
+        auto &thread = m_dbg.current_thread();
+        auto pc = get_register_value(m_dbg.get_registers(thread), reg::rip);
+        if (m_dbg.m_breakpoints.count(pc) && m_dbg.m_breakpoints[pc].is_enabled()) {
+            m_dbg.step_over_breakpoint();
+        } else {
+            m_dbg.resume_thread(thread, PTRACE_SINGLESTEP);
+            m_dbg.wait_for_signal("remote", step_tid);
+        }
+    } else {
+        m_dbg.continue_execution("remote");
+    }
+    return stop_reply();
+}
+
+std::string gdb_server::read_registers() {
+    auto &thread = m_dbg.current_thread();
+    auto &regs = m_dbg.get_registers(thread);
+    user_fpregs_struct fpregs{};
+    counted_ptrace(PTRACE_GETFPREGS, thread.tid, nullptr, &fpregs);
+
+    std::string out;
+    for (auto &r: remote_registers()) {
+        uint8_t value[16]{};
+        if (r.source == reg_source::gp) {
+            std::memcpy(value, reinterpret_cast<const uint8_t *>(&regs) + r.offset, r.size);
+        } else if (r.source == reg_source::fp) {
+            std::memcpy(value, reinterpret_cast<const uint8_t *>(&fpregs) + r.offset, r.size);
+        }
+        out += to_hex(value, r.bits / 8);
+    }
+    return out;
+}
+
+void gdb_server::write_registers(const std::string &hex) {
+    auto data = from_hex(hex);
+    std::size_t offset = 0;
+    for (unsigned n = 0; n < remote_registers().size() && offset < data.size(); ++n) {
+        auto bytes = remote_registers()[n].bits / 8;
+        write_register(n, to_hex(data.data() + offset, std::min<std::size_t>(bytes, data.size() - offset)));
+        offset += bytes;
+    }
+}
+
+std::string gdb_server::read_register(unsigned n) {
+    if (n >= remote_registers().size()) {
+        return "E00";
+    }
+    auto all = read_registers();
+    std::size_t offset = 0;
+    for (unsigned i = 0; i < n; ++i) {
+        offset += remote_registers()[i].bits / 4;
+    }
+    return all.substr(offset, remote_registers()[n].bits / 4);
+}
+
+bool gdb_server::write_register(unsigned n, const std::string &hex) {
+    if (n >= remote_registers().size()) {
+        return false;
+    }
+    auto &r = remote_registers()[n];
+    auto value = from_hex(hex);
+    auto size = std::min(value.size(), r.size);
+
+    auto &thread = m_dbg.current_thread();
+    if (r.source == reg_source::gp) {
+        std::memcpy(reinterpret_cast<uint8_t *>(&m_dbg.get_registers(thread)) + r.offset, value.data(), size);
+        thread.regs_dirty = true;
+    } else if (r.source == reg_source::fp) {
+        user_fpregs_struct fpregs{};
+        counted_ptrace(PTRACE_GETFPREGS, thread.tid, nullptr, &fpregs);
+        std::memcpy(reinterpret_cast<uint8_t *>(&fpregs) + r.offset, value.data(), size);
+        counted_ptrace(PTRACE_SETFPREGS, thread.tid, nullptr, &fpregs);
+    }
+    return true;
+}
+
+//memory as the program sees it, without the int3 of our breakpoints
+std::string gdb_server::read_memory(uint64_t addr, std::size_t len) {
+    std::string data(std::min(len, packet_size), '\0');
+    //code comes from the mapped file, a range that is only partly readable from the process
+    auto got = m_dbg.m_target->read(addr, data.data(), data.size())
+               ? static_cast<ssize_t>(data.size())
+               : read_process_memory(m_dbg.m_pid, addr, data.data(), data.size());
+    if (got <= 0) {
+        return {};
+    }
+    data.resize(got);
+
+    for (auto &[bp_addr, bp]: m_dbg.m_breakpoints) {
+        auto a = static_cast<uint64_t>(bp_addr);
+        if (bp.is_enabled() && a >= addr && a < addr + data.size()) {
+            data[a - addr] = static_cast<char>(bp.get_saved_data());
+        }
+    }
+    return data;
+}
+
+bool gdb_server::write_memory(uint64_t addr, const std::string &data) {
+    //breakpoints under the write are lifted and planted again, so they save the new bytes
+    std::vector<breakpoint *> lifted;
+    for (auto &[bp_addr, bp]: m_dbg.m_breakpoints) {
+        auto a = static_cast<uint64_t>(bp_addr);
+        if (bp.is_enabled() && a >= addr && a < addr + data.size()) {
+            bp.disable();
+            lifted.push_back(&bp);
+        }
+    }
+    auto written = m_dbg.m_target->write(addr, data.data(), data.size());
+    for (auto bp: lifted) {
+        bp->enable();
+    }
+    return written;
+}
+
+std::string gdb_server::target_xml() {
+    std::ostringstream xml;
+    xml << "<?xml version=\"1.0\"?>\n<!DOCTYPE target SYSTEM \"gdb-target.dtd\">\n<target>\n"
+        << "<architecture>i386:x86-64</architecture>\n<osabi>GNU/Linux</osabi>\n";
+
+    std::string feature;
+    unsigned n = 0;
+    for (auto &r: remote_registers()) {
+        if (feature != r.feature) {
+            if (!feature.empty()) {
+                xml << "</feature>\n";
+            }
+            feature = r.feature;
+            xml << "<feature name=\"" << feature << "\">\n";
+            if (feature == "org.gnu.gdb.i386.sse") {
+                xml << "<vector id=\"v4f\" type=\"ieee_single\" count=\"4\"/>\n"
+                    << "<vector id=\"v2d\" type=\"ieee_double\" count=\"2\"/>\n"
+                    << "<vector id=\"v16i8\" type=\"int8\" count=\"16\"/>\n"
+                    << "<vector id=\"v8i16\" type=\"int16\" count=\"8\"/>\n"
+                    << "<vector id=\"v4i32\" type=\"int32\" count=\"4\"/>\n"
+                    << "<vector id=\"v2i64\" type=\"int64\" count=\"2\"/>\n"
+                    << "<union id=\"vec128\"><field name=\"v4_float\" type=\"v4f\"/>"
+                    << "<field name=\"v2_double\" type=\"v2d\"/><field name=\"v16_int8\" type=\"v16i8\"/>"
+                    << "<field name=\"v8_int16\" type=\"v8i16\"/><field name=\"v4_int32\" type=\"v4i32\"/>"
+                    << "<field name=\"v2_int64\" type=\"v2i64\"/><field name=\"uint128\" type=\"uint128\"/></union>\n";
+            }
+        }
+        xml << "<reg name=\"" << r.name << "\" bitsize=\"" << r.bits << "\" type=\"" << r.type << "\" regnum=\""
+            << n++ << "\"/>\n";
+    }
+    xml << "</feature>\n</target>\n";
+    return xml.str();
+}
+
+//qXfer reads: "m" if there is more, "l" with the last piece
+std::string gdb_server::transfer(const std::string &object, const std::string &annex, uint64_t offset,
+                                 std::size_t len) {
+    std::string data;
+    if (object == "features" && annex == "target.xml") {
+        data = target_xml();
+    } else if (object == "auxv") {
+        std::ifstream auxv{"/proc/" + std::to_string(m_dbg.m_pid) + "/auxv", std::ios::binary};
+        data.assign(std::istreambuf_iterator<char>{auxv}, std::istreambuf_iterator<char>{});
+    } else if (object == "exec-file") {
+        char path[PATH_MAX]{};
+        data = realpath(m_dbg.m_prog_name.c_str(), path) ? path : m_dbg.m_prog_name;
+    } else {
+        return "E00";
+    }
+
+    if (offset >= data.size()) {
+        return "l";
+    }
+    len = std::min(len, packet_size - 1);
+    auto piece = data.substr(offset, len);
+    return (offset + piece.size() < data.size() ? "m" : "l") + piece;
+}
+
+void gdb_server::apply_debug_registers() {
+    unsigned long dr7 = 0;
+    for (unsigned i = 0; i < 4; ++i) {
+        if (!m_slots[i].used) {
+            continue;
+        }
+        unsigned len_bits = m_slots[i].len == 8 ? 2 : m_slots[i].len == 4 ? 3 : m_slots[i].len - 1;
+        if (m_slots[i].type == 0) {
+            len_bits = 0;
+        }
+        dr7 |= 1ul << (i * 2);
+        dr7 |= static_cast<unsigned long>(m_slots[i].type | (len_bits << 2)) << (16 + i * 4);
+    }
+
+    //debug registers are per thread
+    for (auto &[tid, thread]: m_dbg.m_threads) {
+        counted_ptrace(PTRACE_POKEUSER, tid, offsetof(user, u_debugreg) + 7 * sizeof(long), 0);
+        for (unsigned i = 0; i < 4; ++i) {
+            if (m_slots[i].used) {
+                counted_ptrace(PTRACE_POKEUSER, tid, offsetof(user, u_debugreg) + i * sizeof(long), m_slots[i].addr);
+            }
+        }
+        counted_ptrace(PTRACE_POKEUSER, tid, offsetof(user, u_debugreg) + 7 * sizeof(long), dr7);
+    }
+}
+
+bool gdb_server::set_hw_point(unsigned type, uint64_t addr, unsigned len, bool insert) {
+    if (len != 1 && len != 2 && len != 4 && len != 8) {
+        return false;
+    }
+    for (auto &slot: m_slots) {
+        if (insert ? !slot.used : slot.used && slot.addr == addr && slot.type == type) {
+            slot = hw_slot{insert, addr, type, len};
+            apply_debug_registers();
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string gdb_server::handle_packet(const std::string &packet, bool &done) {
+    if (packet.empty()) {
+        return "";
+    }
+
+    try {
+        auto args = packet.substr(1);
+        switch (packet[0]) {
+            case '?':
+                return stop_reply();
+            case 'g':
+                return read_registers();
+            case 'G':
+                write_registers(args);
+                return "OK";
+            case 'p':
+                return read_register(std::stoul(args, nullptr, 16));
+            case 'P': {
+                auto eq = args.find('=');
+                return write_register(std::stoul(args.substr(0, eq), nullptr, 16), args.substr(eq + 1)) ? "OK" : "E00";
+            }
+            case 'm':
+            case 'x': {
+                uint64_t addr, len;
+                parse_address(args, addr, len);
+                auto data = read_memory(addr, len);
+                if (data.empty() && len) {
+                    return "E01";
+                }
+                return packet[0] == 'm' ? to_hex(data.data(), data.size()) : "b" + data;
+            }
+            case 'M':
+            case 'X': {
+                uint64_t addr, len;
+                parse_address(args, addr, len);
+                auto payload = args.substr(args.find(':') + 1);
+                auto data = packet[0] == 'M' ? from_hex(payload) : payload;
+                return write_memory(addr, data.substr(0, len)) ? "OK" : "E01";
+            }
+            case 'c':
+                return resume("c");
+            case 'C':
+                return resume("C" + args.substr(0, 2));
+            case 's':
+                return resume("s");
+            case 'S':
+                return resume("S" + args.substr(0, 2));
+            case 'H': {
+                auto tid = std::stol(args.substr(1), nullptr, 16);
+                if (tid > 0 && m_dbg.m_threads.count(tid)) {
+                    m_dbg.m_tid = tid;
+                }
+                return "OK";
+            }
+            case 'T':
+                return m_dbg.m_threads.count(std::stol(args, nullptr, 16)) ? "OK" : "E01";
+            case 'Z':
+            case 'z': {
+                auto insert = packet[0] == 'Z';
+                uint64_t addr, kind;
+                parse_address(args.substr(2), addr, kind);
+                switch (args[0]) {
+                    case '0':
+                        if (insert && !m_dbg.m_breakpoints.count(addr)) {
+                            m_dbg.set_breakpoint_at_address(addr, "show");
+                        } else if (!insert && m_dbg.m_breakpoints.count(addr)) {
+                            m_dbg.remove_breakpoint(addr);
+                        }
+                        return "OK";
+                    case '1':
+                        return set_hw_point(0, addr, 1, insert) ? "OK" : "E01";
+                    case '2':
+                    case '4':
+                        //DR7 lengths, and the CPU ignores the address bits below the length
+                        if ((kind != 1 && kind != 2 && kind != 4 && kind != 8) || addr % kind) {
+                            return "E22";
+                        }
+                        return set_hw_point(args[0] == '2' ? 1 : 3, addr, kind, insert) ? "OK" : "E01";
+                    default:
+                        return ""; //x86 has no read-only watchpoints
+                }
+            }
+            case 'k':
+                kill(m_dbg.m_pid, SIGKILL);
+                while (waitpid(-1, nullptr, __WALL | __WNOTHREAD) > 0) {
+                }
+                m_dbg.end_of_program = true;
+                done = true;
+                return "OK";
+            case 'D':
+                m_dbg.detach();
+                done = true;
+                return "OK";
+            case 'v':
+                if (packet == "vCont?") {
+                    return "vCont;c;C;s;S";
+                }
+                if (is_prefix("vCont;", packet)) {
+                    return resume(packet.substr(6));
+                }
+                if (packet == "vMustReplyEmpty") {
+                    return "";
+                }
+                return "";
+            case 'q':
+            case 'Q':
+                break;
+            default:
+                return "";
+        }
+
+        if (is_prefix("qSupported", packet)) {
+            return "PacketSize=" + hex_number(packet_size) +
+                   ";qXfer:features:read+;qXfer:auxv:read+;qXfer:exec-file:read+;QStartNoAckMode+;"
+                   "swbreak+;hwbreak+;binary-upload+;vContSupported+";
+        }
+        if (packet == "QStartNoAckMode") {
+            return "OK"; //acknowledgements stop once this reply is sent
+        }
+        if (is_prefix("qXfer:", packet)) {
+            //qXfer:object:read:annex:offset,length
+            auto parts = split(packet, ':');
+            if (parts.size() < 5 || parts[2] != "read") {
+                return "";
+            }
+            uint64_t offset, len;
+            parse_address(parts[4], offset, len);
+            return transfer(parts[1], parts[3], offset, len);
+        }
+        if (packet == "qC") {
+            return "QC" + hex_number(m_dbg.m_tid);
+        }
+        if (packet == "qfThreadInfo") {
+            std::string reply = "m";
+            for (auto &[tid, thread]: m_dbg.m_threads) {
+                reply += (reply.size() > 1 ? "," : "") + hex_number(tid);
+            }
+            return reply;
+        }
+        if (packet == "qsThreadInfo") {
+            return "l";
+        }
+        if (packet == "qAttached") {
+            return m_dbg.m_attached ? "1" : "0";
+        }
+        if (is_prefix("qSymbol", packet)) {
+            return "OK";
+        }
+        return "";
+    } catch (std::exception &) {
+        return "E02";
+    }
+}
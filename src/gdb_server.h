@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class debugger;
+
+//Serves the GDB remote serial protocol on top of the ptrace engine, so gdb, lldb or an IDE can
+//drive the debugger with "target remote". Memory travels in binary x/X packets of up to
+//packet_size bytes, each read with a single process_vm_readv.
+class gdb_server {
+public:
+    static constexpr std::size_t packet_size = 0x20000;
+
+    //from here on the output of the engine goes to stderr, stdout may carry the packets
+    gdb_server(debugger &dbg, int in, int out);
+
+    //"stdio" or the path of a unix socket to listen on, false if it cannot be opened
+    static bool open_connection(const std::string &target, int &in, int &out);
+
+    //returns once gdb detaches, kills the program or closes the connection
+    void serve();
+
+private:
+    struct hw_slot {
+        bool used = false;
+        uint64_t addr = 0;
+        unsigned type = 0; //DR7 R/W bits: 0 execute, 1 write, 3 access
+        unsigned len = 1;
+    };
+
+    bool read_packet(std::string &packet);
+
+    void send_packet(const std::string &data);
+
+    std::string handle_packet(const std::string &packet, bool &done);
+
+    std::string stop_reply();
+
+    std::string resume(const std::string &actions);
+
+    std::string read_registers();
+
+    void write_registers(const std::string &hex);
+
+    std::string read_register(unsigned n);
+
+    bool write_register(unsigned n, const std::string &hex);
+
+    std::string read_memory(uint64_t addr, std::size_t len);
+
+    bool write_memory(uint64_t addr, const std::string &data);
+
+    std::string target_xml();
+
+    std::string transfer(const std::string &object, const std::string &annex, uint64_t offset, std::size_t len);
+
+    bool set_hw_point(unsigned type, uint64_t addr, unsigned len, bool insert);
+
+    void apply_debug_registers();
+
+    debugger &m_dbg;
+    int m_in;
+    int m_out;
+    bool m_ack = true;
+    std::string m_input;
+    hw_slot m_slots[4];
+};
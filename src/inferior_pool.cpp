@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <csignal>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+#include "linenoise/linenoise.h"
+#include "inferior_pool.h"
+#include "utility.h"
+
+inferior_pool::inferior_pool(std::string prog_name, std::vector<pid_t> pids)
+        : m_prog_name{std::move(prog_name)}, m_image{std::make_shared<const program_image>(m_prog_name)} {
+    //blocked before any thread starts, so every thread inherits the mask and only the signal thread reads them
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGINT);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    m_signal_fd = signalfd(-1, &mask, SFD_CLOEXEC);
+    m_stop_fd = eventfd(0, EFD_CLOEXEC);
+
+    unsigned number = 1;
+    for (auto pid: pids) {
+        auto inf = std::make_unique<inferior>();
+        inf->number = number++;
+        inf->pid = pid;
+        m_inferiors.push_back(std::move(inf));
+    }
+    m_current = m_inferiors.front().get();
+
+    for (auto &inf: m_inferiors) {
+        inf->thread = std::thread{&inferior_pool::serve, this, std::ref(*inf)};
+    }
+    m_signals = std::thread{&inferior_pool::signal_thread, this};
+
+    //attaching happens in parallel, wait until every inferior is either ready or gone
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_changed.wait(lock, [this]() {
+        return std::all_of(m_inferiors.begin(), m_inferiors.end(), [](auto &&i) { return i->dbg || i->finished; });
+    });
+}
+
+inferior_pool::~inferior_pool() {
+    uint64_t one = 1;
+    write(m_stop_fd, &one, sizeof(one));
+    m_signals.join();
+    for (auto &inf: m_inferiors) {
+        inf->thread.join();
+    }
+    close(m_signal_fd);
+    close(m_stop_fd);
+}
+
+void inferior_pool::print(const inferior &inf, const std::string &text) {
+    std::istringstream lines{text};
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::cout << '[' << inf.number << "] " << line << '\n';
+    }
+    std::cout << std::flush;
+}
+
+void inferior_pool::serve(inferior &inf) {
+    debugger dbg{m_prog_name, m_image, inf.pid, true};
+    dbg.attach();
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        inf.dbg = dbg.finished() ? nullptr : &dbg;
+        inf.finished = dbg.finished();
+    }
+    m_changed.notify_all();
+
+    dbg.serve([this, &inf](const std::string &output, bool command_done) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        print(inf, output);
+        if (command_done) {
+            ++inf.completed;
+            m_changed.notify_all();
+        }
+    });
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        inf.dbg = nullptr;
+        inf.finished = true;
+    }
+    m_changed.notify_all();
+}
+
+//SIGCHLD does not tell which tracer thread it is for, so every inferior polls its own tracees
+void inferior_pool::signal_thread() {
+    auto epoll = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    for (auto fd: {m_signal_fd, m_stop_fd}) {
+        ev.data.fd = fd;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    while (true) {
+        epoll_event event;
+        if (epoll_wait(epoll, &event, 1, -1) <= 0) {
+            continue;
+        }
+        if (event.data.fd == m_stop_fd) {
+            break;
+        }
+
+        signalfd_siginfo info;
+        if (read(m_signal_fd, &info, sizeof(info)) != sizeof(info)) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock{m_mutex};
+        for (auto &inf: m_inferiors) {
+            if (!inf->dbg) {
+                continue;
+            }
+            if (info.ssi_signo == SIGINT) {
+                inf->dbg->events().request_interrupt();
+            } else {
+                inf->dbg->events().notify();
+            }
+        }
+    }
+    close(epoll);
+}
+
+std::vector<inferior_pool::inferior *> inferior_pool::select(const std::string &selector) {
+    std::vector<inferior *> targets;
+    if (selector == "all") {
+        for (auto &inf: m_inferiors) {
+            targets.push_back(inf.get());
+        }
+        return targets;
+    }
+    for (auto &number: split(selector, ',')) {
+        auto n = std::stoul(number);
+        if (n == 0 || n > m_inferiors.size()) {
+            throw std::out_of_range{"No inferior " + number};
+        }
+        targets.push_back(m_inferiors[n - 1].get());
+    }
+    return targets;
+}
+
+void inferior_pool::execute(const std::vector<inferior *> &targets, const std::string &line) {
+    std::vector<std::pair<inferior *, unsigned>> waiting;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        for (auto inf: targets) {
+            if (!inf->dbg) {
+                std::cout << '[' << inf->number << "] The process is not being debugged" << std::endl;
+                continue;
+            }
+            waiting.emplace_back(inf, ++inf->posted);
+            inf->dbg->events().post(line);
+        }
+    }
+
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_changed.wait(lock, [&waiting]() {
+        return std::all_of(waiting.begin(), waiting.end(), [](auto &&w) {
+            return w.first->finished || w.first->completed >= w.second;
+        });
+    });
+}
+
+void inferior_pool::print_inferiors() {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    for (auto &inf: m_inferiors) {
+        std::cout << (inf.get() == m_current ? "* " : "  ") << std::dec << inf->number << "  process " << inf->pid
+                  << (inf->finished ? "  <exited or detached>" : "") << std::endl;
+    }
+}
+
+void inferior_pool::handle_command(const std::string &line) {
+    auto args = split(line, ' ');
+    if (args.empty()) {
+        return;
+    }
+
+    if (args[0][0] == '@') {
+        auto rest = line.substr(line.find(' ') == std::string::npos ? line.size() : line.find(' ') + 1);
+        execute(select(args[0].substr(1)), rest);
+    } else if (args[0] == "inferior") {
+        if (args.size() > 1) {
+            m_current = select(args[1]).front();
+        }
+        std::cout << "Current inferior is " << m_current->number << " (process " << m_current->pid << ")" << std::endl;
+    } else if (is_prefix(args[0], "inferiors")) {
+        print_inferiors();
+    } else {
+        execute({m_current}, line);
+    }
+}
+
+void inferior_pool::run() {
+    std::cout << "Debugging " << m_inferiors.size() << " processes of " << m_prog_name << std::endl;
+
+    char *line = nullptr;
+    while ((line = linenoise("MEGAdbg> ")) != nullptr) {
+        try {
+            handle_command(line);
+        } catch (std::exception &e) {
+            std::cerr << e.what() << std::endl;
+        }
+        linenoiseHistoryAdd(line);
+        linenoiseFree(line);
+
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (std::all_of(m_inferiors.begin(), m_inferiors.end(), [](auto &&i) { return i->finished; })) {
+            break;
+        }
+    }
+
+    //leaving processes traced would kill them on their next breakpoint
+    std::vector<inferior *> attached;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        for (auto &inf: m_inferiors) {
+            if (!inf->finished) {
+                attached.push_back(inf.get());
+            }
+        }
+    }
+    execute(attached, "detach");
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "debugger.h"
+#include "program_image.h"
+
+//Debugs several processes of one program at once. Each inferior has its own debugger state and is
+//served by its own thread, since ptrace requests are only accepted from the thread that attached;
+//the DWARF/ELF index is built once and shared read-only. A signal thread fans SIGCHLD and Ctrl-C
+//out to the inferiors. Commands go to the selected inferior, "@all cmd" or "@1,3 cmd" runs cmd
+//on several of them in parallel.
+class inferior_pool {
+public:
+    inferior_pool(std::string prog_name, std::vector<pid_t> pids);
+
+    ~inferior_pool();
+
+    void run();
+
+private:
+    struct inferior {
+        unsigned number;
+        pid_t pid;
+        std::thread thread;
+        debugger *dbg = nullptr; //owned by the thread, valid while it runs
+        bool finished = false;
+        unsigned posted = 0;
+        unsigned completed = 0;
+    };
+
+    void serve(inferior &inf);
+
+    void signal_thread();
+
+    void handle_command(const std::string &line);
+
+    //posts line to every selected inferior and waits for all of them to complete it
+    void execute(const std::vector<inferior *> &targets, const std::string &line);
+
+    std::vector<inferior *> select(const std::string &selector);
+
+    void print_inferiors();
+
+    void print(const inferior &inf, const std::string &text);
+
+    std::string m_prog_name;
+    std::shared_ptr<const program_image> m_image;
+    std::vector<std::unique_ptr<inferior>> m_inferiors;
+    inferior *m_current = nullptr;
+
+    std::mutex m_mutex; //guards the inferior states and the output
+    std::condition_variable m_changed;
+
+    std::thread m_signals;
+    int m_signal_fd = -1;
+    int m_stop_fd = -1;
+};
@@ -0,0 +1,109 @@
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <elf.h>
+#include <link.h>
+
+#include "library_tracker.h"
+
+namespace {
+    //strings are read in small pieces, the end of the name may be near the end of a mapping
+    std::string read_string(target &process, uint64_t address) {
+        std::string s;
+        char chunk[64];
+        while (s.size() < PATH_MAX && process.read(address + s.size(), chunk, sizeof(chunk))) {
+            for (auto c: chunk) {
+                if (c == '\0') {
+                    return s;
+                }
+                s += c;
+            }
+        }
+        return s;
+    }
+}
+
+bool library_tracker::start(pid_t pid, module_table &modules) {
+    std::ifstream auxv{"/proc/" + std::to_string(pid) + "/auxv", std::ios::binary};
+    uint64_t entry[2];
+    uint64_t base = 0;
+    while (auxv.read(reinterpret_cast<char *>(entry), sizeof(entry)) && entry[0] != AT_NULL) {
+        if (entry[0] == AT_BASE) {
+            base = entry[1];
+        }
+    }
+
+    auto linker = base ? modules.find(base) : nullptr;
+    if (!linker) {
+        return false;
+    }
+    auto r_debug = linker->symbol_address("_r_debug");
+    auto r_brk = linker->symbol_address("_dl_debug_state");
+    if (!r_debug || !r_brk) {
+        return false;
+    }
+
+    m_r_debug = r_debug;
+    m_breakpoint = breakpoint{pid, static_cast<std::intptr_t>(r_brk)};
+    m_breakpoint.enable();
+    return true;
+}
+
+std::vector<std::string> library_tracker::update(target &process) {
+    r_debug debug{};
+    if (!process.read(m_r_debug, &debug, sizeof(debug)) || debug.r_state != r_debug::RT_CONSISTENT) {
+        return {};
+    }
+
+    std::vector<std::string> added;
+    std::set<std::string> loaded;
+    link_map entry{};
+    auto address = reinterpret_cast<uint64_t>(debug.r_map);
+    //the main program has an empty name and the vDSO one that is not a file
+    for (std::size_t n = 0; address && n < 65536; ++n, address = reinterpret_cast<uint64_t>(entry.l_next)) {
+        if (!process.read(address, &entry, sizeof(entry))) {
+            break;
+        }
+        auto name = read_string(process, reinterpret_cast<uint64_t>(entry.l_name));
+        char path[PATH_MAX];
+        if (name.empty() || !realpath(name.c_str(), path)) {
+            continue;
+        }
+        if (loaded.insert(path).second && !m_loaded.count(path)) {
+            added.emplace_back(path);
+        }
+    }
+    m_loaded.swap(loaded);
+    return added;
+}
+
+void library_tracker::move_to(pid_t pid) {
+    if (!active()) {
+        return;
+    }
+    auto enabled = m_breakpoint.is_enabled();
+    m_breakpoint = breakpoint{pid, m_breakpoint.get_address()};
+    if (enabled) {
+        m_breakpoint.enable();
+    }
+}
+
+void library_tracker::original_bytes(std::map<uint64_t, uint8_t> &out) const {
+    if (active() && m_breakpoint.is_enabled()) {
+        out[m_breakpoint.get_address()] = m_breakpoint.get_saved_data();
+    }
+}
+
+void library_tracker::overlay(uint64_t address, uint8_t *buffer, std::size_t size) const {
+    auto addr = static_cast<uint64_t>(m_breakpoint.get_address());
+    if (active() && m_breakpoint.is_enabled() && addr >= address && addr < address + size) {
+        buffer[addr - address] = 0xcc;
+    }
+}
+
+void library_tracker::stop() {
+    if (active() && m_breakpoint.is_enabled()) {
+        m_breakpoint.disable();
+    }
+    m_r_debug = 0;
+}
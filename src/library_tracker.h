@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "breakpoint.h"
+#include "module.h"
+#include "target.h"
+
+//follows the shared libraries of a process through the r_debug protocol of the dynamic linker:
+//an internal breakpoint on _dl_debug_state (r_brk) is hit after every change of the link_map list
+class library_tracker {
+public:
+    //plants the breakpoint in the dynamic linker found through AT_BASE, false for static programs.
+    //modules must already hold the mappings of the process.
+    bool start(pid_t pid, module_table &modules);
+
+    bool active() const { return m_r_debug != 0; }
+
+    //whether addr is the internal breakpoint
+    bool is_event(uint64_t addr) const { return active() && addr == static_cast<uint64_t>(m_breakpoint.get_address()); }
+
+    //walks link_map and returns the real paths of the libraries that were not loaded at the
+    //previous call, nothing while the dynamic linker is in the middle of a change
+    std::vector<std::string> update(target &process);
+
+    //lifts and plants the breakpoint, the thread at it is stepped in between
+    void disable() { m_breakpoint.disable(); }
+
+    void enable() { m_breakpoint.enable(); }
+
+    //the breakpoint lives on in process pid, a copy of the traced one
+    void move_to(pid_t pid);
+
+    //adds the original bytes under the breakpoint
+    void original_bytes(std::map<uint64_t, uint8_t> &out) const;
+
+    //writes the int3 into buffer, a copy of the original code at address
+    void overlay(uint64_t address, uint8_t *buffer, std::size_t size) const;
+
+    //lifts the breakpoint, before detaching
+    void stop();
+
+private:
+    breakpoint m_breakpoint{0, 0};
+    uint64_t m_r_debug = 0;
+    std::set<std::string> m_loaded;
+};
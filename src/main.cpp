@@ -1,20 +1,48 @@
+#include <csignal>
 #include <sys/ptrace.h>
 #include <sys/wait.h>
 #include <sys/personality.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <iostream>
+#include <fstream>
 
 #include "parser.h"
 #include "debugger.h"
+#include "pstack.h"
+#include "perf_sampler.h"
+#include "inferior_pool.h"
+#include "gdb_server.h"
+#include "target.h"
+#include "syscall_tracer.h"
+#include "utility.h"
 
-void execute_debugee(const std::string &prog_name) {
+void execute_debugee(const std::string &prog_name, const std::vector<long> &syscalls) {
     if (ptrace(PTRACE_TRACEME, 0, 0, 0) < 0) {
         std::cerr << "Error in ptrace\n";
         return;
     }
+    //the tracer has to enable seccomp stops before the filter meets the execve below
+    if (!syscalls.empty() && raise(SIGSTOP) != 0) {
+        return;
+    }
+    if (!syscalls.empty() && !syscall_tracer::install_filter(syscalls)) {
+        std::cerr << "Cannot install the seccomp filter\n";
+        return;
+    }
     execl(prog_name.c_str(), prog_name.c_str(), nullptr);
 }
 
+//the prompt, or the commands of the script in batch mode
+int run_commands(debugger &dbg, ArgParser &args, std::istream &script) {
+    dbg.set_timing(args.getTime());
+    if (args.getBatch()) {
+        return dbg.run_script(script);
+    }
+    dbg.run();
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
     ArgParser args(argc, argv);
     if (!args.parse()) {
@@ -23,15 +51,124 @@ int main(int argc, char *argv[]) {
 
     auto prog = args.getProgName();
 
+    if (args.getMode() == Mode::pstack) {
+        return run_pstack(args.getPid());
+    }
+    if (args.getMode() == Mode::perf) {
+        return run_perf_sampler(prog, args.getPid(), args.getHz(), args.getDuration());
+    }
+
+    if (args.getPids().size() > 1) {
+        inferior_pool pool{prog, args.getPids()};
+        pool.run();
+        return 0;
+    }
+
+    std::ifstream script_file;
+    if (!args.getScript().empty()) {
+        script_file.open(args.getScript());
+        if (!script_file) {
+            std::cerr << "Cannot open " << args.getScript() << '\n';
+            return 1;
+        }
+    }
+    std::istream &script = args.getScript().empty() ? std::cin : script_file;
+
+    if (!args.getCore().empty()) {
+        std::unique_ptr<core_target> core;
+        try {
+            core = std::make_unique<core_target>(args.getCore());
+        } catch (std::exception &e) {
+            std::cerr << "Cannot read core " << args.getCore() << ": " << e.what() << '\n';
+            return 1;
+        }
+        debugger dbg{prog, std::move(core)};
+        return run_commands(dbg, args, script);
+    }
+
+    int remote_in = -1;
+    int remote_out = -1;
+    if (args.getMode() == Mode::gdbserver && !gdb_server::open_connection(args.getRemote(), remote_in, remote_out)) {
+        std::cerr << "Cannot listen on " << args.getRemote() << '\n';
+        return 1;
+    }
+
+    if (args.getPid() > 0) {
+        //the debug info is indexed before the target is touched, so it is stopped only for the attach itself
+        debugger dbg{prog, args.getPid()};
+        if (args.getMode() == Mode::gdbserver) {
+            gdb_server server{dbg, remote_in, remote_out};
+            dbg.attach();
+            server.serve();
+            return 0;
+        }
+        dbg.attach();
+        if (args.getMode() == Mode::profile) {
+            try {
+                dbg.profile(args.getHz(), args.getDuration(), args.getOutput());
+            } catch (std::runtime_error &e) {
+                std::cerr << "Error: " << e.what() << '\n';
+                dbg.detach();
+                return 1;
+            }
+            dbg.detach();
+        } else if (args.getMode() == Mode::coverage) {
+            dbg.coverage(args.getOutput());
+        } else {
+            return run_commands(dbg, args, script);
+        }
+        return 0;
+    }
+
+    std::vector<long> syscalls;
+    if (args.getMode() == Mode::syscalls) {
+        for (auto &name: split(args.getSyscalls(), ',')) {
+            auto nr = syscall_number(name);
+            if (nr < 0) {
+                std::cerr << "Unknown syscall " << name << '\n';
+                return 1;
+            }
+            syscalls.push_back(nr);
+        }
+    }
+
     auto pid = fork();
     if (pid == 0) {
         //child
         personality(ADDR_NO_RANDOMIZE);
-        execute_debugee(prog);
+        if (remote_out == STDOUT_FILENO) {
+            //stdin and stdout carry the remote protocol
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+            auto null = open("/dev/null", O_RDONLY);
+            dup2(null, STDIN_FILENO);
+        }
+        execute_debugee(prog, syscalls);
     } else if (pid >= 1) {
         //parent
-        std::cout << "Started debugging process " << pid << '\n';
+        (args.getMode() == Mode::gdbserver ? std::cerr : std::cout) << "Started debugging process " << pid << '\n';
+        if (!syscalls.empty() && !syscall_tracer::prepare_launch(pid, PTRACE_O_TRACESECCOMP, syscalls)) {
+            std::cerr << "Cannot launch " << prog << " with the seccomp filter\n";
+            return 1;
+        }
         debugger dbg{prog, pid};
-        dbg.run();
+        if (args.getMode() == Mode::profile) {
+            dbg.initialise();
+            try {
+                dbg.profile(args.getHz(), args.getDuration(), args.getOutput());
+            } catch (std::runtime_error &e) {
+                std::cerr << "Error: " << e.what() << '\n';
+                return 1;
+            }
+        } else if (args.getMode() == Mode::coverage) {
+            dbg.coverage(args.getOutput());
+        } else if (args.getMode() == Mode::syscalls) {
+            dbg.trace_syscalls(args.getOutput());
+        } else if (args.getMode() == Mode::gdbserver) {
+            gdb_server server{dbg, remote_in, remote_out};
+            dbg.initialise();
+            server.serve();
+        } else {
+            return run_commands(dbg, args, script);
+        }
     }
 }
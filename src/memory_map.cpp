@@ -0,0 +1,42 @@
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "memory_map.h"
+
+std::vector<mapping> read_memory_maps(pid_t pid) {
+    std::vector<mapping> maps;
+    std::ifstream file("/proc/" + std::to_string(pid) + "/maps");
+    std::string line;
+
+    //e.g. 555555554000-555555555000 r--p 00000000 08:01 1234   /usr/bin/prog
+    while (std::getline(file, line)) {
+        std::istringstream ss{line};
+        std::string range, perms, offset, dev;
+        mapping m{};
+
+        ss >> range >> perms >> offset >> dev >> m.inode;
+        auto dash = range.find('-');
+        m.start = std::stoull(range.substr(0, dash), nullptr, 16);
+        m.end = std::stoull(range.substr(dash + 1), nullptr, 16);
+        m.readable = perms[0] == 'r';
+        m.writable = perms[1] == 'w';
+        m.executable = perms[2] == 'x';
+        m.offset = std::stoull(offset, nullptr, 16);
+
+        std::getline(ss >> std::ws, m.path);
+        maps.push_back(std::move(m));
+    }
+
+    return maps;
+}
+
+const mapping *find_mapping(const std::vector<mapping> &maps, uint64_t addr) {
+    auto it = std::upper_bound(maps.begin(), maps.end(), addr,
+                               [](uint64_t addr, auto &&m) { return addr < m.start; });
+    if (it == maps.begin()) {
+        return nullptr;
+    }
+    --it;
+    return it->contains(addr) ? &*it : nullptr;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+//one line of /proc/pid/maps
+struct mapping {
+    uint64_t start;
+    uint64_t end;
+    bool readable;
+    bool writable;
+    bool executable;
+    uint64_t offset;
+    uint64_t inode;
+    std::string path;
+
+    bool contains(uint64_t addr) const { return start <= addr && addr < end; }
+};
+
+std::vector<mapping> read_memory_maps(pid_t pid);
+
+const mapping *find_mapping(const std::vector<mapping> &maps, uint64_t addr);
@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <immintrin.h>
+
+#include "memory_search.h"
+
+namespace {
+    //a chunk is read and searched at once, matches may start in its last bytes and end in the next one
+    constexpr std::size_t chunk_size = 8 << 20;
+    constexpr std::size_t max_workers = 16;
+
+    //one hex digit or ? into value and mask
+    void parse_nibble(char c, uint8_t &value, uint8_t &mask) {
+        if (c == '?') {
+            value = 0;
+            mask = 0;
+        } else if (std::isxdigit(static_cast<unsigned char>(c))) {
+            value = std::isdigit(static_cast<unsigned char>(c)) ? c - '0' : std::tolower(c) - 'a' + 10;
+            mask = 0xf;
+        } else {
+            throw std::runtime_error{std::string{"Not a hex digit: "} + c};
+        }
+    }
+
+    void parse_bytes(const std::string &text, search_pattern &pattern) {
+        std::string digits;
+        std::copy_if(text.begin(), text.end(), std::back_inserter(digits),
+                     [](char c) { return !std::isspace(static_cast<unsigned char>(c)); });
+        if (digits.empty() || digits.size() % 2 != 0) {
+            throw std::runtime_error{"Expected pairs of hex digits: " + text};
+        }
+        for (std::size_t i = 0; i < digits.size(); i += 2) {
+            uint8_t high, high_mask, low, low_mask;
+            parse_nibble(digits[i], high, high_mask);
+            parse_nibble(digits[i + 1], low, low_mask);
+            pattern.bytes.push_back(high << 4 | low);
+            pattern.mask.push_back(high_mask << 4 | low_mask);
+        }
+    }
+
+    void parse_string(const std::string &text, search_pattern &pattern) {
+        if (text.size() < 2 || text.back() != '"') {
+            throw std::runtime_error{"Unterminated string: " + text};
+        }
+        for (std::size_t i = 1; i + 1 < text.size(); ++i) {
+            auto c = text[i];
+            if (c == '\\' && i + 2 < text.size()) {
+                switch (text[++i]) {
+                    case 'n': c = '\n'; break;
+                    case 't': c = '\t'; break;
+                    case '0': c = '\0'; break;
+                    default: c = text[i]; break;
+                }
+            }
+            pattern.bytes.push_back(c);
+            pattern.mask.push_back(0xff);
+        }
+        if (pattern.bytes.empty()) {
+            throw std::runtime_error{"Empty search string"};
+        }
+    }
+
+    void parse_integer(const std::string &text, search_pattern &pattern) {
+        auto colon = text.find(':');
+        auto number = text.substr(0, colon);
+        uint64_t value = 0;
+        uint64_t mask = ~uint64_t{0};
+        std::size_t size;
+
+        if (number.size() > 2 && number[0] == '0' && (number[1] == 'x' || number[1] == 'X')) {
+            auto digits = number.substr(2);
+            if (digits.size() > 16) {
+                throw std::out_of_range{"Integer does not fit in 8 bytes: " + number};
+            }
+            mask = 0;
+            for (auto c: digits) {
+                uint8_t nibble, nibble_mask;
+                parse_nibble(c, nibble, nibble_mask);
+                value = value << 4 | nibble;
+                mask = mask << 4 | nibble_mask;
+            }
+            //the leading digits that were not written are zero
+            mask |= digits.size() < 16 ? ~uint64_t{0} << 4 * digits.size() : 0;
+            size = digits.size() <= 8 ? 4 : 8;
+        } else {
+            std::size_t used = 0;
+            auto negative = !number.empty() && number[0] == '-';
+            value = negative ? static_cast<uint64_t>(std::stoll(number, &used)) : std::stoull(number, &used);
+            if (used != number.size()) {
+                throw std::runtime_error{"Not an integer: " + number};
+            }
+            auto fits_32 = negative ? static_cast<int64_t>(value) >= INT32_MIN : value <= UINT32_MAX;
+            size = fits_32 ? 4 : 8;
+        }
+
+        if (colon != std::string::npos) {
+            size = std::stoul(text.substr(colon + 1));
+            if (size != 1 && size != 2 && size != 4 && size != 8) {
+                throw std::runtime_error{"The size of an integer is 1, 2, 4 or 8 bytes"};
+            }
+        }
+        if (size < 8) {
+            //the bits above the size are either all zero or, for a negative number, all one
+            auto high = static_cast<int64_t>(value) >> (8 * size - 1);
+            if ((value >> 8 * size) != 0 && high != -1) {
+                throw std::out_of_range{"Integer does not fit in " + std::to_string(size) + " bytes: " + number};
+            }
+        }
+
+        for (std::size_t i = 0; i < size; ++i) {
+            pattern.bytes.push_back(value >> 8 * i);
+            pattern.mask.push_back(mask >> 8 * i);
+        }
+    }
+
+    struct matcher {
+        const uint8_t *bytes;
+        const uint8_t *mask;
+        std::size_t size;
+        bool exact;        //no wildcards, a memcmp
+        bool filtered;     //there is a byte that is matched in full, the anchor
+        std::size_t anchor;
+        std::size_t second; //the byte after the anchor if it is matched in full as well, else the anchor
+
+        explicit matcher(const search_pattern &pattern)
+                : bytes{pattern.bytes.data()}, mask{pattern.mask.data()}, size{pattern.bytes.size()},
+                  exact{std::all_of(pattern.mask.begin(), pattern.mask.end(), [](uint8_t m) { return m == 0xff; })},
+                  filtered{false}, anchor{0}, second{0} {
+            //a pair of bytes rules out far more positions than a single one
+            for (std::size_t i = 0; i < size; ++i) {
+                if (mask[i] != 0xff) {
+                    continue;
+                }
+                if (!filtered) {
+                    filtered = true;
+                    anchor = second = i;
+                }
+                if (i + 1 < size && mask[i + 1] == 0xff) {
+                    anchor = i;
+                    second = i + 1;
+                    break;
+                }
+            }
+        }
+
+        bool at(const uint8_t *p) const {
+            if (exact) {
+                return std::memcmp(p, bytes, size) == 0;
+            }
+            for (std::size_t i = 0; i < size; ++i) {
+                if ((p[i] & mask[i]) != bytes[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    //counts every match, keeps the addresses of the first limit ones
+    struct hit_sink {
+        std::vector<uint64_t> &matches;
+        uint64_t base;
+        std::size_t limit;
+        std::size_t count = 0;
+
+        void add(std::size_t offset) {
+            ++count;
+            if (matches.size() < limit) {
+                matches.push_back(base + offset);
+            }
+        }
+    };
+
+    //the positions from first on compared one at a time
+    void scan_tail(const uint8_t *data, std::size_t first, std::size_t positions, const matcher &m, hit_sink &sink) {
+        for (auto i = first; i < positions; ++i) {
+            if (m.at(data + i)) {
+                sink.add(i);
+            }
+        }
+    }
+
+    //data holds positions + size - 1 bytes, a match may start at any of the positions
+    void scan_sse2(const uint8_t *data, std::size_t positions, const matcher &m, hit_sink &sink) {
+        std::size_t i = 0;
+        if (m.filtered) {
+            auto first = _mm_set1_epi8(static_cast<char>(m.bytes[m.anchor]));
+            auto second = _mm_set1_epi8(static_cast<char>(m.bytes[m.second]));
+            for (; i + 16 <= positions; i += 16) {
+                auto eq = _mm_and_si128(
+                        _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + m.anchor)), first),
+                        _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + m.second)), second));
+                for (unsigned bits = _mm_movemask_epi8(eq); bits; bits &= bits - 1) {
+                    auto pos = i + __builtin_ctz(bits);
+                    if (m.at(data + pos)) {
+                        sink.add(pos);
+                    }
+                }
+            }
+        }
+        scan_tail(data, i, positions, m, sink);
+    }
+
+    __attribute__((target("avx2")))
+    void scan_avx2(const uint8_t *data, std::size_t positions, const matcher &m, hit_sink &sink) {
+        std::size_t i = 0;
+        if (m.filtered) {
+            auto first = _mm256_set1_epi8(static_cast<char>(m.bytes[m.anchor]));
+            auto second = _mm256_set1_epi8(static_cast<char>(m.bytes[m.second]));
+            for (; i + 32 <= positions; i += 32) {
+                auto eq = _mm256_and_si256(
+                        _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + m.anchor)), first),
+                        _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + m.second)), second));
+                for (unsigned bits = _mm256_movemask_epi8(eq); bits; bits &= bits - 1) {
+                    auto pos = i + __builtin_ctz(bits);
+                    if (m.at(data + pos)) {
+                        sink.add(pos);
+                    }
+                }
+            }
+        }
+        scan_tail(data, i, positions, m, sink);
+    }
+}
+
+search_pattern parse_search_pattern(const std::string &text) {
+    search_pattern pattern;
+    if (text.empty()) {
+        throw std::runtime_error{"Nothing to search for"};
+    }
+    if (text[0] == '"') {
+        parse_string(text, pattern);
+    } else if (text.compare(0, 2, "x:") == 0) {
+        parse_bytes(text.substr(2), pattern);
+    } else {
+        parse_integer(text, pattern);
+    }
+    for (std::size_t i = 0; i < pattern.bytes.size(); ++i) {
+        pattern.bytes[i] &= pattern.mask[i];
+    }
+    return pattern;
+}
+
+search_result search_memory(const std::vector<search_range> &ranges, const search_pattern &pattern,
+                            const partial_reader &read, std::size_t limit, const memory_viewer &view) {
+    struct chunk {
+        uint64_t start;
+        uint64_t end;
+        uint64_t read_end; //end plus the bytes a match starting before end may need
+    };
+
+    auto size = pattern.bytes.size();
+    std::vector<chunk> chunks;
+    for (auto &r: ranges) {
+        for (auto start = r.start; start < r.end; start += chunk_size) {
+            auto end = std::min<uint64_t>(start + chunk_size, r.end);
+            chunks.push_back(chunk{start, end, std::min<uint64_t>(end + size - 1, r.end)});
+        }
+    }
+
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    auto scan = has_avx2 ? scan_avx2 : scan_sse2;
+    matcher m{pattern};
+    search_result result;
+    std::atomic<std::size_t> next{0};
+    std::mutex result_mutex;
+
+    //every worker takes the chunks in address order, so its first limit matches are its lowest ones
+    auto worker = [&] {
+        std::vector<uint8_t> buffer(chunk_size + size - 1);
+        std::vector<uint64_t> matches;
+        std::size_t total = 0;
+        uint64_t bytes = 0, reads = 0;
+
+        for (auto i = next++; i < chunks.size(); i = next++) {
+            auto &c = chunks[i];
+            if (auto data = view ? view(c.start, c.read_end - c.start) : nullptr) {
+                bytes += c.end - c.start;
+                if (c.read_end - c.start >= size) {
+                    hit_sink sink{matches, c.start, limit};
+                    scan(data, std::min<uint64_t>(c.read_end - c.start - size + 1, c.end - c.start), m, sink);
+                    total += sink.count;
+                }
+                continue;
+            }
+            for (auto pos = c.start; pos < c.end;) {
+                auto want = c.read_end - pos;
+                auto got = read(pos, buffer.data(), want);
+                ++reads;
+                if (got == 0) {
+                    pos = (pos | 0xfff) + 1; //an unreadable page, e.g. a guard page or past the end of a file
+                    continue;
+                }
+                bytes += std::min<uint64_t>(got, c.end - pos);
+                if (got >= size) {
+                    hit_sink sink{matches, pos, limit};
+                    scan(buffer.data(), std::min<uint64_t>(got - size + 1, c.end - pos), m, sink);
+                    total += sink.count;
+                }
+                if (got == want) {
+                    break;
+                }
+                pos += got;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock{result_mutex};
+        result.matches.insert(result.matches.end(), matches.begin(), matches.end());
+        result.total += total;
+        result.bytes += bytes;
+        result.reads += reads;
+    };
+
+    auto n_workers = std::min<std::size_t>({std::max(1u, std::thread::hardware_concurrency()), chunks.size(), max_workers});
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < n_workers; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &t: workers) {
+        t.join();
+    }
+
+    std::sort(result.matches.begin(), result.matches.end());
+    if (result.matches.size() > limit) {
+        result.matches.resize(limit);
+    }
+    return result;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+//a byte pattern with a mask of the bits that have to match, the bytes are already masked
+struct search_pattern {
+    std::vector<uint8_t> bytes;
+    std::vector<uint8_t> mask;
+};
+
+//"text" for a string, x:de ad ?? ef for bytes with ?? wildcards, or an integer like 42 or 0xdead??ef
+//with ? for wildcard hex digits and an optional size in bytes (0xbeef:2), stored little endian
+search_pattern parse_search_pattern(const std::string &text);
+
+struct search_range {
+    uint64_t start;
+    uint64_t end;
+};
+
+struct search_result {
+    std::vector<uint64_t> matches; //the lowest addresses, at most limit
+    std::size_t total = 0;
+    uint64_t bytes = 0; //bytes that could be read and were searched
+    uint64_t reads = 0;
+};
+
+//reads as much of the range as it can from its start, returns the number of bytes read. It is called
+//from several threads at once.
+using partial_reader = std::function<std::size_t(uint64_t address, void *buffer, std::size_t size)>;
+
+//the bytes of a range where they are already in memory, nullptr if they have to be read
+using memory_viewer = std::function<const uint8_t *(uint64_t address, std::size_t size)>;
+
+//searches the ranges in chunks of a few MiB on worker threads, a SIMD filter on one or two bytes of
+//the pattern selects the positions that are compared in full. Unreadable pages are skipped. Chunks
+//that view finds are searched in place, without a read.
+search_result search_memory(const std::vector<search_range> &ranges, const search_pattern &pattern,
+                            const partial_reader &read, std::size_t limit, const memory_viewer &view = nullptr);
@@ -0,0 +1,55 @@
+#include <emmintrin.h>
+
+#include "memory_snapshot.h"
+
+namespace {
+    constexpr std::size_t block_size = 64;
+    constexpr uint64_t merge_gap = 8;
+
+    //four 16 byte compares folded into one mask
+    bool blocks_equal(const uint8_t *a, const uint8_t *b) {
+        auto pa = reinterpret_cast<const __m128i *>(a);
+        auto pb = reinterpret_cast<const __m128i *>(b);
+        auto eq = _mm_and_si128(
+                _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(pa), _mm_loadu_si128(pb)),
+                              _mm_cmpeq_epi8(_mm_loadu_si128(pa + 1), _mm_loadu_si128(pb + 1))),
+                _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(pa + 2), _mm_loadu_si128(pb + 2)),
+                              _mm_cmpeq_epi8(_mm_loadu_si128(pa + 3), _mm_loadu_si128(pb + 3))));
+        return _mm_movemask_epi8(eq) == 0xffff;
+    }
+}
+
+std::vector<changed_range> memory_snapshot::diff(const uint8_t *current) const {
+    std::vector<changed_range> changes;
+    auto old = m_data.data();
+
+    auto add = [&](uint64_t from, uint64_t to) {
+        if (!changes.empty() && from - changes.back().end < merge_gap) {
+            changes.back().end = to;
+        } else {
+            changes.push_back(changed_range{from, to});
+        }
+    };
+    auto diff_bytes = [&](std::size_t from, std::size_t to) {
+        for (auto i = from; i < to;) {
+            if (old[i] == current[i]) {
+                ++i;
+                continue;
+            }
+            auto run = i;
+            while (i < to && old[i] != current[i]) {
+                ++i;
+            }
+            add(m_start + run, m_start + i);
+        }
+    };
+
+    std::size_t i = 0;
+    for (; i + block_size <= m_data.size(); i += block_size) {
+        if (!blocks_equal(old + i, current + i)) {
+            diff_bytes(i, i + block_size);
+        }
+    }
+    diff_bytes(i, m_data.size());
+    return changes;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct changed_range {
+    uint64_t start;
+    uint64_t end;
+};
+
+//a copy of a range of memory, compared with its current contents later to see what a call modified
+class memory_snapshot {
+public:
+    memory_snapshot(uint64_t start, std::vector<uint8_t> data) : m_start{start}, m_data{std::move(data)} {}
+
+    uint64_t start() const { return m_start; }
+
+    uint64_t end() const { return m_start + m_data.size(); }
+
+    std::size_t size() const { return m_data.size(); }
+
+    //the ranges where current, a copy of the same range, differs. Blocks of 64 bytes are compared at
+    //once and only unequal blocks byte by byte, changes less than 8 bytes apart are one range.
+    std::vector<changed_range> diff(const uint8_t *current) const;
+
+private:
+    uint64_t m_start;
+    std::vector<uint8_t> m_data;
+};
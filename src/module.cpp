@@ -0,0 +1,175 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sstream>
+
+#include "module.h"
+
+bool module::load() {
+    if (m_loaded) {
+        return m_valid;
+    }
+    m_loaded = true;
+
+    auto fd = open(m_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    try {
+        m_elf = elf::elf{elf::create_mmap_loader(fd)};
+    } catch (std::exception &) {
+        return false;
+    }
+    try {
+        m_dwarf = dwarf::dwarf{dwarf::elf::create_loader(m_elf)};
+    } catch (std::exception &) {
+        //no debug info, symbols and CFI still work
+    }
+
+    uint64_t first_vaddr = UINT64_MAX;
+    for (auto &seg: m_elf.segments()) {
+        if (seg.get_hdr().type == elf::pt::load) {
+            first_vaddr = std::min<uint64_t>(first_vaddr, seg.get_hdr().vaddr);
+        }
+    }
+    m_bias = first_vaddr == UINT64_MAX ? 0 : m_base - (first_vaddr & ~0xfffull);
+
+    m_valid = true;
+    return true;
+}
+
+uint64_t module::bias() {
+    load();
+    return m_bias;
+}
+
+const cfi_table *module::cfi() {
+    if (!m_cfi && load()) {
+        m_cfi = std::make_unique<cfi_table>(m_elf);
+    }
+    return m_cfi.get();
+}
+
+const symbol_index *module::index() {
+    if (!m_index && load()) {
+        m_index = std::make_unique<symbol_index>(m_elf, m_dwarf);
+    }
+    return m_index.get();
+}
+
+std::string module::function_name(uint64_t addr) {
+    auto idx = index();
+    auto pc = addr - bias();
+    if (idx) {
+        if (auto func = idx->find_function(pc); func && func->has(dwarf::DW_AT::name)) {
+            return at_name(*func);
+        }
+        if (auto sym = idx->find_symbol(pc)) {
+            return demangle(sym->name);
+        }
+    }
+    return "[" + m_path.substr(m_path.rfind('/') + 1) + "]";
+}
+
+std::string module::describe(uint64_t addr) {
+    auto idx = index();
+    if (!idx) {
+        return "??";
+    }
+    auto pc = addr - bias();
+
+    std::ostringstream out;
+    if (auto func = idx->find_function(pc); func && func->has(dwarf::DW_AT::name)) {
+        out << at_name(*func);
+    } else if (auto sym = idx->find_symbol(pc)) {
+        out << demangle(sym->name) << "+0x" << std::hex << pc - sym->addr;
+    } else {
+        out << "??";
+    }
+    if (auto line = idx->find_line(pc)) {
+        out << " at " << (*line)->file->path << ':' << std::dec << (*line)->line;
+    }
+    return out.str();
+}
+
+uint64_t module::symbol_address(const std::string &name) {
+    if (!load()) {
+        return 0;
+    }
+    for (auto &sec: m_elf.sections()) {
+        if (sec.get_hdr().type != elf::sht::symtab && sec.get_hdr().type != elf::sht::dynsym) {
+            continue;
+        }
+        for (auto sym: sec.as_symtab()) {
+            auto &d = sym.get_data();
+            if ((d.type() == elf::stt::func || d.type() == elf::stt::object) && d.value != 0 &&
+                sym.get_name() == name) {
+                return d.value + m_bias;
+            }
+        }
+    }
+    return 0;
+}
+
+uint64_t module::breakpoint_address(const std::string &name) {
+    auto addr = symbol_address(name);
+    if (!addr) {
+        return 0;
+    }
+    auto idx = index();
+    auto line = idx ? idx->find_line(addr - m_bias) : nullptr;
+    if (line && (*line)->address == addr - m_bias && !(*line)->end_sequence) {
+        auto next = *line;
+        ++next;
+        if (!next->end_sequence) {
+            return next->address + m_bias;
+        }
+    }
+    return addr;
+}
+
+void module_table::load_from_maps(const std::vector<mapping> &maps) {
+    //modules that are still mapped at the same place keep their already loaded debug info
+    std::vector<std::unique_ptr<module>> previous;
+    previous.swap(m_modules);
+
+    for (std::size_t i = 0; i < maps.size();) {
+        auto &first = maps[i];
+        if (first.path.empty() || first.path[0] != '/') {
+            ++i;
+            continue;
+        }
+
+        //consecutive mappings of the same file form one module
+        auto low = first.start;
+        auto high = first.end;
+        auto base = first.start - first.offset;
+        auto j = i;
+        for (; j < maps.size() && maps[j].path == first.path && maps[j].inode == first.inode; ++j) {
+            high = maps[j].end;
+            if (maps[j].offset == 0) {
+                base = maps[j].start;
+            }
+        }
+
+        auto same = std::find_if(previous.begin(), previous.end(), [&](auto &&m) {
+            return m && m->path() == first.path && m->low() == low && m->high() == high;
+        });
+        if (same != previous.end()) {
+            m_modules.push_back(std::move(*same));
+        } else {
+            m_modules.push_back(std::make_unique<module>(first.path, low, high, base));
+        }
+        i = j;
+    }
+}
+
+module *module_table::find(uint64_t addr) {
+    auto it = std::upper_bound(m_modules.begin(), m_modules.end(), addr,
+                               [](uint64_t addr, auto &&m) { return addr < m->low(); });
+    if (it == m_modules.begin()) {
+        return nullptr;
+    }
+    --it;
+    return (*it)->contains(addr) ? it->get() : nullptr;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "libelfin/dwarf/dwarf++.hh"
+#include "libelfin/elf/elf++.hh"
+#include "memory_map.h"
+#include "symbol_index.h"
+#include "unwinder.h"
+
+//an ELF object mapped into the tracee. The file is only opened, and its CFI and symbols only
+//indexed, on the first lookup that needs them.
+class module {
+public:
+    module(std::string path, uint64_t low, uint64_t high, uint64_t base)
+            : m_path{std::move(path)}, m_low{low}, m_high{high}, m_base{base} {}
+
+    const std::string &path() const { return m_path; }
+
+    uint64_t low() const { return m_low; }
+
+    uint64_t high() const { return m_high; }
+
+    bool contains(uint64_t addr) const { return m_low <= addr && addr < m_high; }
+
+    //difference between the runtime and the link time addresses
+    uint64_t bias();
+
+    //nullptr if the file cannot be read
+    const cfi_table *cfi();
+
+    const symbol_index *index();
+
+    //the function containing a runtime address, "[file name]" if it is unknown
+    std::string function_name(uint64_t addr);
+
+    //the symbol name and, with debug info, file:line of a runtime address
+    std::string describe(uint64_t addr);
+
+    //runtime address of the function or object symbol name, 0 if the file does not define it
+    uint64_t symbol_address(const std::string &name);
+
+    //where a breakpoint on the function name goes: past its prologue when there is line info
+    uint64_t breakpoint_address(const std::string &name);
+
+private:
+    bool load();
+
+    std::string m_path;
+    uint64_t m_low;
+    uint64_t m_high;
+    uint64_t m_base; //address the file offset 0 is mapped at
+    uint64_t m_bias = 0;
+    bool m_loaded = false;
+    bool m_valid = false;
+    elf::elf m_elf;
+    dwarf::dwarf m_dwarf;
+    std::unique_ptr<cfi_table> m_cfi;
+    std::unique_ptr<symbol_index> m_index;
+};
+
+//the modules of a process sorted by address
+class module_table {
+public:
+    void clear() { m_modules.clear(); }
+
+    //one module per file backed mapping group of /proc/pid/maps
+    void load_from_maps(const std::vector<mapping> &maps);
+
+    module *find(uint64_t addr);
+
+    std::vector<std::unique_ptr<module>> &modules() { return m_modules; }
+
+private:
+    std::vector<std::unique_ptr<module>> m_modules;
+};
@@ -1,18 +1,98 @@
 #include "parser.h"
 #include <string.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <fstream>
+#include <climits>
 
 using namespace std;
 
+//long-only options
+enum {
+    OPT_PSTACK = 256,
+    OPT_PROFILE,
+    OPT_HZ,
+    OPT_DURATION,
+    OPT_PERF,
+    OPT_COVERAGE,
+    OPT_SYSCALLS,
+    OPT_GDBSERVER,
+    OPT_BATCH,
+    OPT_TIME,
+};
+
+static const option longOpts[] = {
+    {"help", no_argument, nullptr, 'h'},
+    {"attach", required_argument, nullptr, 'a'},
+    {"pstack", no_argument, nullptr, OPT_PSTACK},
+    {"profile", no_argument, nullptr, OPT_PROFILE},
+    {"perf", no_argument, nullptr, OPT_PERF},
+    {"coverage", no_argument, nullptr, OPT_COVERAGE},
+    {"syscalls", required_argument, nullptr, OPT_SYSCALLS},
+    {"gdbserver", required_argument, nullptr, OPT_GDBSERVER},
+    {"batch", no_argument, nullptr, OPT_BATCH},
+    {"time", no_argument, nullptr, OPT_TIME},
+    {"hz", required_argument, nullptr, OPT_HZ},
+    {"duration", required_argument, nullptr, OPT_DURATION},
+    {"output", required_argument, nullptr, 'o'},
+    {nullptr, 0, nullptr, 0}
+};
 
 
 string ArgParser::getProgName() {
     return _progName;
 }
 
+pid_t ArgParser::getPid() {
+    return _pid;
+}
+
+vector<pid_t> ArgParser::getPids() {
+    return _pids;
+}
+
+Mode ArgParser::getMode() {
+    return _mode;
+}
+
+unsigned ArgParser::getHz() {
+    return _hz;
+}
+
+double ArgParser::getDuration() {
+    return _duration;
+}
+
+string ArgParser::getOutput() {
+    return _output;
+}
+
+string ArgParser::getSyscalls() {
+    return _syscalls;
+}
+
+string ArgParser::getRemote() {
+    return _remote;
+}
+
+string ArgParser::getScript() {
+    return _script;
+}
+
+string ArgParser::getCore() {
+    return _core;
+}
+
+bool ArgParser::getBatch() {
+    return _batch;
+}
+
+bool ArgParser::getTime() {
+    return _time;
+}
+
 bool ArgParser::fileExist() {
-    fstream fileStream;
+    ifstream fileStream; //read-only, the executable of an attached process cannot be opened for writing
     fileStream.open(_progName);
     if (fileStream.fail()) {
         cout << "File does not exist" << endl;
@@ -23,11 +103,15 @@ bool ArgParser::fileExist() {
 
 bool ArgParser::parse() {
     int opt = 0;
+    if (_argc < 2) {
+        help();
+        return false;
+    }
     string ProgName = string(_argv[1]);
     if (ProgName.find("-") != 0) {
         _progName = ProgName;
     }
-    while ((opt = getopt(_argc, _argv, opts)) != -1) {
+    while ((opt = getopt_long(_argc, _argv, opts, longOpts, nullptr)) != -1) {
         switch (opt) {
             case 'h':
                 help();
@@ -39,11 +123,103 @@ bool ArgParser::parse() {
                 }
                 _progName = string(optarg);
                 break;
+            case 'a':
+                _pids.push_back(atoi(optarg));
+                if (_pid <= 0) {
+                    _pid = _pids.back();
+                }
+                break;
+            case OPT_PSTACK:
+                _mode = Mode::pstack;
+                break;
+            case OPT_PROFILE:
+                _mode = Mode::profile;
+                break;
+            case OPT_PERF:
+                _mode = Mode::perf;
+                break;
+            case OPT_COVERAGE:
+                _mode = Mode::coverage;
+                break;
+            case OPT_SYSCALLS:
+                _mode = Mode::syscalls;
+                _syscalls = string(optarg);
+                break;
+            case OPT_GDBSERVER:
+                _mode = Mode::gdbserver;
+                _remote = string(optarg);
+                break;
+            case 'x':
+                _script = string(optarg);
+                _batch = true;
+                break;
+            case 'c':
+                _core = string(optarg);
+                break;
+            case OPT_BATCH:
+                _batch = true;
+                break;
+            case OPT_TIME:
+                _time = true;
+                break;
+            case OPT_HZ:
+                _hz = atoi(optarg);
+                if (_hz == 0) {
+                    cout << "Incorrect args" << endl;
+                    return false;
+                }
+                break;
+            case OPT_DURATION:
+                _duration = atof(optarg);
+                break;
+            case 'o':
+                _output = string(optarg);
+                break;
             default:
                 help();
                 return false;
         }
     }
+    if (_progName.empty() && optind < _argc) {
+        _progName = string(_argv[optind]);
+    }
+    if (_mode == Mode::pstack && _pid <= 0) {
+        cout << "This mode needs a process to attach to (-a PID)" << endl;
+        return false;
+    }
+    if (!_core.empty() && (_pid > 0 || _mode != Mode::debug)) {
+        cout << "A core file can only be inspected with the interactive debugger or a script" << endl;
+        return false;
+    }
+    if (_mode == Mode::syscalls && _pid > 0) {
+        cout << "The seccomp filter is installed before exec, --syscalls cannot attach" << endl;
+        return false;
+    }
+    if (_pid > 0 && _progName.empty()) {
+        char exe[PATH_MAX]{};
+        string link = "/proc/" + to_string(_pid) + "/exe";
+        if (readlink(link.c_str(), exe, sizeof(exe) - 1) < 0) {
+            cout << "Cannot find executable of process " << _pid << endl;
+            return false;
+        }
+        _progName = exe;
+    }
+    if (_pids.size() > 1 && _mode != Mode::debug) {
+        cout << "Only the interactive debugger accepts several processes" << endl;
+        return false;
+    }
+    char prog[PATH_MAX]{};
+    if (_pids.size() > 1 && !_progName.empty() && !realpath(_progName.c_str(), prog)) {
+        prog[0] = '\0';
+    }
+    for (auto pid: _pids) {
+        char exe[PATH_MAX]{};
+        string link = "/proc/" + to_string(pid) + "/exe";
+        if (_pids.size() > 1 && (readlink(link.c_str(), exe, sizeof(exe) - 1) < 0 || string(prog) != exe)) {
+            cout << "Process " << pid << " does not run " << _progName << endl;
+            return false;
+        }
+    }
     if (_progName.empty() || !fileExist()) {
         return false;
     }
@@ -55,7 +231,27 @@ void ArgParser::help() {
             "    ./my_app [options] [executable-file]" << endl << endl <<
             "Selection of debuggee:" << endl << endl <<
             "   -h             Print this message and then exit." << endl <<
-            "   -p             Option requires an argument"<< endl;
+            "   -p             Option requires an argument"<< endl <<
+            "   -x FILE        Run the commands in FILE without prompt, exit with the status of the program" << endl <<
+            "   --batch        Run the commands of -x FILE, or of stdin, without prompt" << endl <<
+            "   --time         Print the wall time and syscall count of every command on stderr" << endl <<
+            "   -c CORE        Inspect the core file CORE of the executable, without a process" << endl <<
+            "   -a PID         Attach to the running process PID, repeat it to debug several processes" << endl <<
+            "                  of one program (commands take an @N or @all selector)" << endl << endl <<
+            "Non-interactive modes:" << endl << endl <<
+            "   --pstack       Print the stacks of all threads of -a PID and detach" << endl <<
+            "   --profile      Sample the stacks of all threads, write folded stacks for flamegraphs" << endl <<
+            "   --perf         Sample with perf_event_open without stopping the program, print the hottest" << endl <<
+            "                  functions and lines (accepts --hz and --duration)" << endl <<
+            "   --syscalls LIST" << endl <<
+            "                  Trace only the comma separated syscalls (names or numbers), print each call" << endl <<
+            "                  (-o FILE) and a latency summary" << endl <<
+            "   --gdbserver stdio|SOCKET" << endl <<
+            "                  Serve the gdb remote protocol on stdin/stdout or on a unix socket" << endl <<
+            "   --coverage     Run the program to its end and write the executed lines as lcov (-o FILE)" << endl <<
+            "     --hz N         samples per second (default 99)" << endl <<
+            "     --duration S   stop after S seconds (default: until the program exits)" << endl <<
+            "     -o FILE        output file (default: stdout)" << endl;
 }
 
 
@@ -1,11 +1,34 @@
 #include <iostream>
+#include <vector>
 
 using namespace std;
 
+enum class Mode {
+    debug,  //interactive debugger
+    pstack, //print all thread stacks of -a PID and detach
+    profile, //ptrace based sampling profiler writing folded stacks
+    perf,    //perf_event_open sampling without stopping the target
+    coverage, //line coverage with one-shot breakpoints, written as lcov
+    syscalls, //trace the listed syscalls through a seccomp filter
+    gdbserver, //serve the gdb remote protocol
+};
+
 class ArgParser {
 
-    const char *opts = "hp:";
+    const char *opts = "hp:a:o:x:c:";
     string _progName; //name_prog
+    pid_t _pid = 0; //process to attach to
+    vector<pid_t> _pids; //all -a options, several processes of one program are debugged together
+    Mode _mode = Mode::debug;
+    unsigned _hz = 99;
+    double _duration = 0; //seconds, 0 runs until the program exits
+    string _output;
+    string _syscalls; //comma separated names or numbers
+    string _remote;   //"stdio" or a unix socket path for the gdb remote protocol
+    string _script;   //commands to run instead of the prompt
+    string _core;     //core file to inspect instead of a process
+    bool _batch = false;
+    bool _time = false;
     int _argc;
     char **_argv;
 
@@ -19,5 +42,29 @@ public:
     bool parse();
 
     string getProgName();
+
+    pid_t getPid();
+
+    vector<pid_t> getPids();
+
+    Mode getMode();
+
+    unsigned getHz();
+
+    double getDuration();
+
+    string getOutput();
+
+    string getSyscalls();
+
+    string getRemote();
+
+    string getScript();
+
+    string getCore();
+
+    bool getBatch();
+
+    bool getTime();
 };
 
@@ -0,0 +1,344 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <linux/perf_event.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "perf_sampler.h"
+#include "address_space.h"
+#include "attach.h"
+#include "module.h"
+
+namespace {
+    //data pages of the ring of each cpu, must be a power of two: 256 KiB plus the header page per cpu,
+    //whatever the number of threads
+    constexpr std::size_t ring_pages = 64;
+
+    struct ring_buffer {
+        int fd = -1;
+        perf_event_mmap_page *meta = nullptr;
+        uint8_t *data = nullptr;
+        std::size_t size = 0;
+    };
+
+    struct sample_stats {
+        uint64_t samples = 0;
+        uint64_t lost = 0;
+        std::unordered_map<uint64_t, uint64_t> self;            //ip -> samples
+        std::map<std::vector<uint64_t>, uint64_t> stacks;      //ip and return addresses -> samples
+        std::unordered_set<pid_t> threads;
+        bool maps_changed = false;                             //an executable mapping was added
+    };
+
+    int open_event(pid_t tid, int cpu, unsigned hz, bool enable_on_exec) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_SOFTWARE;
+        attr.config = PERF_COUNT_SW_CPU_CLOCK;
+        attr.freq = 1;
+        attr.sample_freq = hz;
+        attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_CALLCHAIN;
+        attr.disabled = 1;
+        attr.enable_on_exec = enable_on_exec;
+        attr.inherit = 1; //threads created later are sampled too, this needs per-cpu events
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.exclude_callchain_kernel = 1;
+        attr.mmap = 1; //executable mappings, e.g. dlopen, are reported as records in the ring
+        attr.wakeup_events = 32;
+
+        return syscall(SYS_perf_event_open, &attr, tid, cpu, -1, PERF_FLAG_FD_CLOEXEC);
+    }
+
+    bool map_ring(ring_buffer &ring) {
+        auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        ring.size = ring_pages * page;
+        auto base = mmap(nullptr, ring.size + page, PROT_READ | PROT_WRITE, MAP_SHARED, ring.fd, 0);
+        if (base == MAP_FAILED) {
+            return false;
+        }
+        ring.meta = static_cast<perf_event_mmap_page *>(base);
+        ring.data = static_cast<uint8_t *>(base) + page;
+        return true;
+    }
+
+    //consumes every complete record between data_tail and data_head
+    void drain(ring_buffer &ring, sample_stats &stats) {
+        auto head = __atomic_load_n(&ring.meta->data_head, __ATOMIC_ACQUIRE);
+        auto tail = ring.meta->data_tail;
+        std::vector<uint8_t> record;
+
+        while (tail < head) {
+            perf_event_header header;
+            auto copy = [&ring](uint64_t pos, void *out, std::size_t len) {
+                auto offset = pos % ring.size;
+                auto first = std::min(len, ring.size - offset);
+                std::memcpy(out, ring.data + offset, first);
+                std::memcpy(static_cast<uint8_t *>(out) + first, ring.data, len - first); //wrapped part
+            };
+            copy(tail, &header, sizeof(header));
+            if (header.size < sizeof(header)) {
+                break;
+            }
+            record.resize(header.size);
+            copy(tail, record.data(), header.size);
+            tail += header.size;
+
+            auto body = reinterpret_cast<const uint64_t *>(record.data() + sizeof(header));
+            if (header.type == PERF_RECORD_SAMPLE) {
+                //sample_type order: ip, pid/tid, callchain
+                auto ip = body[0];
+                auto tid = static_cast<pid_t>(body[1] >> 32);
+                auto nr = body[2];
+                auto chain = body + 3;
+
+                ++stats.samples;
+                ++stats.self[ip];
+                stats.threads.insert(tid);
+                //after the context marker the first entry is the ip itself, the rest are return addresses
+                std::vector<uint64_t> stack;
+                for (uint64_t i = 0; i < nr; ++i) {
+                    if (chain[i] >= PERF_CONTEXT_MAX) {
+                        continue;
+                    }
+                    stack.push_back(stack.empty() ? chain[i] : chain[i] - 1);
+                }
+                ++stats.stacks[stack];
+            } else if (header.type == PERF_RECORD_LOST) {
+                stats.lost += body[1];
+            } else if (header.type == PERF_RECORD_MMAP) {
+                stats.maps_changed = true;
+            }
+        }
+
+        __atomic_store_n(&ring.meta->data_tail, tail, __ATOMIC_RELEASE);
+    }
+
+    void print_report(module_table &modules, const sample_stats &stats, std::size_t top) {
+        struct hits {
+            uint64_t self = 0;
+            uint64_t total = 0;
+            std::string module;
+        };
+        std::map<std::string, hits> functions;
+        std::map<std::string, uint64_t> lines;
+
+        auto name_of = [&modules](uint64_t pc, std::string *location, std::string *module_name) {
+            auto m = modules.find(pc);
+            if (!m) {
+                return std::string{"[unknown]"};
+            }
+            *module_name = m->path().substr(m->path().rfind('/') + 1);
+            if (location) {
+                auto idx = m->index();
+                auto line = idx ? idx->find_line(pc - m->bias()) : nullptr;
+                *location = line ? (*line)->file->path + ':' + std::to_string((*line)->line) : "";
+            }
+            return m->function_name(pc);
+        };
+
+        for (auto &[pc, count]: stats.self) {
+            std::string location, module_name;
+            auto &f = functions[name_of(pc, &location, &module_name)];
+            f.self += count;
+            f.module = module_name;
+            if (!location.empty()) {
+                lines[location] += count;
+            }
+        }
+        //a sample counts once towards the inclusive time of every function on its stack, a recursive
+        //function is not counted again for each of its frames
+        std::unordered_map<uint64_t, std::string> names;
+        for (auto &[stack, count]: stats.stacks) {
+            std::unordered_set<std::string> counted;
+            for (auto pc: stack) {
+                auto name = names.find(pc);
+                if (name == names.end()) {
+                    std::string module_name;
+                    name = names.emplace(pc, name_of(pc, nullptr, &module_name)).first;
+                    functions[name->second].module = module_name;
+                }
+                if (counted.insert(name->second).second) {
+                    functions[name->second].total += count;
+                }
+            }
+        }
+
+        auto percent = [&stats](uint64_t n) {
+            return stats.samples ? 100.0 * n / stats.samples : 0.0;
+        };
+
+        std::vector<std::pair<std::string, hits>> sorted(functions.begin(), functions.end());
+        std::sort(sorted.begin(), sorted.end(), [](auto &&a, auto &&b) { return a.second.self > b.second.self; });
+
+        std::cout << "Samples: " << std::dec << stats.samples << " (lost " << stats.lost << "), threads: "
+                  << stats.threads.size() << std::endl << std::endl;
+        std::cout << "   Self   Total  Samples  Function [module]" << std::endl;
+        std::cout << std::fixed << std::setprecision(2);
+        for (std::size_t i = 0; i < sorted.size() && i < top; ++i) {
+            auto &[name, h] = sorted[i];
+            if (!h.self) {
+                break;
+            }
+            std::cout << std::setw(6) << percent(h.self) << "% " << std::setw(6) << percent(h.total) << "% "
+                      << std::setw(8) << h.self << "  " << name << " [" << h.module << "]" << std::endl;
+        }
+
+        std::vector<std::pair<std::string, uint64_t>> hot_lines(lines.begin(), lines.end());
+        std::sort(hot_lines.begin(), hot_lines.end(), [](auto &&a, auto &&b) { return a.second > b.second; });
+        std::cout << std::endl << "   Self  Samples  Line" << std::endl;
+        for (std::size_t i = 0; i < hot_lines.size() && i < top; ++i) {
+            std::cout << std::setw(6) << percent(hot_lines[i].second) << "% " << std::setw(8) << hot_lines[i].second
+                      << "  " << hot_lines[i].first << std::endl;
+        }
+        std::cout << std::defaultfloat;
+    }
+}
+
+int run_perf_sampler(const std::string &prog, pid_t pid, unsigned hz, double seconds) {
+    using clock = std::chrono::steady_clock;
+
+    //a launched program waits on a pipe until the events exist, they start counting at exec
+    bool launched = pid <= 0;
+    int go[2] = {-1, -1};
+    if (launched) {
+        if (pipe(go) < 0) {
+            return 1;
+        }
+        pid = fork();
+        if (pid == 0) {
+            char c;
+            close(go[1]);
+            if (read(go[0], &c, 1) != 1) {
+                _exit(1);
+            }
+            execl(prog.c_str(), prog.c_str(), nullptr);
+            _exit(127);
+        }
+        close(go[0]);
+    }
+
+    //one ring buffer per cpu, the events of the other threads on that cpu are redirected into it
+    std::vector<ring_buffer> rings;
+    std::vector<int> event_fds;
+    auto tids = launched ? std::vector<pid_t>{pid} : list_threads(pid);
+    auto cpus = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    for (int cpu = 0; cpu < cpus; ++cpu) {
+        ring_buffer ring;
+        for (auto tid: tids) {
+            auto fd = open_event(tid, cpu, hz, launched);
+            if (fd < 0) {
+                continue; //the thread exited in the meantime, or the cpu is offline
+            }
+            event_fds.push_back(fd);
+            if (ring.fd < 0) {
+                ring.fd = fd;
+                if (!map_ring(ring)) {
+                    ring.fd = -1;
+                }
+            } else {
+                ioctl(fd, PERF_EVENT_IOC_SET_OUTPUT, ring.fd);
+            }
+        }
+        if (ring.fd >= 0) {
+            rings.push_back(ring);
+        }
+    }
+
+    if (rings.empty()) {
+        std::cerr << "perf_event_open failed: " << strerror(errno)
+                  << " (check /proc/sys/kernel/perf_event_paranoid)" << std::endl;
+        if (launched) {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+        return 1;
+    }
+
+    if (launched) {
+        //releases the child into exec
+        if (write(go[1], "x", 1) != 1) {
+            std::cerr << "Cannot start " << prog << std::endl;
+        }
+        close(go[1]);
+    } else {
+        for (auto fd: event_fds) {
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    //the mappings are only read again when the ring reports a new executable one
+    address_space maps{pid};
+    module_table modules;
+    sample_stats stats;
+    std::vector<pollfd> fds;
+    for (auto &ring: rings) {
+        fds.push_back(pollfd{ring.fd, POLLIN, 0});
+    }
+
+    auto start = clock::now();
+    auto next_report = start + std::chrono::seconds(1);
+    bool interactive = isatty(STDOUT_FILENO);
+    bool alive = true;
+
+    while (alive && (seconds <= 0 || clock::now() - start < std::chrono::duration<double>(seconds))) {
+        poll(fds.data(), fds.size(), 100);
+        for (auto &ring: rings) {
+            drain(ring, stats);
+        }
+
+        if (launched) {
+            alive = waitpid(pid, nullptr, WNOHANG) == 0;
+        } else {
+            alive = kill(pid, 0) == 0;
+        }
+
+        //mappings are read while the target runs, they are needed before it exits
+        if (alive && (modules.modules().empty() || stats.maps_changed)) {
+            if (stats.maps_changed) {
+                maps.invalidate();
+                stats.maps_changed = false;
+            }
+            auto current = maps.list();
+            if (!current.empty()) {
+                modules.load_from_maps(current);
+            }
+        }
+
+        if (interactive && clock::now() >= next_report) {
+            std::cout << "\033[H\033[2J";
+            print_report(modules, stats, 20);
+            next_report += std::chrono::seconds(1);
+        }
+    }
+
+    for (auto fd: event_fds) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (auto &ring: rings) {
+        drain(ring, stats);
+        munmap(ring.meta, ring.size + sysconf(_SC_PAGESIZE));
+    }
+    for (auto fd: event_fds) {
+        close(fd);
+    }
+    if (launched && alive) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+
+    print_report(modules, stats, 20);
+    return 0;
+}
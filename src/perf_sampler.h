@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+#include <sys/types.h>
+
+//samples the user space call chains of pid (or of prog, launched for the purpose) with a
+//cpu-clock perf event. The samples are read from the mmapped ring buffers while the target keeps
+//running; it is never stopped or traced. Prints a top-like report of the hottest functions and lines.
+int run_perf_sampler(const std::string &prog, pid_t pid, unsigned hz, double seconds);
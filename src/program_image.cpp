@@ -0,0 +1,67 @@
+#include <cstring>
+#include <fcntl.h>
+
+#include "program_image.h"
+
+namespace {
+    //libelfin loads the DWARF sections and the type units on first use, into maps of the dwarf object
+    //that are not synchronized. They are all loaded up front, so the inferiors sharing the image only
+    //ever read it.
+    void load_lazy_parts(const elf::elf &elf, const dwarf::dwarf &dwarf) {
+        using dwarf::section_type;
+        for (auto type: {section_type::abbrev, section_type::aranges, section_type::frame, section_type::line,
+                         section_type::loc, section_type::macinfo, section_type::pubnames, section_type::pubtypes,
+                         section_type::ranges, section_type::str, section_type::types}) {
+            try {
+                dwarf.get_section(type);
+            } catch (std::exception &) {
+                //not in the file, a later lookup throws again without storing anything
+            }
+        }
+
+        //the type units by the signatures in their headers: length, version, abbrev offset, address
+        //size, signature
+        auto &types = elf.get_section(".debug_types");
+        if (!types.valid()) {
+            return;
+        }
+        auto p = static_cast<const uint8_t *>(types.data());
+        auto end = p + types.size();
+        while (end - p >= 4) {
+            uint64_t length = 0;
+            std::memcpy(&length, p, 4);
+            std::size_t offset_size = 4;
+            p += 4;
+            if (length == 0xffffffff) {
+                if (end - p < 8) {
+                    return;
+                }
+                std::memcpy(&length, p, 8);
+                offset_size = 8;
+                p += 8;
+            }
+            if (static_cast<uint64_t>(end - p) < length || length < 2 + offset_size + 1 + 8) {
+                return;
+            }
+            uint64_t signature;
+            std::memcpy(&signature, p + 2 + offset_size + 1, 8);
+            auto &unit = dwarf.get_type_unit(signature);
+            unit.root();
+            unit.type();
+            p += length;
+        }
+    }
+}
+
+//building the index parses the root DIE, the abbreviations and the line table of every compilation
+//unit, load_lazy_parts the rest libelfin would load on demand. Nothing is written afterwards.
+program_image::program_image(const std::string &path) {
+    auto fd = open(path.c_str(), O_RDONLY);
+
+    elf = elf::elf{elf::create_mmap_loader(fd)};
+    dwarf = dwarf::dwarf{dwarf::elf::create_loader(elf)};
+    index = symbol_index{elf, dwarf};
+    if (dwarf.valid()) {
+        load_lazy_parts(elf, dwarf);
+    }
+}
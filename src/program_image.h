@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+#include "symbol_index.h"
+#include "libelfin/dwarf/dwarf++.hh"
+#include "libelfin/elf/elf++.hh"
+
+//the ELF and DWARF of an executable and their symbol index. It is built once and then only read,
+//so all inferiors running the same program share one copy, also across threads.
+struct program_image {
+    explicit program_image(const std::string &path);
+
+    elf::elf elf;
+    dwarf::dwarf dwarf;
+    symbol_index index;
+};
@@ -0,0 +1,65 @@
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sys/ptrace.h>
+
+#include "pstack.h"
+#include "attach.h"
+#include "module.h"
+#include "stack_snapshot.h"
+#include "unwinder.h"
+
+static constexpr std::size_t max_stack_copy = 512 * 1024;
+
+int run_pstack(pid_t pid) {
+    using clock = std::chrono::steady_clock;
+
+    //everything that does not need a stopped target happens before the interrupt
+    auto maps = read_memory_maps(pid);
+    auto tids = seize_threads(pid, 0);
+    if (tids.empty()) {
+        std::cerr << "Cannot attach to process " << pid << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    std::map<pid_t, int> pending_signals;
+    auto start = clock::now();
+    tids = interrupt_threads(tids, pending_signals);
+    auto snapshots = capture_threads(pid, tids, maps, max_stack_copy);
+    detach_threads(tids, pending_signals);
+    auto released = clock::now();
+
+    module_table modules;
+    modules.load_from_maps(maps);
+
+    std::size_t copied = 0;
+    for (auto &snap: snapshots) {
+        copied += snap.stack.size();
+
+        std::cout << "Thread " << std::dec << snap.tid << ":" << std::endl;
+        auto frames = unwind_stack(modules, snap.regs, [&snap](uint64_t addr, void *buf, std::size_t size) {
+            return snap.read(addr, buf, size);
+        });
+
+        for (std::size_t i = 0; i < frames.size(); ++i) {
+            auto pc = frames[i].pc;
+            std::cout << "#" << std::left << std::setw(3) << std::dec << i << std::right
+                      << "0x" << std::setfill('0') << std::setw(16) << std::hex << pc << std::setfill(' ') << " in ";
+            auto lookup = i == 0 ? pc : pc - 1; //the call, not the instruction after it
+            if (auto m = modules.find(lookup)) {
+                std::cout << m->describe(lookup) << " from " << m->path();
+            } else {
+                std::cout << "??";
+            }
+            std::cout << std::endl;
+        }
+        std::cout << std::endl;
+    }
+
+    std::cerr << "Target stopped for "
+              << std::chrono::duration_cast<std::chrono::microseconds>(released - start).count() << " us ("
+              << std::dec << snapshots.size() << " threads, " << copied / 1024 << " KiB of stack)" << std::endl;
+    return 0;
+}
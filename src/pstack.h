@@ -0,0 +1,7 @@
+#pragma once
+
+#include <sys/types.h>
+
+//attaches to pid, copies the registers and stacks of all threads, detaches and only then
+//unwinds and symbolizes the copies. Returns the process exit code.
+int run_pstack(pid_t pid);
@@ -0,0 +1,57 @@
+#include <climits>
+#include <cstring>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+
+#include "stack_snapshot.h"
+#include "utility.h"
+
+bool thread_snapshot::read(uint64_t address, void *buffer, std::size_t size) const {
+    if (address < stack_start || address + size > stack_start + stack.size()) {
+        return false;
+    }
+    std::memcpy(buffer, stack.data() + (address - stack_start), size);
+    return true;
+}
+
+std::vector<thread_snapshot> capture_threads(pid_t pid, const std::vector<pid_t> &tids,
+                                             const std::vector<mapping> &maps, std::size_t max_stack) {
+    std::vector<thread_snapshot> snapshots(tids.size());
+    std::vector<iovec> local, remote;
+
+    for (std::size_t i = 0; i < tids.size(); ++i) {
+        auto &snap = snapshots[i];
+        snap.tid = tids[i];
+        counted_ptrace(PTRACE_GETREGS, snap.tid, nullptr, &snap.regs);
+        snap.stack_start = snap.regs.rsp;
+
+        auto m = find_mapping(maps, snap.regs.rsp);
+        if (!m) {
+            continue;
+        }
+        snap.stack.resize(std::min<uint64_t>(m->end - snap.regs.rsp, max_stack));
+        local.push_back(iovec{snap.stack.data(), snap.stack.size()});
+        remote.push_back(iovec{reinterpret_cast<void *>(snap.stack_start), snap.stack.size()});
+    }
+
+    //process_vm_readv stops at the first remote range that fails, retry the rest one by one
+    std::size_t done = 0;
+    while (done < local.size()) {
+        auto count = std::min<std::size_t>(local.size() - done, IOV_MAX);
+        ++g_syscall_counters.memory;
+        auto n = process_vm_readv(pid, &local[done], count, &remote[done], count, 0);
+        std::size_t expected = 0;
+        for (std::size_t i = done; i < done + count; ++i) {
+            expected += local[i].iov_len;
+        }
+        if (n == static_cast<ssize_t>(expected)) {
+            done += count;
+            continue;
+        }
+        read_process_memory(pid, reinterpret_cast<uint64_t>(remote[done].iov_base), local[done].iov_base,
+                            local[done].iov_len);
+        ++done;
+    }
+
+    return snapshots;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <sys/types.h>
+#include <sys/user.h>
+
+#include "memory_map.h"
+
+//registers and the live part of the stack of one thread, enough to unwind it after the process is released
+struct thread_snapshot {
+    pid_t tid;
+    user_regs_struct regs;
+    uint64_t stack_start;
+    std::vector<uint8_t> stack;
+
+    //reads from the captured bytes only
+    bool read(uint64_t address, void *buffer, std::size_t size) const;
+};
+
+//copies rsp up to the end of its mapping (at most max_stack bytes) for every stopped thread,
+//all stacks in a single process_vm_readv
+std::vector<thread_snapshot> capture_threads(pid_t pid, const std::vector<pid_t> &tids,
+                                             const std::vector<mapping> &maps, std::size_t max_stack);
@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <map>
+
+#include "stack_trie.h"
+
+stack_trie::stack_trie() {
+    m_nodes.push_back(node{0, 0, 0}); //root
+}
+
+void stack_trie::add(const std::vector<stack_frame> &frames) {
+    uint32_t current = 0;
+    for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+        auto inserted = m_children.emplace(std::make_pair(current, it->pc), m_nodes.size());
+        if (inserted.second) {
+            m_nodes.push_back(node{it->pc, current, 0});
+        }
+        current = inserted.first->second;
+    }
+    ++m_nodes[current].count;
+    ++m_samples;
+}
+
+void stack_trie::write_folded(std::ostream &out, const std::function<std::string(uint64_t pc)> &name) const {
+    std::unordered_map<uint64_t, std::string> names;
+    auto lookup = [&](uint64_t pc) -> const std::string & {
+        auto it = names.find(pc);
+        if (it == names.end()) {
+            it = names.emplace(pc, name(pc)).first;
+        }
+        return it->second;
+    };
+
+    //different pcs of one function collapse into the same line
+    std::map<std::string, uint64_t> folded;
+    std::vector<uint32_t> path;
+    for (uint32_t i = 1; i < m_nodes.size(); ++i) {
+        if (!m_nodes[i].count) {
+            continue;
+        }
+        path.clear();
+        for (auto n = i; n != 0; n = m_nodes[n].parent) {
+            path.push_back(n);
+        }
+
+        std::string line;
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            if (!line.empty()) {
+                line += ';';
+            }
+            line += lookup(m_nodes[*it].pc);
+        }
+        folded[line] += m_nodes[i].count;
+    }
+
+    for (auto &[stack, count]: folded) {
+        out << stack << ' ' << count << '\n';
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "unwinder.h"
+
+//call stacks merged by common prefix (outermost frame first). Every node is found through one
+//hash lookup keyed by (parent node, pc), so adding a sample costs one probe per frame.
+class stack_trie {
+public:
+    stack_trie();
+
+    //frames innermost first, as returned by unwind_stack
+    void add(const std::vector<stack_frame> &frames);
+
+    std::size_t samples() const { return m_samples; }
+
+    //Brendan Gregg's folded format, "outer;inner count" per line. name is called once per distinct pc.
+    void write_folded(std::ostream &out, const std::function<std::string(uint64_t pc)> &name) const;
+
+private:
+    struct node {
+        uint64_t pc;
+        uint32_t parent;
+        uint64_t count; //samples whose innermost frame is this node
+    };
+
+    struct edge_hash {
+        std::size_t operator()(const std::pair<uint32_t, uint64_t> &e) const {
+            return std::hash<uint64_t>{}(e.second * 0x9e3779b97f4a7c15ull ^ e.first);
+        }
+    };
+
+    std::vector<node> m_nodes;
+    std::unordered_map<std::pair<uint32_t, uint64_t>, uint32_t, edge_hash> m_children;
+    std::size_t m_samples = 0;
+};
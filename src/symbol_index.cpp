@@ -0,0 +1,84 @@
+#include <algorithm>
+
+#include "symbol_index.h"
+
+symbol_index::symbol_index(const elf::elf &elf, const dwarf::dwarf &dwarf) {
+    for (auto &sec: elf.sections()) {
+        if (sec.get_hdr().type != elf::sht::symtab && sec.get_hdr().type != elf::sht::dynsym)
+            continue;
+
+        for (auto sym: sec.as_symtab()) {
+            auto &d = sym.get_data();
+            if ((d.type() != elf::stt::func && d.type() != elf::stt::object) || d.value == 0) {
+                continue;
+            }
+            m_symbols.push_back(symbol_range{d.value, d.value + std::max<uint64_t>(d.size, 1),
+                                             symbol{to_symbol_type(d.type()), sym.get_name(), d.value}});
+        }
+    }
+    std::sort(m_symbols.begin(), m_symbols.end(),
+              [](auto &&a, auto &&b) { return a.low < b.low; });
+
+    if (!dwarf.valid()) {
+        return;
+    }
+
+    for (auto &cu: dwarf.compilation_units()) {
+        for (const auto &die: cu.root()) {
+            if (die.tag != dwarf::DW_TAG::subprogram) {
+                continue;
+            }
+            try {
+                for (auto &range: die_pc_range(die)) {
+                    m_functions.push_back(function_range{range.low, range.high, die});
+                }
+            } catch (std::out_of_range &) {
+                //declarations and inlined-only functions have no code
+            }
+        }
+
+        //each row covers the addresses up to the next row of the same sequence, like line_table::find_address
+        auto &lt = cu.get_line_table();
+        auto prev = lt.begin(), end = lt.end();
+        if (prev == end) {
+            continue;
+        }
+        auto it = prev;
+        for (++it; it != end; prev = it++) {
+            if (!prev->end_sequence && prev->address < it->address) {
+                m_lines.push_back(line_range{prev->address, it->address, prev});
+            }
+        }
+    }
+
+    std::sort(m_functions.begin(), m_functions.end(),
+              [](auto &&a, auto &&b) { return a.low < b.low; });
+    std::sort(m_lines.begin(), m_lines.end(),
+              [](auto &&a, auto &&b) { return a.low < b.low; });
+}
+
+template<typename T>
+static const T *find_range(const std::vector<T> &ranges, uint64_t pc) {
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), pc,
+                               [](uint64_t pc, auto &&r) { return pc < r.low; });
+    if (it == ranges.begin()) {
+        return nullptr;
+    }
+    --it;
+    return pc < it->high ? &*it : nullptr;
+}
+
+const dwarf::die *symbol_index::find_function(uint64_t pc) const {
+    auto range = find_range(m_functions, pc);
+    return range ? &range->die : nullptr;
+}
+
+const dwarf::line_table::iterator *symbol_index::find_line(uint64_t pc) const {
+    auto range = find_range(m_lines, pc);
+    return range ? &range->entry : nullptr;
+}
+
+const symbol *symbol_index::find_symbol(uint64_t addr) const {
+    auto range = find_range(m_symbols, addr);
+    return range ? &range->sym : nullptr;
+}
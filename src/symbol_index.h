@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "libelfin/dwarf/dwarf++.hh"
+#include "libelfin/elf/elf++.hh"
+#include "utility.h"
+
+//address sorted lookup tables over the DWARF info and the ELF symbol tables, built once so that
+//pc -> function/line queries are a binary search instead of a walk over every compilation unit and line table
+class symbol_index {
+public:
+    symbol_index() = default;
+
+    //dwarf may be invalid for objects without debug info, then only the ELF symbols are indexed
+    symbol_index(const elf::elf &elf, const dwarf::dwarf &dwarf);
+
+    //pc is a DWARF (unrelocated) address, nullptr if no function covers it
+    const dwarf::die *find_function(uint64_t pc) const;
+
+    //the line table row covering pc, nullptr if there is none
+    const dwarf::line_table::iterator *find_line(uint64_t pc) const;
+
+    //the function or object symbol covering addr, nullptr if there is none
+    const symbol *find_symbol(uint64_t addr) const;
+
+private:
+    struct function_range {
+        uint64_t low;
+        uint64_t high;
+        dwarf::die die;
+    };
+
+    struct line_range {
+        uint64_t low;
+        uint64_t high;
+        dwarf::line_table::iterator entry;
+    };
+
+    struct symbol_range {
+        uint64_t low;
+        uint64_t high;
+        symbol sym;
+    };
+
+    std::vector<function_range> m_functions;
+    std::vector<symbol_range> m_symbols;
+    std::vector<line_range> m_lines;
+};
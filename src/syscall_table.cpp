@@ -0,0 +1,123 @@
+#include <sys/syscall.h>
+#include <cstdlib>
+
+#include "syscall_table.h"
+
+static const syscall_desc syscalls[] = {
+    {SYS_read, "read", "dpu", false},
+    {SYS_write, "write", "dbu", false},
+    {SYS_open, "open", "sxo", false},
+    {SYS_close, "close", "d", false},
+    {SYS_stat, "stat", "sp", false},
+    {SYS_fstat, "fstat", "dp", false},
+    {SYS_lstat, "lstat", "sp", false},
+    {SYS_poll, "poll", "pud", false},
+    {SYS_lseek, "lseek", "dld", false},
+    {SYS_mmap, "mmap", "puxxdl", true},
+    {SYS_mprotect, "mprotect", "pux", false},
+    {SYS_munmap, "munmap", "pu", false},
+    {SYS_brk, "brk", "p", true},
+    {SYS_rt_sigaction, "rt_sigaction", "dppu", false},
+    {SYS_rt_sigprocmask, "rt_sigprocmask", "dppu", false},
+    {SYS_ioctl, "ioctl", "dxp", false},
+    {SYS_pread64, "pread64", "dpul", false},
+    {SYS_pwrite64, "pwrite64", "dbul", false},
+    {SYS_readv, "readv", "dpd", false},
+    {SYS_writev, "writev", "dpd", false},
+    {SYS_access, "access", "so", false},
+    {SYS_pipe, "pipe", "p", false},
+    {SYS_select, "select", "dpppp", false},
+    {SYS_sched_yield, "sched_yield", "", false},
+    {SYS_mremap, "mremap", "puuxp", true},
+    {SYS_madvise, "madvise", "pud", false},
+    {SYS_dup, "dup", "d", false},
+    {SYS_dup2, "dup2", "dd", false},
+    {SYS_nanosleep, "nanosleep", "pp", false},
+    {SYS_getpid, "getpid", "", false},
+    {SYS_sendfile, "sendfile", "ddpu", false},
+    {SYS_socket, "socket", "ddd", false},
+    {SYS_connect, "connect", "dpu", false},
+    {SYS_accept, "accept", "dpp", false},
+    {SYS_sendto, "sendto", "dbuxpu", false},
+    {SYS_recvfrom, "recvfrom", "dpuxpp", false},
+    {SYS_sendmsg, "sendmsg", "dpx", false},
+    {SYS_recvmsg, "recvmsg", "dpx", false},
+    {SYS_shutdown, "shutdown", "dd", false},
+    {SYS_bind, "bind", "dpu", false},
+    {SYS_listen, "listen", "dd", false},
+    {SYS_clone, "clone", "xpppp", false},
+    {SYS_fork, "fork", "", false},
+    {SYS_vfork, "vfork", "", false},
+    {SYS_execve, "execve", "spp", false},
+    {SYS_exit, "exit", "d", false},
+    {SYS_wait4, "wait4", "dpxp", false},
+    {SYS_kill, "kill", "dd", false},
+    {SYS_uname, "uname", "p", false},
+    {SYS_fcntl, "fcntl", "ddx", false},
+    {SYS_flock, "flock", "dd", false},
+    {SYS_fsync, "fsync", "d", false},
+    {SYS_fdatasync, "fdatasync", "d", false},
+    {SYS_truncate, "truncate", "sl", false},
+    {SYS_ftruncate, "ftruncate", "dl", false},
+    {SYS_getcwd, "getcwd", "pu", false},
+    {SYS_chdir, "chdir", "s", false},
+    {SYS_rename, "rename", "ss", false},
+    {SYS_mkdir, "mkdir", "so", false},
+    {SYS_rmdir, "rmdir", "s", false},
+    {SYS_unlink, "unlink", "s", false},
+    {SYS_readlink, "readlink", "spu", false},
+    {SYS_chmod, "chmod", "so", false},
+    {SYS_getuid, "getuid", "", false},
+    {SYS_arch_prctl, "arch_prctl", "xp", false},
+    {SYS_gettid, "gettid", "", false},
+    {SYS_futex, "futex", "pdupdd", false},
+    {SYS_sched_getaffinity, "sched_getaffinity", "dup", false},
+    {SYS_getdents64, "getdents64", "dpu", false},
+    {SYS_set_tid_address, "set_tid_address", "p", false},
+    {SYS_clock_gettime, "clock_gettime", "dp", false},
+    {SYS_clock_nanosleep, "clock_nanosleep", "ddpp", false},
+    {SYS_exit_group, "exit_group", "d", false},
+    {SYS_epoll_wait, "epoll_wait", "dpdd", false},
+    {SYS_epoll_ctl, "epoll_ctl", "dddp", false},
+    {SYS_tgkill, "tgkill", "ddd", false},
+    {SYS_openat, "openat", "dsxo", false},
+    {SYS_newfstatat, "newfstatat", "dspx", false},
+    {SYS_unlinkat, "unlinkat", "dsx", false},
+    {SYS_set_robust_list, "set_robust_list", "pu", false},
+    {SYS_ppoll, "ppoll", "puppu", false},
+    {SYS_accept4, "accept4", "dppx", false},
+    {SYS_epoll_pwait, "epoll_pwait", "dpddpu", false},
+    {SYS_eventfd2, "eventfd2", "ux", false},
+    {SYS_epoll_create1, "epoll_create1", "x", false},
+    {SYS_pipe2, "pipe2", "px", false},
+    {SYS_prlimit64, "prlimit64", "ddpp", false},
+    {SYS_getrandom, "getrandom", "pux", false},
+    {SYS_statx, "statx", "dsxxp", false},
+    {SYS_rseq, "rseq", "pudd", false},
+    {SYS_clone3, "clone3", "pu", false},
+};
+
+const syscall_desc *find_syscall(long nr) {
+    for (auto &s: syscalls) {
+        if (s.nr == nr) {
+            return &s;
+        }
+    }
+    return nullptr;
+}
+
+long syscall_number(const std::string &name) {
+    for (auto &s: syscalls) {
+        if (name == s.name) {
+            return s.nr;
+        }
+    }
+
+    //syscalls missing from the table can still be traced by number
+    char *end;
+    auto nr = std::strtol(name.c_str(), &end, 10);
+    if (name.empty() || *end != '\0' || nr < 0 || nr > 1023) {
+        return -1;
+    }
+    return nr;
+}
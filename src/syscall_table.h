@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+//how the arguments of a syscall are printed, one letter per argument:
+//d int, l long, u unsigned, x hex, o octal, p pointer, s C string, b buffer whose length is the next argument
+struct syscall_desc {
+    long nr;
+    const char *name;
+    const char *args;
+    bool hex_result; //the result is an address
+};
+
+//nullptr for syscalls that are not in the table
+const syscall_desc *find_syscall(long nr);
+
+//accepts a name or a number, -1 if it is neither
+long syscall_number(const std::string &name);
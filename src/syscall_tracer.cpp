@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <sys/prctl.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "syscall_tracer.h"
+#include "utility.h"
+
+bool syscall_tracer::install_filter(const std::vector<long> &nrs) {
+    //load arch, other ABIs are allowed; load nr, one jump per traced syscall to the TRACE return
+    if (nrs.size() > 250) {
+        return false; //the jump offsets are 8 bit
+    }
+    std::vector<sock_filter> filter;
+    auto n = static_cast<uint8_t>(nrs.size());
+    filter.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, arch)));
+    filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 0, static_cast<uint8_t>(n + 1)));
+    filter.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, nr)));
+    for (uint8_t i = 0; i < n; ++i) {
+        filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<uint32_t>(nrs[i]), static_cast<uint8_t>(n - i), 0));
+    }
+    filter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+    filter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE));
+
+    sock_fprog prog{static_cast<unsigned short>(filter.size()), filter.data()};
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0) {
+        return false;
+    }
+    return prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog) == 0;
+}
+
+bool syscall_tracer::prepare_launch(pid_t pid, long options, const std::vector<long> &nrs) {
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFSTOPPED(status) || WSTOPSIG(status) != SIGSTOP) {
+        return false;
+    }
+    if (counted_ptrace(PTRACE_SETOPTIONS, pid, nullptr, options) < 0 || counted_ptrace(PTRACE_CONT, pid, nullptr, 0) < 0) {
+        return false;
+    }
+    //the filter is in place now and the next syscall is the execve of the program
+    if (std::find(nrs.begin(), nrs.end(), SYS_execve) == nrs.end()) {
+        return true;
+    }
+    if (waitpid(pid, &status, 0) != pid || !WIFSTOPPED(status) || status >> 8 != (SIGTRAP | PTRACE_EVENT_SECCOMP << 8)) {
+        return false;
+    }
+    return counted_ptrace(PTRACE_CONT, pid, nullptr, 0) == 0;
+}
+
+void syscall_tracer::start(const std::string &output) {
+    m_active = true;
+    m_out = &std::cout;
+    if (!output.empty()) {
+        m_file.open(output);
+        if (m_file) {
+            m_out = &m_file;
+        } else {
+            std::cerr << "Cannot open " << output << ", writing to stdout" << std::endl;
+        }
+    }
+}
+
+static void quote(std::ostream &out, const char *data, std::size_t size, bool truncated) {
+    out << '"';
+    for (std::size_t i = 0; i < size; ++i) {
+        switch (data[i]) {
+            case '\n': out << "\\n"; break;
+            case '\t': out << "\\t"; break;
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            default:
+                if (std::isprint(static_cast<unsigned char>(data[i]))) {
+                    out << data[i];
+                } else {
+                    out << "\\x" << std::hex << std::setw(2) << std::setfill('0')
+                        << (static_cast<unsigned>(data[i]) & 0xff) << std::dec;
+                }
+        }
+    }
+    out << '"';
+    if (truncated) {
+        out << "...";
+    }
+}
+
+std::string syscall_tracer::format_call(pid_t tid, long nr, const user_regs_struct &regs) const {
+    static constexpr std::size_t max_string = 32;
+    const uint64_t args[] = {regs.rdi, regs.rsi, regs.rdx, regs.r10, regs.r8, regs.r9};
+
+    auto desc = find_syscall(nr);
+    std::ostringstream out;
+    std::string format = desc ? desc->args : "xxxxxx";
+    if (desc) {
+        out << desc->name;
+    } else {
+        out << "syscall_" << nr;
+    }
+    out << '(';
+
+    for (std::size_t i = 0; i < format.size(); ++i) {
+        if (i) {
+            out << ", ";
+        }
+        auto arg = args[i];
+        switch (format[i]) {
+            case 'd': out << static_cast<int32_t>(arg); break;
+            case 'l': out << static_cast<int64_t>(arg); break;
+            case 'u': out << arg; break;
+            case 'o': out << '0' << std::oct << arg << std::dec; break;
+            case 'x': out << "0x" << std::hex << arg << std::dec; break;
+            case 'p':
+                if (arg) {
+                    out << "0x" << std::hex << arg << std::dec;
+                } else {
+                    out << "NULL";
+                }
+                break;
+            case 's':
+            case 'b': {
+                if (!arg) {
+                    out << "NULL";
+                    break;
+                }
+                char buffer[max_string + 1];
+                auto want = format[i] == 'b' && i + 1 < 6 ? std::min<uint64_t>(args[i + 1], max_string + 1)
+                                                          : max_string + 1;
+                auto got = read_process_memory(tid, arg, buffer, want);
+                if (got <= 0) {
+                    out << "0x" << std::hex << arg << std::dec;
+                    break;
+                }
+                std::size_t size = got;
+                if (format[i] == 's') {
+                    size = strnlen(buffer, got);
+                }
+                quote(out, buffer, std::min(size, max_string), size > max_string);
+                break;
+            }
+        }
+    }
+    out << ')';
+    return out.str();
+}
+
+void syscall_tracer::enter(pid_t tid, const user_regs_struct &regs) {
+    auto nr = static_cast<long>(regs.orig_rax);
+    m_pending[tid] = pending_call{nr, format_call(tid, nr, regs), clock::now()};
+}
+
+void syscall_tracer::exit(pid_t tid, const user_regs_struct &regs) {
+    auto now = clock::now();
+    auto found = m_pending.find(tid);
+    if (found == m_pending.end()) {
+        return;
+    }
+    auto &call = found->second;
+
+    auto ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - call.start).count());
+    auto result = static_cast<int64_t>(regs.rax);
+    bool error = result < 0 && result >= -4095;
+
+    auto &s = m_stats[call.nr];
+    ++s.calls;
+    s.errors += error;
+    s.total_ns += ns;
+    s.min_ns = std::min(s.min_ns, ns);
+    s.max_ns = std::max(s.max_ns, ns);
+    unsigned bucket = 0;
+    for (auto us = ns / 1000; us > 1 && bucket + 1 < n_buckets; us >>= 1) {
+        ++bucket;
+    }
+    ++s.buckets[bucket];
+
+    auto desc = find_syscall(call.nr);
+    auto &out = *m_out;
+    out << '[' << tid << "] " << call.call << " = ";
+    if (error) {
+        out << "-1 " << strerrorname_np(-result) << " (" << strerror(-result) << ')';
+    } else if (desc && desc->hex_result) {
+        out << "0x" << std::hex << result << std::dec;
+    } else {
+        out << result;
+    }
+    out << " <" << ns / 1000 << " us>\n";
+
+    m_pending.erase(found);
+}
+
+void syscall_tracer::print_summary(std::ostream &out) const {
+    out << std::dec << std::left << std::setw(20) << "syscall" << std::right
+        << std::setw(10) << "calls" << std::setw(8) << "errors" << std::setw(12) << "total us"
+        << std::setw(10) << "avg us" << std::setw(10) << "min us" << std::setw(10) << "max us" << '\n';
+    for (auto &[nr, s]: m_stats) {
+        auto desc = find_syscall(nr);
+        out << std::left << std::setw(20) << (desc ? desc->name : "syscall_" + std::to_string(nr)) << std::right
+            << std::setw(10) << s.calls << std::setw(8) << s.errors << std::setw(12) << s.total_ns / 1000
+            << std::setw(10) << s.total_ns / s.calls / 1000 << std::setw(10) << s.min_ns / 1000
+            << std::setw(10) << s.max_ns / 1000 << '\n';
+    }
+
+    for (auto &[nr, s]: m_stats) {
+        auto desc = find_syscall(nr);
+        out << '\n' << (desc ? desc->name : "syscall_" + std::to_string(nr)) << " latency:\n";
+
+        unsigned first = n_buckets, last = 0;
+        uint64_t most = 0;
+        for (unsigned i = 0; i < n_buckets; ++i) {
+            if (s.buckets[i]) {
+                first = std::min(first, i);
+                last = i;
+                most = std::max(most, s.buckets[i]);
+            }
+        }
+        for (auto i = first; i <= last && first < n_buckets; ++i) {
+            uint64_t low = i ? 1ull << i : 0;
+            out << std::setw(10) << low << " - " << std::left << std::setw(10) << (2ull << i) << std::right
+                << " us" << std::setw(10) << s.buckets[i] << " |"
+                << std::string(s.buckets[i] * 40 / most, '#') << '\n';
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+#include <sys/user.h>
+
+#include "syscall_table.h"
+
+//strace-like syscall tracing where only the named syscalls stop the tracee: a seccomp filter
+//returns SECCOMP_RET_TRACE for them and lets every other syscall run without a ptrace stop
+class syscall_tracer {
+public:
+    //installs the filter in the calling process, meant for the child between PTRACE_TRACEME and exec.
+    //Until the tracer sets PTRACE_O_TRACESECCOMP a traced syscall fails with ENOSYS, so the child stops
+    //itself with SIGSTOP before and waits for prepare_launch.
+    static bool install_filter(const std::vector<long> &nrs);
+
+    //the tracer's side: sets options (which must include PTRACE_O_TRACESECCOMP) at the SIGSTOP of the
+    //child and lets a traced execve launching the program pass, the exec SIGTRAP is left to be waited
+    //for. False if the child did not get that far.
+    static bool prepare_launch(pid_t pid, long options, const std::vector<long> &nrs);
+
+    //each finished call is written to output, or to stdout if it is empty
+    void start(const std::string &output);
+
+    bool active() const { return m_active; }
+
+    //the seccomp stop before the syscall runs, the arguments are read from the cached registers
+    void enter(pid_t tid, const user_regs_struct &regs);
+
+    //the syscall exit stop after it
+    void exit(pid_t tid, const user_regs_struct &regs);
+
+    //calls, errors and the latency histogram of each traced syscall
+    void print_summary(std::ostream &out) const;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr unsigned n_buckets = 24; //bucket i counts latencies in [2^i, 2^(i+1)) us
+
+    struct pending_call {
+        long nr;
+        std::string call;
+        clock::time_point start;
+    };
+
+    struct stats {
+        uint64_t calls = 0;
+        uint64_t errors = 0;
+        uint64_t total_ns = 0;
+        uint64_t min_ns = UINT64_MAX;
+        uint64_t max_ns = 0;
+        uint64_t buckets[n_buckets]{};
+    };
+
+    std::string format_call(pid_t tid, long nr, const user_regs_struct &regs) const;
+
+    bool m_active = false;
+    std::ofstream m_file;
+    std::ostream *m_out = nullptr;
+    std::unordered_map<pid_t, pending_call> m_pending;
+    std::map<long, stats> m_stats;
+};
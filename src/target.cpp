@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/procfs.h>
+#include <unistd.h>
+
+#include "target.h"
+#include "utility.h"
+
+bool live_target::read(uint64_t address, void *buffer, std::size_t size) {
+    return m_space.read_from_file(address, buffer, size) ||
+           read_process_memory(m_pid, address, buffer, size) == static_cast<ssize_t>(size);
+}
+
+void live_target::read_many(std::vector<memory_request> &requests) {
+    std::vector<memory_request> from_process;
+    std::vector<std::size_t> index;
+    for (std::size_t i = 0; i < requests.size(); ++i) {
+        auto &r = requests[i];
+        r.ok = m_space.read_from_file(r.address, r.buffer, r.size);
+        if (!r.ok) {
+            from_process.push_back(r);
+            index.push_back(i);
+        }
+    }
+    read_process_memory(m_pid, from_process);
+    for (std::size_t i = 0; i < from_process.size(); ++i) {
+        requests[index[i]].ok = from_process[i].ok;
+    }
+}
+
+bool live_target::write(uint64_t address, const void *buffer, std::size_t size) {
+    m_space.mark_modified(address, size);
+    return write_process_memory(m_pid, address, buffer, size) == static_cast<ssize_t>(size);
+}
+
+bool live_target::registers(pid_t tid, user_regs_struct &regs) {
+    return counted_ptrace(PTRACE_GETREGS, tid, nullptr, &regs) == 0;
+}
+
+std::vector<mapping> live_target::memory_maps() {
+    return m_space.list();
+}
+
+std::string live_target::executable() {
+    char exe[PATH_MAX]{};
+    readlink(("/proc/" + std::to_string(m_pid) + "/exe").c_str(), exe, sizeof(exe) - 1);
+    return exe;
+}
+
+core_target::core_target(const std::string &path) {
+    auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error{"Cannot open " + path + ": " + strerror(errno)};
+    }
+    m_core = elf::elf{elf::create_mmap_loader(fd)};
+    if (m_core.get_hdr().type != elf::et::core) {
+        throw std::runtime_error{path + " is not a core file"};
+    }
+
+    std::vector<mapping> files;
+    for (auto &seg: m_core.segments()) {
+        auto &hdr = seg.get_hdr();
+        if (hdr.type == elf::pt::note) {
+            parse_notes(static_cast<const uint8_t *>(seg.data()), hdr.filesz, files);
+        } else if (hdr.type == elf::pt::load) {
+            auto data = hdr.filesz ? static_cast<const uint8_t *>(seg.data()) : nullptr;
+            m_segments.push_back(segment{hdr.vaddr, hdr.vaddr + hdr.memsz, hdr.filesz, data});
+
+            mapping m{};
+            m.start = hdr.vaddr;
+            m.end = hdr.vaddr + hdr.memsz;
+            m.readable = (hdr.flags & elf::pf::r) == elf::pf::r;
+            m.writable = (hdr.flags & elf::pf::w) == elf::pf::w;
+            m.executable = (hdr.flags & elf::pf::x) == elf::pf::x;
+            m_maps.push_back(m);
+        }
+    }
+
+    auto by_start = [](auto &&a, auto &&b) { return a.start < b.start; };
+    std::sort(m_segments.begin(), m_segments.end(), by_start);
+    std::sort(m_maps.begin(), m_maps.end(), by_start);
+    for (auto &file: files) {
+        auto m = std::lower_bound(m_maps.begin(), m_maps.end(), file, by_start);
+        if (m != m_maps.end() && m->start == file.start) {
+            m->path = file.path;
+            m->offset = file.offset;
+        }
+    }
+
+    //the executable is the file mapped at the entry point
+    for (std::size_t i = 0; i + 1 < m_auxv.size(); i += 2) {
+        if (m_auxv[i] == AT_ENTRY) {
+            if (auto m = find_mapping(m_maps, m_auxv[i + 1])) {
+                m_executable = m->path;
+            }
+        }
+    }
+    if (m_pid == 0 && !m_threads.empty()) {
+        m_pid = m_threads.front().tid;
+    }
+}
+
+void core_target::parse_notes(const uint8_t *notes, std::size_t size, std::vector<mapping> &files) {
+    auto align = [](std::size_t n) { return (n + 3) & ~std::size_t{3}; };
+
+    for (std::size_t pos = 0; pos + sizeof(Elf64_Nhdr) <= size;) {
+        Elf64_Nhdr hdr;
+        std::memcpy(&hdr, notes + pos, sizeof(hdr));
+        auto name = reinterpret_cast<const char *>(notes + pos + sizeof(hdr));
+        auto desc = notes + pos + sizeof(hdr) + align(hdr.n_namesz);
+        pos += sizeof(hdr) + align(hdr.n_namesz) + align(hdr.n_descsz);
+        if (pos > size || hdr.n_namesz != 5 || std::strncmp(name, "CORE", 5) != 0) {
+            continue;
+        }
+
+        if (hdr.n_type == NT_PRSTATUS && hdr.n_descsz >= sizeof(elf_prstatus)) {
+            elf_prstatus status;
+            std::memcpy(&status, desc, sizeof(status));
+            core_thread thread{status.pr_pid, {}, status.pr_cursig};
+            std::memcpy(&thread.regs, &status.pr_reg, sizeof(thread.regs));
+            m_threads.push_back(thread);
+        } else if (hdr.n_type == NT_PRPSINFO && hdr.n_descsz >= sizeof(elf_prpsinfo)) {
+            elf_prpsinfo info;
+            std::memcpy(&info, desc, sizeof(info));
+            m_pid = info.pr_pid;
+        } else if (hdr.n_type == NT_AUXV) {
+            m_auxv.resize(hdr.n_descsz / sizeof(uint64_t));
+            std::memcpy(m_auxv.data(), desc, m_auxv.size() * sizeof(uint64_t));
+        } else if (hdr.n_type == NT_FILE && hdr.n_descsz >= 16) {
+            //count, page size, (start, end, file offset in pages) per mapping, then the names
+            uint64_t header[2];
+            std::memcpy(header, desc, sizeof(header));
+            auto count = header[0];
+            if (16 + count * 24 > hdr.n_descsz) {
+                continue;
+            }
+            auto name_pos = reinterpret_cast<const char *>(desc + 16 + count * 24);
+            auto names_end = reinterpret_cast<const char *>(desc + hdr.n_descsz);
+            for (uint64_t i = 0; i < count && name_pos < names_end; ++i) {
+                uint64_t entry[3];
+                std::memcpy(entry, desc + 16 + i * 24, sizeof(entry));
+                mapping m{};
+                m.start = entry[0];
+                m.end = entry[1];
+                m.offset = entry[2] * header[1];
+                m.path = std::string{name_pos, strnlen(name_pos, names_end - name_pos)};
+                name_pos += m.path.size() + 1;
+                files.push_back(std::move(m));
+            }
+        }
+    }
+}
+
+const core_target::segment *core_target::find_segment(uint64_t address) const {
+    auto it = std::upper_bound(m_segments.begin(), m_segments.end(), address,
+                               [](uint64_t address, auto &&s) { return address < s.start; });
+    if (it == m_segments.begin() || address >= (--it)->end) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+const uint8_t *core_target::view(uint64_t address, std::size_t size) const {
+    auto seg = find_segment(address);
+    if (!seg || address + size > seg->start + seg->file_size) {
+        return nullptr;
+    }
+    return seg->data + (address - seg->start);
+}
+
+bool core_target::read(uint64_t address, void *buffer, std::size_t size) {
+    auto out = static_cast<uint8_t *>(buffer);
+    while (size > 0) {
+        auto seg = find_segment(address);
+        if (!seg) {
+            return false;
+        }
+        auto offset = address - seg->start;
+        std::size_t n = std::min<uint64_t>(size, seg->end - address);
+        if (offset < seg->file_size) {
+            n = std::min<uint64_t>(n, seg->file_size - offset);
+            std::memcpy(out, seg->data + offset, n);
+        } else if (!read_from_file(address, out, n)) {
+            return false;
+        }
+        out += n;
+        address += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool core_target::read_from_file(uint64_t address, void *buffer, std::size_t size) const {
+    auto m = find_mapping(m_maps, address);
+    if (!m || m->path.empty()) {
+        return false;
+    }
+    auto fd = open(m->path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    auto n = pread(fd, buffer, size, m->offset + (address - m->start));
+    close(fd);
+    if (n < 0) {
+        return false;
+    }
+    //the rest of the page the file ends in reads as zeros, the pages after it are not mapped
+    auto end_of_file = address + n;
+    if (static_cast<std::size_t>(n) < size && address + size > ((end_of_file + 0xfff) & ~uint64_t{0xfff})) {
+        return false;
+    }
+    std::memset(static_cast<uint8_t *>(buffer) + n, 0, size - n);
+    return true;
+}
+
+bool core_target::registers(pid_t tid, user_regs_struct &regs) {
+    for (auto &thread: m_threads) {
+        if (thread.tid == tid) {
+            regs = thread.regs;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <sys/user.h>
+
+#include "address_space.h"
+#include "core_writer.h"
+#include "memory_map.h"
+#include "utility.h"
+#include "libelfin/elf/elf++.hh"
+
+//where the debugger takes the memory, registers and mappings of the program from, so that the
+//commands inspecting state work the same on a live process and on a core file
+class target {
+public:
+    virtual ~target() = default;
+
+    //false for a core file, which can only be inspected
+    virtual bool live() const = 0;
+
+    //false unless every byte of the range was read
+    virtual bool read(uint64_t address, void *buffer, std::size_t size) = 0;
+
+    //many ranges at once, e.g. the nodes of one level of a tree
+    virtual void read_many(std::vector<memory_request> &requests) {
+        for (auto &r: requests) {
+            r.ok = read(r.address, r.buffer, r.size);
+        }
+    }
+
+    virtual bool write(uint64_t address, const void *buffer, std::size_t size) = 0;
+
+    //the registers of a stopped thread
+    virtual bool registers(pid_t tid, user_regs_struct &regs) = 0;
+
+    virtual std::vector<mapping> memory_maps() = 0;
+
+    //the mappings may have changed, e.g. a library was loaded
+    virtual void mappings_changed() {}
+
+    //path of the main executable, empty if unknown
+    virtual std::string executable() = 0;
+
+    //the range in place where the target keeps it mapped, nullptr if it has to be copied with read
+    virtual const uint8_t *view(uint64_t, std::size_t) const { return nullptr; }
+};
+
+//reads of read-only data of mapped files are served from the files, everything else goes to the process
+class live_target : public target {
+public:
+    explicit live_target(pid_t pid) : m_pid{pid}, m_space{pid} {}
+
+    bool live() const override { return true; }
+
+    bool read(uint64_t address, void *buffer, std::size_t size) override;
+
+    void read_many(std::vector<memory_request> &requests) override;
+
+    bool write(uint64_t address, const void *buffer, std::size_t size) override;
+
+    bool registers(pid_t tid, user_regs_struct &regs) override;
+
+    std::vector<mapping> memory_maps() override;
+
+    void mappings_changed() override { m_space.invalidate(); }
+
+    void set_code_overlay(address_space::code_overlay overlay) { m_space.set_code_overlay(std::move(overlay)); }
+
+    std::string executable() override;
+
+private:
+    pid_t m_pid;
+    address_space m_space;
+};
+
+//an ELF core file mapped with the elf loader: memory is served straight from its PT_LOAD segments,
+//the threads and their registers come from the NT_PRSTATUS notes and the file names from NT_FILE
+class core_target : public target {
+public:
+    //throws if path is not a readable ELF core
+    explicit core_target(const std::string &path);
+
+    bool live() const override { return false; }
+
+    bool read(uint64_t address, void *buffer, std::size_t size) override;
+
+    bool write(uint64_t, const void *, std::size_t) override { return false; }
+
+    bool registers(pid_t tid, user_regs_struct &regs) override;
+
+    std::vector<mapping> memory_maps() override { return m_maps; }
+
+    std::string executable() override { return m_executable; }
+
+    //points into the mapped core, nullptr unless the whole range is stored in one segment
+    const uint8_t *view(uint64_t address, std::size_t size) const override;
+
+    pid_t pid() const { return m_pid; }
+
+    //the thread that crashed, or was current when the core was written, comes first
+    const std::vector<core_thread> &threads() const { return m_threads; }
+
+private:
+    struct segment {
+        uint64_t start;
+        uint64_t end;
+        uint64_t file_size; //the rest of the segment was not dumped
+        const uint8_t *data;
+    };
+
+    const segment *find_segment(uint64_t address) const;
+
+    //bytes of a mapped file, for the read-only parts of executables and libraries a core leaves out
+    bool read_from_file(uint64_t address, void *buffer, std::size_t size) const;
+
+    //collects the threads, the auxiliary vector and the mapped files (into files)
+    void parse_notes(const uint8_t *notes, std::size_t size, std::vector<mapping> &files);
+
+    elf::elf m_core;
+    std::vector<segment> m_segments; //sorted by address
+    std::vector<core_thread> m_threads;
+    std::vector<mapping> m_maps;
+    std::vector<uint64_t> m_auxv;
+    std::string m_executable;
+    pid_t m_pid = 0;
+};
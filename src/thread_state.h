@@ -0,0 +1,18 @@
+#pragma once
+
+#include <sys/types.h>
+#include <sys/user.h>
+
+//per-thread bookkeeping of the tracee, the registers are cached while the thread is stopped
+struct thread_state {
+    pid_t tid = 0;
+    bool stopped = false;
+    bool new_thread = false;      //waiting for the initial SIGSTOP of a freshly cloned thread
+    bool stepping = false;
+    bool interrupt_requested = false; //its next SIGSTOP or PTRACE_EVENT_STOP is the user's interrupt
+    bool in_syscall = false;      //stopped at a traced syscall entry, resumed to its exit
+    int pending_signal = 0;       //signal to deliver on the next resume
+    user_regs_struct regs{};
+    bool regs_valid = false;
+    bool regs_dirty = false;
+};
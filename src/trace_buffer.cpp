@@ -0,0 +1,282 @@
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "trace_buffer.h"
+
+namespace {
+    constexpr char trace_magic[8] = {'M', 'E', 'G', 'A', 'T', 'R', 'C', '1'};
+
+    enum class record_type : uint16_t { definition, hit };
+
+    struct record_header {
+        uint32_t size; //including the header
+        record_type type;
+        uint16_t tracepoint;
+    };
+
+    struct hit_header {
+        uint64_t time;
+        uint64_t pc;
+        uint64_t missing;
+        uint32_t tid;
+        uint32_t count;
+    };
+
+    //fits the largest hit, so a hit is assembled on the stack and pushed in one piece
+    constexpr std::size_t max_hit_size = sizeof(record_header) + sizeof(hit_header) + max_trace_values * 8;
+
+    template<typename T>
+    T read_at(const std::vector<uint8_t> &data, std::size_t offset) {
+        if (offset + sizeof(T) > data.size()) {
+            throw std::runtime_error{"Truncated trace record"};
+        }
+        T value;
+        std::memcpy(&value, data.data() + offset, sizeof(T));
+        return value;
+    }
+
+    std::string read_string(const std::vector<uint8_t> &data, std::size_t &offset, std::size_t end) {
+        auto start = offset;
+        while (offset < end && data[offset]) {
+            ++offset;
+        }
+        if (offset == end) {
+            throw std::runtime_error{"Truncated trace record"};
+        }
+        return std::string{data.begin() + start, data.begin() + offset++};
+    }
+
+    void print_value(std::ostream &out, trace_format format, uint64_t value) {
+        switch (format) {
+            case trace_format::signed_integer:
+                out << std::dec << static_cast<int64_t>(value);
+                break;
+            case trace_format::unsigned_integer:
+                out << std::dec << value;
+                break;
+            case trace_format::floating: {
+                double d;
+                std::memcpy(&d, &value, sizeof(d));
+                out << std::defaultfloat << d;
+                break;
+            }
+            case trace_format::address:
+                out << "0x" << std::hex << value;
+                break;
+        }
+    }
+}
+
+trace_buffer::trace_buffer(const std::string &path, std::size_t capacity) : m_path{path} {
+    std::size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    m_ring.resize(size);
+
+    m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        throw std::runtime_error{"Cannot create " + path + ": " + std::strerror(errno)};
+    }
+    push(trace_magic, sizeof(trace_magic));
+    m_thread = std::thread{&trace_buffer::drain, this};
+}
+
+trace_buffer::~trace_buffer() {
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+    ::close(m_fd);
+}
+
+bool trace_buffer::push(const void *data, std::size_t size) {
+    auto head = m_head.load(std::memory_order_relaxed);
+    auto tail = m_tail.load(std::memory_order_acquire);
+    if (m_ring.size() - (head - tail) < size) {
+        return false;
+    }
+
+    auto mask = m_ring.size() - 1;
+    auto at = head & mask;
+    auto first = std::min(size, m_ring.size() - at);
+    std::memcpy(m_ring.data() + at, data, first);
+    std::memcpy(m_ring.data(), static_cast<const uint8_t *>(data) + first, size - first);
+    m_head.store(head + size, std::memory_order_release);
+
+    //the flush thread also looks every 100 ms, it is only woken when the ring fills up
+    auto half = m_ring.size() / 2;
+    if (head - tail < half && head + size - tail >= half) {
+        m_wake.notify_one();
+    }
+    return true;
+}
+
+void trace_buffer::define(uint16_t number, uint64_t address, const std::string &location,
+                          const std::vector<trace_value> &values) {
+    std::vector<uint8_t> record(sizeof(record_header));
+    auto append = [&](const void *data, std::size_t size) {
+        auto p = static_cast<const uint8_t *>(data);
+        record.insert(record.end(), p, p + size);
+    };
+    append(&address, sizeof(address));
+    uint16_t count = values.size();
+    append(&count, sizeof(count));
+    for (auto &v: values) {
+        append(&v.format, sizeof(v.format));
+        append(v.name.c_str(), v.name.size() + 1);
+    }
+    append(location.c_str(), location.size() + 1);
+
+    record_header header{static_cast<uint32_t>(record.size()), record_type::definition, number};
+    std::memcpy(record.data(), &header, sizeof(header));
+    if (record.size() > m_ring.size()) {
+        throw std::runtime_error{"Tracepoint definition too large"};
+    }
+    while (!push(record.data(), record.size())) {
+        flush();
+    }
+}
+
+bool trace_buffer::record(uint16_t number, uint64_t time, uint64_t pc, uint32_t tid, uint64_t missing,
+                          const uint64_t *values, uint16_t count) {
+    uint8_t record[max_hit_size];
+    auto size = sizeof(record_header) + sizeof(hit_header) + count * sizeof(uint64_t);
+    record_header header{static_cast<uint32_t>(size), record_type::hit, number};
+    hit_header hit{time, pc, missing, tid, count};
+    std::memcpy(record, &header, sizeof(header));
+    std::memcpy(record + sizeof(header), &hit, sizeof(hit));
+    std::memcpy(record + sizeof(header) + sizeof(hit), values, count * sizeof(uint64_t));
+
+    if (!push(record, size)) {
+        ++m_dropped;
+        return false;
+    }
+    ++m_records;
+    return true;
+}
+
+void trace_buffer::flush() {
+    auto target = m_head.load(std::memory_order_relaxed);
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_flush_requested = true;
+    m_wake.notify_one();
+    m_flushed.wait(lock, [&] { return m_tail.load(std::memory_order_acquire) >= target; });
+}
+
+void trace_buffer::drain() {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    while (true) {
+        m_wake.wait_for(lock, std::chrono::milliseconds{100}, [&] {
+            return m_stop || m_flush_requested ||
+                   m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_relaxed) >= m_ring.size() / 2;
+        });
+        auto stop = m_stop;
+        m_flush_requested = false;
+        auto head = m_head.load(std::memory_order_acquire);
+        auto tail = m_tail.load(std::memory_order_relaxed);
+
+        lock.unlock();
+        write_out(tail, head);
+        m_tail.store(head, std::memory_order_release);
+        lock.lock();
+
+        m_flushed.notify_all();
+        if (stop) {
+            return;
+        }
+    }
+}
+
+void trace_buffer::write_out(uint64_t from, uint64_t to) {
+    auto mask = m_ring.size() - 1;
+    while (from < to) {
+        auto at = from & mask;
+        auto size = std::min<uint64_t>(to - from, m_ring.size() - at);
+        auto written = ::write(m_fd, m_ring.data() + at, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return; //the disk is full, the rest is lost like a dropped hit
+        }
+        from += written;
+    }
+}
+
+void dump_trace(const std::string &path, std::ostream &out) {
+    std::ifstream file{path, std::ios::binary};
+    if (!file) {
+        throw std::runtime_error{"Cannot open " + path};
+    }
+    std::vector<uint8_t> data{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    if (data.size() < sizeof(trace_magic) || std::memcmp(data.data(), trace_magic, sizeof(trace_magic)) != 0) {
+        throw std::runtime_error{path + " is not a trace file"};
+    }
+
+    struct definition {
+        std::vector<trace_value> values;
+    };
+    std::map<uint16_t, definition> tracepoints;
+    uint64_t first_time = 0;
+    std::size_t hits = 0;
+
+    for (std::size_t offset = sizeof(trace_magic); offset < data.size();) {
+        auto header = read_at<record_header>(data, offset);
+        auto end = offset + header.size;
+        if (header.size < sizeof(header) || end > data.size()) {
+            throw std::runtime_error{"Truncated trace record"};
+        }
+        auto p = offset + sizeof(header);
+
+        if (header.type == record_type::definition) {
+            auto address = read_at<uint64_t>(data, p);
+            auto count = read_at<uint16_t>(data, p + 8);
+            p += 10;
+            definition def;
+            for (uint16_t i = 0; i < count; ++i) {
+                auto format = read_at<trace_format>(data, p++);
+                def.values.push_back(trace_value{read_string(data, p, end), format});
+            }
+            auto location = read_string(data, p, end);
+            out << "Tracepoint " << std::dec << header.tracepoint << " at 0x" << std::hex << address;
+            if (!location.empty()) {
+                out << " in " << location;
+            }
+            out << std::endl;
+            tracepoints[header.tracepoint] = std::move(def);
+        } else if (header.type == record_type::hit) {
+            auto hit = read_at<hit_header>(data, p);
+            p += sizeof(hit);
+            if (!hits++) {
+                first_time = hit.time;
+            }
+            auto found = tracepoints.find(header.tracepoint);
+            out << std::dec << std::fixed << std::setprecision(6) << (hit.time - first_time) / 1e9 << " tid " << hit.tid
+                << " #" << header.tracepoint << " 0x" << std::hex << hit.pc;
+            for (uint32_t i = 0; i < hit.count; ++i) {
+                auto value = read_at<uint64_t>(data, p + i * 8);
+                auto known = found != tracepoints.end() && i < found->second.values.size();
+                out << (i ? ", " : "  ") << (known ? found->second.values[i].name : "$" + std::to_string(i)) << " = ";
+                if (hit.missing >> i & 1) {
+                    out << "<unavailable>";
+                } else {
+                    print_value(out, known ? found->second.values[i].format : trace_format::address, value);
+                }
+            }
+            out << '\n';
+        }
+        offset = end;
+    }
+    out << std::dec << hits << (hits == 1 ? " hit of " : " hits of ") << tracepoints.size()
+        << (tracepoints.size() == 1 ? " tracepoint" : " tracepoints") << std::endl;
+}
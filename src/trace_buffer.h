@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//how tdump shows a collected value
+enum class trace_format : uint8_t { signed_integer, unsigned_integer, floating, address };
+
+struct trace_value {
+    std::string name; //the expression text
+    trace_format format;
+};
+
+static constexpr std::size_t max_trace_values = 64;
+
+//the records of tracepoint hits on their way to the trace file. Hits are copied into a ring buffer
+//allocated up front and a thread of the buffer writes them out, so recording a hit takes no syscall
+//and no allocation. A hit that finds the ring full is dropped and counted rather than waited for.
+//
+//The file starts with "MEGATRC1", then records of a trace_record_header and a payload: a definition
+//(address, value count, per value its format and its NUL terminated name, the NUL terminated
+//location) or a hit (monotonic time in ns, pc, tid, bit mask of the values that could not be read,
+//one 64 bit word per value).
+class trace_buffer {
+public:
+    //throws std::runtime_error if path cannot be created
+    explicit trace_buffer(const std::string &path, std::size_t capacity = 4 << 20);
+
+    //writes out what is left and ends the flush thread
+    ~trace_buffer();
+
+    trace_buffer(const trace_buffer &) = delete;
+
+    trace_buffer &operator=(const trace_buffer &) = delete;
+
+    //announces tracepoint number, waits for room rather than dropping it
+    void define(uint16_t number, uint64_t address, const std::string &location, const std::vector<trace_value> &values);
+
+    //called by one thread only, false if the hit was dropped
+    bool record(uint16_t number, uint64_t time, uint64_t pc, uint32_t tid, uint64_t missing, const uint64_t *values,
+                uint16_t count);
+
+    //returns once everything recorded so far is in the file
+    void flush();
+
+    const std::string &path() const { return m_path; }
+
+    uint64_t records() const { return m_records; }
+
+    uint64_t dropped() const { return m_dropped; }
+
+private:
+    bool push(const void *data, std::size_t size);
+
+    //the flush thread
+    void drain();
+
+    void write_out(uint64_t from, uint64_t to);
+
+    std::string m_path;
+    int m_fd = -1;
+    std::vector<uint8_t> m_ring; //a power of two bytes
+    std::atomic<uint64_t> m_head{0}; //bytes ever pushed, only the recording thread advances it
+    std::atomic<uint64_t> m_tail{0}; //bytes ever written out, only the flush thread advances it
+    uint64_t m_records = 0;
+    uint64_t m_dropped = 0;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;    //the flush thread: the ring is half full, a flush or the end
+    std::condition_variable m_flushed; //flush(): the tail moved
+    bool m_flush_requested = false;
+    bool m_stop = false;
+    std::thread m_thread;
+};
+
+//decodes a trace file into a line per hit, with the times relative to the first hit. Throws
+//std::runtime_error if path is not a trace file.
+void dump_trace(const std::string &path, std::ostream &out);
@@ -0,0 +1,499 @@
+#include <algorithm>
+#include <cstring>
+
+#include "unwinder.h"
+#include "module.h"
+
+namespace {
+    //DW_EH_PE_* pointer encodings of .eh_frame
+    constexpr uint8_t pe_omit = 0xff;
+    constexpr uint8_t pe_pcrel = 0x10;
+
+    struct byte_cursor {
+        const uint8_t *p;
+        const uint8_t *end;
+        uint64_t base_addr; //address of the byte the section data starts with
+        const uint8_t *base;
+
+        template<typename T>
+        T fixed() {
+            T v{};
+            if (p + sizeof(T) <= end) {
+                std::memcpy(&v, p, sizeof(T));
+            }
+            p += sizeof(T);
+            return v;
+        }
+
+        uint64_t uleb() {
+            uint64_t result = 0;
+            unsigned shift = 0;
+            while (p < end) {
+                auto byte = *p++;
+                result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                shift += 7;
+                if (!(byte & 0x80)) {
+                    break;
+                }
+            }
+            return result;
+        }
+
+        int64_t sleb() {
+            int64_t result = 0;
+            unsigned shift = 0;
+            uint8_t byte = 0;
+            while (p < end) {
+                byte = *p++;
+                result |= static_cast<int64_t>(byte & 0x7f) << shift;
+                shift += 7;
+                if (!(byte & 0x80)) {
+                    break;
+                }
+            }
+            if (shift < 64 && (byte & 0x40)) {
+                result |= -(static_cast<int64_t>(1) << shift);
+            }
+            return result;
+        }
+
+        uint64_t encoded(uint8_t encoding) {
+            if (encoding == pe_omit) {
+                return 0;
+            }
+            auto field_addr = base_addr + (p - base);
+            uint64_t value;
+            switch (encoding & 0x0f) {
+                case 0x01: value = uleb(); break;
+                case 0x02: value = fixed<uint16_t>(); break;
+                case 0x03: value = fixed<uint32_t>(); break;
+                case 0x09: value = sleb(); break;
+                case 0x0a: value = fixed<int16_t>(); break;
+                case 0x0b: value = fixed<int32_t>(); break;
+                default: value = fixed<uint64_t>(); break; //absptr, udata8, sdata8
+            }
+            if ((encoding & 0x70) == pe_pcrel) {
+                value += field_addr;
+            }
+            return value;
+        }
+    };
+
+    bool evaluate(const uint8_t *p, const uint8_t *end, const uint64_t *regs, const bool *valid,
+                  const memory_reader &read, std::vector<uint64_t> stack, uint64_t &result) {
+        byte_cursor cur{p, end, 0, p};
+        auto pop = [&stack]() {
+            auto v = stack.empty() ? 0 : stack.back();
+            if (!stack.empty()) {
+                stack.pop_back();
+            }
+            return v;
+        };
+
+        while (cur.p < cur.end) {
+            auto op = *cur.p++;
+            if (op >= 0x30 && op <= 0x4f) { //lit0-31
+                stack.push_back(op - 0x30);
+                continue;
+            }
+            if ((op >= 0x70 && op <= 0x8f) || op == 0x92) { //breg0-31, bregx
+                unsigned r = op == 0x92 ? cur.uleb() : op - 0x70;
+                auto offset = cur.sleb();
+                if (r >= n_cfi_registers || !valid[r]) {
+                    return false;
+                }
+                stack.push_back(regs[r] + offset);
+                continue;
+            }
+
+            int64_t b, a;
+            switch (op) {
+                case 0x03: stack.push_back(cur.fixed<uint64_t>()); break;
+                case 0x06: {
+                    uint64_t value;
+                    if (!read(pop(), &value, sizeof(value))) {
+                        return false;
+                    }
+                    stack.push_back(value);
+                    break;
+                }
+                case 0x08: stack.push_back(cur.fixed<uint8_t>()); break;
+                case 0x09: stack.push_back(cur.fixed<int8_t>()); break;
+                case 0x0a: stack.push_back(cur.fixed<uint16_t>()); break;
+                case 0x0b: stack.push_back(cur.fixed<int16_t>()); break;
+                case 0x0c: stack.push_back(cur.fixed<uint32_t>()); break;
+                case 0x0d: stack.push_back(cur.fixed<int32_t>()); break;
+                case 0x0e: stack.push_back(cur.fixed<uint64_t>()); break;
+                case 0x0f: stack.push_back(cur.fixed<int64_t>()); break;
+                case 0x10: stack.push_back(cur.uleb()); break;
+                case 0x11: stack.push_back(cur.sleb()); break;
+                case 0x12: stack.push_back(stack.empty() ? 0 : stack.back()); break;
+                case 0x13: pop(); break;
+                case 0x14: stack.push_back(stack.size() < 2 ? 0 : stack[stack.size() - 2]); break;
+                case 0x16: b = pop(); a = pop(); stack.push_back(b); stack.push_back(a); break;
+                case 0x1a: b = pop(); a = pop(); stack.push_back(a & b); break;
+                case 0x1c: b = pop(); a = pop(); stack.push_back(a - b); break;
+                case 0x1e: b = pop(); a = pop(); stack.push_back(a * b); break;
+                case 0x21: b = pop(); a = pop(); stack.push_back(a | b); break;
+                case 0x22: b = pop(); a = pop(); stack.push_back(a + b); break;
+                case 0x23: stack.push_back(pop() + cur.uleb()); break;
+                case 0x24: b = pop(); a = pop(); stack.push_back(static_cast<uint64_t>(a) << b); break;
+                case 0x25: b = pop(); a = pop(); stack.push_back(static_cast<uint64_t>(a) >> b); break;
+                case 0x26: b = pop(); a = pop(); stack.push_back(a >> b); break;
+                case 0x27: b = pop(); a = pop(); stack.push_back(a ^ b); break;
+                case 0x29: b = pop(); a = pop(); stack.push_back(a == b); break;
+                case 0x2a: b = pop(); a = pop(); stack.push_back(a >= b); break;
+                case 0x2b: b = pop(); a = pop(); stack.push_back(a > b); break;
+                case 0x2c: b = pop(); a = pop(); stack.push_back(a <= b); break;
+                case 0x2d: b = pop(); a = pop(); stack.push_back(a < b); break;
+                case 0x2e: b = pop(); a = pop(); stack.push_back(a != b); break;
+                case 0x96: break;
+                default:
+                    return false; //not used by call frame information in practice
+            }
+        }
+
+        if (stack.empty()) {
+            return false;
+        }
+        result = stack.back();
+        return true;
+    }
+}
+
+cfi_table::cfi_table(const elf::elf &elf) : m_elf{elf} {
+    auto &eh_frame = m_elf.get_section(".eh_frame");
+    if (eh_frame.valid() && eh_frame.size()) {
+        parse(eh_frame, true);
+        return;
+    }
+    auto &debug_frame = m_elf.get_section(".debug_frame");
+    if (debug_frame.valid() && debug_frame.size()) {
+        parse(debug_frame, false);
+    }
+}
+
+void cfi_table::parse(const elf::section &sec, bool eh_frame) {
+    m_data = static_cast<const uint8_t *>(sec.data());
+    m_size = sec.size();
+    m_section_addr = sec.get_hdr().addr;
+    m_eh_frame = eh_frame;
+
+    byte_cursor cur{m_data, m_data + m_size, m_section_addr, m_data};
+    while (cur.p + 4 <= cur.end) {
+        auto start = cur.p;
+        uint64_t length = cur.fixed<uint32_t>();
+        if (length == 0) {
+            if (eh_frame) {
+                break; //terminator
+            }
+            continue;
+        }
+        bool is64 = length == 0xffffffff;
+        if (is64) {
+            length = cur.fixed<uint64_t>();
+        }
+        auto body = cur.p;
+        auto next = body + length;
+        if (next > cur.end) {
+            break;
+        }
+
+        uint64_t id = is64 ? cur.fixed<uint64_t>() : cur.fixed<uint32_t>();
+        bool is_cie = eh_frame ? id == 0 : id == (is64 ? ~0ull : 0xffffffffull);
+        if (is_cie) {
+            get_cie(start - m_data);
+        } else {
+            //.eh_frame stores the distance back to the CIE, .debug_frame its section offset
+            uint64_t cie_offset = eh_frame ? (body - m_data) - id : id;
+            if (auto c = get_cie(cie_offset)) {
+                byte_cursor fields{cur.p, next, m_section_addr, m_data};
+                auto low = fields.encoded(c->fde_encoding);
+                auto range = fields.encoded(c->fde_encoding & 0x0f);
+                if (c->augmentation_data) {
+                    auto len = fields.uleb();
+                    fields.p += len;
+                }
+                if (low) {
+                    m_fdes.push_back(fde{low, low + range, cie_offset, fields.p, next});
+                }
+            }
+        }
+        cur.p = next;
+    }
+
+    std::sort(m_fdes.begin(), m_fdes.end(), [](auto &&a, auto &&b) { return a.low < b.low; });
+}
+
+const cfi_table::cie *cfi_table::get_cie(uint64_t offset) const {
+    auto it = m_cies.find(offset);
+    if (it != m_cies.end()) {
+        return &it->second;
+    }
+    if (offset + 4 > m_size) {
+        return nullptr;
+    }
+
+    byte_cursor cur{m_data + offset, m_data + m_size, m_section_addr, m_data};
+    uint64_t length = cur.fixed<uint32_t>();
+    bool is64 = length == 0xffffffff;
+    if (is64) {
+        length = cur.fixed<uint64_t>();
+    }
+    auto next = cur.p + length;
+    if (next > cur.end) {
+        return nullptr;
+    }
+    cur.end = next;
+    cur.p += is64 ? 8 : 4; //CIE id
+
+    auto version = cur.fixed<uint8_t>();
+    std::string augmentation{reinterpret_cast<const char *>(cur.p)};
+    cur.p += augmentation.size() + 1;
+    if (version >= 4) {
+        cur.p += 2; //address_size, segment_selector_size
+    }
+
+    cie c{};
+    c.code_align = cur.uleb();
+    c.data_align = cur.sleb();
+    c.ra_reg = version == 1 ? cur.fixed<uint8_t>() : cur.uleb();
+    c.fde_encoding = 0;
+    c.augmentation_data = !augmentation.empty() && augmentation[0] == 'z';
+
+    if (c.augmentation_data) {
+        auto len = cur.uleb();
+        auto data_end = cur.p + len;
+        for (auto ch: augmentation.substr(1)) {
+            if (ch == 'R') {
+                c.fde_encoding = cur.fixed<uint8_t>();
+            } else if (ch == 'P') {
+                cur.encoded(cur.fixed<uint8_t>());
+            } else if (ch == 'L') {
+                cur.fixed<uint8_t>();
+            }
+        }
+        cur.p = data_end;
+    }
+    c.instructions = cur.p;
+    c.end = next;
+
+    return &(m_cies[offset] = c);
+}
+
+bool cfi_table::execute(const cie &c, const uint8_t *p, const uint8_t *end, uint64_t loc, uint64_t pc,
+                        frame_rules &rules, const frame_rules &initial) const {
+    byte_cursor cur{p, end, m_section_addr, m_data};
+    std::vector<frame_rules> remembered;
+
+    auto set = [&rules](uint64_t r, rule::kind type, int64_t value) {
+        if (r < n_cfi_registers) {
+            rules.regs[r].type = type;
+            rules.regs[r].value = value;
+        }
+    };
+    auto set_expr = [&rules, &cur](uint64_t r, rule::kind type) {
+        auto len = cur.uleb();
+        if (r < n_cfi_registers) {
+            rules.regs[r].type = type;
+            rules.regs[r].expr = cur.p;
+            rules.regs[r].expr_end = cur.p + len;
+        }
+        cur.p += len;
+    };
+    auto advance = [&loc, pc](uint64_t delta) {
+        loc += delta;
+        return loc > pc; //the current row covers pc
+    };
+
+    while (cur.p < cur.end) {
+        auto op = *cur.p++;
+        auto operand = op & 0x3f;
+
+        switch (op & 0xc0) {
+            case 0x40: //DW_CFA_advance_loc
+                if (advance(operand * c.code_align)) {
+                    return true;
+                }
+                continue;
+            case 0x80: //DW_CFA_offset
+                set(operand, rule::kind::offset, cur.uleb() * c.data_align);
+                continue;
+            case 0xc0: //DW_CFA_restore
+                if (operand < n_cfi_registers) {
+                    rules.regs[operand] = initial.regs[operand];
+                }
+                continue;
+        }
+
+        uint64_t r;
+        switch (op) {
+            case 0x00: break;
+            case 0x01:
+                loc = cur.encoded(c.fde_encoding);
+                if (loc > pc) {
+                    return true;
+                }
+                break;
+            case 0x02: if (advance(cur.fixed<uint8_t>() * c.code_align)) return true; break;
+            case 0x03: if (advance(cur.fixed<uint16_t>() * c.code_align)) return true; break;
+            case 0x04: if (advance(cur.fixed<uint32_t>() * c.code_align)) return true; break;
+            case 0x05: r = cur.uleb(); set(r, rule::kind::offset, cur.uleb() * c.data_align); break;
+            case 0x06:
+                r = cur.uleb();
+                if (r < n_cfi_registers) {
+                    rules.regs[r] = initial.regs[r];
+                }
+                break;
+            case 0x07: set(cur.uleb(), rule::kind::undefined, 0); break;
+            case 0x08: set(cur.uleb(), rule::kind::same, 0); break;
+            case 0x09: r = cur.uleb(); set(r, rule::kind::reg, cur.uleb()); break;
+            case 0x0a: remembered.push_back(rules); break;
+            case 0x0b:
+                if (!remembered.empty()) {
+                    rules = remembered.back();
+                    remembered.pop_back();
+                }
+                break;
+            case 0x0c:
+                rules.cfa_reg = cur.uleb();
+                rules.cfa_offset = cur.uleb();
+                rules.cfa_expr = nullptr;
+                break;
+            case 0x0d: rules.cfa_reg = cur.uleb(); rules.cfa_expr = nullptr; break;
+            case 0x0e: rules.cfa_offset = cur.uleb(); break;
+            case 0x0f: {
+                auto len = cur.uleb();
+                rules.cfa_expr = cur.p;
+                rules.cfa_expr_end = cur.p + len;
+                cur.p += len;
+                break;
+            }
+            case 0x10: set_expr(cur.uleb(), rule::kind::expression); break;
+            case 0x11: r = cur.uleb(); set(r, rule::kind::offset, cur.sleb() * c.data_align); break;
+            case 0x12:
+                rules.cfa_reg = cur.uleb();
+                rules.cfa_offset = cur.sleb() * c.data_align;
+                rules.cfa_expr = nullptr;
+                break;
+            case 0x13: rules.cfa_offset = cur.sleb() * c.data_align; break;
+            case 0x14: r = cur.uleb(); set(r, rule::kind::val_offset, cur.uleb() * c.data_align); break;
+            case 0x15: r = cur.uleb(); set(r, rule::kind::val_offset, cur.sleb() * c.data_align); break;
+            case 0x16: set_expr(cur.uleb(), rule::kind::val_expression); break;
+            case 0x2e: cur.uleb(); break; //DW_CFA_GNU_args_size
+            case 0x2f: r = cur.uleb(); set(r, rule::kind::offset, -static_cast<int64_t>(cur.uleb()) * c.data_align); break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+bool cfi_table::find_rules(uint64_t pc, frame_rules &out) const {
+    auto it = std::upper_bound(m_fdes.begin(), m_fdes.end(), pc,
+                               [](uint64_t pc, auto &&f) { return pc < f.low; });
+    if (it == m_fdes.begin()) {
+        return false;
+    }
+    --it;
+    if (pc >= it->high) {
+        return false;
+    }
+
+    auto c = get_cie(it->cie_offset);
+    frame_rules initial{};
+    if (!execute(*c, c->instructions, c->end, it->low, UINT64_MAX, initial, initial)) {
+        return false;
+    }
+    out = initial;
+    return execute(*c, it->instructions, it->end, it->low, pc, out, initial);
+}
+
+std::vector<stack_frame> unwind_stack(module_table &modules, const user_regs_struct &regs,
+                                      const memory_reader &read, std::size_t max_frames) {
+    uint64_t r[n_cfi_registers] = {
+            regs.rax, regs.rdx, regs.rcx, regs.rbx, regs.rsi, regs.rdi, regs.rbp, regs.rsp,
+            regs.r8, regs.r9, regs.r10, regs.r11, regs.r12, regs.r13, regs.r14, regs.r15, regs.rip};
+    bool valid[n_cfi_registers];
+    std::fill(std::begin(valid), std::end(valid), true);
+
+    std::vector<stack_frame> frames;
+    while (frames.size() < max_frames && valid[cfi_return_address] && r[cfi_return_address]) {
+        auto pc = r[cfi_return_address];
+        //a return address points after the call, which may already be the next function
+        auto lookup = frames.empty() ? pc : pc - 1;
+
+        uint64_t next[n_cfi_registers];
+        bool next_valid[n_cfi_registers];
+        std::copy(std::begin(r), std::end(r), next);
+        std::copy(std::begin(valid), std::end(valid), next_valid);
+        uint64_t cfa;
+
+        cfi_table::frame_rules rules;
+        auto m = modules.find(lookup);
+        auto cfi = m ? m->cfi() : nullptr;
+        if (cfi && cfi->find_rules(lookup - m->bias(), rules)) {
+            if (rules.cfa_expr) {
+                if (!evaluate(rules.cfa_expr, rules.cfa_expr_end, r, valid, read, {}, cfa)) {
+                    break;
+                }
+            } else {
+                if (rules.cfa_reg >= n_cfi_registers || !valid[rules.cfa_reg]) {
+                    break;
+                }
+                cfa = r[rules.cfa_reg] + rules.cfa_offset;
+            }
+
+            for (unsigned i = 0; i < n_cfi_registers; ++i) {
+                auto &rule = rules.regs[i];
+                uint64_t address;
+                switch (rule.type) {
+                    case cfi_table::rule::kind::same:
+                        break;
+                    case cfi_table::rule::kind::undefined:
+                        next_valid[i] = false;
+                        break;
+                    case cfi_table::rule::kind::offset:
+                        next_valid[i] = read(cfa + rule.value, &next[i], sizeof(uint64_t));
+                        break;
+                    case cfi_table::rule::kind::val_offset:
+                        next[i] = cfa + rule.value;
+                        break;
+                    case cfi_table::rule::kind::reg:
+                        next[i] = rule.value < n_cfi_registers ? r[rule.value] : 0;
+                        next_valid[i] = rule.value < n_cfi_registers && valid[rule.value];
+                        break;
+                    case cfi_table::rule::kind::expression:
+                        next_valid[i] = evaluate(rule.expr, rule.expr_end, r, valid, read, {cfa}, address)
+                                        && read(address, &next[i], sizeof(uint64_t));
+                        break;
+                    case cfi_table::rule::kind::val_expression:
+                        next_valid[i] = evaluate(rule.expr, rule.expr_end, r, valid, read, {cfa}, next[i]);
+                        break;
+                }
+            }
+        } else {
+            //no CFI: assume the usual push %rbp; mov %rsp,%rbp frame
+            auto fp = r[6];
+            if (!valid[6] || fp < r[7]) {
+                frames.push_back(stack_frame{pc, 0});
+                break;
+            }
+            cfa = fp + 16;
+            next_valid[6] = read(fp, &next[6], sizeof(uint64_t));
+            next_valid[cfi_return_address] = read(fp + 8, &next[cfi_return_address], sizeof(uint64_t));
+        }
+
+        frames.push_back(stack_frame{pc, cfa});
+
+        next[7] = cfa;
+        next_valid[7] = true;
+        if (cfa <= r[7]) {
+            break; //the stack has to unwind towards higher addresses
+        }
+        std::copy(std::begin(next), std::end(next), r);
+        std::copy(std::begin(next_valid), std::end(next_valid), valid);
+    }
+
+    return frames;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+#include <sys/user.h>
+
+#include "libelfin/elf/elf++.hh"
+
+class module_table;
+
+//x86-64 DWARF register numbers 0-15 are the general purpose registers, 16 is the return address
+static constexpr unsigned n_cfi_registers = 17;
+static constexpr unsigned cfi_return_address = 16;
+
+//the call frame information (.eh_frame, or .debug_frame if there is none) of one ELF file,
+//with all FDEs indexed by address when it is constructed
+class cfi_table {
+public:
+    explicit cfi_table(const elf::elf &elf);
+
+    //how to recover the caller's registers at pc (an unrelocated address of this file)
+    struct rule {
+        enum class kind { same, undefined, offset, val_offset, reg, expression, val_expression };
+        kind type = kind::same;
+        int64_t value = 0;
+        const uint8_t *expr = nullptr;
+        const uint8_t *expr_end = nullptr;
+    };
+
+    struct frame_rules {
+        unsigned cfa_reg = 7;
+        int64_t cfa_offset = 8;
+        const uint8_t *cfa_expr = nullptr; //set when the CFA is a DWARF expression
+        const uint8_t *cfa_expr_end = nullptr;
+        rule regs[n_cfi_registers];
+    };
+
+    //returns false if no FDE covers pc
+    bool find_rules(uint64_t pc, frame_rules &out) const;
+
+private:
+    struct cie {
+        uint64_t code_align;
+        int64_t data_align;
+        unsigned ra_reg;
+        uint8_t fde_encoding;
+        bool augmentation_data;
+        const uint8_t *instructions;
+        const uint8_t *end;
+    };
+
+    struct fde {
+        uint64_t low;
+        uint64_t high;
+        uint64_t cie_offset;
+        const uint8_t *instructions;
+        const uint8_t *end;
+    };
+
+    void parse(const elf::section &sec, bool eh_frame);
+
+    const cie *get_cie(uint64_t offset) const;
+
+    bool execute(const cie &c, const uint8_t *p, const uint8_t *end, uint64_t loc, uint64_t pc,
+                 frame_rules &rules, const frame_rules &initial) const;
+
+    elf::elf m_elf; //keeps the section data mapped
+    const uint8_t *m_data = nullptr;
+    std::size_t m_size = 0;
+    uint64_t m_section_addr = 0;
+    bool m_eh_frame = true;
+    mutable std::map<uint64_t, cie> m_cies; //parsed on first reference
+    std::vector<fde> m_fdes;
+};
+
+using memory_reader = std::function<bool(uint64_t address, void *buffer, std::size_t size)>;
+
+struct stack_frame {
+    uint64_t pc;
+    uint64_t cfa;
+};
+
+//walks the stack with the CFI of the modules covering each pc, falling back to the frame
+//pointer chain when there is none. All memory accesses go through read, so it works on live
+//processes as well as on captured stack bytes.
+std::vector<stack_frame> unwind_stack(module_table &modules, const user_regs_struct &regs,
+                                      const memory_reader &read, std::size_t max_frames = 128);
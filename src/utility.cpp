@@ -1,30 +1,42 @@
+#include <climits>
 #include <cstdint>
 #include <vector>
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <cxxabi.h>
 
 #include "utility.h"
 #include "registers.h"
 
 uint64_t get_register_value(pid_t pid, reg r) {
     user_regs_struct regs;
-    ptrace(PTRACE_GETREGS, pid, nullptr, &regs);
+    counted_ptrace(PTRACE_GETREGS, pid, nullptr, &regs);
+    return get_register_value(regs, r);
+}
+
+void set_register_value(pid_t pid, reg r, uint64_t value) {
+    user_regs_struct regs;
+    counted_ptrace(PTRACE_GETREGS, pid, nullptr, &regs);
+    set_register_value(regs, r, value);
+    counted_ptrace(PTRACE_SETREGS, pid, nullptr, &regs);
+}
+
+uint64_t get_register_value(const user_regs_struct &regs, reg r) {
     auto it = std::find_if(begin(g_register_descriptors), end(g_register_descriptors),
                            [r](auto &&rd) { return rd.r == r; });
 
-    return *(reinterpret_cast<uint64_t *>(&regs) + (it - begin(g_register_descriptors)));
+    return *(reinterpret_cast<const uint64_t *>(&regs) + (it - begin(g_register_descriptors)));
 }
 
-void set_register_value(pid_t pid, reg r, uint64_t value) {
-    user_regs_struct regs;
-    ptrace(PTRACE_GETREGS, pid, nullptr, &regs);
+void set_register_value(user_regs_struct &regs, reg r, uint64_t value) {
     auto it = std::find_if(begin(g_register_descriptors), end(g_register_descriptors),
                            [r](auto &&rd) { return rd.r == r; });
 
     *(reinterpret_cast<uint64_t *>(&regs) + (it - begin(g_register_descriptors))) = value;
-    ptrace(PTRACE_SETREGS, pid, nullptr, &regs);
 }
 
 uint64_t get_register_value_from_dwarf_register(pid_t pid, unsigned regnum) {
@@ -72,6 +84,17 @@ bool is_suffix(const std::string &s, const std::string &of) {
     return std::equal(s.begin(), s.end(), of.begin() + diff);
 }
 
+std::string demangle(const std::string &name) {
+    int status;
+    auto demangled = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+    if (status != 0) {
+        return name;
+    }
+    std::string result{demangled};
+    free(demangled);
+    return result;
+}
+
 std::string to_string(symbol_type st) {
     switch (st) {
         case symbol_type::notype:
@@ -104,6 +127,69 @@ symbol_type to_symbol_type(elf::stt sym) {
     }
 }
 
+thread_local syscall_counters g_syscall_counters;
+
+ssize_t read_process_memory(pid_t pid, uint64_t address, void *buffer, std::size_t size) {
+    ++g_syscall_counters.memory;
+    iovec local{buffer, size};
+    iovec remote{reinterpret_cast<void *>(address), size};
+    auto n = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+    if (n == static_cast<ssize_t>(size)) {
+        return n;
+    }
+
+    //process_vm_readv honours page protections, /proc/pid/mem can read everything the tracer may see
+    auto fd = open(("/proc/" + std::to_string(pid) + "/mem").c_str(), O_RDONLY);
+    if (fd < 0) {
+        return n;
+    }
+    ++g_syscall_counters.memory;
+    n = pread(fd, buffer, size, address);
+    close(fd);
+    return n;
+}
+
+void read_process_memory(pid_t pid, std::vector<memory_request> &requests) {
+    std::vector<iovec> local, remote;
+    for (std::size_t i = 0; i < requests.size();) {
+        auto first = i;
+        local.clear();
+        remote.clear();
+        for (; i < requests.size() && local.size() < IOV_MAX; ++i) {
+            local.push_back(iovec{requests[i].buffer, requests[i].size});
+            remote.push_back(iovec{reinterpret_cast<void *>(requests[i].address), requests[i].size});
+        }
+        ++g_syscall_counters.memory;
+        auto n = process_vm_readv(pid, local.data(), local.size(), remote.data(), remote.size(), 0);
+
+        //the transfer stops at the first range that cannot be read in full
+        std::size_t done = n < 0 ? 0 : n;
+        for (auto j = first; j < i; ++j) {
+            auto &r = requests[j];
+            if (done >= r.size) {
+                done -= r.size;
+                r.ok = true;
+                continue;
+            }
+            r.ok = read_process_memory(pid, r.address, r.buffer, r.size) == static_cast<ssize_t>(r.size);
+            i = j + 1;
+            break;
+        }
+    }
+}
+
+ssize_t write_process_memory(pid_t pid, uint64_t address, const void *buffer, std::size_t size) {
+    //writes through /proc/pid/mem ignore the page protections (e.g. read-only text) and do not need a stopped thread
+    auto fd = open(("/proc/" + std::to_string(pid) + "/mem").c_str(), O_WRONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    ++g_syscall_counters.memory;
+    auto n = pwrite(fd, buffer, size, address);
+    close(fd);
+    return n;
+}
+
 void print_source(const std::string &file_name, unsigned line, unsigned n_lines_context) {
     std::ifstream file{file_name};
 
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <sys/personality.h>
+#include <sys/ptrace.h>
 #include <unistd.h>
 #include <vector>
 
@@ -28,6 +29,10 @@ struct symbol {
 
 uint64_t get_register_value(pid_t pid, reg r);
 
+uint64_t get_register_value(const user_regs_struct &regs, reg r);
+
+void set_register_value(user_regs_struct &regs, reg r, uint64_t value);
+
 void set_register_value(pid_t pid, reg r, uint64_t value);
 
 uint64_t get_register_value_from_dwarf_register(pid_t pid, unsigned regnum);
@@ -42,4 +47,36 @@ bool is_prefix(const std::string &s, const std::string &of);
 
 bool is_suffix(const std::string &s, const std::string &of);
 
+std::string demangle(const std::string &name);
+
+//syscalls issued by the calling thread, for the per-command statistics of --time
+struct syscall_counters {
+    uint64_t ptrace = 0;
+    uint64_t memory = 0; //process_vm_readv and /proc/pid/mem accesses
+};
+
+extern thread_local syscall_counters g_syscall_counters;
+
+//every ptrace request of the debugger goes through here so that it is counted
+template<typename... Args>
+long counted_ptrace(__ptrace_request request, Args... args) {
+    ++g_syscall_counters.ptrace;
+    return ptrace(request, args...);
+}
+
+ssize_t read_process_memory(pid_t pid, uint64_t address, void *buffer, std::size_t size);
+
+//one range of a vectored read, ok is set if all of it was read
+struct memory_request {
+    uint64_t address;
+    void *buffer;
+    std::size_t size;
+    bool ok = false;
+};
+
+//reads the ranges with one process_vm_readv per IOV_MAX of them, a range that cannot be read is retried alone
+void read_process_memory(pid_t pid, std::vector<memory_request> &requests);
+
+ssize_t write_process_memory(pid_t pid, uint64_t address, const void *buffer, std::size_t size);
+
 void print_source(const std::string &file_name, unsigned line, unsigned n_lines_context = 2);
@@ -0,0 +1,1482 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#include "registers.h"
+#include "utility.h"
+#include "variables.h"
+#include "libelfin/dwarf/internal.hh"
+
+using namespace dwarf;
+
+namespace {
+    //the most a string pointer is followed for
+    constexpr std::size_t max_string = 200;
+
+    //the most read at once for the elements of a container, more is taken for garbage
+    constexpr uint64_t max_container_read = 64 << 20;
+
+    //DW_TAG_atomic_type of DWARF 5, which libelfin does not name
+    constexpr auto atomic_type = static_cast<DW_TAG>(0x47);
+
+    uint64_t read_uleb(const uint8_t *&p, const uint8_t *end) {
+        uint64_t value = 0;
+        for (unsigned shift = 0; p < end; shift += 7) {
+            auto byte = *p++;
+            value |= uint64_t{byte & 0x7fu} << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        return value;
+    }
+
+    int64_t read_sleb(const uint8_t *&p, const uint8_t *end) {
+        int64_t value = 0;
+        unsigned shift = 0;
+        uint8_t byte = 0;
+        while (p < end) {
+            byte = *p++;
+            value |= int64_t{byte & 0x7f} << shift;
+            shift += 7;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        if (shift < 64 && (byte & 0x40)) {
+            value |= -(int64_t{1} << shift);
+        }
+        return value;
+    }
+
+    template<typename T>
+    T read_fixed(const uint8_t *&p, const uint8_t *end) {
+        if (end - p < static_cast<std::ptrdiff_t>(sizeof(T))) {
+            throw std::runtime_error{"Truncated location expression"};
+        }
+        T value;
+        std::memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return value;
+    }
+
+    const reg dwarf_registers[] = {reg::rax, reg::rdx, reg::rcx, reg::rbx, reg::rsi, reg::rdi,
+                                   reg::rbp, reg::rsp, reg::r8, reg::r9, reg::r10, reg::r11,
+                                   reg::r12, reg::r13, reg::r14, reg::r15, reg::rip};
+
+    uint64_t dwarf_register(const user_regs_struct &regs, unsigned regnum) {
+        if (regnum >= std::size(dwarf_registers)) {
+            throw std::runtime_error{"Variable in DWARF register " + std::to_string(regnum)};
+        }
+        return get_register_value(regs, dwarf_registers[regnum]);
+    }
+
+    std::pair<const uint8_t *, const uint8_t *> block(const value &v) {
+        std::size_t size;
+        auto data = static_cast<const uint8_t *>(v.as_block(&size));
+        return {data, data + size};
+    }
+
+    //the expression of the DWARF 4 location list (.debug_loc) of var that covers pc, a link time address.
+    //Entries are offsets from the base address, the low_pc of the unit unless an entry of base
+    //~0 sets another. Returns an empty range if none covers pc, the variable is optimized out there.
+    std::pair<const uint8_t *, const uint8_t *> location_list_entry(const die &var, uint64_t pc) {
+        auto section = var.get_unit().get_dwarf().get_section(section_type::loc);
+        auto offset = var[DW_AT::location].as_sec_offset();
+        auto p = reinterpret_cast<const uint8_t *>(section->begin);
+        auto end = reinterpret_cast<const uint8_t *>(section->end);
+        if (offset >= static_cast<uint64_t>(end - p)) {
+            throw std::runtime_error{"Invalid location list"};
+        }
+        p += offset;
+
+        auto &root = var.get_unit().root();
+        uint64_t base = root.has(DW_AT::low_pc) ? at_low_pc(root) : 0;
+        while (true) {
+            auto begin = read_fixed<uint64_t>(p, end);
+            auto finish = read_fixed<uint64_t>(p, end);
+            if (begin == 0 && finish == 0) {
+                return {nullptr, nullptr};
+            }
+            if (begin == ~uint64_t{0}) {
+                base = finish;
+                continue;
+            }
+            auto length = read_fixed<uint16_t>(p, end);
+            if (end - p < length) {
+                throw std::runtime_error{"Truncated location expression"};
+            }
+            if (pc >= base + begin && pc < base + finish) {
+                return {p, p + length};
+            }
+            p += length;
+        }
+    }
+
+    //the operations compilers emit for variables of unoptimized code
+    location evaluate(const uint8_t *p, const uint8_t *end, const frame_info &frame, const die &function);
+
+    uint64_t frame_base(const die &function, const frame_info &frame) {
+        if (!function.valid() || !function.has(DW_AT::frame_base)) {
+            throw std::runtime_error{"No frame base"};
+        }
+        auto base = function[DW_AT::frame_base];
+        if (base.get_type() != value::type::exprloc && base.get_type() != value::type::block) {
+            throw std::runtime_error{"Unsupported frame base"};
+        }
+        auto [p, end] = block(base);
+        auto result = evaluate(p, end, frame, die{});
+        if (result.type == location::kind::value) {
+            uint64_t value = 0;
+            std::memcpy(&value, result.bytes.data(), std::min(result.bytes.size(), sizeof(value)));
+            return value;
+        }
+        return result.address;
+    }
+
+    location evaluate(const uint8_t *p, const uint8_t *end, const frame_info &frame, const die &function) {
+        std::vector<uint64_t> stack;
+        auto pop = [&] {
+            if (stack.empty()) {
+                throw std::runtime_error{"Invalid location expression"};
+            }
+            auto top = stack.back();
+            stack.pop_back();
+            return top;
+        };
+        auto value_of = [](uint64_t value) {
+            location loc{location::kind::value, 0, {}};
+            loc.bytes.resize(sizeof(value));
+            std::memcpy(loc.bytes.data(), &value, sizeof(value));
+            return loc;
+        };
+        auto read = [&](uint64_t address, void *buffer, std::size_t size) {
+            if (!frame.read || !frame.read(address, buffer, size)) {
+                std::ostringstream message;
+                message << "Cannot access memory at 0x" << std::hex << address;
+                throw std::runtime_error{message.str()};
+            }
+        };
+
+        //a register or computed value ends a location, or the part of one a DW_OP_piece follows
+        location ended;
+        bool has_ended = false;
+        std::vector<uint8_t> pieces;
+        bool pieces_missing = false;
+
+        while (p < end) {
+            auto op = static_cast<DW_OP>(*p++);
+            switch (op) {
+                case DW_OP::addr:
+                    stack.push_back(read_fixed<uint64_t>(p, end) + frame.load_address);
+                    break;
+                case DW_OP::fbreg:
+                    stack.push_back(frame_base(function, frame) + read_sleb(p, end));
+                    break;
+                case DW_OP::breg0 ... DW_OP::breg31: {
+                    auto regnum = static_cast<unsigned>(op) - static_cast<unsigned>(DW_OP::breg0);
+                    stack.push_back(dwarf_register(*frame.regs, regnum) + read_sleb(p, end));
+                    break;
+                }
+                case DW_OP::bregx: {
+                    auto regnum = read_uleb(p, end);
+                    stack.push_back(dwarf_register(*frame.regs, regnum) + read_sleb(p, end));
+                    break;
+                }
+                case DW_OP::reg0 ... DW_OP::reg31:
+                    ended = value_of(dwarf_register(*frame.regs, static_cast<unsigned>(op) - static_cast<unsigned>(DW_OP::reg0)));
+                    has_ended = true;
+                    break;
+                case DW_OP::regx:
+                    ended = value_of(dwarf_register(*frame.regs, read_uleb(p, end)));
+                    has_ended = true;
+                    break;
+                case DW_OP::call_frame_cfa:
+                    if (!frame.cfa) {
+                        throw std::runtime_error{"The frame address is unknown"};
+                    }
+                    stack.push_back(frame.cfa);
+                    break;
+                case DW_OP::lit0 ... DW_OP::lit31:
+                    stack.push_back(static_cast<unsigned>(op) - static_cast<unsigned>(DW_OP::lit0));
+                    break;
+                case DW_OP::const1u:
+                    stack.push_back(read_fixed<uint8_t>(p, end));
+                    break;
+                case DW_OP::const1s:
+                    stack.push_back(read_fixed<int8_t>(p, end));
+                    break;
+                case DW_OP::const2u:
+                    stack.push_back(read_fixed<uint16_t>(p, end));
+                    break;
+                case DW_OP::const2s:
+                    stack.push_back(read_fixed<int16_t>(p, end));
+                    break;
+                case DW_OP::const4u:
+                    stack.push_back(read_fixed<uint32_t>(p, end));
+                    break;
+                case DW_OP::const4s:
+                    stack.push_back(read_fixed<int32_t>(p, end));
+                    break;
+                case DW_OP::const8u:
+                case DW_OP::const8s:
+                    stack.push_back(read_fixed<uint64_t>(p, end));
+                    break;
+                case DW_OP::constu:
+                    stack.push_back(read_uleb(p, end));
+                    break;
+                case DW_OP::consts:
+                    stack.push_back(read_sleb(p, end));
+                    break;
+                case DW_OP::dup: {
+                    auto top = pop();
+                    stack.insert(stack.end(), {top, top});
+                    break;
+                }
+                case DW_OP::drop:
+                    pop();
+                    break;
+                case DW_OP::over: {
+                    auto b = pop();
+                    auto a = pop();
+                    stack.insert(stack.end(), {a, b, a});
+                    break;
+                }
+                case DW_OP::swap: {
+                    auto b = pop();
+                    auto a = pop();
+                    stack.insert(stack.end(), {b, a});
+                    break;
+                }
+                case DW_OP::deref:
+                case DW_OP::deref_size: {
+                    auto size = op == DW_OP::deref ? sizeof(uint64_t) : read_fixed<uint8_t>(p, end);
+                    if (size > sizeof(uint64_t)) {
+                        throw std::runtime_error{"Invalid location expression"};
+                    }
+                    uint64_t value = 0;
+                    read(pop(), &value, size);
+                    stack.push_back(value);
+                    break;
+                }
+                case DW_OP::plus_uconst:
+                    stack.push_back(pop() + read_uleb(p, end));
+                    break;
+                case DW_OP::plus: {
+                    auto b = pop();
+                    stack.push_back(pop() + b);
+                    break;
+                }
+                case DW_OP::minus: {
+                    auto b = pop();
+                    stack.push_back(pop() - b);
+                    break;
+                }
+                case DW_OP::mul: {
+                    auto b = pop();
+                    stack.push_back(pop() * b);
+                    break;
+                }
+                case DW_OP::and_: {
+                    auto b = pop();
+                    stack.push_back(pop() & b);
+                    break;
+                }
+                case DW_OP::or_: {
+                    auto b = pop();
+                    stack.push_back(pop() | b);
+                    break;
+                }
+                case DW_OP::xor_: {
+                    auto b = pop();
+                    stack.push_back(pop() ^ b);
+                    break;
+                }
+                case DW_OP::neg:
+                    stack.push_back(-pop());
+                    break;
+                case DW_OP::not_:
+                    stack.push_back(~pop());
+                    break;
+                case DW_OP::shl: {
+                    auto b = pop();
+                    auto a = pop();
+                    stack.push_back(b < 64 ? a << b : 0);
+                    break;
+                }
+                case DW_OP::shr: {
+                    auto b = pop();
+                    auto a = pop();
+                    stack.push_back(b < 64 ? a >> b : 0);
+                    break;
+                }
+                case DW_OP::nop:
+                    break;
+                case DW_OP::stack_value:
+                    ended = value_of(pop());
+                    has_ended = true;
+                    break;
+                case DW_OP::implicit_value: {
+                    auto size = read_uleb(p, end);
+                    if (static_cast<uint64_t>(end - p) < size) {
+                        throw std::runtime_error{"Truncated location expression"};
+                    }
+                    ended = location{location::kind::value, 0, {p, p + size}};
+                    has_ended = true;
+                    p += size;
+                    break;
+                }
+                case DW_OP::piece: {
+                    //the part is in memory at the top of the stack, in what ended it, or optimized out
+                    auto size = read_uleb(p, end);
+                    if (size > max_container_read) {
+                        throw std::runtime_error{"Invalid location expression"};
+                    }
+                    auto at = pieces.size();
+                    pieces.resize(at + size);
+                    if (has_ended) {
+                        std::memcpy(pieces.data() + at, ended.bytes.data(), std::min<std::size_t>(size, ended.bytes.size()));
+                    } else if (!stack.empty()) {
+                        read(stack.back(), pieces.data() + at, size);
+                    } else {
+                        pieces_missing = true;
+                    }
+                    stack.clear();
+                    has_ended = false;
+                    break;
+                }
+                default:
+                    throw std::runtime_error{"Unsupported location operation " + to_string(op)};
+            }
+            if (has_ended && p < end && static_cast<DW_OP>(*p) != DW_OP::piece) {
+                throw std::runtime_error{"Invalid location expression"};
+            }
+        }
+        if (!pieces.empty()) {
+            //a value partly optimized out is not shown with made up parts
+            return pieces_missing ? location{} : location{location::kind::value, 0, std::move(pieces)};
+        }
+        if (has_ended) {
+            return ended;
+        }
+        if (stack.empty()) {
+            return location{}; //an empty expression, the variable was optimized out
+        }
+        return location{location::kind::memory, stack.back(), {}};
+    }
+
+    //the source name of a type DIE, for pointers and error messages
+    std::string type_name(const die &type) {
+        if (!type.valid()) {
+            return "void";
+        }
+        auto target = [&] { return type.has(DW_AT::type) ? at_type(type) : die{}; };
+        switch (type.tag) {
+            case DW_TAG::pointer_type:
+                if (auto t = target(); t.valid() && t.tag == DW_TAG::subroutine_type) {
+                    std::string params;
+                    for (auto &child: t) {
+                        if (child.tag == DW_TAG::formal_parameter) {
+                            params += (params.empty() ? "" : ", ") + type_name(at_type(child));
+                        }
+                    }
+                    return type_name(t.has(DW_AT::type) ? at_type(t) : die{}) + " (*)(" + params + ")";
+                }
+                return type_name(target()) + " *";
+            case DW_TAG::reference_type:
+                return type_name(target()) + " &";
+            case DW_TAG::rvalue_reference_type:
+                return type_name(target()) + " &&";
+            case DW_TAG::const_type:
+                return "const " + type_name(target());
+            case DW_TAG::volatile_type:
+                return "volatile " + type_name(target());
+            case DW_TAG::array_type: {
+                std::string dims;
+                for (auto &child: type) {
+                    if (child.tag == DW_TAG::subrange_type) {
+                        auto count = child.has(DW_AT::count) ? child[DW_AT::count].as_uconstant()
+                                     : child.has(DW_AT::upper_bound) ? child[DW_AT::upper_bound].as_uconstant() + 1 : 0;
+                        dims += "[" + std::to_string(count) + "]";
+                    }
+                }
+                return type_name(target()) + " " + dims;
+            }
+            default:
+                break;
+        }
+        if (type.has(DW_AT::name)) {
+            return at_name(type);
+        }
+        switch (type.tag) {
+            case DW_TAG::structure_type:
+                return "struct {...}";
+            case DW_TAG::class_type:
+                return "class {...}";
+            case DW_TAG::union_type:
+                return "union {...}";
+            case DW_TAG::enumeration_type:
+                return "enum {...}";
+            default:
+                return "?";
+        }
+    }
+
+    uint64_t member_offset(const die &member) {
+        if (!member.has(DW_AT::data_member_location)) {
+            return 0; //members of unions
+        }
+        auto location = member[DW_AT::data_member_location];
+        if (location.get_type() == value::type::exprloc || location.get_type() == value::type::block) {
+            auto [p, end] = block(location);
+            if (p < end && static_cast<DW_OP>(*p) == DW_OP::plus_uconst) {
+                ++p;
+                return read_uleb(p, end);
+            }
+            throw std::runtime_error{"Unsupported member location"};
+        }
+        return location.as_uconstant();
+    }
+
+    bool scope_contains(const die &scope, uint64_t pc) {
+        try {
+            return die_pc_range(scope).contains(pc);
+        } catch (std::exception &) {
+            return false;
+        }
+    }
+
+    void collect_variables(const die &scope, uint64_t pc, std::vector<scoped_variable> &out) {
+        for (auto &child: scope) {
+            if (child.tag == DW_TAG::lexical_block && scope_contains(child, pc)) {
+                collect_variables(child, pc, out);
+            }
+        }
+        for (auto &child: scope) {
+            if (child.tag == DW_TAG::variable || child.tag == DW_TAG::formal_parameter) {
+                out.push_back(scoped_variable{child, child.tag == DW_TAG::formal_parameter});
+            }
+        }
+    }
+
+    int64_t sign_extend(uint64_t value, std::size_t size) {
+        if (size >= 8) {
+            return static_cast<int64_t>(value);
+        }
+        auto shift = 64 - 8 * size;
+        return static_cast<int64_t>(value << shift) >> shift;
+    }
+
+    uint64_t load_integer(const uint8_t *data, std::size_t size) {
+        uint64_t value = 0;
+        std::memcpy(&value, data, std::min<std::size_t>(size, sizeof(value)));
+        return value;
+    }
+
+    void escape(std::ostream &out, uint8_t c, char quote) {
+        switch (c) {
+            case '\n': out << "\\n"; break;
+            case '\t': out << "\\t"; break;
+            case '\\': out << "\\\\"; break;
+            default:
+                if (c == quote) {
+                    out << '\\' << quote;
+                } else if (std::isprint(c)) {
+                    out << static_cast<char>(c);
+                } else {
+                    out << '\\' << std::oct << std::setw(3) << std::setfill('0') << unsigned{c} << std::dec
+                        << std::setfill(' ');
+                }
+        }
+    }
+
+    bool is_char(const type_desc &type) {
+        return type.type == type_desc::kind::base && type.size == 1 &&
+               (type.encoding == DW_ATE::signed_char || type.encoding == DW_ATE::unsigned_char);
+    }
+
+    uint64_t align_up(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    uint64_t alignment_of(const type_desc &type) {
+        switch (type.type) {
+            case type_desc::kind::structure: {
+                uint64_t alignment = 1;
+                for (auto &m: type.members) {
+                    alignment = std::max(alignment, alignment_of(*m.type));
+                }
+                return alignment;
+            }
+            case type_desc::kind::array:
+                return alignment_of(*type.target);
+            case type_desc::kind::function:
+            case type_desc::kind::unknown:
+                return 1;
+            default:
+                return std::clamp<uint64_t>(type.size, 1, 16);
+        }
+    }
+
+    //the template arguments that are types, in order
+    std::vector<die> template_types(const die &type) {
+        std::vector<die> types;
+        for (auto &child: type) {
+            if (child.tag == DW_TAG::template_type_parameter && child.has(DW_AT::type)) {
+                types.push_back(at_type(child));
+            }
+        }
+        return types;
+    }
+
+    //the libstdc++ containers by their names, sizes and template arguments. DIEs do not link to their
+    //namespace, the sizes tell these from other classes of the same name.
+    type_desc::container container_of(const die &type, uint64_t size, std::size_t n_types) {
+        static const struct {
+            const char *prefix;
+            uint64_t size;
+            std::size_t n_types;
+            type_desc::container library;
+        } known[] = {
+                {"vector<", 24, 1, type_desc::container::vector},
+                {"basic_string<char,", 32, 1, type_desc::container::string},
+                {"map<", 48, 2, type_desc::container::map},
+                {"unordered_map<", 56, 2, type_desc::container::unordered_map},
+        };
+        if (!type.has(DW_AT::name)) {
+            return type_desc::container::none;
+        }
+        auto name = at_name(type);
+        for (auto &k: known) {
+            if (name.compare(0, std::strlen(k.prefix), k.prefix) == 0 && size == k.size && n_types >= k.n_types) {
+                return k.library;
+            }
+        }
+        return type_desc::container::none;
+    }
+}
+
+const type_desc &type_cache::get(const die &type) {
+    if (!type.valid()) {
+        return m_void;
+    }
+    auto key = type.get_section_offset();
+    auto found = m_types.find(key);
+    if (found != m_types.end()) {
+        return *found->second;
+    }
+
+    //the qualifiers and typedefs share the description of the type they qualify
+    auto qualify = [&]() -> const type_desc & {
+        auto &underlying = get(type.has(DW_AT::type) ? at_type(type) : die{});
+        m_types[key] = &underlying;
+        return underlying;
+    };
+    if (type.tag == atomic_type) {
+        return qualify(); //not a case below, DW_TAG has no enumerator for it
+    }
+
+    switch (type.tag) {
+        case DW_TAG::typedef_:
+        case DW_TAG::const_type:
+        case DW_TAG::volatile_type:
+        case DW_TAG::restrict_type:
+        case DW_TAG::shared_type:
+            return qualify();
+        default:
+            break;
+    }
+
+    //registered before it is resolved, so types that point to themselves find it
+    m_owned.push_back(std::make_unique<type_desc>());
+    auto &desc = *m_owned.back();
+    m_types[key] = &desc;
+    resolve(type, desc);
+    return desc;
+}
+
+const type_desc &type_cache::builtin(const std::string &name, uint64_t size, DW_ATE encoding) {
+    auto &desc = m_builtins[name];
+    if (!desc) {
+        m_owned.push_back(std::make_unique<type_desc>(type_desc{type_desc::kind::base, name, size, encoding}));
+        desc = m_owned.back().get();
+    }
+    return *desc;
+}
+
+const type_desc &type_cache::pointer_to(const type_desc &target) {
+    auto &desc = m_pointers[&target];
+    if (!desc) {
+        m_owned.push_back(std::make_unique<type_desc>(type_desc{type_desc::kind::pointer, target.name + " *",
+                                                                sizeof(void *), {}, &target}));
+        desc = m_owned.back().get();
+    }
+    return *desc;
+}
+
+void type_cache::resolve(const die &type, type_desc &desc) {
+    desc.name = type_name(type);
+    desc.size = type.has(DW_AT::byte_size) ? type[DW_AT::byte_size].as_uconstant() : 0;
+    auto target = [&]() -> const type_desc & { return get(type.has(DW_AT::type) ? at_type(type) : die{}); };
+
+    switch (type.tag) {
+        case DW_TAG::base_type:
+            desc.type = type_desc::kind::base;
+            desc.encoding = static_cast<DW_ATE>(type[DW_AT::encoding].as_uconstant());
+            break;
+        case DW_TAG::unspecified_type: //decltype(nullptr)
+            desc.type = type_desc::kind::base;
+            desc.encoding = DW_ATE::unsigned_;
+            desc.size = sizeof(void *);
+            break;
+        case DW_TAG::pointer_type:
+        case DW_TAG::ptr_to_member_type:
+            desc.type = type_desc::kind::pointer;
+            desc.size = desc.size ? desc.size : sizeof(void *);
+            desc.target = &target();
+            break;
+        case DW_TAG::reference_type:
+        case DW_TAG::rvalue_reference_type:
+            desc.type = type_desc::kind::reference;
+            desc.size = desc.size ? desc.size : sizeof(void *);
+            desc.target = &target();
+            break;
+        case DW_TAG::structure_type:
+        case DW_TAG::class_type:
+        case DW_TAG::union_type:
+            desc.type = type_desc::kind::structure;
+            for (auto &child: type) {
+                if (child.tag == DW_TAG::inheritance) {
+                    auto &base = get(at_type(child));
+                    desc.members.push_back(type_desc::member{base.name, member_offset(child), &base, true});
+                    continue;
+                }
+                //static members are declarations without a location in the object
+                if (child.tag != DW_TAG::member || child.has(DW_AT::external) || child.has(DW_AT::declaration)) {
+                    continue;
+                }
+                type_desc::member m{child.has(DW_AT::name) ? at_name(child) : "", member_offset(child),
+                                    &get(at_type(child)), false};
+                if (child.has(DW_AT::bit_size)) {
+                    m.bit_size = child[DW_AT::bit_size].as_uconstant();
+                    if (child.has(DW_AT::data_bit_offset)) {
+                        auto bits = child[DW_AT::data_bit_offset].as_uconstant();
+                        m.offset = bits / 8;
+                        m.bit_offset = bits % 8;
+                    } else if (child.has(DW_AT::bit_offset)) {
+                        //counted from the most significant bit of the storage unit
+                        auto storage = child.has(DW_AT::byte_size) ? child[DW_AT::byte_size].as_uconstant() : m.type->size;
+                        m.bit_offset = storage * 8 - child[DW_AT::bit_offset].as_uconstant() - m.bit_size;
+                    }
+                }
+                desc.members.push_back(std::move(m));
+            }
+            if (auto args = template_types(type); !args.empty()) {
+                desc.library = container_of(type, desc.size, args.size());
+                if (desc.library != type_desc::container::none) {
+                    desc.target = &get(args[0]);
+                    desc.mapped = args.size() > 1 ? &get(args[1]) : nullptr;
+                }
+            }
+            break;
+        case DW_TAG::array_type: {
+            std::vector<uint64_t> dims;
+            for (auto &child: type) {
+                if (child.tag == DW_TAG::subrange_type) {
+                    dims.push_back(child.has(DW_AT::count) ? child[DW_AT::count].as_uconstant()
+                                   : child.has(DW_AT::upper_bound) ? child[DW_AT::upper_bound].as_uconstant() + 1 : 0);
+                }
+            }
+            if (dims.empty()) {
+                dims.push_back(0);
+            }
+            //int a[2][3] is an array of two arrays of three ints
+            auto element = &target();
+            for (auto i = dims.size(); i-- > 1;) {
+                m_owned.push_back(std::make_unique<type_desc>());
+                auto &inner = *m_owned.back();
+                inner.type = type_desc::kind::array;
+                inner.name = element->name + "[" + std::to_string(dims[i]) + "]";
+                inner.count = dims[i];
+                inner.target = element;
+                inner.size = dims[i] * element->size;
+                element = &inner;
+            }
+            desc.type = type_desc::kind::array;
+            desc.count = dims[0];
+            desc.target = element;
+            desc.size = desc.size ? desc.size : dims[0] * element->size;
+            break;
+        }
+        case DW_TAG::enumeration_type:
+            desc.type = type_desc::kind::enumeration;
+            for (auto &child: type) {
+                if (child.tag == DW_TAG::enumerator && child.has(DW_AT::const_value)) {
+                    desc.enumerators.emplace_back(child[DW_AT::const_value].as_sconstant(), at_name(child));
+                }
+            }
+            break;
+        case DW_TAG::subroutine_type:
+            desc.type = type_desc::kind::function;
+            break;
+        default:
+            desc.type = type_desc::kind::unknown;
+            break;
+    }
+}
+
+uint32_t type_cache::compile(const type_desc &desc) {
+    auto found = m_layout_of.find(&desc);
+    if (found != m_layout_of.end()) {
+        return found->second;
+    }
+
+    //registered before it is flattened, so references to the type itself find it
+    auto index = static_cast<uint32_t>(m_layouts.size());
+    m_layout_of[&desc] = index;
+    m_layouts.push_back(type_layout{desc.name, desc.size, alignment_of(desc), {}, desc.enumerators});
+    std::vector<layout_field> fields;
+    flatten(desc, 0, "", fields);
+    m_layouts[index].fields = std::move(fields);
+    return index;
+}
+
+void type_cache::flatten(const type_desc &desc, uint64_t offset, const std::string &name,
+                         std::vector<layout_field> &fields) {
+    using kind = layout_field::kind;
+    layout_field field{kind::unknown, desc.encoding};
+    field.offset = offset;
+    field.size = desc.size;
+    field.name = name;
+
+    if (desc.library != type_desc::container::none) {
+        static const kind kinds[] = {kind::unknown, kind::std_vector, kind::std_string, kind::std_map,
+                                     kind::std_unordered_map};
+        field.type = kinds[static_cast<int>(desc.library)];
+        field.nested = compile(*desc.target);
+        field.mapped = desc.mapped ? compile(*desc.mapped) : 0;
+        fields.push_back(std::move(field));
+        return;
+    }
+
+    switch (desc.type) {
+        case type_desc::kind::base:
+            field.type = kind::scalar;
+            break;
+        case type_desc::kind::enumeration:
+            field.type = kind::enumeration;
+            field.nested = compile(desc);
+            break;
+        case type_desc::kind::pointer:
+            field.type = is_char(*desc.target) ? kind::string_pointer
+                         : desc.target->type == type_desc::kind::function ? kind::function_pointer : kind::pointer;
+            field.nested = compile(desc);
+            break;
+        case type_desc::kind::reference:
+            field.type = kind::reference;
+            field.nested = compile(*desc.target);
+            break;
+        case type_desc::kind::array:
+            field.count = desc.count;
+            if (is_char(*desc.target)) {
+                field.type = kind::char_array;
+            } else {
+                field.type = kind::array;
+                field.nested = compile(*desc.target);
+            }
+            break;
+        case type_desc::kind::structure: {
+            auto open = fields.size();
+            field.type = kind::open;
+            fields.push_back(std::move(field));
+            for (auto &m: desc.members) {
+                auto member_name = m.base_class ? "<" + m.name + ">" : m.name;
+                if (!m.bit_size) {
+                    flatten(*m.type, offset + m.offset, member_name, fields);
+                    continue;
+                }
+                layout_field bits{kind::bit_field, m.type->encoding, m.bit_size, m.bit_offset, offset + m.offset,
+                                  m.type->size};
+                bits.name = std::move(member_name);
+                fields.push_back(std::move(bits));
+            }
+            fields[open].nested = static_cast<uint32_t>(fields.size());
+            fields.push_back(layout_field{kind::close});
+            return;
+        }
+        case type_desc::kind::function:
+            field.type = kind::function;
+            field.nested = compile(desc);
+            break;
+        case type_desc::kind::unknown:
+            field.nested = compile(desc);
+            break;
+    }
+    fields.push_back(std::move(field));
+}
+
+location locate(const die &var, const die &function, const frame_info &frame) {
+    if (var.has(DW_AT::const_value)) {
+        auto v = var[DW_AT::const_value];
+        location loc{location::kind::value};
+        if (v.get_type() == value::type::block) {
+            auto [p, end] = block(v);
+            loc.bytes.assign(p, end);
+        } else {
+            auto n = v.as_sconstant();
+            loc.bytes.resize(sizeof(n));
+            std::memcpy(loc.bytes.data(), &n, sizeof(n));
+        }
+        return loc;
+    }
+    if (!var.has(DW_AT::location)) {
+        return location{};
+    }
+    auto v = var[DW_AT::location];
+    if (v.get_type() == value::type::loclist) {
+        auto [p, end] = location_list_entry(var, frame.regs->rip - frame.load_address);
+        return p ? evaluate(p, end, frame, function) : location{};
+    }
+    if (v.get_type() != value::type::exprloc && v.get_type() != value::type::block) {
+        return location{};
+    }
+    auto [p, end] = block(v);
+    return evaluate(p, end, frame, function);
+}
+
+fixed_location fixed_location_of(const die &var, const die &function) {
+    //one operation, and for DW_OP_fbreg a frame base of one operation, where a register holds the base
+    auto single = [](const value &v, fixed_location &out, int64_t bias, bool frame_base) {
+        if (v.get_type() != value::type::exprloc && v.get_type() != value::type::block) {
+            return false;
+        }
+        auto [p, end] = block(v);
+        if (p == end) {
+            return false;
+        }
+        auto op = static_cast<DW_OP>(*p++);
+        auto breg = static_cast<unsigned>(op) - static_cast<unsigned>(DW_OP::breg0);
+        auto regnum = static_cast<unsigned>(op) - static_cast<unsigned>(DW_OP::reg0);
+        if (op == DW_OP::addr && end - p == 8) {
+            out.type = fixed_location::kind::address;
+            out.offset = read_fixed<uint64_t>(p, end) + bias;
+        } else if (op == DW_OP::call_frame_cfa && p == end) {
+            out.type = fixed_location::kind::cfa_offset;
+            out.offset = bias;
+        } else if (breg < std::size(dwarf_registers)) {
+            out.type = fixed_location::kind::register_offset;
+            out.r = dwarf_registers[breg];
+            out.offset = read_sleb(p, end) + bias;
+        } else if (regnum < std::size(dwarf_registers) && p == end) {
+            out.type = frame_base ? fixed_location::kind::register_offset : fixed_location::kind::register_value;
+            out.r = dwarf_registers[regnum];
+            out.offset = bias;
+        } else {
+            return false;
+        }
+        return p == end;
+    };
+
+    fixed_location result;
+    if (var.has(DW_AT::const_value) || !var.has(DW_AT::location)) {
+        return result;
+    }
+    auto v = var[DW_AT::location];
+    if (v.get_type() != value::type::exprloc && v.get_type() != value::type::block) {
+        return result;
+    }
+    auto [p, end] = block(v);
+    if (p != end && static_cast<DW_OP>(*p) == DW_OP::fbreg) {
+        ++p;
+        auto offset = read_sleb(p, end);
+        if (p != end || !function.valid() || !function.has(DW_AT::frame_base) ||
+            !single(function[DW_AT::frame_base], result, offset, true) || result.type == fixed_location::kind::address) {
+            return fixed_location{};
+        }
+        return result;
+    }
+    return single(v, result, 0, false) ? result : fixed_location{};
+}
+
+std::vector<scoped_variable> variables_in_scope(const die &function, uint64_t pc) {
+    std::vector<scoped_variable> variables;
+    collect_variables(function, pc, variables);
+    return variables;
+}
+
+std::string variable_name(const die &var) {
+    if (var.has(DW_AT::name)) {
+        return at_name(var);
+    }
+    for (auto attr: {DW_AT::specification, DW_AT::abstract_origin}) {
+        if (var.has(attr)) {
+            return variable_name(var[attr].as_reference());
+        }
+    }
+    return "";
+}
+
+die variable_type(const die &var) {
+    if (var.has(DW_AT::type)) {
+        return at_type(var);
+    }
+    for (auto attr: {DW_AT::specification, DW_AT::abstract_origin}) {
+        if (var.has(attr)) {
+            return variable_type(var[attr].as_reference());
+        }
+    }
+    return die{};
+}
+
+std::unordered_map<std::string, die> index_globals(const dwarf::dwarf &dwarf) {
+    std::unordered_map<std::string, die> globals;
+    //C++ defines variables of namespaces at the top level, referring to a declaration in the namespace
+    std::unordered_map<section_offset, std::string> qualified;
+    std::vector<die> definitions;
+
+    std::function<void(const die &, const std::string &)> collect = [&](const die &scope, const std::string &prefix) {
+        for (auto &child: scope) {
+            if (child.tag == DW_TAG::namespace_) {
+                collect(child, prefix + (child.has(DW_AT::name) ? at_name(child) + "::" : ""));
+            } else if (child.tag == DW_TAG::variable) {
+                if (!prefix.empty() && child.has(DW_AT::name)) {
+                    qualified[child.get_section_offset()] = prefix + at_name(child);
+                }
+                if (child.has(DW_AT::location)) {
+                    definitions.push_back(child);
+                }
+            }
+        }
+    };
+    for (auto &cu: dwarf.compilation_units()) {
+        collect(cu.root(), "");
+    }
+
+    for (auto &var: definitions) {
+        auto declaration = var.has(DW_AT::specification) ? var[DW_AT::specification].as_reference() : var;
+        auto name = qualified.find(declaration.get_section_offset());
+        if (name != qualified.end()) {
+            globals.emplace(name->second, var);
+        }
+        globals.emplace(variable_name(var), var);
+    }
+    return globals;
+}
+
+void value_printer::print(uint32_t layout, const uint8_t *data, std::size_t size, uint64_t address) {
+    auto &fields = m_types.layout_at(layout).fields;
+    std::vector<char> first{true}; //per open structure, whether no member has been printed yet
+    prefetch(layout, {element{data, size, address}});
+
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+        auto &field = fields[i];
+        if (field.type == layout_field::kind::close) {
+            m_out << "}";
+            first.pop_back();
+            continue;
+        }
+        m_out << (first.back() ? "" : ", ");
+        first.back() = false;
+        if (!field.name.empty()) {
+            m_out << field.name << " = ";
+        }
+        if (field.type != layout_field::kind::open) {
+            print_field(field, data, size, address);
+        } else if (i > 0 && field.offset >= size) {
+            m_out << "<unavailable>";
+            i = field.nested;
+        } else {
+            m_out << "{";
+            first.push_back(true);
+        }
+    }
+}
+
+void value_printer::print_field(const layout_field &field, const uint8_t *data, std::size_t size, uint64_t address) {
+    using kind = layout_field::kind;
+    auto partial = field.type == kind::array || field.type == kind::char_array || field.type == kind::bit_field;
+    if (partial ? field.offset >= size : field.offset + field.size > size) {
+        m_out << "<unavailable>";
+        return;
+    }
+    auto p = data + field.offset;
+    auto field_address = address ? address + field.offset : 0;
+
+    switch (field.type) {
+        case kind::scalar:
+            print_base(field.encoding, field.size, p);
+            break;
+        case kind::bit_field: {
+            auto bits = load_integer(p, std::min<std::size_t>(size - field.offset, 8)) >> field.bit_offset;
+            bits &= field.bit_size < 64 ? (uint64_t{1} << field.bit_size) - 1 : ~uint64_t{0};
+            auto is_signed = field.encoding == DW_ATE::signed_ || field.encoding == DW_ATE::signed_char;
+            if (is_signed && field.bit_size < 64 && (bits >> (field.bit_size - 1)) & 1) {
+                m_out << std::dec << static_cast<int64_t>(bits | ~uint64_t{0} << field.bit_size);
+            } else {
+                m_out << std::dec << bits;
+            }
+            break;
+        }
+        case kind::enumeration: {
+            auto &enumerators = m_types.layout_at(field.nested).enumerators;
+            auto value = sign_extend(load_integer(p, field.size), field.size);
+            auto e = std::find_if(enumerators.begin(), enumerators.end(), [&](auto &&e) { return e.first == value; });
+            if (e != enumerators.end()) {
+                m_out << e->second;
+            } else {
+                m_out << std::dec << value;
+            }
+            break;
+        }
+        case kind::string_pointer: {
+            auto address = load_integer(p, sizeof(uint64_t));
+            m_out << "0x" << std::hex << address;
+            if (address) {
+                m_out << " ";
+                print_string(address);
+            }
+            break;
+        }
+        case kind::function_pointer: {
+            auto address = load_integer(p, sizeof(uint64_t));
+            m_out << "(" << m_types.layout_at(field.nested).name << ") 0x" << std::hex << address;
+            if (address) {
+                m_out << " <" << m_symbolize(address) << ">";
+            }
+            break;
+        }
+        case kind::pointer:
+            m_out << "(" << m_types.layout_at(field.nested).name << ") 0x" << std::hex << load_integer(p, sizeof(uint64_t));
+            break;
+        case kind::reference: {
+            auto address = load_integer(p, sizeof(uint64_t));
+            m_out << "@0x" << std::hex << address << ": ";
+            std::vector<uint8_t> referee(m_types.layout_at(field.nested).size);
+            if (!m_read(address, referee.data(), referee.size())) {
+                m_out << "<error: Cannot access memory at 0x" << std::hex << address << ">";
+            } else {
+                print(field.nested, referee.data(), referee.size());
+            }
+            break;
+        }
+        case kind::char_array: {
+            auto n = std::min<uint64_t>({field.count, size - field.offset, max_string});
+            auto length = std::find(p, p + n, 0) - p;
+            m_out << '"';
+            for (std::ptrdiff_t i = 0; i < length; ++i) {
+                escape(m_out, p[i], '"');
+            }
+            m_out << '"' << (length == static_cast<std::ptrdiff_t>(max_string) ? "..." : "");
+            break;
+        }
+        case kind::array: {
+            auto stride = m_types.layout_at(field.nested).size;
+            auto available = stride ? std::min<uint64_t>(field.count, (size - field.offset) / stride) : 0;
+            auto n = std::min<uint64_t>(available, m_max_elements);
+            std::vector<element> elements;
+            for (uint64_t i = 0; i < n; ++i) {
+                elements.push_back(element{p + i * stride, size - field.offset - i * stride,
+                                           field_address ? field_address + i * stride : 0});
+            }
+            prefetch(field.nested, elements);
+            m_out << "{";
+            for (uint64_t i = 0; i < n; ++i) {
+                m_out << (i ? ", " : "");
+                print(field.nested, elements[i].data, elements[i].size, elements[i].address);
+            }
+            if (n < field.count) {
+                m_out << (n ? ", " : "") << "...";
+            }
+            m_out << "}";
+            break;
+        }
+        case kind::std_string:
+            print_std_string(p, size - field.offset, field_address);
+            break;
+        case kind::std_vector:
+            print_vector(field, p);
+            break;
+        case kind::std_map:
+            print_map(field, p);
+            break;
+        case kind::std_unordered_map:
+            print_unordered_map(field, p, field_address);
+            break;
+        case kind::function:
+            m_out << "{" << m_types.layout_at(field.nested).name << "}";
+            break;
+        case kind::unknown:
+            m_out << "<unknown type " << m_types.layout_at(field.nested).name << ">";
+            break;
+        case kind::open:
+        case kind::close:
+            break;
+    }
+}
+
+void value_printer::print_std_string(const uint8_t *data, std::size_t available, uint64_t address) {
+    //{pointer, length, 16 byte local buffer}, the pointer points to the local buffer for short strings
+    auto pointer = load_integer(data, 8);
+    auto length = load_integer(data + 8, 8);
+    auto n = std::min<uint64_t>(length, max_string);
+    auto text = data + 16;
+    if (n > 0 && !(address && pointer == address + 16 && n < 16 && available >= 32)) {
+        text = fetch(pointer, n);
+    }
+    if (!text) {
+        m_out << "<error: Cannot access memory at 0x" << std::hex << pointer << ">";
+        return;
+    }
+    m_out << '"';
+    for (uint64_t i = 0; i < n; ++i) {
+        escape(m_out, text[i], '"');
+    }
+    m_out << '"' << (length > n ? "..." : "");
+}
+
+void value_printer::print_vector(const layout_field &field, const uint8_t *data) {
+    //{start, finish, end of storage}
+    auto start = load_integer(data, 8);
+    auto finish = load_integer(data + 8, 8);
+    auto end = load_integer(data + 16, 8);
+    auto stride = m_types.layout_at(field.nested).size;
+    if (finish < start || end < finish || (stride && (finish - start) % stride)) {
+        m_out << "<invalid std::vector>";
+        return;
+    }
+    auto length = stride ? (finish - start) / stride : 0;
+    m_out << "std::vector of length " << std::dec << length << ", capacity " << (stride ? (end - start) / stride : 0);
+    if (length == 0) {
+        return;
+    }
+
+    auto n = std::min<uint64_t>(length, m_max_elements);
+    auto bytes = n * stride <= max_container_read ? fetch(start, n * stride) : nullptr;
+    if (!bytes) {
+        m_out << " = <error: Cannot access memory at 0x" << std::hex << start << ">";
+        return;
+    }
+    std::vector<element> elements;
+    for (uint64_t i = 0; i < n; ++i) {
+        elements.push_back(element{bytes + i * stride, stride, start + i * stride});
+    }
+    prefetch(field.nested, elements);
+    m_out << " = {";
+    for (uint64_t i = 0; i < n; ++i) {
+        m_out << (i ? ", " : "");
+        print(field.nested, elements[i].data, elements[i].size, elements[i].address);
+    }
+    m_out << (n < length ? ", ...}" : "}");
+}
+
+void value_printer::print_map(const layout_field &field, const uint8_t *data) {
+    //the header node follows the comparator: {color, parent (the root), leftmost, rightmost}, then the
+    //count. Nodes are {color, parent, left, right} followed by the pair.
+    auto root = load_integer(data + 16, 8);
+    auto count = load_integer(data + 40, 8);
+    auto &key = m_types.layout_at(field.nested);
+    auto &value = m_types.layout_at(field.mapped);
+    auto pair_alignment = std::max(key.alignment, value.alignment);
+    auto key_offset = align_up(32, pair_alignment);
+    auto value_offset = key_offset + align_up(key.size, value.alignment);
+    auto node_size = key_offset + align_up(value_offset - key_offset + value.size, pair_alignment);
+    m_out << "std::map with " << std::dec << count << " elements";
+    if (count == 0) {
+        return;
+    }
+
+    //the tree is read one level at a time. If not all of it is printed, only the subtrees with fewer
+    //than limit read nodes before them in order, which may hold one of the first limit elements.
+    auto limit = std::min<uint64_t>(count, m_max_elements);
+    std::unordered_map<uint64_t, const uint8_t *> nodes; //nullptr if it could not be read
+    std::vector<std::vector<uint8_t>> levels;
+    std::vector<std::pair<uint64_t, const uint8_t *>> ordered;
+    std::vector<uint64_t> frontier{root};
+    std::function<void(uint64_t, unsigned)> visit = [&](uint64_t node, unsigned depth) {
+        if (node == 0 || ordered.size() >= limit || depth > 128) {
+            return;
+        }
+        auto found = nodes.find(node);
+        if (found == nodes.end()) {
+            frontier.push_back(node);
+            return;
+        }
+        if (!found->second) {
+            return;
+        }
+        visit(load_integer(found->second + 16, 8), depth + 1);
+        if (ordered.size() < limit) {
+            ordered.emplace_back(node, found->second);
+            visit(load_integer(found->second + 24, 8), depth + 1);
+        }
+    };
+
+    while (!frontier.empty()) {
+        auto &buffer = levels.emplace_back(frontier.size() * node_size);
+        std::vector<memory_request> requests;
+        for (std::size_t i = 0; i < frontier.size(); ++i) {
+            requests.push_back(memory_request{frontier[i], buffer.data() + i * node_size, node_size});
+        }
+        m_read_many(requests);
+        for (auto &r: requests) {
+            nodes[r.address] = r.ok ? static_cast<const uint8_t *>(r.buffer) : nullptr;
+        }
+        frontier.clear();
+        if (limit < count) {
+            ordered.clear();
+            visit(root, 0);
+            continue;
+        }
+        for (auto &r: requests) {
+            for (auto child: {load_integer(static_cast<const uint8_t *>(r.buffer) + 16, 8),
+                              load_integer(static_cast<const uint8_t *>(r.buffer) + 24, 8)}) {
+                if (r.ok && child && !nodes.count(child)) {
+                    frontier.push_back(child);
+                }
+            }
+        }
+    }
+    if (limit == count) {
+        visit(root, 0);
+    }
+    print_pairs(field, ordered, key_offset, value_offset);
+    m_out << (ordered.size() < count ? ", ...}" : "}");
+}
+
+void value_printer::print_unordered_map(const layout_field &field, const uint8_t *data, uint64_t address) {
+    //{buckets, bucket count, before begin (the first node), element count, ...}. The nodes of all
+    //buckets are one list, {next, pair}; a bucket points to the node before its first one.
+    auto buckets = load_integer(data, 8);
+    auto bucket_count = load_integer(data + 8, 8);
+    auto first = load_integer(data + 16, 8);
+    auto count = load_integer(data + 24, 8);
+    auto &key = m_types.layout_at(field.nested);
+    auto &value = m_types.layout_at(field.mapped);
+    auto pair_alignment = std::max(key.alignment, value.alignment);
+    auto key_offset = align_up(8, pair_alignment);
+    auto value_offset = key_offset + align_up(key.size, value.alignment);
+    auto node_size = key_offset + align_up(value_offset - key_offset + value.size, pair_alignment);
+    m_out << "std::unordered_map with " << std::dec << count << " elements";
+    if (count == 0) {
+        return;
+    }
+
+    //if most of the elements are printed, the buckets give the nodes before every bucket and the short
+    //chains of all buckets are followed at once. Else the list is followed one node at a time.
+    auto limit = std::min<uint64_t>(count, m_max_elements);
+    std::vector<uint64_t> frontier{first};
+    if (count <= limit * 64 && bucket_count * 8 <= max_container_read) {
+        if (auto table = fetch(buckets, bucket_count * 8)) {
+            for (uint64_t i = 0; i < bucket_count; ++i) {
+                auto before = load_integer(table + i * 8, 8);
+                if (before && before != address + 16) {
+                    frontier.push_back(before);
+                }
+            }
+        }
+        std::sort(frontier.begin(), frontier.end());
+        frontier.erase(std::unique(frontier.begin(), frontier.end()), frontier.end());
+    }
+
+    std::unordered_map<uint64_t, const uint8_t *> nodes; //nullptr if it could not be read
+    std::vector<std::vector<uint8_t>> rounds;
+    std::vector<std::pair<uint64_t, const uint8_t *>> ordered;
+    while (!frontier.empty()) {
+        auto &buffer = rounds.emplace_back(frontier.size() * node_size);
+        std::vector<memory_request> requests;
+        for (std::size_t i = 0; i < frontier.size(); ++i) {
+            requests.push_back(memory_request{frontier[i], buffer.data() + i * node_size, node_size});
+        }
+        m_read_many(requests);
+        frontier.clear();
+        for (auto &r: requests) {
+            nodes[r.address] = r.ok ? static_cast<const uint8_t *>(r.buffer) : nullptr;
+        }
+        for (auto &r: requests) {
+            auto next = r.ok ? load_integer(static_cast<const uint8_t *>(r.buffer), 8) : 0;
+            if (next && !nodes.count(next)) {
+                frontier.push_back(next);
+            }
+        }
+
+        ordered.clear();
+        auto node = first;
+        for (auto found = nodes.find(node); found != nodes.end() && found->second && ordered.size() < limit;
+             found = nodes.find(node)) {
+            ordered.emplace_back(node, found->second);
+            node = load_integer(found->second, 8);
+        }
+        if (node == 0 || ordered.size() == limit || nodes.size() > count + limit) {
+            break;
+        }
+    }
+    print_pairs(field, ordered, key_offset, value_offset);
+    m_out << (ordered.size() < count ? ", ...}" : "}");
+}
+
+void value_printer::print_pairs(const layout_field &field,
+                                const std::vector<std::pair<uint64_t, const uint8_t *>> &nodes,
+                                uint64_t key_offset, uint64_t value_offset) {
+    auto &key = m_types.layout_at(field.nested);
+    auto &value = m_types.layout_at(field.mapped);
+    std::vector<element> keys, values;
+    for (auto &[address, node]: nodes) {
+        keys.push_back(element{node + key_offset, key.size, address + key_offset});
+        values.push_back(element{node + value_offset, value.size, address + value_offset});
+    }
+    prefetch(field.nested, keys);
+    prefetch(field.mapped, values);
+
+    m_out << " = {";
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        m_out << (i ? ", " : "") << "[";
+        print(field.nested, keys[i].data, keys[i].size, keys[i].address);
+        m_out << "] = ";
+        print(field.mapped, values[i].data, values[i].size, values[i].address);
+    }
+}
+
+void value_printer::prefetch(uint32_t layout, const std::vector<element> &elements) {
+    std::unordered_map<uint64_t, uint64_t> wanted;
+    auto want = [&](uint64_t address, uint64_t size) {
+        auto fetched = m_fetched.lower_bound({address, size});
+        if (address && size && size <= max_container_read &&
+            (fetched == m_fetched.end() || fetched->first.first != address)) {
+            wanted[address] = std::max(wanted[address], size);
+        }
+    };
+
+    for (auto &field: m_types.layout_at(layout).fields) {
+        if (field.type != layout_field::kind::std_string && field.type != layout_field::kind::std_vector) {
+            continue;
+        }
+        for (auto &e: elements) {
+            if (field.offset + field.size > e.size) {
+                continue;
+            }
+            auto p = e.data + field.offset;
+            auto start = load_integer(p, 8);
+            auto end = load_integer(p + 8, 8);
+            if (field.type == layout_field::kind::std_string) {
+                if (!(e.address && start == e.address + field.offset + 16)) {
+                    want(start, std::min<uint64_t>(end, max_string));
+                }
+            } else if (auto stride = m_types.layout_at(field.nested).size; stride && end > start) {
+                want(start, std::min<uint64_t>((end - start) / stride, m_max_elements) * stride);
+            }
+        }
+    }
+    if (wanted.empty()) {
+        return;
+    }
+
+    std::vector<memory_request> requests;
+    for (auto [address, size]: wanted) {
+        auto &bytes = m_fetched[{address, size}];
+        bytes.resize(size);
+        requests.push_back(memory_request{address, bytes.data(), size});
+    }
+    m_read_many(requests);
+    for (auto &r: requests) {
+        if (!r.ok) {
+            m_fetched.erase({r.address, r.size});
+        }
+    }
+}
+
+const uint8_t *value_printer::fetch(uint64_t address, std::size_t size) {
+    //entries are never replaced, the elements being printed point into them
+    auto fetched = m_fetched.lower_bound({address, size});
+    if (fetched != m_fetched.end() && fetched->first.first == address) {
+        return fetched->second.data();
+    }
+    std::vector<uint8_t> bytes(size);
+    std::vector<memory_request> request{memory_request{address, bytes.data(), size}};
+    m_read_many(request);
+    if (!request[0].ok) {
+        return nullptr;
+    }
+    return m_fetched.emplace(std::make_pair(address, size), std::move(bytes)).first->second.data();
+}
+
+void value_printer::print_base(DW_ATE encoding, std::size_t size, const uint8_t *data) {
+    auto value = load_integer(data, size);
+    switch (encoding) {
+        case DW_ATE::boolean:
+            m_out << (value ? "true" : "false");
+            break;
+        case DW_ATE::float_: {
+            std::ostringstream text;
+            if (size == sizeof(float)) {
+                float f;
+                std::memcpy(&f, data, sizeof(f));
+                text << std::setprecision(9) << f;
+            } else if (size == sizeof(double)) {
+                double d;
+                std::memcpy(&d, data, sizeof(d));
+                text << std::setprecision(17) << d;
+            } else {
+                long double ld = 0; //the x87 80 bit format in 16 bytes
+                std::memcpy(&ld, data, std::min(size, sizeof(ld)));
+                text << std::setprecision(21) << ld;
+            }
+            m_out << text.str();
+            break;
+        }
+        case DW_ATE::signed_:
+        case DW_ATE::signed_char:
+            if (size > 8) {
+                m_out << "0x" << std::hex << load_integer(data + 8, 8) << std::setw(16) << std::setfill('0') << value
+                      << std::setfill(' ');
+                break;
+            }
+            m_out << std::dec << sign_extend(value, size);
+            if (encoding == DW_ATE::signed_char && size == 1) {
+                m_out << " '";
+                escape(m_out, value, '\'');
+                m_out << "'";
+            }
+            break;
+        default:
+            if (size > 8) {
+                m_out << "0x" << std::hex << load_integer(data + 8, 8) << std::setw(16) << std::setfill('0') << value
+                      << std::setfill(' ');
+                break;
+            }
+            m_out << std::dec << value;
+            if (encoding == DW_ATE::unsigned_char && size == 1) {
+                m_out << " '";
+                escape(m_out, value, '\'');
+                m_out << "'";
+            }
+            break;
+    }
+}
+
+void value_printer::print_string(uint64_t address) {
+    //up to the end of the page first, a string may end just before an unmapped one
+    std::string text;
+    char buffer[max_string];
+    auto to_page_end = 0x1000 - (address & 0xfff);
+    auto first = std::min<std::size_t>(max_string, to_page_end);
+    if (!m_read(address, buffer, first)) {
+        m_out << "<error: Cannot access memory at 0x" << std::hex << address << ">";
+        return;
+    }
+    std::size_t n = first;
+    if (std::find(buffer, buffer + first, '\0') == buffer + first && first < max_string &&
+        m_read(address + first, buffer + first, max_string - first)) {
+        n = max_string;
+    }
+
+    auto length = std::find(buffer, buffer + n, '\0') - buffer;
+    m_out << '"';
+    for (std::ptrdiff_t i = 0; i < length; ++i) {
+        escape(m_out, buffer[i], '"');
+    }
+    m_out << '"' << (length == static_cast<std::ptrdiff_t>(max_string) ? "..." : "");
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/user.h>
+
+#include "registers.h"
+#include "utility.h"
+#include "libelfin/dwarf/dwarf++.hh"
+
+//what printing needs to know of a type DIE, with typedefs and cv-qualifiers stripped
+struct type_desc {
+    enum class kind { base, pointer, reference, structure, array, enumeration, function, unknown };
+
+    //the libstdc++ classes printed by their elements rather than their members
+    enum class container { none, vector, string, map, unordered_map };
+
+    struct member {
+        std::string name;
+        uint64_t offset;
+        const type_desc *type;
+        bool base_class;         //an inherited part, printed as <name> = {...}
+        unsigned bit_size = 0;   //non-zero for bit fields
+        unsigned bit_offset = 0; //from the least significant bit of the bytes at offset
+    };
+
+    kind type = kind::unknown;
+    std::string name;                  //as in the source, "int *" for pointers
+    uint64_t size = 0;
+    dwarf::DW_ATE encoding{};          //of base types
+    const type_desc *target = nullptr; //what a pointer or reference points to, the element of an array
+                                       //or a container, the key of a map
+    const type_desc *mapped = nullptr; //the values of a map
+    container library = container::none;
+    uint64_t count = 0;                //of the elements of an array
+    std::vector<member> members{};
+    std::vector<std::pair<int64_t, std::string>> enumerators{};
+};
+
+//one entry of a flattened type: a value, or the start or end of the braces of a nested structure
+struct layout_field {
+    enum class kind : uint8_t {
+        scalar, bit_field, enumeration, pointer, string_pointer, function_pointer, reference, char_array, array,
+        function, std_vector, std_string, std_map, std_unordered_map, open, close, unknown
+    };
+
+    kind type;
+    dwarf::DW_ATE encoding{};
+    unsigned bit_size = 0;
+    unsigned bit_offset = 0;
+    uint64_t offset = 0;  //from the start of the outermost object
+    uint64_t size = 0;
+    uint64_t count = 0;   //of the elements of arrays
+    uint32_t nested = 0;  //layout of the elements of arrays and containers, the keys of maps and what
+                          //references refer to, the own layout of the other values for their type names,
+                          //the index of the close of opens
+    uint32_t mapped = 0;  //layout of the values of maps
+    std::string name{};   //member name, "<Base>" for base classes, empty at the top
+};
+
+//a type as an array of fields in printing order, nested structures are inlined between open and close
+//fields so a value prints in one pass over its bytes; only arrays and references refer to other layouts
+struct type_layout {
+    std::string name;
+    uint64_t size = 0;
+    uint64_t alignment = 1;
+    std::vector<layout_field> fields;
+    std::vector<std::pair<int64_t, std::string>> enumerators{};
+};
+
+//the types of the DIEs of one DWARF file: DIEs are resolved into descriptions once, keyed by the
+//section offset of the DIE, and descriptions compiled into layouts the first time they are printed
+class type_cache {
+public:
+    //type may be an invalid DIE for void
+    const type_desc &get(const dwarf::die &type);
+
+    //the types expressions produce that may not be in the DWARF: the base type of the given name,
+    //and pointers to any type
+    const type_desc &builtin(const std::string &name, uint64_t size, dwarf::DW_ATE encoding);
+
+    const type_desc &pointer_to(const type_desc &target);
+
+    //the index of the layout of type, compiled on first use
+    uint32_t layout(const dwarf::die &type) { return compile(get(type)); }
+
+    uint32_t layout(const type_desc &type) { return compile(type); }
+
+    const type_layout &layout_at(uint32_t index) const { return m_layouts[index]; }
+
+private:
+    void resolve(const dwarf::die &type, type_desc &desc);
+
+    uint32_t compile(const type_desc &desc);
+
+    void flatten(const type_desc &desc, uint64_t offset, const std::string &name, std::vector<layout_field> &fields);
+
+    std::unordered_map<dwarf::section_offset, const type_desc *> m_types; //typedefs share the entry of their type
+    std::vector<std::unique_ptr<type_desc>> m_owned;
+    type_desc m_void{type_desc::kind::unknown, "void"};
+    std::unordered_map<std::string, const type_desc *> m_builtins;
+    std::unordered_map<const type_desc *, const type_desc *> m_pointers;
+    std::unordered_map<const type_desc *, uint32_t> m_layout_of;
+    std::vector<type_layout> m_layouts;
+};
+
+//where the program keeps a variable in the selected frame
+struct frame_info {
+    const user_regs_struct *regs;
+    uint64_t cfa;          //0 if unknown
+    uint64_t load_address; //added to the link time addresses of DW_OP_addr
+    std::function<bool(uint64_t address, void *buffer, std::size_t size)> read; //for DW_OP_deref and pieces
+};
+
+struct location {
+    enum class kind { memory, value, none };
+    kind type = kind::none;
+    uint64_t address = 0;
+    std::vector<uint8_t> bytes{}; //the value of a variable held in a register or computed
+};
+
+//evaluates DW_AT_location of var, function gives the frame base and is an invalid DIE for globals.
+//Location lists are looked up at the pc of frame, DWARF 4 ones only. A composite (DW_OP_piece)
+//location is read into a value, DW_OP_bit_piece is not supported.
+location locate(const dwarf::die &var, const dwarf::die &function, const frame_info &frame);
+
+//a location of the forms unoptimized code uses, which can be computed without evaluating DWARF
+struct fixed_location {
+    enum class kind {
+        address,         //offset is the link time address
+        cfa_offset,      //offset from the canonical frame address
+        register_offset, //offset from the value of r
+        register_value,  //the variable is held in r
+        other            //needs locate
+    };
+    kind type = kind::other;
+    int64_t offset = 0;
+    reg r = reg::rax;
+};
+
+fixed_location fixed_location_of(const dwarf::die &var, const dwarf::die &function);
+
+struct scoped_variable {
+    dwarf::die die;
+    bool parameter;
+};
+
+//the variables and parameters of function visible at pc (a DWARF address), innermost scope first
+std::vector<scoped_variable> variables_in_scope(const dwarf::die &function, uint64_t pc);
+
+//the name of a variable, also for definitions that refer to their declaration
+std::string variable_name(const dwarf::die &var);
+
+dwarf::die variable_type(const dwarf::die &var);
+
+//the variables defined outside of functions by name, qualified with their namespaces and not
+std::unordered_map<std::string, dwarf::die> index_globals(const dwarf::dwarf &dwarf);
+
+//formats values from a copy of their bytes following their layouts. Memory is only read again for
+//what pointers, references and containers point to. The elements of containers are read in batches,
+//the nodes of a tree one level at a time, and the strings and vectors in the elements of one batch
+//are prefetched together, so printing a large container takes a few vectored reads per level.
+class value_printer {
+public:
+    using memory_reader = std::function<bool(uint64_t address, void *buffer, std::size_t size)>;
+    using bulk_reader = std::function<void(std::vector<memory_request> &requests)>;
+
+    //symbolize names the function at a code address for function pointers, max_elements limits the
+    //elements printed of each array and container
+    value_printer(std::ostream &out, const type_cache &types, memory_reader read, bulk_reader read_many,
+                  std::function<std::string(uint64_t)> symbolize, std::size_t max_elements = 200)
+            : m_out{out}, m_types{types}, m_read{std::move(read)}, m_read_many{std::move(read_many)},
+              m_symbolize{std::move(symbolize)}, m_max_elements{max_elements} {}
+
+    //data holds size bytes of a value of the layout, fields past them are printed as <unavailable>.
+    //address is where the bytes were read from, 0 for values not in memory.
+    void print(uint32_t layout, const uint8_t *data, std::size_t size, uint64_t address = 0);
+
+private:
+    //a value in a buffer of the printer, e.g. an element of a vector or the key of a map node
+    struct element {
+        const uint8_t *data;
+        std::size_t size;
+        uint64_t address;
+    };
+
+    void print_field(const layout_field &field, const uint8_t *data, std::size_t size, uint64_t address);
+
+    void print_std_string(const uint8_t *data, std::size_t available, uint64_t address);
+
+    void print_vector(const layout_field &field, const uint8_t *data);
+
+    void print_map(const layout_field &field, const uint8_t *data);
+
+    void print_unordered_map(const layout_field &field, const uint8_t *data, uint64_t address);
+
+    //prints the pairs of a map, whose nodes hold the key at key_offset and the value at value_offset
+    void print_pairs(const layout_field &field, const std::vector<std::pair<uint64_t, const uint8_t *>> &nodes,
+                     uint64_t key_offset, uint64_t value_offset);
+
+    //reads what the strings and vectors in the elements point to with one batch
+    void prefetch(uint32_t layout, const std::vector<element> &elements);
+
+    //the bytes at address from the prefetched ones or read now, nullptr if they cannot be read
+    const uint8_t *fetch(uint64_t address, std::size_t size);
+
+    void print_base(dwarf::DW_ATE encoding, std::size_t size, const uint8_t *data);
+
+    void print_string(uint64_t address);
+
+    std::ostream &m_out;
+    const type_cache &m_types;
+    memory_reader m_read;
+    bulk_reader m_read_many;
+    std::function<std::string(uint64_t)> m_symbolize;
+    std::size_t m_max_elements;
+    std::map<std::pair<uint64_t, std::size_t>, std::vector<uint8_t>> m_fetched; //by address and size
+};
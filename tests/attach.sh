@@ -0,0 +1,15 @@
+#!/bin/sh
+#attaching seizes every thread of a running process, detaching leaves it running
+. "$(dirname "$0")/lib.sh"
+
+build spin -pthread
+start spin
+sleep 0.2
+printf 'thread\nbt\ndetach\n' | debug spin -a "$started"
+expect '^Attached to process [0-9]* (2 threads), stopped in [0-9]* us$'
+expect '^\* [0-9]* stopped at 0x'
+expect '^  [0-9]* stopped at 0x'
+expect '^#0 0x[0-9a-f]* in spin at .*spin\.cpp:7$'
+expect '^Detached from process [0-9]*, target was stopped for [0-9]* us$'
+sleep 0.1
+not_stopped "$started"
@@ -0,0 +1,23 @@
+#!/bin/sh
+#batch mode exits with the status of the program, 128 + the signal when it is killed at the end of the
+#script, or 1 at the first command that fails; --time prints what every command cost
+. "$(dirname "$0")/lib.sh"
+
+build loop
+status=0
+printf 'break step\ncont\nprint i\n' | "$debugger" --batch --time ./loop > out 2>&1 || status=$?
+test "$status" = 137
+expect '^i = 0$'
+expect '^\[time\] cont: [0-9.]* ms, [0-9]* ptrace, [0-9]* memory syscalls$'
+expect '^\[time\] total: '
+
+printf 'cont\n' | "$debugger" --batch ./loop > out 2>&1
+expect '^4999950000$'
+
+for command in frobnicate 'thread 99999' 'print nope'; do
+    status=0
+    printf 'break step\n%s\ncont\n' "$command" | "$debugger" --batch ./loop > out 2>&1 || status=$?
+    test "$status" = 1
+    expect "^Error in '$command': "
+    reject '^Hit breakpoint'
+done
@@ -0,0 +1,11 @@
+#!/bin/sh
+#class parameters passed by value are found through the pointer their location dereferences
+. "$(dirname "$0")/lib.sh"
+
+build byvalue
+printf 'break take\ncont\nprint s\nprint v\n' | debug byvalue
+expect '^s = "hello"$'
+expect '^v = std::vector of length 3, capacity 3 = {1, 2, 3}$'
+
+printf 'break take if v[1] == 2\ncont\nprint v[2]\n' | debug byvalue
+expect '^v\[2\] = 3$'
@@ -0,0 +1,18 @@
+#!/bin/sh
+#restart goes back to the state of a checkpoint, as often as asked, and the session still ends
+. "$(dirname "$0")/lib.sh"
+
+build loop
+printf 'break step\ncont\ncheckpoint\ncont\ncont\nprint i\nrestart 1\nprint i\nprint total\ncont\nprint i\nrestart 1\nprint i\n' |
+    timeout 30 "$debugger" --batch ./loop > out 2>&1 || true
+expect '^Checkpoint 1: process [0-9]* at 0x[0-9a-f]* in step at .*loop\.cpp:6$'
+expect '^i = 2$'
+test "$(grep -c '^Switched to process [0-9]* from checkpoint 1 in ' out)" = 2
+test "$(grep -c '^i = 0$' out)" = 2
+expect '^total = 0$'
+expect '^i = 1$'
+expect '^Killed process '
+
+build spin -pthread
+printf 'break stop_here\ncont\ncheckpoint\n' | timeout 30 "$debugger" --batch ./spin > out 2>&1 || true
+expect "^Error in 'checkpoint': Checkpoints need a stopped, single threaded program$"
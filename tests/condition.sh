@@ -0,0 +1,17 @@
+#!/bin/sh
+#breakpoint conditions see the pc of the breakpoint and the locals of its frame, ignore counts skip hits
+. "$(dirname "$0")/lib.sh"
+
+build loop -no-pie
+printf 'break step\n' | debug loop
+address=$(sed -n 's/^Set breakpoint 1 at address \(0x[0-9a-f]*\)$/\1/p' out)
+test -n "$address"
+
+printf 'break step if $rip == %s && i == 500\ncont\nprint i\n' "$address" | debug loop
+expect "Hit breakpoint 1 at address $address"
+expect '^i = 500$'
+expect '^500 breakpoint hits did not stop'
+
+printf 'break step if i %% 2 == 1\nignore 1 3\ncont\nprint i\ninfo breakpoints\n' | debug loop
+expect '^i = 7$'
+expect 'stop only if i % 2 == 1'
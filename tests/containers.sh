@@ -0,0 +1,21 @@
+#!/bin/sh
+#libstdc++ vectors, strings, maps and unordered maps print by their elements, a map of 1000 elements
+#is read in a few batches and only up to the element limit
+. "$(dirname "$0")/lib.sh"
+
+build containers
+printf 'break stop_here\ncont\nfinish\nprint numbers\nprint empty\nprint small\nprint large\nprint names\nprint counts\nset print elements 4\nprint squares\nset print elements 0\nprint squares\n' |
+    debug containers --time
+expect '^numbers = std::vector of length 3, capacity 3 = {1, 2, 3}$'
+expect '^empty = std::vector of length 0, capacity 0$'
+expect '^small = "short"$'
+expect '^large = "x\{40\}"$'
+expect '^names = std::map with 3 elements = {\[1\] = "one", \[2\] = "two", \[3\] = "three"}$'
+expect '^counts = std::unordered_map with 1 elements = {\["a"\] = 1}$'
+expect '^squares = std::map with 1000 elements = {\[0\] = 0, \[1\] = 1, \[2\] = 4, \[3\] = 9, \.\.\.}$'
+expect '^squares = std::map with 1000 elements = {.*, \[999\] = 998001}$'
+#a read per level of the tree, not per node
+test "$(grep -c '^\[time\] print squares: ' out)" = 2
+for reads in $(sed -n 's/^\[time\] print squares: .* \([0-9]*\) memory syscalls$/\1/p' out); do
+    test "$reads" -lt 50
+done
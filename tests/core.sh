@@ -0,0 +1,22 @@
+#!/bin/sh
+#a core from gcore is inspected like the stopped process: stack, variables, registers and threads,
+#but it cannot run
+. "$(dirname "$0")/lib.sh"
+
+build loop
+printf 'break step\nignore 1 3\ncont\nregister read rip\ngcore loop.core\n' | debug loop
+rip=$(grep -x '[0-9a-f]*' out | head -n 1)
+test -n "$rip"
+
+status=0
+printf 'bt\nprint i\nprint total\nthread\nregister read rip\ncont\n' | "$debugger" --batch -c loop.core ./loop > out 2>&1 ||
+    status=$?
+test "$status" = 1
+expect '^Core of process [0-9]* (1 threads), terminated by Trace/breakpoint trap at 0x[0-9a-f]* in step at '
+expect '^#0 0x[0-9a-f]* in step at .*loop\.cpp:6$'
+expect '^#1 0x[0-9a-f]* in main at .*loop\.cpp:11$'
+expect '^i = 3$'
+expect '^total = 3$'
+expect '^\* [0-9]* stopped at 0x'
+expect "^$rip\$"
+expect "^Error in 'cont': The program is not running"
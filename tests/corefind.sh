@@ -0,0 +1,17 @@
+#!/bin/sh
+#find in a core reads the pages of a chunk that can be read when another page of it cannot, the part
+#of the last page of a mapped file past its end reads as zeros
+. "$(dirname "$0")/lib.sh"
+
+build mapped
+{ head -c 4500 /dev/zero | tr "\0" x; printf needle; } > data.txt
+ulimit -c unlimited 2>/dev/null || exit 77
+(./mapped) 2>/dev/null || true
+core=$(ls | grep '^core' | head -n 1)
+if [ -z "$core" ]; then
+    exit 77 #core_pattern hands cores to another program
+fi
+
+printf 'find "needle"\n' | debug mapped -c "$core"
+expect '^0x[0-9a-f]* in .*/data\.txt$'
+expect '^1 match in '
@@ -0,0 +1,24 @@
+#!/bin/sh
+#coverage started over a user breakpoint, or before one, counts its hits without taking the int3 for the
+#program's code
+. "$(dirname "$0")/lib.sh"
+
+build loop -no-pie
+printf 'break step\n' | debug loop
+address=$(sed -n 's/^Set breakpoint 1 at address \(0x[0-9a-f]*\)$/\1/p' out)
+test -n "$address"
+
+printf 'break step\ncoverage\ngcore loop.core\ncont\ncoverage report\n' | debug loop
+expect '^Saved loop.core'
+expect '^DA:6,1$'
+
+printf 'memory read %s\n' "$address" | debug loop -c loop.core
+expect '^[0-9a-f]*$'
+reject 'cc$'
+
+#a user breakpoint set after the coverage points keeps stopping once its coverage point was hit
+printf 'coverage\nbreak step\ncont\nprint i\ncont\nprint i\ncoverage report\n' | debug loop
+expect '^i = 0$'
+expect '^i = 1$'
+expect '^DA:6,1$'
+expect '^DA:13,0$'
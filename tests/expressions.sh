@@ -0,0 +1,28 @@
+#!/bin/sh
+#print evaluates C expressions with the precedence of C over literals, variables, members, pointers
+#and registers; bad expressions are errors
+. "$(dirname "$0")/lib.sh"
+
+build types
+printf '%s\n' 'break stop_here' cont finish 'print 1 + 2 * 3 - 4 / 2' 'print (1 + 2) * 3 % 4' 'print -7 / 2' \
+    'print 7.5 / 2' 'print 1 << 4 | 3 ^ 1' 'print ~0 & 0xff' 'print !0 && 3 > 2 || 0' \
+    'print square.corners[1].x * origin.y' 'print square.origin->x' 'print &origin == square.origin' \
+    "print square.name[1]" "print 'a' + 1" 'print $rip != 0' | debug types
+expect '^1 + 2 \* 3 - 4 / 2 = 5$'
+expect '^(1 + 2) \* 3 % 4 = 1$'
+expect '^-7 / 2 = -3$'
+expect '^7\.5 / 2 = 3\.75$'
+expect '^1 << 4 | 3 ^ 1 = 18$'
+expect '^~0 & 0xff = 255$'
+expect '^!0 && 3 > 2 || 0 = 1$'
+expect '^square\.corners\[1\]\.x \* origin\.y = 8$'
+expect '^square\.origin->x = -1$'
+expect '^&origin == square\.origin = 1$'
+expect "^square\.name\[1\] = 113 'q'$"
+expect "^'a' + 1 = 98$"
+expect '^\$rip != 0 = 1$'
+
+for error in '1 / (origin.x + 1):Division by zero' 'nothing + 1:nothing' '1 +:' 'origin[0]:Cannot subscript'; do
+    printf 'break stop_here\ncont\nfinish\nprint %s\n' "${error%%:*}" | debug types
+    expect "^Error in 'print .*': .*${error#*:}"
+done
@@ -0,0 +1,23 @@
+#!/bin/sh
+#find searches the memory of the process for strings, bytes with wildcards and integers, all of it or
+#a range
+. "$(dirname "$0")/lib.sh"
+
+build relro -pie -fPIE
+printf 'break main\ncont\nprint names\nprint &names\n' | debug relro
+set -- $(sed -n 's/^names = {\(0x[0-9a-f]*\) "alpha", \(0x[0-9a-f]*\) "beta", \(0x[0-9a-f]*\) "gamma"}$/\1 \2 \3/p' out)
+test "$#" = 3
+alpha=$1
+beta=$2
+gamma=$3
+array=$(sed -n 's/^&names = .* \(0x[0-9a-f]*\)$/\1/p' out)
+test -n "$array"
+
+printf 'break main\ncont\nfind "gamma"\nfind x:61 6c ?? 68 61 00\nfind %s\nfind %s +0x100 "beta"\nfind\n' "$alpha" "$alpha" |
+    debug relro
+expect "^$gamma in .*/relro\$"
+expect "^$alpha in .*/relro\$"
+expect "^$array in .*/relro\$"
+expect "^$beta in .*/relro\$"
+expect '^1 match in 0\.0 MiB in '
+expect "^Error in 'find': Usage: find "
@@ -0,0 +1,15 @@
+#!/bin/sh
+#gcore writes a core with a note per thread and the program goes on unharmed
+. "$(dirname "$0")/lib.sh"
+
+build spin -pthread
+printf 'break stop_here\ncont\ngcore spin.core\n' | debug spin
+expect '^Saved spin.core: [0-9]* segments, [0-9]* KiB written'
+test "$(readelf -nW spin.core | grep -c NT_PRSTATUS)" = 2
+readelf -lW spin.core | grep -q '^  NOTE '
+
+build loop
+printf 'break main\ncont\ngcore loop.core\ncont\n' | debug loop
+expect '^Saved loop.core'
+expect '^4999950000$'
+expect 'exited with code 0$'
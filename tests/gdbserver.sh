@@ -0,0 +1,45 @@
+#!/bin/sh
+#the remote protocol over stdio: packets are acknowledged, memory reads hide the int3 of breakpoints,
+#only a trap of an int3 is reported as swbreak
+. "$(dirname "$0")/lib.sh"
+
+#packet <data>: the data framed with its checksum
+packet() {
+    sum=$(printf '%s' "$1" | od -An -tu1 -v | tr -s ' ' '\n' | awk 'NF { s += $1 } END { printf "%02x", s % 256 }')
+    printf '$%s#%s' "$1" "$sum"
+}
+
+build loop -no-pie
+step=$(nm loop | sed -n 's/^0*\([0-9a-f]*\) T _Z4stepi$/\1/p')
+second=$(objdump -d --no-show-raw-insn loop | sed -n "/<_Z4stepi>:/{n;n;s/^ *\([0-9a-f]*\):.*/\1/p;}")
+total=$(nm loop | sed -n 's/^0*\([0-9a-f]*\) B total$/\1/p')
+test -n "$step" && test -n "$second" && test -n "$total"
+
+{
+    packet qSupported:swbreak+
+    packet '?'
+    printf '$?#zz'
+    packet "Z0,$step,1"
+    packet 'vCont;c'
+    packet "m$step,1"
+    packet "x$step,1"
+    packet "Z0,$second,1"
+    packet 'vCont;s'
+    packet "m$total,8"
+    packet "Z2,$(printf '%x' $((0x$total + 1))),4"
+    packet k
+} | timeout 30 "$debugger" --gdbserver stdio ./loop > out 2> err || true
+
+#the replies one per line, the acknowledgements before them
+sed 's/\$\([^#]*\)#../\n\1\n/g' out > replies
+cp replies out
+expect '^-+$'
+expect 'PacketSize=[0-9a-f]*;.*swbreak+'
+expect '^T05thread:[0-9a-f]*;$'
+expect '^T05thread:[0-9a-f]*;swbreak:;$'
+expect '^55$'
+expect '^bU$'
+expect '^0000000000000000$'
+expect '^E22$'
+expect '^OK$'
+test "$(grep -c 'swbreak:' out)" = 1
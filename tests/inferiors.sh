@@ -0,0 +1,23 @@
+#!/bin/sh
+#several -a processes of one program: @N selects where a command runs, @all runs it on every one
+. "$(dirname "$0")/lib.sh"
+
+build spin -pthread
+start spin
+first=$started
+start spin
+second=$started
+sleep 0.2
+printf '@all bt\n@2 print counter\n@all detach\n' | timeout 30 "$debugger" -a "$first" -a "$second" > out 2>&1 || true
+expect '^Debugging 2 processes of .*/spin$'
+expect "^\[1\] Attached to process $first "
+expect "^\[2\] Attached to process $second "
+expect '^\[1\] #0 0x[0-9a-f]* in spin at '
+expect '^\[2\] #0 0x[0-9a-f]* in spin at '
+expect '^\[2\] counter = [0-9]*$'
+reject '^\[1\] counter'
+expect "^\[1\] Detached from process $first"
+expect "^\[2\] Detached from process $second"
+sleep 0.1
+not_stopped "$first"
+not_stopped "$second"
@@ -0,0 +1,55 @@
+#!/bin/sh
+#sourced by the tests: $1 is the debugger, the test runs in a fresh directory that is removed afterwards
+set -e
+debugger=$1
+tests=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+running=
+trap 'kill $running 2>/dev/null || true; rm -rf "$work"' EXIT
+cd "$work"
+
+#build <program> [compiler flags]: compiles tests/programs/<program>.cpp into ./<program>
+build() {
+    name=$1
+    shift
+    g++ -gdwarf-4 -O0 "$@" -o "$name" "$tests/programs/$name.cpp"
+}
+
+#start <program>: runs ./<program> in the background for the debugger to attach to, its pid is in
+#$started. It is killed at the end of the test.
+start() {
+    "./$1" > /dev/null 2>&1 &
+    started=$!
+    running="$running $started"
+}
+
+#debug <program> [debugger options]: runs the commands on stdin in batch mode, the output goes to ./out
+debug() {
+    name=$1
+    shift
+    "$debugger" --batch "$@" "./$name" > out 2>&1 || true
+}
+
+expect() {
+    if ! grep -q -- "$1" out; then
+        echo "expected: $1"
+        cat out
+        exit 1
+    fi
+}
+
+reject() {
+    if grep -q -- "$1" out; then
+        echo "unexpected: $1"
+        cat out
+        exit 1
+    fi
+}
+
+#fails if process $1 is stopped, e.g. left stopped by a detach
+not_stopped() {
+    if grep -q '^State:.*\(stopped\|tracing stop\)' "/proc/$1/status"; then
+        echo "process $1 is stopped"
+        exit 1
+    fi
+}
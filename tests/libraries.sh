@@ -0,0 +1,14 @@
+#!/bin/sh
+#a breakpoint on a function of a library the program loads later stays pending until the library
+#appears, stops there with the library's symbols and lines, and the program goes on afterwards
+. "$(dirname "$0")/lib.sh"
+
+g++ -gdwarf-4 -O0 -shared -fPIC -o libplugin.so "$tests/programs/plugin.cpp"
+build host -ldl
+printf 'break plugin_entry\ncont\nbt\ncont\n' | debug host
+expect '^No function plugin_entry yet, the breakpoint is set when a library defining it is loaded$'
+expect '^Resolved pending breakpoint on plugin_entry in .*/libplugin\.so$'
+expect '^#0 0x[0-9a-f]* in plugin_entry at .*plugin\.cpp:2 from .*/libplugin\.so$'
+expect '^#1 0x[0-9a-f]* in main at .*host\.cpp:11$'
+expect '^42$'
+expect 'exited with code 0$'
@@ -0,0 +1,11 @@
+#!/bin/sh
+#variables of optimized code are found through the entry of their location list that covers the pc
+. "$(dirname "$0")/lib.sh"
+
+#libelfin rejects the DW_AT_GNU_locviews attribute of the location views
+build optimized -O2 -no-pie -gno-variable-location-views
+printf 'break sum\ncont\nprint n\nprint total\nbreak optimized.cpp:13\ncont\ncont\nprint total\nprint i\n' | debug optimized
+expect '^n = 10$'
+expect '^total = 0$'
+expect '^total = 1$'
+expect '^i = 1$'
@@ -0,0 +1,13 @@
+#!/bin/sh
+#--perf samples a launched program without tracing it; the Total column counts a sample once per
+#function, however deep the recursion
+. "$(dirname "$0")/lib.sh"
+
+build recursive
+"$debugger" --perf --hz 1000 ./recursive > out 2>&1 || true
+if grep -q 'perf_event_open failed' out; then
+    exit 77
+fi
+expect '^Samples: [1-9][0-9]* (lost [0-9]*), threads: 1$'
+expect '^ *[0-9.]*% 100\.00% *[0-9]*  fib \[recursive\]$'
+expect 'recursive\.cpp:2$'
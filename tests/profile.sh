@@ -0,0 +1,24 @@
+#!/bin/sh
+#--profile samples until the program exits by default, rates and durations out of range are errors
+. "$(dirname "$0")/lib.sh"
+
+build busy
+"$debugger" --profile ./busy > out 2> err
+grep -q '^[0-9]* samples' err
+expect ";main;work;.* [0-9]*$"
+
+if "$debugger" --profile --duration -1 ./busy > out 2>&1; then
+    exit 1
+fi
+expect '^Error: The sampling rate of a profile must be positive, its duration not negative$'
+
+build loop
+printf 'break step\ncont\nprofile -1\n' | debug loop
+expect "^Error in 'profile -1': The sampling rate of a profile must be positive, its duration not negative$"
+
+printf 'break step\ncont\nprofile 1 0\n' | debug loop
+expect "^Error in 'profile 1 0': The sampling rate of a profile must be positive"
+
+printf 'break step\ncont\nprofile 0\n' | debug loop
+reject '^Error'
+expect '^[0-9]* samples'
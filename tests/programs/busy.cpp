@@ -0,0 +1,15 @@
+#include <chrono>
+
+volatile unsigned long counter;
+
+void work() {
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds{300};
+    while (std::chrono::steady_clock::now() < end) {
+        ++counter;
+    }
+}
+
+int main() {
+    work();
+    return 0;
+}
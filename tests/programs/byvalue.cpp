@@ -0,0 +1,13 @@
+#include <string>
+#include <vector>
+
+std::size_t total;
+
+void take(std::string s, std::vector<int> v) {
+    total = s.size() + v.size();
+}
+
+int main() {
+    take("hello", {1, 2, 3});
+    return 0;
+}
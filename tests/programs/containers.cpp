@@ -0,0 +1,22 @@
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+void stop_here() {
+}
+
+int main() {
+    std::vector<int> numbers{1, 2, 3};
+    std::vector<int> empty;
+    std::string small = "short";
+    std::string large(40, 'x');
+    std::map<int, std::string> names{{2, "two"}, {1, "one"}, {3, "three"}};
+    std::unordered_map<std::string, int> counts{{"a", 1}};
+    std::map<int, int> squares;
+    for (int i = 0; i < 1000; ++i) {
+        squares[i] = i * i;
+    }
+    stop_here();
+    return 0;
+}
@@ -0,0 +1,9 @@
+#include <cstdio>
+#include <unistd.h>
+
+int main() {
+    std::printf("hello\n");
+    std::fflush(stdout);
+    execl("/bin/true", "true", nullptr);
+    return 1;
+}
@@ -0,0 +1,13 @@
+#include <cstdio>
+#include <dlfcn.h>
+
+//loads ./libplugin.so, built from plugin.cpp, after the program started
+int main() {
+    auto handle = dlopen("./libplugin.so", RTLD_NOW);
+    if (!handle) {
+        return 1;
+    }
+    auto entry = reinterpret_cast<int (*)(int)>(dlsym(handle, "plugin_entry"));
+    std::printf("%d\n", entry(21));
+    return 0;
+}
@@ -0,0 +1,15 @@
+#include <cstdio>
+
+long total = 0;
+
+void step(int i) {
+    total += i;
+}
+
+int main() {
+    for (int i = 0; i < 100000; ++i) {
+        step(i);
+    }
+    std::printf("%ld\n", total);
+    return 0;
+}
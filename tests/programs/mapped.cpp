@@ -0,0 +1,11 @@
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+//maps three pages of data.txt, which is shorter: the last page cannot be read. The kernel leaves the
+//mapping out of the core, it is read from the file.
+int main() {
+    auto fd = open("data.txt", O_RDONLY);
+    mmap(nullptr, 3 * 4096, PROT_READ, MAP_PRIVATE, fd, 0);
+    std::abort();
+}
@@ -0,0 +1,21 @@
+#include <cstdio>
+
+volatile int sink;
+
+__attribute__((noinline)) void report(int value) {
+    sink = value;
+}
+
+__attribute__((noinline)) int sum(int n) {
+    int total = 0;
+    for (int i = 0; i < n; ++i) {
+        total += i * i;
+        report(total);
+    }
+    return total;
+}
+
+int main() {
+    std::printf("%d\n", sum(10));
+    return 0;
+}
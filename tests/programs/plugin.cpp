@@ -0,0 +1,3 @@
+extern "C" int plugin_entry(int x) {
+    return x * 2;
+}
@@ -0,0 +1,11 @@
+long fib(int n) {
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+int main() {
+    long sum = 0;
+    for (int i = 0; i < 20; ++i) {
+        sum += fib(30);
+    }
+    return sum == 42;
+}
@@ -0,0 +1,8 @@
+#include <cstdio>
+
+const char *const names[] = {"alpha", "beta", "gamma"};
+
+int main() {
+    std::puts(names[1]);
+    return 0;
+}
@@ -0,0 +1,18 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+
+const char *text;
+
+void look() {
+}
+
+int main() {
+    auto first = open("first.txt", O_RDONLY);
+    auto second = open("second.txt", O_RDONLY);
+    text = static_cast<const char *>(mmap(nullptr, 4096, PROT_READ, MAP_PRIVATE, first, 0));
+    look();
+    //another file at the same address, without a library load the debugger would notice
+    mmap(const_cast<char *>(text), 4096, PROT_READ, MAP_PRIVATE | MAP_FIXED, second, 0);
+    look();
+    return 0;
+}
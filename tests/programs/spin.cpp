@@ -0,0 +1,18 @@
+#include <thread>
+
+volatile unsigned long counter;
+
+void spin() {
+    for (;;) {
+        ++counter;
+    }
+}
+
+void stop_here() {
+    spin();
+}
+
+int main() {
+    std::thread worker{spin};
+    stop_here();
+}
@@ -0,0 +1,32 @@
+#include <atomic>
+
+enum class colour { red, green = 5, blue };
+
+struct point {
+    int x;
+    int y;
+};
+
+struct shape {
+    const char *name;
+    point corners[2];
+    colour fill;
+    unsigned visible : 1;
+    unsigned layer : 3;
+    union {
+        int as_int;
+        float as_float;
+    } tag;
+    point *origin;
+    std::atomic<int> refs;
+};
+
+void stop_here(const shape &s) {
+}
+
+int main() {
+    point origin{-1, 2};
+    shape square{"square", {{0, 0}, {4, 4}}, colour::green, 1, 5, {7}, &origin, {3}};
+    stop_here(square);
+    return 0;
+}
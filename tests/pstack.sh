@@ -0,0 +1,13 @@
+#!/bin/sh
+#--pstack prints the stack of every thread and leaves the process running
+. "$(dirname "$0")/lib.sh"
+
+build spin -pthread
+start spin
+sleep 0.2
+"$debugger" --pstack -a "$started" > out 2>&1
+test "$(grep -c '^Thread [0-9]*:$' out)" = 2
+expect '^#1  0x[0-9a-f]* in stop_here at .*spin\.cpp:12 from '
+expect '^Target stopped for [0-9]* us (2 threads, [0-9]* KiB of stack)$'
+sleep 0.1
+not_stopped "$started"
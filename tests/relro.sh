@@ -0,0 +1,8 @@
+#!/bin/sh
+#the pointers of a PIE's relocated read-only data are read from the process, not the file
+. "$(dirname "$0")/lib.sh"
+
+build relro -pie -fPIE
+printf 'break main\ncont\nprint names\n' | debug relro
+expect 'names = {0x[0-9a-f]* "alpha", 0x[0-9a-f]* "beta", 0x[0-9a-f]* "gamma"}'
+reject 'Cannot access memory'
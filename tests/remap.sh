@@ -0,0 +1,11 @@
+#!/bin/sh
+#memory read from a mapped file after the program mapped another file at the same address shows the
+#new file, not the one the cached mappings still name
+. "$(dirname "$0")/lib.sh"
+
+build remap
+echo first > first.txt
+echo second > second.txt
+printf 'break look\ncont\nprint text\ncont\nprint text\n' | debug remap
+expect '^text = 0x[0-9a-f]* "first\\n"$'
+expect '^text = 0x[0-9a-f]* "second\\n"$'
@@ -0,0 +1,11 @@
+#!/bin/sh
+#a command that fails while other threads run in non-stop mode is reported and leaves them running,
+#the interrupt at the end lets the session end at the end of the input
+. "$(dirname "$0")/lib.sh"
+
+build spin -pthread
+(printf 'nonstop\nbreak stop_here\ncont\n'; sleep 1; printf 'gcore missing/spin.core\n'; sleep 1; printf 'thread\ninterrupt\n'; sleep 1) |
+    timeout 30 "$debugger" ./spin > out 2>&1 || true
+expect '^Hit breakpoint 1'
+expect 'Error: Cannot open missing/spin.core'
+expect '^  [0-9]* running$'
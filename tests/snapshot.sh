@@ -0,0 +1,15 @@
+#!/bin/sh
+#diff lists the ranges that changed since a snapshot and the variable they belong to
+. "$(dirname "$0")/lib.sh"
+
+build loop
+printf 'break step\ncont\nprint &total\n' | debug loop
+total=$(sed -n 's/^&total = .* \(0x[0-9a-f]*\)$/\1/p' out)
+test -n "$total"
+
+printf 'break step\ncont\ncont\nsnapshot a %s +0x10\ndiff a\ncont\ncont\ndiff a\ndiff b\n' "$total" | debug loop
+expect "^Snapshot a of $total-0x[0-9a-f]* (16 bytes) in "
+expect '^0 changed ranges, 0 of 16 bytes, compared in '
+expect "^$total-0x[0-9a-f]* (1 bytes) in total\$"
+expect '^1 changed ranges, 1 of 16 bytes, compared in '
+expect "^Error in 'diff b': No snapshot b$"
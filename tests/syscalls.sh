@@ -0,0 +1,11 @@
+#!/bin/sh
+#tracing execve lets the exec launching the program pass and reports the ones the program makes
+. "$(dirname "$0")/lib.sh"
+
+build exec
+"$debugger" --syscalls execve,write ./exec > out 2>&1
+expect '^hello$'
+expect 'write(1, "hello\\n", 6) = 6'
+expect 'execve("/bin/true", .*) = 0'
+expect 'exited with code 0'
+test "$(grep -c 'execve(' out)" = 1
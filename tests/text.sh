@@ -0,0 +1,14 @@
+#!/bin/sh
+#code is read from the executable without a syscall, with the int3 of the breakpoints in it like in
+#the process, until the debugger writes into it
+. "$(dirname "$0")/lib.sh"
+
+build loop -no-pie
+step=0x$(nm loop | sed -n 's/^0*\([0-9a-f]*\) T _Z4stepi$/\1/p')
+printf 'break step\nmemory read %s\nmemory write %s 0x1122334455667788\nmemory read %s\n' "$step" "$step" "$step" |
+    debug loop --time
+expect "^\[time\] memory read $step: [0-9.]* ms, 0 ptrace, 0 memory syscalls$"
+#the breakpoint is after the 7 bytes of the prologue, the int3 is the top byte of the little endian word
+expect '^cc[0-9a-f]\{14\}$'
+expect '^1122334455667788$'
+expect "^\[time\] memory read $step: [0-9.]* ms, 0 ptrace, 1 memory syscalls$"
@@ -0,0 +1,26 @@
+#!/bin/sh
+#a stop parks every thread in all-stop mode, in non-stop mode the others keep running until interrupted
+. "$(dirname "$0")/lib.sh"
+
+build spin -pthread
+counters() {
+    sed -n 's/^.*counter = \([0-9]*\)$/\1/p' out | tr '\n' ' '
+}
+
+(printf 'break stop_here\ncont\nthread\nprint counter\n'; sleep 0.3; printf 'print counter\n') |
+    timeout 30 "$debugger" --batch ./spin > out 2>&1 || true
+expect '^\* [0-9]* stopped at 0x'
+expect '^  [0-9]* stopped at 0x'
+set -- $(counters)
+test "$#" = 2
+test "$1" = "$2"
+
+#the prompt services the events of running threads while it waits for input, a script does not
+(printf 'nonstop\nbreak stop_here\ncont\n'; sleep 0.5; printf 'thread\nprint counter\n'; sleep 0.3; printf 'print counter\ninterrupt\nthread\n') |
+    timeout 30 "$debugger" ./spin > out 2>&1 || true
+expect '^  [0-9]* running$'
+expect 'Thread [0-9]* interrupted at 0x[0-9a-f]* in spin at '
+expect '^\* [0-9]* stopped at 0x[0-9a-f]*$'
+set -- $(counters)
+test "$#" = 2
+test "$1" != "$2"
@@ -0,0 +1,15 @@
+#!/bin/sh
+#tracepoints record the pc of the tracepoint, registers as they are there and the locals of its frame
+. "$(dirname "$0")/lib.sh"
+
+build loop -no-pie
+printf 'break step\n' | debug loop
+address=$(sed -n 's/^Set breakpoint 1 at address \(0x[0-9a-f]*\)$/\1/p' out)
+test -n "$address"
+
+printf 'break loop.cpp:13\ntrace step collect i, $rip, $regs\ncont\ntdump\n' | debug loop
+expect "^Tracepoint 2 at $address in step"
+expect "#2 $address  i = 0, \$rip = $address, \$rax = "
+expect "#2 $address  i = 99999, \$rip = $address,"
+expect '^100000 hits of 1 tracepoint$'
+expect '^100000 hits recorded, 0 dropped'
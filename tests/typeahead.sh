@@ -0,0 +1,12 @@
+#!/bin/sh
+#without a terminal the prompt reads stdin through the event loop too, so commands sent while the
+#program runs are neither lost nor rejected, they run at the next stop
+. "$(dirname "$0")/lib.sh"
+
+build busy
+(printf 'break busy.cpp:14\ncont\n'; sleep 0.1; printf 'print counter > 0\nprint 1 + 1') |
+    timeout 30 "$debugger" ./busy > out 2>&1 || true
+expect '^Hit breakpoint'
+expect '^counter > 0 = 1$'
+expect '^1 + 1 = 2$'
+reject 'is running'
@@ -0,0 +1,12 @@
+#!/bin/sh
+#structures are printed through their compiled layouts: nested structures and arrays, enumerators,
+#bit fields, unions, pointers, references and base classes
+. "$(dirname "$0")/lib.sh"
+
+build types
+printf 'break stop_here\ncont\nprint s\nfinish\nprint origin\nprint square\n' | debug types
+expect '^s = @0x[0-9a-f]*: {name = 0x[0-9a-f]* "square", corners = {{x = 0, y = 0}, {x = 4, y = 4}}, fill = green, '
+expect 'visible = 1, layer = 5, tag = {as_int = 7, as_float = [0-9.e-]*}, origin = (point \*) 0x[0-9a-f]*, '
+expect 'refs = {<__atomic_base<int>> = {_M_i = 3}}}$'
+expect '^origin = {x = -1, y = 2}$'
+expect '^square = {name = 0x[0-9a-f]* "square", corners = '